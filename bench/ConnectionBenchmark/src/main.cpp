@@ -0,0 +1,385 @@
+/**
+ * @file main.cpp
+ *
+ * This module holds the main() function, which is the entrypoint
+ * to the program which compares the Connection backends available on
+ * Linux by how many system calls and how much processor time each needs
+ * to receive a steady flood of traffic from a synthetic Twitch chat
+ * server on the loopback interface, and how many bytes received each
+ * copies out of the buffers it receives into.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <SyntheticServer.hpp>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <Twitch/ConnectionAdapter.hpp>
+#include <Twitch/EpollConnection.hpp>
+#ifdef TWITCH_HAVE_IO_URING
+#include <Twitch/UringConnection.hpp>
+#endif /* TWITCH_HAVE_IO_URING */
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the line terminator used by the Twitch server.
+     */
+    const std::string CRLF = "\r\n";
+
+    /**
+     * This holds the settings of the benchmark.
+     */
+    struct Settings {
+        /**
+         * This is the total number of lines per second the server sends,
+         * spread evenly across all connections.
+         */
+        size_t linesPerSecond = 100000;
+
+        /**
+         * This is the number of connections to make to the server.
+         */
+        size_t numConnections = 10;
+
+        /**
+         * This is how long, in seconds, to measure each backend.
+         */
+        double duration = 5.0;
+    };
+
+    /**
+     * This holds what was measured for one backend.
+     */
+    struct Results {
+        /**
+         * This is the number of lines received.
+         */
+        uint64_t linesReceived = 0;
+
+        /**
+         * This is the number of system calls made.
+         */
+        uint64_t systemCalls = 0;
+
+        /**
+         * This is the number of bytes received which were copied out of
+         * the buffers the backend received them into.
+         */
+        uint64_t bytesCopied = 0;
+
+        /**
+         * This is the processor time used, user and system together,
+         * in seconds.
+         */
+        double cpuTime = 0.0;
+
+        /**
+         * This is the wall clock time of the measurement, in seconds.
+         */
+        double wallTime = 0.0;
+    };
+
+    /**
+     * This function returns the processor time used so far by the
+     * process, user and system together, in seconds.
+     *
+     * @return
+     *     The processor time used so far by the process is returned.
+     */
+    double GetCpuTime() {
+        struct rusage usage;
+        (void)getrusage(RUSAGE_SELF, &usage);
+        return (
+            (double)usage.ru_utime.tv_sec + (double)usage.ru_utime.tv_usec / 1e6
+            + (double)usage.ru_stime.tv_sec + (double)usage.ru_stime.tv_usec / 1e6
+        );
+    }
+
+    /**
+     * This function starts the synthetic server in a child process,
+     * so that its work isn't counted against the backends measured.
+     *
+     * @param[in] settings
+     *     These are the settings of the benchmark.
+     *
+     * @param[out] child
+     *     This is where to store the process identifier of the child.
+     *
+     * @return
+     *     The port on which the server is listening is returned.
+     *
+     * @retval 0
+     *     This is returned if the server could not be started.
+     */
+    uint16_t StartServer(const Settings& settings, pid_t& child) {
+        int channel[2];
+        if (pipe(channel) != 0) {
+            return 0;
+        }
+        child = fork();
+        if (child < 0) {
+            return 0;
+        }
+        if (child == 0) {
+            (void)close(channel[0]);
+            Twitch::SyntheticServer server;
+            Twitch::SyntheticServer::Configuration configuration;
+            configuration.linesPerSecond = settings.linesPerSecond / settings.numConnections;
+            uint16_t port = 0;
+            if (server.Start(configuration)) {
+                port = server.GetPort();
+            }
+            (void)write(channel[1], &port, sizeof(port));
+            (void)close(channel[1]);
+            if (port != 0) {
+                for (;;) {
+                    (void)pause();
+                }
+            }
+            _exit(EXIT_FAILURE);
+        }
+        (void)close(channel[1]);
+        uint16_t port = 0;
+        if (read(channel[0], &port, sizeof(port)) != sizeof(port)) {
+            port = 0;
+        }
+        (void)close(channel[0]);
+        return port;
+    }
+
+    /**
+     * This function measures one backend.
+     *
+     * @param[in] settings
+     *     These are the settings of the benchmark.
+     *
+     * @param[in] makeConnection
+     *     This is the function to call to make each connection.
+     *
+     * @param[in] getSystemCallCount
+     *     This is the function to call to get the number of system calls
+     *     made so far by the backend.
+     *
+     * @param[in] getBytesCopied
+     *     This is the function to call to get the number of bytes
+     *     received so far which the backend copied out of the buffers
+     *     it received them into.
+     *
+     * @param[in] borrow
+     *     This indicates whether or not to receive through the buffer
+     *     received delegate, which lets the backend lend out its buffers,
+     *     rather than the message received delegate.
+     *
+     * @return
+     *     What was measured is returned.
+     */
+    Results Measure(
+        const Settings& settings,
+        std::function< std::shared_ptr< Twitch::Connection >() > makeConnection,
+        std::function< uint64_t() > getSystemCallCount,
+        std::function< uint64_t() > getBytesCopied,
+        bool borrow
+    ) {
+        std::atomic< uint64_t > linesReceived(0);
+        const auto countLines = [&linesReceived](const char* data, size_t length){
+            uint64_t lines = 0;
+            for (size_t i = 0; i < length; ++i) {
+                if (data[i] == '\n') {
+                    ++lines;
+                }
+            }
+            (void)linesReceived.fetch_add(lines, std::memory_order_relaxed);
+        };
+        std::vector< std::shared_ptr< Twitch::Connection > > connections;
+        for (size_t i = 0; i < settings.numConnections; ++i) {
+            const auto connection = makeConnection();
+            if (borrow) {
+                Twitch::ConnectionAdapter::Adapt(connection)->SetBufferReceivedDelegate(
+                    [countLines](Twitch::ConnectionV2::ReceivedBuffer&& buffer){
+                        countLines(buffer.GetData(), buffer.GetLength());
+                    }
+                );
+            } else {
+                connection->SetMessageReceivedDelegate(
+                    [countLines](const std::string& message){
+                        countLines(message.data(), message.length());
+                    }
+                );
+            }
+            if (!connection->Connect()) {
+                fprintf(stderr, "error: unable to connect to synthetic server\n");
+                exit(EXIT_FAILURE);
+            }
+            connection->Send("NICK justinfan" + std::to_string(i) + CRLF);
+            connection->Send("JOIN #channel" + std::to_string(i) + CRLF);
+            connections.push_back(connection);
+        }
+
+        // Let the flood settle before measuring.
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        Results results;
+        const auto linesBefore = linesReceived.load();
+        const auto systemCallsBefore = getSystemCallCount();
+        const auto bytesCopiedBefore = getBytesCopied();
+        const auto cpuTimeBefore = GetCpuTime();
+        const auto start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::duration< double >(settings.duration));
+        results.linesReceived = linesReceived.load() - linesBefore;
+        results.systemCalls = getSystemCallCount() - systemCallsBefore;
+        results.bytesCopied = getBytesCopied() - bytesCopiedBefore;
+        results.cpuTime = GetCpuTime() - cpuTimeBefore;
+        results.wallTime = std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count();
+        for (const auto& connection: connections) {
+            connection->Disconnect();
+        }
+        return results;
+    }
+
+    /**
+     * This function prints what was measured for one backend.
+     *
+     * @param[in] name
+     *     This is the name of the backend.
+     *
+     * @param[in] results
+     *     This is what was measured.
+     */
+    void Report(const char* name, const Results& results) {
+        const auto linesPerSecond = (double)results.linesReceived / results.wallTime;
+        printf(
+            "%-13s lines/s: %9.0f  syscalls/line: %6.3f  copied B/line: %6.1f  CPU ms/s: %7.1f  CPU ms per 100k lines/s: %7.1f\n",
+            name,
+            linesPerSecond,
+            (results.linesReceived == 0) ? 0.0 : (double)results.systemCalls / (double)results.linesReceived,
+            (results.linesReceived == 0) ? 0.0 : (double)results.bytesCopied / (double)results.linesReceived,
+            results.cpuTime * 1000.0 / results.wallTime,
+            (linesPerSecond == 0.0) ? 0.0 : results.cpuTime * 1000.0 / results.wallTime * 100000.0 / linesPerSecond
+        );
+    }
+
+}
+
+/**
+ * This function prints to the standard error stream information
+ * about how to use this program.
+ */
+void PrintUsageInformation() {
+    fprintf(
+        stderr,
+        (
+            "Usage: TwitchConnectionBenchmark [OPTION]...\n"
+            "\n"
+            "Compare the Connection backends by system calls per line received, bytes\n"
+            "copied out of receive buffers per line, and processor time used, receiving\n"
+            "traffic from a synthetic Twitch chat server on the loopback interface.\n"
+            "io_uring is measured both lending out its buffers and copying out of them.\n"
+            "\n"
+            "  --rate N          Total lines per second sent by the server (default: 100000)\n"
+            "  --connections N   Connections to make (default: 10)\n"
+            "  --duration S      Seconds to measure each backend (default: 5)\n"
+        )
+    );
+}
+
+/**
+ * This function is the entrypoint of the program.
+ *
+ * @param[in] argc
+ *     This is the number of command-line arguments given to the program.
+ *
+ * @param[in] argv
+ *     This is the array of command-line arguments given to the program.
+ */
+int main(int argc, char* argv[]) {
+    Settings settings;
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (i + 1 >= argc) {
+            PrintUsageInformation();
+            return EXIT_FAILURE;
+        }
+        const char* value = argv[++i];
+        if (option == "--rate") {
+            settings.linesPerSecond = (size_t)strtoull(value, NULL, 10);
+        } else if (option == "--connections") {
+            settings.numConnections = (size_t)strtoull(value, NULL, 10);
+        } else if (option == "--duration") {
+            settings.duration = strtod(value, NULL);
+        } else {
+            PrintUsageInformation();
+            return EXIT_FAILURE;
+        }
+    }
+    if (
+        (settings.linesPerSecond == 0)
+        || (settings.numConnections == 0)
+        || (settings.duration <= 0.0)
+    ) {
+        PrintUsageInformation();
+        return EXIT_FAILURE;
+    }
+    pid_t child = 0;
+    const auto port = StartServer(settings, child);
+    if (port == 0) {
+        fprintf(stderr, "error: unable to start synthetic server\n");
+        return EXIT_FAILURE;
+    }
+    printf(
+        "%zu lines/s over %zu connections, %.1f s per backend\n",
+        settings.linesPerSecond,
+        settings.numConnections,
+        settings.duration
+    );
+    const auto epollReactor = std::make_shared< Twitch::EpollReactor >();
+    Report(
+        "epoll",
+        Measure(
+            settings,
+            [port, epollReactor]{
+                return std::make_shared< Twitch::EpollConnection >("127.0.0.1", port, epollReactor);
+            },
+            [epollReactor]{ return epollReactor->GetSystemCallCount(); },
+            []{ return (uint64_t)0; },
+            true
+        )
+    );
+#ifdef TWITCH_HAVE_IO_URING
+    if (Twitch::UringReactor::IsSupported()) {
+        const auto uringReactor = std::make_shared< Twitch::UringReactor >();
+        for (const auto borrow: {true, false}) {
+            Report(
+                borrow ? "io_uring" : "io_uring copy",
+                Measure(
+                    settings,
+                    [port, uringReactor]{
+                        return std::make_shared< Twitch::UringConnection >("127.0.0.1", port, uringReactor);
+                    },
+                    [uringReactor]{ return uringReactor->GetSystemCallCount(); },
+                    [uringReactor]{ return uringReactor->GetBytesCopied(); },
+                    borrow
+                )
+            );
+        }
+    } else {
+        printf("io_uring not supported by the running kernel\n");
+    }
+#else /* not TWITCH_HAVE_IO_URING */
+    printf("io_uring backend not built\n");
+#endif /* TWITCH_HAVE_IO_URING */
+    (void)kill(child, SIGTERM);
+    (void)waitpid(child, NULL, 0);
+    return EXIT_SUCCESS;
+}
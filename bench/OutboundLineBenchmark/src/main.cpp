@@ -0,0 +1,207 @@
+/**
+ * @file main.cpp
+ *
+ * This module holds the main() function, which is the entrypoint
+ * to the program which compares two ways of putting together the lines
+ * sent to the Twitch server: concatenating temporary strings, as was
+ * done before, and writing each piece directly onto the end of the
+ * outbound buffer with Twitch::OutboundLine.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <chrono>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <src/OutboundLine.hpp>
+#include <string>
+
+namespace {
+
+    /**
+     * This is the required line terminator for lines of text
+     * sent to Twitch chat servers.
+     */
+    const std::string CRLF = "\r\n";
+
+    /**
+     * This is how many bytes are held in the outbound buffer before
+     * it's "sent" (cleared), mirroring how the worker thread of
+     * Twitch::Messaging holds lines.
+     */
+    constexpr size_t FLUSH_THRESHOLD = 8192;
+
+    /**
+     * These are the pieces of the lines put together by the benchmark.
+     */
+    const std::string channel = "somechannel";
+    const std::string parent = "b34ccfc7-4977-403a-8a94-33c6bac34fb8";
+    const std::string message = "Hello, World!  This is a chat message of a typical length, give or take.";
+
+    /**
+     * This function measures one way of putting together lines.
+     *
+     * @param[in] numLines
+     *     This is the number of lines to put together.
+     *
+     * @param[in] makeLine
+     *     This is the function to call to put together one line onto
+     *     the end of the given buffer.
+     *
+     * @param[out] bytes
+     *     This is where to store the number of bytes put together,
+     *     which also keeps the work from being optimized away.
+     *
+     * @return
+     *     The average number of nanoseconds taken to put together
+     *     one line is returned.
+     */
+    double Measure(
+        size_t numLines,
+        std::function< void(std::string& buffer) > makeLine,
+        size_t& bytes
+    ) {
+        std::string buffer;
+        bytes = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < numLines; ++i) {
+            makeLine(buffer);
+            if (buffer.length() >= FLUSH_THRESHOLD) {
+                bytes += buffer.length();
+                buffer.clear();
+            }
+        }
+        const auto stop = std::chrono::steady_clock::now();
+        bytes += buffer.length();
+        return (
+            (double)std::chrono::duration_cast< std::chrono::nanoseconds >(stop - start).count()
+            / (double)numLines
+        );
+    }
+
+    /**
+     * This function reports how two ways of putting together the same
+     * kind of line compare.
+     *
+     * @param[in] name
+     *     This is the name of the kind of line.
+     *
+     * @param[in] numLines
+     *     This is the number of lines to put together each way.
+     *
+     * @param[in] concatenate
+     *     This is the function to call to put together one line
+     *     by concatenating temporary strings.
+     *
+     * @param[in] build
+     *     This is the function to call to put together one line
+     *     with Twitch::OutboundLine.
+     */
+    void Compare(
+        const char* name,
+        size_t numLines,
+        std::function< void(std::string& buffer) > concatenate,
+        std::function< void(std::string& buffer) > build
+    ) {
+        size_t concatenatedBytes, builtBytes;
+        const auto concatenated = Measure(numLines, concatenate, concatenatedBytes);
+        const auto built = Measure(numLines, build, builtBytes);
+        printf(
+            "%-8s concatenation: %7.1f ns/line  OutboundLine: %7.1f ns/line  (%.2fx)%s\n",
+            name,
+            concatenated,
+            built,
+            (built == 0.0) ? 0.0 : concatenated / built,
+            (concatenatedBytes == builtBytes) ? "" : "  OUTPUT DIFFERS"
+        );
+    }
+
+}
+
+/**
+ * This function prints to the standard error stream information
+ * about how to use this program.
+ */
+void PrintUsageInformation() {
+    fprintf(
+        stderr,
+        (
+            "Usage: TwitchOutboundLineBenchmark [OPTION]...\n"
+            "\n"
+            "Compare putting together outbound lines by concatenating temporary strings\n"
+            "against writing them directly onto the outbound buffer.\n"
+            "\n"
+            "  --lines N   Lines to put together each way (default: 10000000)\n"
+        )
+    );
+}
+
+/**
+ * This function is the entrypoint of the program.
+ *
+ * @param[in] argc
+ *     This is the number of command-line arguments given to the program.
+ *
+ * @param[in] argv
+ *     This is the array of command-line arguments given to the program.
+ */
+int main(int argc, char* argv[]) {
+    size_t numLines = 10000000;
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (i + 1 >= argc) {
+            PrintUsageInformation();
+            return EXIT_FAILURE;
+        }
+        const char* value = argv[++i];
+        if (option == "--lines") {
+            numLines = (size_t)strtoull(value, NULL, 10);
+        } else {
+            PrintUsageInformation();
+            return EXIT_FAILURE;
+        }
+    }
+    if (numLines == 0) {
+        PrintUsageInformation();
+        return EXIT_FAILURE;
+    }
+    Compare(
+        "PRIVMSG",
+        numLines,
+        [](std::string& buffer){
+            buffer += "PRIVMSG #" + channel + " :" + message + CRLF;
+        },
+        [](std::string& buffer){
+            Twitch::OutboundLine line(buffer);
+            line.Append("PRIVMSG #").Append(channel).Append(" :").Append(message);
+            (void)line.Finish();
+        }
+    );
+    Compare(
+        "reply",
+        numLines,
+        [](std::string& buffer){
+            buffer += "@reply-parent-msg-id=" + parent + " PRIVMSG #" + channel + " :" + message + CRLF;
+        },
+        [](std::string& buffer){
+            Twitch::OutboundLine line(buffer);
+            line.AppendTag("reply-parent-msg-id", parent);
+            line.Append("PRIVMSG #").Append(channel).Append(" :").Append(message);
+            (void)line.Finish();
+        }
+    );
+    Compare(
+        "whisper",
+        numLines,
+        [](std::string& buffer){
+            buffer += "PRIVMSG #jtv :.w " + channel + " " + message + CRLF;
+        },
+        [](std::string& buffer){
+            Twitch::OutboundLine line(buffer);
+            line.Append("PRIVMSG #jtv :.w ").Append(channel).Append(" ").Append(message);
+            (void)line.Finish();
+        }
+    );
+    return EXIT_SUCCESS;
+}
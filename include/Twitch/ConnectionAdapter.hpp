@@ -0,0 +1,89 @@
+#ifndef TWITCH_CONNECTION_ADAPTER_HPP
+#define TWITCH_CONNECTION_ADAPTER_HPP
+
+/**
+ * @file ConnectionAdapter.hpp
+ *
+ * This module declares the Twitch::ConnectionAdapter class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "Connection.hpp"
+#include "ConnectionV2.hpp"
+
+#include <memory>
+#include <stddef.h>
+
+namespace Twitch {
+
+    /**
+     * This is an implementation of the ConnectionV2 interface which
+     * passes everything along to an implementation of the Connection
+     * interface.
+     *
+     * Data received is copied once, into a buffer kept by the adapter
+     * and handed over from there.  Fragments sent are put together into
+     * one message before being passed along.
+     */
+    class ConnectionAdapter
+        : public ConnectionV2
+    {
+        // Lifecycle management
+    public:
+        ~ConnectionAdapter() noexcept;
+        ConnectionAdapter(const ConnectionAdapter& other) = delete;
+        ConnectionAdapter(ConnectionAdapter&&) noexcept = delete;
+        ConnectionAdapter& operator=(const ConnectionAdapter& other) = delete;
+        ConnectionAdapter& operator=(ConnectionAdapter&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This constructs the adapter.
+         *
+         * @param[in] adaptee
+         *     This is the connection to which to pass everything along.
+         */
+        explicit ConnectionAdapter(std::shared_ptr< Connection > adaptee);
+
+        /**
+         * This function returns the ConnectionV2 interface of the given
+         * connection, if it implements it, or otherwise a new adapter
+         * of the connection.
+         *
+         * @param[in] connection
+         *     This is the connection to adapt.
+         *
+         * @return
+         *     The ConnectionV2 interface to the given connection
+         *     is returned.
+         */
+        static std::shared_ptr< ConnectionV2 > Adapt(std::shared_ptr< Connection > connection);
+
+        // Twitch::ConnectionV2
+    public:
+        virtual void SetDataReceivedDelegate(DataReceivedDelegate dataReceivedDelegate) override;
+        virtual void SetDisconnectedDelegate(Connection::DisconnectedDelegate disconnectedDelegate) override;
+        virtual bool Connect() override;
+        virtual void Disconnect() override;
+        virtual void Send(const Fragment* fragments, size_t numFragments) override;
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
+
+#endif /* TWITCH_CONNECTION_ADAPTER_HPP */
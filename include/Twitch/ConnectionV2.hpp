@@ -0,0 +1,348 @@
+#ifndef TWITCH_CONNECTION_V2_HPP
+#define TWITCH_CONNECTION_V2_HPP
+
+/**
+ * @file ConnectionV2.hpp
+ *
+ * This module declares the Twitch::ConnectionV2 interface.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "Connection.hpp"
+
+#include <functional>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace Twitch {
+
+    /**
+     * This is the second version of the interface which represents the
+     * network connection between the client and the Twitch server.
+     *
+     * Unlike Connection, data received is handed over as an rvalue, so
+     * that the receiver can take it without copying, and data sent is
+     * given as a list of fragments, so that the sender doesn't have to
+     * put each line together before sending it.  Connections which
+     * receive into buffers of their own may also lend those buffers
+     * out, through a ReceivedBuffer, rather than copying out of them.
+     *
+     * Implementations of Connection which don't also implement this
+     * interface can be used wherever it's needed through
+     * ConnectionAdapter.
+     */
+    class ConnectionV2 {
+    public:
+        // Types
+
+        /**
+         * This is the type of function to call whenever data is
+         * received from the Twitch server.
+         *
+         * @param[in,out] data
+         *     This is the data received from the Twitch server.  The
+         *     function may take ownership of the data by moving from it,
+         *     or swap in storage of its own to be reused by the connection.
+         *     Anything left in the string belongs to the connection again
+         *     once the function returns, which reuses its storage for the
+         *     next data received.
+         */
+        typedef std::function< void(std::string&& data) > DataReceivedDelegate;
+
+        /**
+         * This holds data received from the Twitch server, either in a
+         * buffer lent out by the connection, or in a string of its own.
+         * A lent buffer is given back to the connection when the
+         * ReceivedBuffer is released or destroyed, so it should be
+         * released as soon as the data is no longer needed.
+         */
+        class ReceivedBuffer {
+            // Types
+        public:
+            /**
+             * This is the type of function called to give a lent buffer
+             * back to the connection which lent it out.
+             *
+             * @param[in] pool
+             *     This is the pool of buffers from which the buffer
+             *     was lent out.
+             *
+             * @param[in] token
+             *     This identifies the buffer within the pool.
+             */
+            typedef void (*ReturnFunction)(void* pool, uintptr_t token);
+
+            // Lifecycle management
+        public:
+            ~ReceivedBuffer() noexcept;
+            ReceivedBuffer(const ReceivedBuffer&) = delete;
+            ReceivedBuffer(ReceivedBuffer&& other) noexcept;
+            ReceivedBuffer& operator=(const ReceivedBuffer&) = delete;
+            ReceivedBuffer& operator=(ReceivedBuffer&& other) noexcept;
+
+            // Public methods
+        public:
+            /**
+             * This is the default constructor, which makes a buffer
+             * holding no data.
+             */
+            ReceivedBuffer();
+
+            /**
+             * This constructs the buffer to hold the given data,
+             * which it takes.
+             *
+             * @param[in,out] data
+             *     This is the data for the buffer to take.
+             */
+            explicit ReceivedBuffer(std::string&& data);
+
+            /**
+             * This constructs the buffer to refer to data in a buffer
+             * lent out from the given pool.
+             *
+             * @param[in] data
+             *     This points to the first byte of the data.
+             *
+             * @param[in] length
+             *     This is the number of bytes of data.
+             *
+             * @param[in] pool
+             *     This is the pool of buffers from which the buffer was
+             *     lent out.  It's held until the buffer is given back.
+             *
+             * @param[in] returnFunction
+             *     This is the function to call to give the buffer back
+             *     to the pool.
+             *
+             * @param[in] token
+             *     This identifies the buffer within the pool.
+             */
+            ReceivedBuffer(
+                const char* data,
+                size_t length,
+                std::shared_ptr< void > pool,
+                ReturnFunction returnFunction,
+                uintptr_t token
+            );
+
+            /**
+             * This method returns a pointer to the first byte of the data.
+             *
+             * @return
+             *     A pointer to the first byte of the data is returned.
+             */
+            const char* GetData() const;
+
+            /**
+             * This method returns the number of bytes of data.
+             *
+             * @return
+             *     The number of bytes of data is returned.
+             */
+            size_t GetLength() const;
+
+            /**
+             * This method forgets the data past the given length.
+             * A lent buffer isn't given back until it's released.
+             *
+             * @param[in] length
+             *     This is the number of bytes of data to keep.  It must
+             *     not be more than the number of bytes held.
+             */
+            void Truncate(size_t length);
+
+            /**
+             * This method forgets the data, giving back the buffer
+             * holding it if it was lent out.
+             */
+            void Release();
+
+            // Private properties
+        private:
+            /**
+             * This points to the first byte of the data.
+             */
+            const char* data_ = nullptr;
+
+            /**
+             * This is the number of bytes of data.
+             */
+            size_t length_ = 0;
+
+            /**
+             * This holds the data, if it isn't in a lent buffer.
+             */
+            std::string owned_;
+
+            /**
+             * This is the pool of buffers from which the buffer was lent
+             * out, or null if the buffer wasn't lent out.
+             */
+            std::shared_ptr< void > pool_;
+
+            /**
+             * This is the function to call to give the buffer back to
+             * the pool.
+             */
+            ReturnFunction returnFunction_ = nullptr;
+
+            /**
+             * This identifies the buffer within the pool.
+             */
+            uintptr_t token_ = 0;
+        };
+
+        /**
+         * This is the type of function to call whenever data is
+         * received from the Twitch server, handing over the buffer
+         * holding it.
+         *
+         * @param[in,out] buffer
+         *     This holds the data received from the Twitch server.
+         *     The function may take it by moving from it; otherwise
+         *     it's released once the function returns.
+         */
+        typedef std::function< void(ReceivedBuffer&& buffer) > BufferReceivedDelegate;
+
+        /**
+         * This refers to a piece of data to be sent.  The data isn't
+         * copied; it must remain valid until the Send call returns.
+         */
+        struct Fragment {
+            /**
+             * This points to the first byte of the data.
+             */
+            const char* data = nullptr;
+
+            /**
+             * This is the number of bytes of data.
+             */
+            size_t length = 0;
+
+            /**
+             * This is the default constructor.
+             */
+            Fragment() = default;
+
+            /**
+             * This constructs the fragment to refer to the given data.
+             *
+             * @param[in] data
+             *     This points to the first byte of the data.
+             *
+             * @param[in] length
+             *     This is the number of bytes of data.
+             */
+            Fragment(const char* data, size_t length)
+                : data(data)
+                , length(length)
+            {
+            }
+
+            /**
+             * This constructs the fragment to refer to the contents
+             * of the given string.
+             *
+             * @param[in] data
+             *     This is the string whose contents the fragment
+             *     refers to.
+             */
+            Fragment(const std::string& data)
+                : data(data.data())
+                , length(data.length())
+            {
+            }
+        };
+
+        // Methods
+
+        /**
+         * This method is called to set up a callback to happen whenever
+         * any data is received from the Twitch server.
+         *
+         * @param[in] dataReceivedDelegate
+         *     This is the function to call whenever any data is received
+         *     from the Twitch server.
+         */
+        virtual void SetDataReceivedDelegate(DataReceivedDelegate dataReceivedDelegate) = 0;
+
+        /**
+         * This method is called to set up a callback to happen whenever
+         * any data is received from the Twitch server, handing over the
+         * buffer holding it.  It takes the place of the data received
+         * delegate.
+         *
+         * Connections which don't lend out buffers of their own may leave
+         * this as it is, which hands over the data received in a string
+         * held by the buffer.
+         *
+         * @param[in] bufferReceivedDelegate
+         *     This is the function to call whenever any data is received
+         *     from the Twitch server.
+         */
+        virtual void SetBufferReceivedDelegate(BufferReceivedDelegate bufferReceivedDelegate);
+
+        /**
+         * This method is called to set up a callback to happen when
+         * the Twitch server closes its end of the connection.
+         *
+         * @param[in] disconnectedDelegate
+         *     This is the function to call when the Twitch server closes
+         *     its end of the connection.
+         */
+        virtual void SetDisconnectedDelegate(Connection::DisconnectedDelegate disconnectedDelegate) = 0;
+
+        /**
+         * This method is called to establish a connection to the Twitch chat
+         * server.  This is a synchronous call; the connection will either
+         * succeed or fail before the method returns.
+         *
+         * @return
+         *     An indication of whether or not the connection was successful
+         *     is returned.
+         */
+        virtual bool Connect() = 0;
+
+        /**
+         * This method is called to break an existing connection to the Twitch
+         * chat server.  This is a synchronous call; the connection will be
+         * disconnected before the method returns.
+         */
+        virtual void Disconnect() = 0;
+
+        /**
+         * This method queues the given fragments of data to be sent to
+         * the Twitch server, one after the other, as if they were one
+         * message.  This is an asynchronous call; the data may or may not
+         * be sent before the method returns.
+         *
+         * @param[in] fragments
+         *     This points to the first of the fragments of data to send.
+         *
+         * @param[in] numFragments
+         *     This is the number of fragments of data to send.
+         */
+        virtual void Send(const Fragment* fragments, size_t numFragments) = 0;
+
+        /**
+         * This method returns an indication of whether or not any data
+         * queued to be sent hasn't yet been written to the network.
+         * Connections which write all data before Send returns, or which
+         * can't tell, may leave this as it is.
+         *
+         * @return
+         *     An indication of whether or not any data queued to be sent
+         *     hasn't yet been written to the network is returned.
+         */
+        virtual bool IsSendPending() {
+            return false;
+        }
+    };
+
+}
+
+#endif /* TWITCH_CONNECTION_V2_HPP */
@@ -0,0 +1,165 @@
+#ifndef TWITCH_EPOLL_CONNECTION_HPP
+#define TWITCH_EPOLL_CONNECTION_HPP
+
+/**
+ * @file EpollConnection.hpp
+ *
+ * This module declares the Twitch::EpollReactor and
+ * Twitch::EpollConnection classes.  They're only available on Linux.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "Connection.hpp"
+#include "ConnectionV2.hpp"
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace Twitch {
+
+    /**
+     * This class waits for network events on any number of
+     * EpollConnection instances, using one epoll instance serviced by
+     * a small, fixed number of threads, so that thousands of connections
+     * can be kept without a thread for each of them.
+     */
+    class EpollReactor {
+        // Lifecycle management
+    public:
+        ~EpollReactor() noexcept;
+        EpollReactor(const EpollReactor& other) = delete;
+        EpollReactor(EpollReactor&&) noexcept = delete;
+        EpollReactor& operator=(const EpollReactor& other) = delete;
+        EpollReactor& operator=(EpollReactor&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This constructs the reactor, starting its threads.
+         *
+         * @param[in] numThreads
+         *     This is the number of threads to use to handle network
+         *     events.  Events for any one connection are handled by
+         *     only one thread at a time.
+         */
+        explicit EpollReactor(size_t numThreads = 1);
+
+        /**
+         * This function returns the reactor shared by every
+         * EpollConnection constructed without one of its own.  It has
+         * one thread, and is made the first time it's needed.
+         *
+         * @return
+         *     The reactor shared by every EpollConnection constructed
+         *     without one of its own is returned.
+         */
+        static std::shared_ptr< EpollReactor > GetDefault();
+
+        /**
+         * This method returns the number of system calls the reactor and
+         * the connections it services have made so far to wait for
+         * network events, read, and write.  It's meant for benchmarks.
+         *
+         * @return
+         *     The number of system calls made so far to service the
+         *     connections of the reactor is returned.
+         */
+        uint64_t GetSystemCallCount() const;
+
+        // Private properties
+    private:
+        friend class EpollConnection;
+
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+    /**
+     * This is an implementation of the Connection and ConnectionV2
+     * interfaces which uses a non-blocking TCP socket serviced by
+     * an EpollReactor.
+     *
+     * Data received is read straight into a buffer kept by the connection
+     * for as long as it lives, and handed to the message received delegate
+     * from there, on a thread of the reactor.  Messages sent are appended
+     * to an outbound buffer and written by the reactor the next time the
+     * socket is writable, so that everything sent in the meantime goes
+     * out in one write.
+     */
+    class EpollConnection
+        : public Connection
+        , public ConnectionV2
+    {
+        // Lifecycle management
+    public:
+        ~EpollConnection() noexcept;
+        EpollConnection(const EpollConnection& other) = delete;
+        EpollConnection(EpollConnection&&) noexcept = delete;
+        EpollConnection& operator=(const EpollConnection& other) = delete;
+        EpollConnection& operator=(EpollConnection&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This constructs the connection.
+         *
+         * @param[in] host
+         *     This is the host name or address of the Twitch chat server.
+         *
+         * @param[in] port
+         *     This is the port number of the Twitch chat server.
+         *
+         * @param[in] reactor
+         *     This is the reactor to service the connection.  If null,
+         *     the reactor returned by EpollReactor::GetDefault is used.
+         */
+        explicit EpollConnection(
+            const std::string& host = "irc.chat.twitch.tv",
+            uint16_t port = 6667,
+            std::shared_ptr< EpollReactor > reactor = nullptr
+        );
+
+        // Twitch::Connection
+    public:
+        virtual void SetMessageReceivedDelegate(MessageReceivedDelegate messageReceivedDelegate) override;
+        virtual void SetDisconnectedDelegate(DisconnectedDelegate disconnectedDelegate) override;
+        virtual bool Connect() override;
+        virtual void Disconnect() override;
+        virtual void Send(const std::string& message) override;
+
+        // Twitch::ConnectionV2
+    public:
+        virtual void SetDataReceivedDelegate(DataReceivedDelegate dataReceivedDelegate) override;
+        virtual void Send(const Fragment* fragments, size_t numFragments) override;
+        virtual bool IsSendPending() override;
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
+
+#endif /* TWITCH_EPOLL_CONNECTION_HPP */
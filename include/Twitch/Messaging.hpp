@@ -11,13 +11,16 @@
 
 #include "Connection.hpp"
 #include "TimeKeeper.hpp"
+#include "TrafficRecorder.hpp"
 
 #include <functional>
 #include <memory>
 #include <map>
 #include <set>
+#include <stdint.h>
 #include <string>
 #include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <utility>
 #include <vector>
 
 namespace Twitch {
@@ -36,6 +39,46 @@ namespace Twitch {
          */
         typedef std::function< std::shared_ptr< Connection >() > ConnectionFactory;
 
+        /**
+         * This is the type of value used to select kinds of events,
+         * by combining the values defined in Events.
+         */
+        typedef uint32_t EventMask;
+
+        /**
+         * This scopes the values which select kinds of events in
+         * an EventMask.
+         */
+        struct Events {
+            /**
+             * These are the kinds of events which a user may or may not
+             * be interested in.  Each one corresponds to the User callback
+             * of the same name.
+             */
+            enum : EventMask {
+                Doom = 0x00000001,
+                Join = 0x00000002,
+                Leave = 0x00000004,
+                NameList = 0x00000008,
+                Message = 0x00000010,
+                PrivateMessage = 0x00000020,
+                Whisper = 0x00000040,
+                Notice = 0x00000080,
+                Host = 0x00000100,
+                RoomModeChange = 0x00000200,
+                Clear = 0x00000400,
+                Mod = 0x00000800,
+                UserState = 0x00001000,
+                Sub = 0x00002000,
+                Raid = 0x00004000,
+                Ritual = 0x00008000,
+                LogIn = 0x00010000,
+                LogOut = 0x00020000,
+                RawMessage = 0x00040000,
+                All = 0xFFFFFFFF,
+            };
+        };
+
         /**
          * This contains information about the tags of a message.
          */
@@ -598,6 +641,773 @@ namespace Twitch {
             TagsInfo tags;
         };
 
+        /**
+         * This contains information about a completed log-in handshake with
+         * the Twitch server.
+         */
+        struct HandshakeInfo {
+            /**
+             * This is the amount of time, in seconds, as measured by the time
+             * keeper, from when the connection was established to when the
+             * server confirmed the log-in.  It's zero if no time keeper
+             * was provided.
+             */
+            double duration = 0.0;
+
+            /**
+             * This flag indicates whether or not the capabilities negotiated
+             * during a previous log-in were requested directly, skipping the
+             * step of asking the server to list its capabilities.
+             */
+            bool usedCachedCapabilities = false;
+        };
+
+        /**
+         * These are the ways the class can deal with lines received from the
+         * Twitch server arriving faster than they can be handled, once the
+         * backlog of lines waiting to be handled reaches its limit.
+         */
+        enum class InboundOverloadPolicy {
+            /**
+             * Hold up the connection delivering the lines until there is
+             * room for them in the backlog, or the backlog is empty, or
+             * the connection starts closing.  No lines are dropped.  While held up, the thread delivering the lines
+             * can't deliver lines for any other connection.
+             */
+            Block,
+
+            /**
+             * Drop the oldest membership lines (JOIN, PART, and name lists)
+             * first, and then the oldest chat messages (PRIVMSG), until there
+             * is room for the new lines in the backlog.
+             */
+            DropLowPriority,
+
+            /**
+             * Drop membership lines and keep only a sample of the chat
+             * messages (PRIVMSG) in each channel.
+             */
+            SampleMessages,
+        };
+
+        /**
+         * This holds the limit on the backlog of lines received from the
+         * Twitch server but not yet handled, and what to do when it's reached.
+         */
+        struct InboundBacklogConfiguration {
+            /**
+             * This is the maximum number of bytes of received lines to hold
+             * in the backlog, or zero if there is no limit.  Lines other
+             * than membership lines and chat messages are never dropped.
+             * If a policy which drops lines can't make enough room for
+             * newly received lines, the newest membership lines and chat
+             * messages among them are dropped, and if the rest still
+             * don't fit, the connection is held up until they do, as with
+             * the Block policy.  The backlog only goes over this limit by
+             * lines received together while it's empty, or while the
+             * connection is closing.  A line still being received which
+             * grows longer than this limit is discarded, along with the
+             * rest of it when it arrives.
+             */
+            size_t maxBytes = 0;
+
+            /**
+             * This selects what to do when the backlog reaches its limit.
+             */
+            InboundOverloadPolicy policy = InboundOverloadPolicy::DropLowPriority;
+
+            /**
+             * This applies to the SampleMessages policy, and is the number
+             * of chat messages in each channel out of which one is kept while
+             * the backlog is at its limit.
+             */
+            size_t messageSampleRate = 10;
+        };
+
+        /**
+         * This holds statistics about the backlog of lines received from the
+         * Twitch server but not yet handled.
+         */
+        struct InboundBacklogStatistics {
+            /**
+             * This is the number of bytes currently in the backlog.
+             */
+            size_t bytes = 0;
+
+            /**
+             * This is the largest number of bytes that have been in the
+             * backlog at one time.
+             */
+            size_t peakBytes = 0;
+
+            /**
+             * This is the number of membership lines (JOIN, PART, and name
+             * lists) dropped because the backlog was at its limit.
+             */
+            size_t lowPriorityLinesDropped = 0;
+
+            /**
+             * This is the number of chat messages (PRIVMSG) dropped because
+             * the backlog was at its limit.
+             */
+            size_t messagesDropped = 0;
+
+            /**
+             * This is the number of lines discarded because they were
+             * longer than the limit on the backlog.
+             */
+            size_t oversizedLinesDropped = 0;
+
+            /**
+             * This is the number of times the connection was held up
+             * because the backlog was at its limit.
+             */
+            size_t timesBlocked = 0;
+        };
+
+        /**
+         * These are the ways a message given to the class to be sent
+         * to the Twitch server can turn out.
+         */
+        enum class DeliveryOutcome {
+            /**
+             * The message was sent to the Twitch server.
+             */
+            Sent,
+
+            /**
+             * The message was held, waiting to be sent, for longer than
+             * allowed, and was dropped.
+             */
+            Expired,
+
+            /**
+             * The message was dropped without being sent, because it
+             * couldn't be sent right away and couldn't be held, or because
+             * it was empty or too long to be sent.
+             */
+            Dropped,
+
+            /**
+             * The message was dropped without being sent, because the
+             * modes of the channel to which it was to be sent would have
+             * caused the Twitch server to drop it, such as when the
+             * channel is in subscribers-only mode and the user isn't
+             * a subscriber.
+             */
+            Rejected,
+        };
+
+        /**
+         * This is the type of function called to report how a message given
+         * to the class to be sent to the Twitch server turned out.
+         *
+         * @param[in] outcome
+         *     This is how the message turned out.
+         */
+        typedef std::function< void(DeliveryOutcome outcome) > DeliveryDelegate;
+
+        /**
+         * This holds optional settings for a single message to be sent
+         * to the Twitch server.
+         */
+        struct SendOptions {
+            /**
+             * This is the most number of seconds the message may be held,
+             * waiting to be sent, before it's dropped, or zero to use the
+             * expiration configured for the outbound queue.
+             */
+            double expiration = 0.0;
+
+            /**
+             * If not null, this is called, in the worker thread of the
+             * class, to report how the message turned out.
+             */
+            DeliveryDelegate deliveryDelegate;
+        };
+
+        /**
+         * This holds the settings of the queue in which messages, whispers,
+         * and channel joins are held while they can't be sent, such as
+         * while the user agent is disconnected or reconnecting, or while
+         * the rate at which messages are sent is at its limit.
+         */
+        struct OutboundQueueConfiguration {
+            /**
+             * This is the maximum number of messages, whispers, and channel
+             * joins to hold in the queue, or zero if none are held.  While
+             * none are held, anything which can't be sent right away is
+             * dropped, and the rate limit isn't applied.
+             */
+            size_t maxMessages = 0;
+
+            /**
+             * This is the maximum number of bytes of messages, whispers, and
+             * channel joins to hold in the queue, or zero if there is no
+             * limit.
+             */
+            size_t maxBytes = 0;
+
+            /**
+             * This is the most number of seconds anything may be held in the
+             * queue before it's dropped, or zero if there is no limit.
+             * It may be overridden for each message by SendOptions.
+             */
+            double expiration = 0.0;
+
+            /**
+             * This is the most number of messages and whispers to send
+             * within any window of time of the length given by
+             * rateLimitWindow, or zero if there is no limit.  Channel joins
+             * aren't counted against this limit.
+             */
+            size_t rateLimit = 20;
+
+            /**
+             * This is the length of the window of time, in seconds, over
+             * which the rate limit applies.
+             */
+            double rateLimitWindow = 30.0;
+        };
+
+        /**
+         * This holds statistics about the queue in which messages, whispers,
+         * and channel joins are held while they can't be sent.
+         */
+        struct OutboundQueueStatistics {
+            /**
+             * This is the number of messages, whispers, and channel joins
+             * currently held in the queue.
+             */
+            size_t messages = 0;
+
+            /**
+             * This is the number of bytes currently held in the queue.
+             */
+            size_t bytes = 0;
+
+            /**
+             * This is the largest number of bytes that have been held in
+             * the queue at one time.
+             */
+            size_t peakBytes = 0;
+
+            /**
+             * This is the number of messages, whispers, and channel joins
+             * sent after being held in the queue.
+             */
+            size_t messagesSent = 0;
+
+            /**
+             * This is the number of messages, whispers, and channel joins
+             * dropped because they were held in the queue for too long.
+             */
+            size_t messagesExpired = 0;
+
+            /**
+             * This is the number of messages, whispers, and channel joins
+             * dropped because they couldn't be sent right away and there
+             * was no room for them in the queue, or because they were
+             * taken from the queue but couldn't be sent at all.
+             */
+            size_t messagesDropped = 0;
+        };
+
+        /**
+         * This holds what is known about the modes of a channel, and the
+         * standing of the user in it, which decide whether or not, and how
+         * soon, a message sent by the user to the channel is accepted by
+         * the Twitch server.  It's kept up to date from the ROOMSTATE and
+         * USERSTATE commands sent by the Twitch server.
+         */
+        struct ChannelState {
+            /**
+             * This is the least number of seconds which must pass between
+             * messages sent by the user to the channel, or zero if the
+             * channel isn't in slow mode.
+             */
+            int slow = 0;
+
+            /**
+             * This is the number of minutes a follower will need to have
+             * been following in order to be able to chat, or -1 if the
+             * channel isn't in followers-only mode.  It's only reported;
+             * messages aren't held back by it, since the Twitch server
+             * doesn't tell the client how long the user has followed.
+             */
+            int followersOnly = -1;
+
+            /**
+             * This indicates whether or not only subscribers may chat
+             * in the channel.
+             */
+            bool subsOnly = false;
+
+            /**
+             * This indicates whether or not only messages made up entirely
+             * of emotes are allowed in the channel.  It's only reported;
+             * messages aren't checked against it, since only the Twitch
+             * server knows which words are emotes for the user.
+             */
+            bool emoteOnly = false;
+
+            /**
+             * This indicates whether or not messages which aren't unique
+             * are dropped in the channel.
+             */
+            bool r9k = false;
+
+            /**
+             * This indicates whether or not the user is a moderator of the
+             * channel, or the broadcaster.  Moderators aren't held back by
+             * the modes of the channel.
+             */
+            bool moderator = false;
+
+            /**
+             * This indicates whether or not the user is a VIP of the
+             * channel.  VIPs aren't held back by the modes of the channel.
+             */
+            bool vip = false;
+
+            /**
+             * This indicates whether or not the user is a subscriber to
+             * the channel.
+             */
+            bool subscriber = false;
+
+            /**
+             * This is the number of messages to the channel currently held
+             * in the outbound queue.
+             */
+            size_t messagesQueued = 0;
+
+            /**
+             * This is the number of messages to the channel dropped without
+             * being sent because the modes of the channel would have caused
+             * the Twitch server to drop them.  Messages are only checked
+             * against the modes while the outbound queue is set up.
+             */
+            size_t messagesRejected = 0;
+        };
+
+        /**
+         * This gives access to a line received from the Twitch server,
+         * broken into its parts, without copying any of them.  The
+         * references are only valid during the call to User::RawMessage.
+         */
+        struct RawMessageInfo {
+            // Properties
+
+            /**
+             * This is the raw line of text, without the line terminator.
+             */
+            const std::string& line;
+
+            /**
+             * This is the raw string containing the line's tags, if any,
+             * without the leading at-sign (@) character.
+             */
+            const std::string& tags;
+
+            /**
+             * This is the line's prefix, if any, without the leading
+             * colon (:) character.
+             */
+            const std::string& prefix;
+
+            /**
+             * This is the line's command, which may be a three-digit code,
+             * or an IRC command name.
+             */
+            const std::string& command;
+
+            /**
+             * These are the line's parameters, if any.
+             */
+            const std::vector< std::string >& parameters;
+
+            /**
+             * This indicates whether or not the line will be handled, and
+             * may result in other events.  If false, the line is either
+             * a command which isn't handled, or will be dropped because
+             * of event interests or sampling.
+             */
+            bool handled;
+
+            // Methods
+
+            /**
+             * This is the constructor.
+             *
+             * @param[in] line
+             *     This is the raw line of text, without the line terminator.
+             *
+             * @param[in] tags
+             *     This is the raw string containing the line's tags.
+             *
+             * @param[in] prefix
+             *     This is the line's prefix.
+             *
+             * @param[in] command
+             *     This is the line's command.
+             *
+             * @param[in] parameters
+             *     These are the line's parameters.
+             *
+             * @param[in] handled
+             *     This indicates whether or not the line will be handled.
+             */
+            RawMessageInfo(
+                const std::string& line,
+                const std::string& tags,
+                const std::string& prefix,
+                const std::string& command,
+                const std::vector< std::string >& parameters,
+                bool handled
+            )
+                : line(line)
+                , tags(tags)
+                , prefix(prefix)
+                , command(command)
+                , parameters(parameters)
+                , handled(handled)
+            {
+            }
+        };
+
+        /**
+         * This selects how many of the chat messages (PRIVMSG) received in a
+         * channel are passed along, for users which only need a
+         * representative sample of busy channels.  Messages not sampled are
+         * dropped right after their command is recognized, before their tags
+         * are decoded.  Moderation events (CLEARCHAT, CLEARMSG) and other
+         * commands are never dropped.
+         */
+        struct ChannelSampling {
+            /**
+             * This is the number of chat messages out of which one is kept.
+             * A value of one keeps every message.
+             */
+            size_t keepOneIn = 1;
+
+            /**
+             * If not zero, this is the maximum average number of chat
+             * messages per second to keep, beyond which messages are
+             * dropped.  This requires a time keeper to be set.
+             */
+            double maxPerSecond = 0.0;
+        };
+
+        /**
+         * This is the base class of the events delivered to observers.
+         * Each event is created once, and then shared, without being
+         * copied or modified, by every observer interested in it.
+         * Events of kinds which carry information are instances of the
+         * InfoEvent template.
+         */
+        struct Event {
+            /**
+             * This is the kind of event, which is one of the values
+             * defined in Events.
+             */
+            EventMask type = 0;
+
+            /**
+             * This is the destructor, declared virtual so that events
+             * carrying information can be destroyed through the base class.
+             */
+            virtual ~Event() = default;
+        };
+
+        /**
+         * This is the type of event which carries information about what
+         * happened.  The kind of event determines the type of information:
+         *
+         * - Join, Leave: MembershipInfo
+         * - NameList: NameListInfo
+         * - Message, PrivateMessage: MessageInfo
+         * - Whisper: WhisperInfo
+         * - Notice: NoticeInfo
+         * - Host: HostInfo
+         * - RoomModeChange: RoomModeChangeInfo
+         * - Clear: ClearInfo
+         * - Mod: ModInfo
+         * - UserState: UserStateInfo
+         * - Sub: SubInfo
+         * - Raid: RaidInfo
+         * - Ritual: RitualInfo
+         *
+         * Doom, LogIn, and LogOut events carry no information.
+         *
+         * @tparam Info
+         *     This is the type of information carried by the event.
+         */
+        template< typename Info > struct InfoEvent
+            : public Event
+        {
+            /**
+             * This holds the information about what happened.
+             */
+            Info info;
+        };
+
+        /**
+         * This is the type of function called to deliver events to an
+         * observer.
+         *
+         * @param[in] event
+         *     This is the event to deliver.
+         */
+        typedef std::function< void(std::shared_ptr< const Event > event) > ObserverDelegate;
+
+        /**
+         * This is the type of function returned when adding an observer,
+         * which may be called to remove the observer.
+         */
+        typedef std::function< void() > RemoveObserverDelegate;
+
+        /**
+         * This selects which events an observer receives, and how they
+         * are delivered to it.
+         */
+        struct ObserverConfiguration {
+            /**
+             * This selects the kinds of events the observer receives.
+             */
+            EventMask events = Events::All;
+
+            /**
+             * If true, events are queued and delivered to the observer in
+             * a thread of its own, rather than in the thread which handles
+             * lines received from the Twitch server.
+             */
+            bool ownThread = false;
+
+            /**
+             * If the observer has its own thread, and this is not zero,
+             * this is the maximum number of events to queue for the
+             * observer.
+             */
+            size_t maxQueuedEvents = 0;
+
+            /**
+             * This selects what to do with an event when the observer's
+             * queue is full.  If true, the event is dropped for the
+             * observer.  Otherwise, handling of lines received from the
+             * Twitch server waits until there is room in the queue.
+             */
+            bool dropWhenFull = false;
+        };
+
+        /**
+         * This holds a snapshot of a histogram of measured values, such as
+         * durations in nanoseconds.  Values are counted in buckets whose
+         * width grows with the values they hold, so that every value is
+         * counted with a precision of about six percent.
+         */
+        struct HistogramSnapshot {
+            // Properties
+
+            /**
+             * This is the number of values measured.
+             */
+            uint64_t count = 0;
+
+            /**
+             * This is the sum of all values measured.
+             */
+            uint64_t sum = 0;
+
+            /**
+             * This is the smallest value measured, or zero if no values
+             * were measured.
+             */
+            uint64_t min = 0;
+
+            /**
+             * This is the largest value measured.
+             */
+            uint64_t max = 0;
+
+            /**
+             * These are the buckets in which at least one value was
+             * counted, in increasing order.  The first element of each pair
+             * is the largest value the bucket can hold, and the second
+             * element is the number of values counted in the bucket.
+             */
+            std::vector< std::pair< uint64_t, uint64_t > > buckets;
+
+            // Methods
+
+            /**
+             * This method estimates the value below which the given
+             * percentage of values measured fall.
+             *
+             * @param[in] percentile
+             *     This is the percentage, from 0 to 100.
+             *
+             * @return
+             *     The estimated value at the given percentile is returned,
+             *     or zero if no values were measured.
+             */
+            uint64_t GetPercentile(double percentile) const;
+        };
+
+        /**
+         * This holds what is measured about one kind of command
+         * received from the Twitch server.
+         */
+        struct CommandMetrics {
+            /**
+             * This is the number of lines received with the command.
+             */
+            uint64_t linesReceived = 0;
+
+            /**
+             * This is a histogram of how long it took to handle lines
+             * received with the command, including decoding their tags and
+             * delivering any resulting events to the user, in nanoseconds.
+             * Chat messages are delivered afterwards, in batches, so for
+             * them this only covers preparing them for delivery.
+             */
+            HistogramSnapshot handlerTime;
+        };
+
+        /**
+         * This holds a snapshot of what is measured about the operation of
+         * the instance, while metrics are enabled.
+         */
+        struct Metrics {
+            /**
+             * This indicates whether or not metrics are enabled.
+             */
+            bool enabled = false;
+
+            /**
+             * This is the number of bytes received from the Twitch server.
+             */
+            uint64_t bytesReceived = 0;
+
+            /**
+             * This is the number of bytes sent to the Twitch server.
+             */
+            uint64_t bytesSent = 0;
+
+            /**
+             * This is the number of lines received from the Twitch server.
+             */
+            uint64_t linesReceived = 0;
+
+            /**
+             * This is the number of lines sent to the Twitch server.
+             */
+            uint64_t linesSent = 0;
+
+            /**
+             * This is the number of times lines were handed to the
+             * connection to be sent to the Twitch server.  Lines produced
+             * together are handed over together, so this is usually less
+             * than the number of lines sent.
+             */
+            uint64_t sends = 0;
+
+            /**
+             * This holds what is measured about each kind of command
+             * received from the Twitch server, keyed by command.  Once
+             * 64 different commands have been seen, any others are
+             * counted under the key "other".
+             */
+            std::map< std::string, CommandMetrics > commands;
+
+            /**
+             * This is a histogram of how long it took to parse lines
+             * received from the Twitch server, in nanoseconds.
+             */
+            HistogramSnapshot parseTime;
+
+            /**
+             * This is a histogram of how long lines received from the
+             * Twitch server waited, from when they were received until
+             * they began to be parsed, in nanoseconds.
+             */
+            HistogramSnapshot queueWaitTime;
+
+            /**
+             * This is a histogram of how long it took to handle lines
+             * received from the Twitch server, for all commands,
+             * in nanoseconds.
+             */
+            HistogramSnapshot handlerTime;
+
+            /**
+             * This is a histogram of how long it took, from when lines
+             * were received from the Twitch server, until the resulting
+             * events began to be delivered to the user, in nanoseconds.
+             */
+            HistogramSnapshot endToEndTime;
+
+            /**
+             * This is a histogram of how long before they were received
+             * the Twitch server sent lines having timestamps (the
+             * "tmi-sent-ts" tag), in nanoseconds, according to the time
+             * keeper.  Lines which seem to have been received before they
+             * were sent, due to clocks being out of step, are counted
+             * as having no lag.
+             */
+            HistogramSnapshot serverLag;
+
+            /**
+             * This is the number of actions currently waiting to be
+             * performed by the worker thread.
+             */
+            size_t actionsQueued = 0;
+
+            /**
+             * This is the largest number of actions which have been waiting
+             * to be performed by the worker thread at one time.
+             */
+            size_t peakActionsQueued = 0;
+
+            /**
+             * This is the number of actions currently awaiting responses
+             * from the Twitch server.
+             */
+            size_t actionsAwaitingResponses = 0;
+
+            /**
+             * This is the number of actions which timed out waiting
+             * for responses from the Twitch server.
+             */
+            uint64_t timeoutsFired = 0;
+
+            /**
+             * This is the number of messages, whispers, and channel joins
+             * currently held in the outbound queue.
+             */
+            size_t outboundQueued = 0;
+
+            /**
+             * This is the number of bytes currently held in the
+             * outbound queue.
+             */
+            size_t outboundQueuedBytes = 0;
+
+            /**
+             * This is the number of messages, whispers, and channel joins
+             * dropped because they were held in the outbound queue
+             * for too long.
+             */
+            uint64_t outboundExpired = 0;
+
+            /**
+             * This is the number of messages, whispers, and channel joins
+             * dropped because they couldn't be sent right away and there
+             * was no room for them in the outbound queue.
+             */
+            uint64_t outboundDropped = 0;
+        };
+
         /**
          * This is a base class and interface to be implemented by the user of
          * this class, in order to receive notifications, events, and other
@@ -676,6 +1486,25 @@ namespace Twitch {
             virtual void Message(MessageInfo&& messageInfo) {
             }
 
+            /**
+             * This is called once for each batch of messages sent to
+             * channels, received together from the Twitch server, so that
+             * they can be handled in bulk.  Messages are delivered in the
+             * order received, and any other events received in between
+             * messages are delivered between batches.
+             *
+             * By default, each message is passed along to the Message method.
+             *
+             * @param[in] messageInfos
+             *     These contain all the information about the received
+             *     messages.
+             */
+            virtual void Messages(std::vector< MessageInfo >&& messageInfos) {
+                for (auto& messageInfo: messageInfos) {
+                    Message(std::move(messageInfo));
+                }
+            }
+
             /**
              * This is called whenever the user receives a message sent
              * privately from another user.  This is generally only seen when
@@ -796,6 +1625,41 @@ namespace Twitch {
              */
             virtual void Ritual(RitualInfo&& ritualInfo) {
             }
+
+            /**
+             * This is called for every line received from the Twitch server,
+             * including lines with commands which aren't otherwise handled,
+             * as soon as the line is broken into its parts and before any
+             * other event resulting from the line is delivered.  Chat
+             * messages are delivered in batches, so their raw messages
+             * may arrive ahead of the batch.  Raw messages are not
+             * delivered to observers.
+             *
+             * @param[in] rawMessageInfo
+             *     This gives access to the parts of the line, which are only
+             *     valid during the call.
+             */
+            virtual void RawMessage(const RawMessageInfo& rawMessageInfo) {
+            }
+
+            /**
+             * This is called to offer the user, as if it were one more
+             * observer, an event which carries information and is also
+             * being delivered to observers.  If the user takes the event,
+             * the method for the kind of event isn't called.  Otherwise,
+             * that method is called with a copy of the information, since
+             * the event itself must not be modified.
+             *
+             * @param[in] event
+             *     This is the event shared with the observers.
+             *
+             * @return
+             *     An indication of whether or not the user took the event
+             *     is returned.
+             */
+            virtual bool SharedEvent(const std::shared_ptr< const Event >& event) {
+                return false;
+            }
         };
 
         // Lifecycle management
@@ -834,6 +1698,23 @@ namespace Twitch {
             size_t minLevel = 0
         );
 
+        /**
+         * This method arranges for the tracing of lines sent to and received
+         * from the Twitch server, which is published as diagnostic messages
+         * at level 0, to be delivered to subscribers in a separate thread,
+         * so that subscribers which take a while don't hold up handling
+         * the lines.  Traced lines wait in a queue of the given capacity.
+         * If the queue is full, traced lines are dropped, and a warning is
+         * published saying how many.  Lines are only traced at all while
+         * there is a subscriber to level 0 diagnostic messages.
+         *
+         * @param[in] capacity
+         *     This is the maximum number of traced lines to queue.
+         *     If zero, traced lines are delivered to subscribers in the
+         *     thread handling the lines, which is the default.
+         */
+        void SetAsynchronousLineTracing(size_t capacity);
+
         /**
          * This method is used to provide the class with a means of
          * establishing connections to the Twitch server.
@@ -864,6 +1745,262 @@ namespace Twitch {
          */
         void SetUser(std::shared_ptr< User > user);
 
+        /**
+         * This method adds an observer which receives every event.
+         * Observers receive the same events as the user, right after the
+         * user, but as shared immutable event objects, so that any number
+         * of observers can receive them without copying them.  A user
+         * can receive them the same way by taking them in its SharedEvent
+         * method.  Unless configured to have a thread of its own, an observer is called
+         * in the thread which handles lines received from the Twitch
+         * server, and so must not call back into this object.
+         *
+         * @param[in] delegate
+         *     This is the function to call to deliver events to the
+         *     observer.
+         *
+         * @return
+         *     A function is returned which may be called to remove the
+         *     observer.
+         */
+        RemoveObserverDelegate AddObserver(ObserverDelegate delegate);
+
+        /**
+         * This method adds an observer which receives the events selected
+         * by the given configuration, delivered as the configuration
+         * specifies.
+         *
+         * @param[in] delegate
+         *     This is the function to call to deliver events to the
+         *     observer.
+         *
+         * @param[in] configuration
+         *     This selects which events the observer receives, and how
+         *     they are delivered to it.
+         *
+         * @return
+         *     A function is returned which may be called to remove the
+         *     observer.
+         */
+        RemoveObserverDelegate AddObserver(
+            ObserverDelegate delegate,
+            const ObserverConfiguration& configuration
+        );
+
+        /**
+         * This method enables remembering the IRCv3 capabilities negotiated
+         * with the Twitch server, so that later log-ins can request them
+         * directly instead of first asking the server to list the
+         * capabilities it supports.  If the server refuses the cached
+         * capabilities, the cache is discarded and the capabilities are
+         * negotiated from scratch.
+         *
+         * @param[in] cacheFilePath
+         *     If not empty, this is the path to a file in which to persist
+         *     the cache, so that it survives beyond the lifetime of this
+         *     object.  Any capabilities already stored in the file are
+         *     loaded immediately.
+         */
+        void EnableCapabilitiesCache(const std::string& cacheFilePath = "");
+
+        /**
+         * This method returns information about the most recently completed
+         * log-in handshake with the Twitch server.
+         *
+         * @return
+         *     Information about the most recently completed log-in handshake
+         *     with the Twitch server is returned.
+         */
+        HandshakeInfo GetLastHandshakeInfo();
+
+        /**
+         * This method sets the limit on the backlog of lines received from
+         * the Twitch server but not yet handled, and what to do when it's
+         * reached.
+         *
+         * @param[in] configuration
+         *     This holds the limit on the backlog and what to do when it's
+         *     reached.
+         */
+        void ConfigureInboundBacklog(const InboundBacklogConfiguration& configuration);
+
+        /**
+         * This method returns statistics about the backlog of lines received
+         * from the Twitch server but not yet handled.
+         *
+         * @return
+         *     Statistics about the backlog of lines received from the Twitch
+         *     server but not yet handled are returned.
+         */
+        InboundBacklogStatistics GetInboundBacklogStatistics();
+
+        /**
+         * This method sets up the queue in which messages, whispers, and
+         * channel joins are held while they can't be sent, such as while
+         * the user agent is disconnected or reconnecting, or while the
+         * rate at which messages are sent is at its limit.  Whatever is
+         * held is sent, in order, once the user agent is logged in again,
+         * no faster than the rate limit allows.
+         *
+         * @param[in] configuration
+         *     This holds the settings of the queue.
+         */
+        void ConfigureOutboundQueue(const OutboundQueueConfiguration& configuration);
+
+        /**
+         * This method returns statistics about the queue in which messages,
+         * whispers, and channel joins are held while they can't be sent.
+         *
+         * @return
+         *     Statistics about the queue in which messages, whispers,
+         *     and channel joins are held are returned.
+         */
+        OutboundQueueStatistics GetOutboundQueueStatistics();
+
+        /**
+         * This method returns what is known about the modes of the given
+         * channel, the standing of the user in it, and the messages to it
+         * held in the outbound queue.
+         *
+         * While the outbound queue is set up, messages sent by the user
+         * to a channel are scheduled according to its modes, unless the
+         * user is a moderator or VIP of the channel.  In slow mode,
+         * a message sent too soon after the last one is held in the
+         * outbound queue until enough time has passed, without holding up
+         * messages to other channels.  In subscribers-only mode, messages
+         * from a user who isn't a subscriber are rejected, and in r9k
+         * mode, a message the same as the last one sent to the channel is
+         * rejected.  Slow mode requires a time keeper to be set.
+         * Followers-only and emote-only modes are only reported.  If the
+         * outbound queue isn't set up, messages are sent right away
+         * whatever the modes of the channel.  What's known about
+         * a channel is forgotten when it's left or the connection
+         * is closed.
+         *
+         * @param[in] channel
+         *     This is the name of the channel whose state to return.
+         *
+         * @return
+         *     What is known about the given channel is returned.
+         */
+        ChannelState GetChannelState(const std::string& channel);
+
+        /**
+         * This method selects the kinds of events in which the user is
+         * interested.  Lines received from the Twitch server which could
+         * only result in events of other kinds are dropped as soon as their
+         * command is recognized, without decoding their tags or building
+         * their events.  Lines needed to log in, stay connected, detect
+         * log-in failures, and schedule messages sent to channels are
+         * always handled, and the LogIn and LogOut callbacks are always
+         * made.
+         *
+         * @param[in] events
+         *     This selects the kinds of events in which the user is
+         *     interested, by combining values defined in Events.
+         *     By default, the user is interested in all events.
+         */
+        void SetEventInterests(EventMask events);
+
+        /**
+         * This method sets how many of the chat messages received in the
+         * given channel are passed along.
+         *
+         * @param[in] channel
+         *     This is the name of the channel whose chat messages to sample.
+         *     If empty, the sampling applies to every channel which doesn't
+         *     have sampling of its own.
+         *
+         * @param[in] sampling
+         *     This selects how many chat messages to pass along.
+         */
+        void SetChannelSampling(
+            const std::string& channel,
+            const ChannelSampling& sampling
+        );
+
+        /**
+         * This method removes any sampling previously set for the given
+         * channel.
+         *
+         * @param[in] channel
+         *     This is the name of the channel whose sampling to remove.
+         *     If empty, the sampling which applies to every channel which
+         *     doesn't have sampling of its own is removed.
+         */
+        void ClearChannelSampling(const std::string& channel);
+
+        /**
+         * This method sets up the recording of every line sent to and
+         * received from the Twitch server, with timestamps.  Recording is
+         * started and stopped with the recorder itself.
+         *
+         * @param[in] trafficRecorder
+         *     This is the recorder to use.  If null, lines are
+         *     not recorded.  The recorder must not be shared with any
+         *     other Messaging instance, since it only accepts lines from
+         *     one thread.
+         */
+        void SetTrafficRecorder(std::shared_ptr< TrafficRecorder > trafficRecorder);
+
+        /**
+         * This method turns the collection of metrics about the operation
+         * of the instance on or off.  Metrics are off by default, and
+         * while off, nothing is measured.  Metrics already collected
+         * are kept when metrics are turned off.
+         *
+         * @param[in] enable
+         *     This indicates whether or not to collect metrics.
+         */
+        void EnableMetrics(bool enable);
+
+        /**
+         * This method returns a snapshot of the metrics collected about
+         * the operation of the instance.
+         *
+         * @return
+         *     A snapshot of the metrics collected is returned.
+         */
+        Metrics GetMetrics();
+
+        /**
+         * This method returns the metrics collected about the operation
+         * of the instance, formatted in the Prometheus text exposition
+         * format.  Durations are given in seconds.
+         *
+         * @return
+         *     The metrics collected, in Prometheus text format,
+         *     are returned.
+         */
+        std::string GetMetricsText();
+
+        /**
+         * This method sets how often to publish a summary of the latencies
+         * measured while metrics are enabled, as a diagnostic message at
+         * level 1.  The summary gives the median and 99th percentile of
+         * every latency measured since metrics were first enabled.
+         * Summaries are only published while there is a time keeper.
+         *
+         * @param[in] interval
+         *     This is how often, in seconds, to publish a summary.
+         *     If zero, summaries are not published, which is the default.
+         */
+        void SetLatencySummaryInterval(double interval);
+
+        /**
+         * This method writes the metrics collected about the operation
+         * of the instance, formatted in the Prometheus text exposition
+         * format, to the given file, replacing any file already there.
+         *
+         * @param[in] filePath
+         *     This is the path to the file in which to write the metrics.
+         *
+         * @return
+         *     An indication of whether or not the metrics were written
+         *     is returned.
+         */
+        bool WriteMetrics(const std::string& filePath);
+
         /**
          * This method starts the process of logging into the Twitch server as
          * a registered user/bot.
@@ -897,6 +2034,30 @@ namespace Twitch {
          */
         void LogOut(const std::string& farewell);
 
+        /**
+         * This method starts the process of logging out of the Twitch
+         * server gracefully.  Before the farewell is sent, anything held
+         * in the outbound queue is sent, no faster than the rate limit
+         * allows, and the connection is closed only once everything has
+         * been written to it, unless the given deadline passes first,
+         * in which case the farewell is sent and the connection closed
+         * right away.  Anything still held in the outbound queue stays
+         * there, to be sent after logging in again.
+         *
+         * @param[in] farewell
+         *     This is the message to include in the command sent to the
+         *     Twitch server just before the connection is closed.
+         *
+         * @param[in] deadline
+         *     This is the most number of seconds, according to the time
+         *     keeper, to spend logging out.  If zero, or if no time keeper
+         *     is set, the user agent logs out right away.
+         */
+        void LogOut(
+            const std::string& farewell,
+            double deadline
+        );
+
         /**
          * This method starts the process of joining a Twitch chat channel.
          *
@@ -927,6 +2088,25 @@ namespace Twitch {
             const std::string& message
         );
 
+        /**
+         * This method sends a message to Twitch chat channel, with the
+         * given options.
+         *
+         * @param[in] channel
+         *     This is the name of the channel to which to send the message.
+         *
+         * @param[in] message
+         *     This is the content of the message to send.
+         *
+         * @param[in] options
+         *     These are the options to apply to the message.
+         */
+        void SendMessage(
+            const std::string& channel,
+            const std::string& message,
+            const SendOptions& options
+        );
+
         /**
          * This method sends a response to Twitch chat channel.  A response
          * is like a message, except that it includes a tag indicating
@@ -948,6 +2128,30 @@ namespace Twitch {
             const std::string& parent
         );
 
+        /**
+         * This method sends a response to Twitch chat channel, with the
+         * given options.
+         *
+         * @param[in] channel
+         *     This is the name of the channel to which to send the message.
+         *
+         * @param[in] message
+         *     This is the content of the message to send.
+         *
+         * @param[in] parent
+         *     This is the `id` of the message for which this should
+         *     be interpreted as a response.
+         *
+         * @param[in] options
+         *     These are the options to apply to the message.
+         */
+        void SendResponse(
+            const std::string& channel,
+            const std::string& message,
+            const std::string& parent,
+            const SendOptions& options
+        );
+
         /**
          * This method sends a whsper to another Twitch user.
          *
@@ -962,6 +2166,25 @@ namespace Twitch {
             const std::string& message
         );
 
+        /**
+         * This method sends a whisper to another Twitch user, with the
+         * given options.
+         *
+         * @param[in] nickname
+         *     This is the nickname of the other Twitch user to whisper.
+         *
+         * @param[in] message
+         *     This is the content of the whisper to send.
+         *
+         * @param[in] options
+         *     These are the options to apply to the whisper.
+         */
+        void SendWhisper(
+            const std::string& nickname,
+            const std::string& message,
+            const SendOptions& options
+        );
+
         // Private properties
     private:
         /**
@@ -0,0 +1,303 @@
+#ifndef TWITCH_MESSAGING_FLEET_HPP
+#define TWITCH_MESSAGING_FLEET_HPP
+
+/**
+ * @file MessagingFleet.hpp
+ *
+ * This module declares the Twitch::MessagingFleet class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "Messaging.hpp"
+#include "TimeKeeper.hpp"
+
+#include <memory>
+#include <string>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <vector>
+
+namespace Twitch {
+
+    /**
+     * This class manages many Messaging instances, one per account, logging
+     * them all into Twitch chat concurrently while keeping the number of
+     * log-ins in progress and the rate at which they are started within
+     * configured limits.
+     */
+    class MessagingFleet {
+        // Types
+    public:
+        /**
+         * This holds everything needed to log one account into Twitch chat.
+         */
+        struct Account {
+            /**
+             * This is the nickname to use when logging into chat.
+             */
+            std::string nickname;
+
+            /**
+             * This is the OAuth token to use to authenticate with the Twitch
+             * server.
+             */
+            std::string token;
+
+            /**
+             * These are the channels to join once logged in.
+             */
+            std::vector< std::string > channels;
+
+            /**
+             * If not null, this is the object which will receive the
+             * notifications, events, and other callbacks for the account.
+             */
+            std::shared_ptr< Messaging::User > user;
+        };
+
+        /**
+         * This holds the limits the fleet observes when logging in accounts.
+         */
+        struct Configuration {
+            /**
+             * This is the maximum number of log-ins which may be in progress
+             * at the same time.
+             */
+            size_t maxLogInsInFlight = 10;
+
+            /**
+             * This is the maximum number of log-ins which may be started
+             * within any rate limit window.  Twitch allows 20 authentication
+             * attempts per 10 seconds for a regular account.
+             */
+            size_t maxLogInsPerWindow = 20;
+
+            /**
+             * This is the length of the rate limit window, in seconds.
+             */
+            double rateLimitWindow = 10.0;
+        };
+
+        /**
+         * This summarizes a distribution of latencies, in seconds.
+         */
+        struct LatencyHistogram {
+            /**
+             * This is the number of samples in the distribution.
+             */
+            size_t count = 0;
+
+            /**
+             * This is the smallest sample.
+             */
+            double minimum = 0.0;
+
+            /**
+             * This is the median sample.
+             */
+            double p50 = 0.0;
+
+            /**
+             * This is the sample below which 90 percent of samples fall.
+             */
+            double p90 = 0.0;
+
+            /**
+             * This is the sample below which 99 percent of samples fall.
+             */
+            double p99 = 0.0;
+
+            /**
+             * This is the largest sample.
+             */
+            double maximum = 0.0;
+        };
+
+        /**
+         * This reports how far along the fleet is in logging in accounts.
+         */
+        struct Progress {
+            /**
+             * This is the number of accounts given to the fleet.
+             */
+            size_t total = 0;
+
+            /**
+             * This is the number of accounts whose log-in hasn't started yet.
+             */
+            size_t waiting = 0;
+
+            /**
+             * This is the number of accounts whose log-in is in progress.
+             */
+            size_t inFlight = 0;
+
+            /**
+             * This is the number of accounts which are logged in.
+             */
+            size_t loggedIn = 0;
+
+            /**
+             * This is the number of accounts which failed to log in, or
+             * were logged out.
+             */
+            size_t failed = 0;
+        };
+
+        /**
+         * This reports the progress and latencies observed by the fleet.
+         */
+        struct Report {
+            /**
+             * This reports how far along the fleet is in logging in accounts.
+             */
+            Progress progress;
+
+            /**
+             * This is the distribution of time taken from starting each
+             * log-in to being logged in.
+             */
+            LatencyHistogram timeToLogIn;
+
+            /**
+             * This is the distribution of time taken from starting each
+             * log-in to receiving the first message in a channel.
+             */
+            LatencyHistogram timeToFirstMessage;
+        };
+
+        // Lifecycle management
+    public:
+        ~MessagingFleet() noexcept;
+        MessagingFleet(const MessagingFleet& other) = delete;
+        MessagingFleet(MessagingFleet&&) noexcept = delete;
+        MessagingFleet& operator=(const MessagingFleet& other) = delete;
+        MessagingFleet& operator=(MessagingFleet&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This is the default constructor.
+         */
+        MessagingFleet();
+
+        /**
+         * This method forms a new subscription to diagnostic
+         * messages published by the fleet.  Diagnostic messages of
+         * individual accounts are available from their Messaging instances.
+         *
+         * @param[in] delegate
+         *     This is the function to call to deliver messages
+         *     to the subscriber.
+         *
+         * @param[in] minLevel
+         *     This is the minimum level of message that this subscriber
+         *     desires to receive.
+         *
+         * @return
+         *     A function is returned which may be called
+         *     to terminate the subscription.
+         */
+        SystemAbstractions::DiagnosticsSender::UnsubscribeDelegate SubscribeToDiagnostics(
+            SystemAbstractions::DiagnosticsSender::DiagnosticMessageDelegate delegate,
+            size_t minLevel = 0
+        );
+
+        /**
+         * This method is used to provide the fleet with a means of
+         * establishing connections to the Twitch server.  It is called
+         * once for every connection made by any account.
+         *
+         * @param[in] connectionFactory
+         *     This is the function to call in order to make a new
+         *     connection to the Twitch server.
+         */
+        void SetConnectionFactory(Messaging::ConnectionFactory connectionFactory);
+
+        /**
+         * This method is used to provide the fleet with a means of
+         * measuring elapsed time periods.  If not called, the fleet
+         * measures time with a monotonic clock.
+         *
+         * @param[in] timeKeeper
+         *     This is the object to use to measure elapsed time periods.
+         */
+        void SetTimeKeeper(std::shared_ptr< TimeKeeper > timeKeeper);
+
+        /**
+         * This method sets the limits the fleet observes when logging in
+         * accounts.
+         *
+         * @param[in] configuration
+         *     These are the limits to observe.
+         */
+        void Configure(const Configuration& configuration);
+
+        /**
+         * This method starts the process of logging the given accounts into
+         * Twitch chat.  The accounts are added to any given previously.
+         *
+         * @param[in] accounts
+         *     These are the accounts to log in.
+         */
+        void LogIn(const std::vector< Account >& accounts);
+
+        /**
+         * This method starts the process of logging all accounts out of
+         * the Twitch server.
+         *
+         * @param[in] farewell
+         *     This is the message to include in the command sent to the
+         *     Twitch server just before each connection is closed.
+         */
+        void LogOut(const std::string& farewell);
+
+        /**
+         * This method returns how far along the fleet is in logging in
+         * accounts.
+         *
+         * @return
+         *     How far along the fleet is in logging in accounts is returned.
+         */
+        Progress GetProgress();
+
+        /**
+         * This method returns the progress and latencies observed by the
+         * fleet.
+         *
+         * @return
+         *     The progress and latencies observed by the fleet are returned.
+         */
+        Report GetReport();
+
+        /**
+         * This method returns the Messaging instance used for the account
+         * with the given index, in the order the accounts were given.
+         *
+         * @param[in] index
+         *     This is the index of the account whose Messaging instance
+         *     to return.
+         *
+         * @return
+         *     The Messaging instance used for the account is returned.
+         */
+        Messaging& GetMessaging(size_t index);
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
+
+#endif /* TWITCH_MESSAGING_FLEET_HPP */
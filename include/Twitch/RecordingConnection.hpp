@@ -0,0 +1,87 @@
+#ifndef TWITCH_RECORDING_CONNECTION_HPP
+#define TWITCH_RECORDING_CONNECTION_HPP
+
+/**
+ * @file RecordingConnection.hpp
+ *
+ * This module declares the Twitch::RecordingConnection class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "Connection.hpp"
+
+#include <memory>
+#include <string>
+
+namespace Twitch {
+
+    /**
+     * This is a decorator of any other connection to the Twitch server
+     * which captures, to a file, all the data received and sent over the
+     * connection, exactly as received or sent, along with when the server
+     * closes its end of the connection.  Each record is timed, using a
+     * monotonic clock, from when the connection was established.
+     *
+     * The file uses the format of TrafficRecorder files, and can be
+     * replayed by ReplayConnection.  Any OAuth token sent is redacted.
+     *
+     * Unlike TrafficRecorder, the data is written to the file as it passes
+     * through the connection, since a capture is meant for tests and
+     * benchmarks rather than being left on in production.
+     */
+    class RecordingConnection
+        : public Connection
+    {
+        // Lifecycle management
+    public:
+        ~RecordingConnection() noexcept;
+        RecordingConnection(const RecordingConnection& other) = delete;
+        RecordingConnection(RecordingConnection&&) noexcept = delete;
+        RecordingConnection& operator=(const RecordingConnection& other) = delete;
+        RecordingConnection& operator=(RecordingConnection&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This constructs the connection.
+         *
+         * @param[in] connection
+         *     This is the connection to decorate.
+         *
+         * @param[in] filePath
+         *     This is the path to the file in which to capture the traffic
+         *     of the connection.  It's replaced each time the connection
+         *     is established.
+         */
+        RecordingConnection(
+            std::shared_ptr< Connection > connection,
+            const std::string& filePath
+        );
+
+        // Twitch::Connection
+    public:
+        virtual void SetMessageReceivedDelegate(MessageReceivedDelegate messageReceivedDelegate) override;
+        virtual void SetDisconnectedDelegate(DisconnectedDelegate disconnectedDelegate) override;
+        virtual bool Connect() override;
+        virtual void Disconnect() override;
+        virtual void Send(const std::string& message) override;
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
+
+#endif /* TWITCH_RECORDING_CONNECTION_HPP */
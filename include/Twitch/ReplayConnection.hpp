@@ -0,0 +1,122 @@
+#ifndef TWITCH_REPLAY_CONNECTION_HPP
+#define TWITCH_REPLAY_CONNECTION_HPP
+
+/**
+ * @file ReplayConnection.hpp
+ *
+ * This module declares the Twitch::ReplayConnection class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "Connection.hpp"
+
+#include <memory>
+#include <string>
+
+namespace Twitch {
+
+    /**
+     * This is a connection which, instead of connecting to the Twitch
+     * server, plays back the data received in a file captured by
+     * RecordingConnection, so that Messaging can be driven end to end,
+     * for benchmarks and regression tests, without a network.
+     *
+     * The data is played back on a thread of its own, which is started
+     * when the connection is established.  In order to keep each response
+     * after the request it answers, no data is played back until the
+     * client has sent at least as many lines as had been sent by the point
+     * the data was captured.
+     */
+    class ReplayConnection
+        : public Connection
+    {
+        // Lifecycle management
+    public:
+        ~ReplayConnection() noexcept;
+        ReplayConnection(const ReplayConnection& other) = delete;
+        ReplayConnection(ReplayConnection&&) noexcept = delete;
+        ReplayConnection& operator=(const ReplayConnection& other) = delete;
+        ReplayConnection& operator=(ReplayConnection&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This constructs the connection.
+         *
+         * @param[in] filePath
+         *     This is the path to the file captured by RecordingConnection
+         *     to play back.
+         *
+         * @param[in] speed
+         *     This is how fast to play back the data, relative to how fast
+         *     it was captured.  For example, 1.0 plays it back in real
+         *     time, and 10.0 plays it back ten times as fast.  Zero (or
+         *     any negative value) plays it back as fast as possible.
+         */
+        explicit ReplayConnection(
+            const std::string& filePath,
+            double speed = 1.0
+        );
+
+        /**
+         * This method waits for all the data in the capture file to be
+         * played back, or for the connection to be broken.
+         *
+         * @param[in] timeout
+         *     This is the maximum amount of time, in seconds, to wait.
+         *
+         * @return
+         *     An indication of whether or not the playback finished
+         *     before the timeout is returned.
+         */
+        bool AwaitCompletion(double timeout);
+
+        /**
+         * This method returns the number of records of data received
+         * which have been played back since the connection was last
+         * established.
+         *
+         * @return
+         *     The number of records of data received which have been
+         *     played back since the connection was last established
+         *     is returned.
+         */
+        size_t GetRecordsPlayed();
+
+        /**
+         * This method returns all the data sent by the client since
+         * the connection was last established.
+         *
+         * @return
+         *     All the data sent by the client since the connection was
+         *     last established is returned.
+         */
+        std::string GetDataSent();
+
+        // Twitch::Connection
+    public:
+        virtual void SetMessageReceivedDelegate(MessageReceivedDelegate messageReceivedDelegate) override;
+        virtual void SetDisconnectedDelegate(DisconnectedDelegate disconnectedDelegate) override;
+        virtual bool Connect() override;
+        virtual void Disconnect() override;
+        virtual void Send(const std::string& message) override;
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
+
+#endif /* TWITCH_REPLAY_CONNECTION_HPP */
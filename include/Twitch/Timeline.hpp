@@ -0,0 +1,88 @@
+#ifndef TWITCH_TIMELINE_HPP
+#define TWITCH_TIMELINE_HPP
+
+/**
+ * @file Timeline.hpp
+ *
+ * This module declares the Twitch::Timeline functions.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <string>
+
+namespace Twitch {
+
+    /**
+     * These functions control the recording of a timeline of what the
+     * threads of the library are doing, such as performing actions,
+     * parsing lines, handling commands, and calling the user, and export
+     * it in the Chrome trace event format, which can be loaded into
+     * chrome://tracing or Perfetto.
+     *
+     * The library only records the timeline if it's built with
+     * TWITCH_ENABLE_TRACING defined (the TWITCH_ENABLE_TRACING CMake
+     * option); otherwise none of the instrumentation is compiled.
+     * Each thread records into a buffer of its own, so recording
+     * takes no locks.  The buffer grows as zones are recorded, and is
+     * released once the thread has exited and its zones have been
+     * cleared.
+     */
+    namespace Timeline {
+
+        /**
+         * This function indicates whether or not the library was built
+         * with its timeline instrumentation compiled in.
+         *
+         * @return
+         *     An indication of whether or not the library was built
+         *     with its timeline instrumentation compiled in is returned.
+         */
+        bool IsCompiledIn();
+
+        /**
+         * This function starts recording the timeline.
+         */
+        void Start();
+
+        /**
+         * This function stops recording the timeline.  What was recorded
+         * is kept until Clear is called.
+         */
+        void Stop();
+
+        /**
+         * This function discards everything recorded so far.  It should
+         * not be called while the timeline is being exported.
+         */
+        void Clear();
+
+        /**
+         * This function returns the timeline recorded so far, in the
+         * Chrome trace event JSON format.
+         *
+         * @return
+         *     The timeline recorded so far, in the Chrome trace event
+         *     JSON format, is returned.
+         */
+        std::string GetChromeTrace();
+
+        /**
+         * This function writes the timeline recorded so far, in the
+         * Chrome trace event JSON format, to the given file, replacing
+         * any file already there.
+         *
+         * @param[in] filePath
+         *     This is the path to the file in which to write the timeline.
+         *
+         * @return
+         *     An indication of whether or not the timeline was written
+         *     is returned.
+         */
+        bool WriteChromeTrace(const std::string& filePath);
+
+    }
+
+}
+
+#endif /* TWITCH_TIMELINE_HPP */
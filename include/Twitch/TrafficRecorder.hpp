@@ -0,0 +1,289 @@
+#ifndef TWITCH_TRAFFIC_RECORDER_HPP
+#define TWITCH_TRAFFIC_RECORDER_HPP
+
+/**
+ * @file TrafficRecorder.hpp
+ *
+ * This module declares the Twitch::TrafficRecorder class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+
+namespace Twitch {
+
+    /**
+     * This class records lines sent to and received from the Twitch server,
+     * with timestamps, to a file in a compact binary format.  Recording a
+     * line only copies it into a fixed-size lock-free ring buffer, which a
+     * background thread drains to the file, so that recording can be left
+     * on at full traffic rates.
+     *
+     * Lines must be recorded from only one thread.  The first thread to
+     * record a line after recording is started becomes the only thread
+     * allowed to record lines, until recording is started again.  Lines
+     * recorded from any other thread are refused.  This means a recorder
+     * can't be shared by more than one Messaging instance.
+     *
+     * The file begins with the four characters "TTR1", followed by
+     * records, each consisting of:
+     *
+     * - 1 byte: the type of record (see Record::Type)
+     * - 8 bytes: the time of the record, in microseconds since the UNIX
+     *   epoch (little-endian)
+     * - 4 bytes: the length of the line (little-endian)
+     * - the line, without any line terminator
+     *
+     * The same format is used by RecordingConnection and ReplayConnection
+     * to capture and replay the raw data of a whole connection.
+     */
+    class TrafficRecorder {
+        // Types
+    public:
+        /**
+         * This holds one record of traffic, as read back from a file.
+         */
+        struct Record {
+            /**
+             * These are the types of records.
+             */
+            enum class Type : uint8_t {
+                /**
+                 * A line received from the Twitch server.
+                 */
+                Received = 0,
+
+                /**
+                 * A line sent to the Twitch server.
+                 */
+                Sent = 1,
+
+                /**
+                 * Records dropped because the ring buffer was full.
+                 * The line holds the number of records dropped, in decimal.
+                 */
+                Dropped = 2,
+
+                /**
+                 * Data received from the Twitch server, exactly as
+                 * received, including any line terminators.
+                 */
+                ReceivedData = 3,
+
+                /**
+                 * Data sent to the Twitch server, exactly as sent,
+                 * including any line terminators.
+                 */
+                SentData = 4,
+
+                /**
+                 * The Twitch server closed its end of the connection.
+                 * The line is empty.
+                 */
+                Disconnected = 5,
+            };
+
+            /**
+             * This is the type of record.
+             */
+            Type type = Type::Received;
+
+            /**
+             * This is the time of the record, in microseconds.  Records made
+             * by TrafficRecorder are timed from the UNIX epoch (1 January
+             * 1970, Midnight, UTC).  Records made by RecordingConnection are
+             * timed from when the connection was established.
+             */
+            uint64_t time = 0;
+
+            /**
+             * This is the line recorded, without any line terminator,
+             * or for ReceivedData and SentData records, the data exactly
+             * as received or sent.
+             */
+            std::string line;
+        };
+
+        // Lifecycle management
+    public:
+        ~TrafficRecorder() noexcept;
+        TrafficRecorder(const TrafficRecorder& other) = delete;
+        TrafficRecorder(TrafficRecorder&&) noexcept = delete;
+        TrafficRecorder& operator=(const TrafficRecorder& other) = delete;
+        TrafficRecorder& operator=(TrafficRecorder&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This is the default constructor.
+         */
+        TrafficRecorder();
+
+        /**
+         * This method starts recording to the given file, replacing any
+         * file already there.
+         *
+         * @param[in] filePath
+         *     This is the path to the file in which to record traffic.
+         *
+         * @param[in] capacity
+         *     This is the size, in bytes, of the ring buffer holding
+         *     records not yet written to the file.  It's rounded up to
+         *     a power of two.
+         *
+         * @return
+         *     An indication of whether or not recording was started
+         *     is returned.
+         */
+        bool Start(
+            const std::string& filePath,
+            size_t capacity = 1048576
+        );
+
+        /**
+         * This method stops recording, after writing to the file any
+         * records not yet written.
+         */
+        void Stop();
+
+        /**
+         * This method records a line received from the Twitch server.
+         *
+         * @param[in] line
+         *     This is the line received, without any line terminator.
+         *
+         * @return
+         *     An indication of whether or not the line was recorded is
+         *     returned.  It isn't recorded if recording hasn't been started,
+         *     if the ring buffer is full, or if it's called from a thread
+         *     other than the one which records lines.
+         */
+        bool RecordReceived(const std::string& line);
+
+        /**
+         * This method records a line sent to the Twitch server.  Any OAuth
+         * token in the line is redacted.
+         *
+         * @param[in] line
+         *     This is the line sent, without any line terminator.
+         *
+         * @return
+         *     An indication of whether or not the line was recorded is
+         *     returned.  It isn't recorded if recording hasn't been started,
+         *     if the ring buffer is full, or if it's called from a thread
+         *     other than the one which records lines.
+         */
+        bool RecordSent(const std::string& line);
+
+        /**
+         * This function checks for and skips past the beginning of a file
+         * of recorded traffic.
+         *
+         * @param[in,out] input
+         *     This is the stream from which to read the file.
+         *
+         * @return
+         *     An indication of whether or not the stream begins with what's
+         *     expected at the beginning of a file of recorded traffic
+         *     is returned.
+         */
+        static bool ReadHeader(std::istream& input);
+
+        /**
+         * This function reads the next record from a file of recorded
+         * traffic.
+         *
+         * @param[in,out] input
+         *     This is the stream from which to read the file.
+         *
+         * @param[out] record
+         *     This is where to store the record read.
+         *
+         * @return
+         *     An indication of whether or not a complete record was read
+         *     is returned.
+         */
+        static bool ReadRecord(
+            std::istream& input,
+            Record& record
+        );
+
+        /**
+         * This function writes the given record to a file of recorded
+         * traffic.
+         *
+         * @param[in,out] output
+         *     This is the stream to which to write the file.
+         *
+         * @param[in] record
+         *     This is the record to write.
+         *
+         * @return
+         *     An indication of whether or not the record was written
+         *     is returned.
+         */
+        static bool WriteRecord(
+            std::ostream& output,
+            const Record& record
+        );
+
+        /**
+         * This function writes what is expected at the beginning of
+         * a file of recorded traffic.
+         *
+         * @param[in,out] output
+         *     This is the stream to which to write the file.
+         *
+         * @return
+         *     An indication of whether or not the beginning of the file
+         *     was written is returned.
+         */
+        static bool WriteHeader(std::ostream& output);
+
+        /**
+         * This function returns a copy of the given data to be sent to the
+         * Twitch server, with any OAuth token in it redacted.
+         *
+         * @param[in] data
+         *     This is the data to be sent, which may hold several lines.
+         *
+         * @return
+         *     A copy of the given data, with any OAuth token in it
+         *     redacted, is returned.
+         */
+        static std::string Redact(const std::string& data);
+
+        /**
+         * This function formats the given record as a line of text.
+         *
+         * @param[in] record
+         *     This is the record to format.
+         *
+         * @return
+         *     The record, formatted as a line of text, is returned.
+         */
+        static std::string FormatRecord(const Record& record);
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
+
+#endif /* TWITCH_TRAFFIC_RECORDER_HPP */
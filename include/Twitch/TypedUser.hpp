@@ -0,0 +1,262 @@
+#ifndef TWITCH_TYPED_USER_HPP
+#define TWITCH_TYPED_USER_HPP
+
+/**
+ * @file TypedUser.hpp
+ *
+ * This module declares the Twitch::TypedUser class template.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "Messaging.hpp"
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * This macro declares, within the TypedUser class template, what is needed
+ * to detect whether or not the handler type has a method handling the
+ * given kind of event, and to forward the event to it if it does.
+ *
+ * @param[in] name
+ *     This is the name of the User method, and of the handler method,
+ *     which handle the kind of event.
+ *
+ * @param[in] Info
+ *     This is the type of information carried by the kind of event.
+ */
+#define TWITCH_TYPED_USER_EVENT(name, Info) \
+    private: \
+        template< typename H > static auto Detect##name(int) \
+            -> decltype(std::declval< H& >().name(std::declval< Messaging::Info&& >()), std::true_type()); \
+        template< typename H > static std::false_type Detect##name(...); \
+        void Forward##name(Messaging::Info&& info, std::true_type) { \
+            handler_->name(std::move(info)); \
+        } \
+        void Forward##name(Messaging::Info&&, std::false_type) { \
+        } \
+    public: \
+        static constexpr bool Has##name() { \
+            return decltype(Detect##name< Handler >(0))::value; \
+        } \
+        virtual void name(Messaging::Info&& info) override { \
+            Forward##name(std::move(info), std::integral_constant< bool, Has##name() >()); \
+        }
+
+/**
+ * This macro declares, within the TypedUser class template, what is needed
+ * to detect whether or not the handler type has a method handling the
+ * given kind of event, which carries no information, and to forward the
+ * event to it if it does.
+ *
+ * @param[in] name
+ *     This is the name of the User method, and of the handler method,
+ *     which handle the kind of event.
+ */
+#define TWITCH_TYPED_USER_EVENT_WITHOUT_INFO(name) \
+    private: \
+        template< typename H > static auto Detect##name(int) \
+            -> decltype(std::declval< H& >().name(), std::true_type()); \
+        template< typename H > static std::false_type Detect##name(...); \
+        void Forward##name(std::true_type) { \
+            handler_->name(); \
+        } \
+        void Forward##name(std::false_type) { \
+        } \
+    public: \
+        static constexpr bool Has##name() { \
+            return decltype(Detect##name< Handler >(0))::value; \
+        } \
+        virtual void name() override { \
+            Forward##name(std::integral_constant< bool, Has##name() >()); \
+        }
+
+namespace Twitch {
+
+    /**
+     * This adapts an object of any type having methods named and typed like
+     * some or all of the Messaging::User methods into a Messaging::User.
+     * Which methods the handler type has is determined at compile time, and
+     * GetEventInterests returns them as the mask to give
+     * Messaging::SetEventInterests, so that Messaging doesn't build the
+     * kinds of events for which the handler has no method.  Events still
+     * reach the adapter through the virtual User methods, like they reach
+     * any other user, and the adapter then calls the handler's method.
+     *
+     * @tparam Handler
+     *     This is the type of object which handles events.
+     */
+    template< typename Handler > class TypedUser final
+        : public Messaging::User
+    {
+        // Lifecycle management
+    public:
+        ~TypedUser() noexcept = default;
+        TypedUser(const TypedUser&) = delete;
+        TypedUser(TypedUser&&) noexcept = delete;
+        TypedUser& operator=(const TypedUser&) = delete;
+        TypedUser& operator=(TypedUser&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This constructs the adapter.
+         *
+         * @param[in] handler
+         *     This is the object to which to forward events.
+         */
+        explicit TypedUser(std::shared_ptr< Handler > handler)
+            : handler_(handler)
+        {
+        }
+
+        TWITCH_TYPED_USER_EVENT_WITHOUT_INFO(Doom)
+        TWITCH_TYPED_USER_EVENT_WITHOUT_INFO(LogIn)
+        TWITCH_TYPED_USER_EVENT_WITHOUT_INFO(LogOut)
+        TWITCH_TYPED_USER_EVENT(Join, MembershipInfo)
+        TWITCH_TYPED_USER_EVENT(Leave, MembershipInfo)
+        TWITCH_TYPED_USER_EVENT(NameList, NameListInfo)
+        TWITCH_TYPED_USER_EVENT(Message, MessageInfo)
+        TWITCH_TYPED_USER_EVENT(PrivateMessage, MessageInfo)
+        TWITCH_TYPED_USER_EVENT(Whisper, WhisperInfo)
+        TWITCH_TYPED_USER_EVENT(Notice, NoticeInfo)
+        TWITCH_TYPED_USER_EVENT(Host, HostInfo)
+        TWITCH_TYPED_USER_EVENT(RoomModeChange, RoomModeChangeInfo)
+        TWITCH_TYPED_USER_EVENT(Clear, ClearInfo)
+        TWITCH_TYPED_USER_EVENT(Mod, ModInfo)
+        TWITCH_TYPED_USER_EVENT(UserState, UserStateInfo)
+        TWITCH_TYPED_USER_EVENT(Sub, SubInfo)
+        TWITCH_TYPED_USER_EVENT(Raid, RaidInfo)
+        TWITCH_TYPED_USER_EVENT(Ritual, RitualInfo)
+
+    private:
+        template< typename H > static auto DetectMessages(int)
+            -> decltype(std::declval< H& >().Messages(std::declval< std::vector< Messaging::MessageInfo >&& >()), std::true_type());
+        template< typename H > static std::false_type DetectMessages(...);
+
+        void ForwardMessages(
+            std::vector< Messaging::MessageInfo >&& messageInfos,
+            std::true_type
+        ) {
+            handler_->Messages(std::move(messageInfos));
+        }
+
+        void ForwardMessages(
+            std::vector< Messaging::MessageInfo >&& messageInfos,
+            std::false_type
+        ) {
+            for (auto& messageInfo: messageInfos) {
+                ForwardMessage(
+                    std::move(messageInfo),
+                    std::integral_constant< bool, HasMessage() >()
+                );
+            }
+        }
+
+    public:
+        /**
+         * This method indicates whether or not the handler type has a
+         * method which handles batches of messages.
+         *
+         * @return
+         *     An indication of whether or not the handler type has a
+         *     method which handles batches of messages is returned.
+         */
+        static constexpr bool HasMessages() {
+            return decltype(DetectMessages< Handler >(0))::value;
+        }
+
+        virtual void Messages(std::vector< Messaging::MessageInfo >&& messageInfos) override {
+            ForwardMessages(
+                std::move(messageInfos),
+                std::integral_constant< bool, HasMessages() >()
+            );
+        }
+
+    private:
+        template< typename H > static auto DetectRawMessage(int)
+            -> decltype(std::declval< H& >().RawMessage(std::declval< const Messaging::RawMessageInfo& >()), std::true_type());
+        template< typename H > static std::false_type DetectRawMessage(...);
+
+        void ForwardRawMessage(
+            const Messaging::RawMessageInfo& rawMessageInfo,
+            std::true_type
+        ) {
+            handler_->RawMessage(rawMessageInfo);
+        }
+
+        void ForwardRawMessage(
+            const Messaging::RawMessageInfo&,
+            std::false_type
+        ) {
+        }
+
+    public:
+        /**
+         * This method indicates whether or not the handler type has a
+         * method which handles raw messages.
+         *
+         * @return
+         *     An indication of whether or not the handler type has a
+         *     method which handles raw messages is returned.
+         */
+        static constexpr bool HasRawMessage() {
+            return decltype(DetectRawMessage< Handler >(0))::value;
+        }
+
+        virtual void RawMessage(const Messaging::RawMessageInfo& rawMessageInfo) override {
+            ForwardRawMessage(
+                rawMessageInfo,
+                std::integral_constant< bool, HasRawMessage() >()
+            );
+        }
+
+        /**
+         * This method returns the kinds of events for which the handler
+         * type has methods.
+         *
+         * @return
+         *     The kinds of events for which the handler type has methods
+         *     are returned.
+         */
+        static constexpr Messaging::EventMask GetEventInterests() {
+            return (
+                (HasDoom() ? (Messaging::EventMask)Messaging::Events::Doom : (Messaging::EventMask)0)
+                | (HasLogIn() ? (Messaging::EventMask)Messaging::Events::LogIn : (Messaging::EventMask)0)
+                | (HasLogOut() ? (Messaging::EventMask)Messaging::Events::LogOut : (Messaging::EventMask)0)
+                | (HasJoin() ? (Messaging::EventMask)Messaging::Events::Join : (Messaging::EventMask)0)
+                | (HasLeave() ? (Messaging::EventMask)Messaging::Events::Leave : (Messaging::EventMask)0)
+                | (HasNameList() ? (Messaging::EventMask)Messaging::Events::NameList : (Messaging::EventMask)0)
+                | ((HasMessage() || HasMessages()) ? (Messaging::EventMask)Messaging::Events::Message : (Messaging::EventMask)0)
+                | (HasPrivateMessage() ? (Messaging::EventMask)Messaging::Events::PrivateMessage : (Messaging::EventMask)0)
+                | (HasWhisper() ? (Messaging::EventMask)Messaging::Events::Whisper : (Messaging::EventMask)0)
+                | (HasNotice() ? (Messaging::EventMask)Messaging::Events::Notice : (Messaging::EventMask)0)
+                | (HasHost() ? (Messaging::EventMask)Messaging::Events::Host : (Messaging::EventMask)0)
+                | (HasRoomModeChange() ? (Messaging::EventMask)Messaging::Events::RoomModeChange : (Messaging::EventMask)0)
+                | (HasClear() ? (Messaging::EventMask)Messaging::Events::Clear : (Messaging::EventMask)0)
+                | (HasMod() ? (Messaging::EventMask)Messaging::Events::Mod : (Messaging::EventMask)0)
+                | (HasUserState() ? (Messaging::EventMask)Messaging::Events::UserState : (Messaging::EventMask)0)
+                | (HasSub() ? (Messaging::EventMask)Messaging::Events::Sub : (Messaging::EventMask)0)
+                | (HasRaid() ? (Messaging::EventMask)Messaging::Events::Raid : (Messaging::EventMask)0)
+                | (HasRitual() ? (Messaging::EventMask)Messaging::Events::Ritual : (Messaging::EventMask)0)
+                | (HasRawMessage() ? (Messaging::EventMask)Messaging::Events::RawMessage : (Messaging::EventMask)0)
+            );
+        }
+
+        // Private properties
+    private:
+        /**
+         * This is the object to which to forward events.
+         */
+        std::shared_ptr< Handler > handler_;
+    };
+
+}
+
+#undef TWITCH_TYPED_USER_EVENT
+#undef TWITCH_TYPED_USER_EVENT_WITHOUT_INFO
+
+#endif /* TWITCH_TYPED_USER_HPP */
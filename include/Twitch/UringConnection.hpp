@@ -0,0 +1,230 @@
+#ifndef TWITCH_URING_CONNECTION_HPP
+#define TWITCH_URING_CONNECTION_HPP
+
+/**
+ * @file UringConnection.hpp
+ *
+ * This module declares the Twitch::UringReactor and
+ * Twitch::UringConnection classes.  They're only available on Linux,
+ * when the library is built against kernel headers which support
+ * io_uring multishot receive and provided buffer rings.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "Connection.hpp"
+#include "ConnectionV2.hpp"
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace Twitch {
+
+    /**
+     * This class services any number of UringConnection instances with
+     * one io_uring instance and one thread.
+     *
+     * Each connection keeps one multishot receive outstanding, which the
+     * kernel completes into buffers it picks from a ring of buffers
+     * provided by the reactor and shared by all its connections, so that
+     * no receive needs to be resubmitted and no connection holds a buffer
+     * while idle.  All the sends and receives the reactor has to start
+     * are submitted together with the same system call used to wait for
+     * completions.
+     *
+     * Connections with a buffer received delegate are lent the buffers
+     * their data arrives in, which go back to the kernel once released.
+     * Only while half the buffers are already lent out is data copied
+     * out of its buffer instead, so that the kernel never runs out of
+     * buffers to receive into.
+     */
+    class UringReactor {
+        // Lifecycle management
+    public:
+        ~UringReactor() noexcept;
+        UringReactor(const UringReactor& other) = delete;
+        UringReactor(UringReactor&&) noexcept = delete;
+        UringReactor& operator=(const UringReactor& other) = delete;
+        UringReactor& operator=(UringReactor&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This is the default constructor.  If the kernel doesn't support
+         * what the reactor needs, the reactor is left unusable, which can
+         * be checked by calling IsUsable.
+         */
+        UringReactor();
+
+        /**
+         * This method indicates whether or not the reactor was set up
+         * and can service connections.
+         *
+         * @return
+         *     An indication of whether or not the reactor was set up
+         *     and can service connections is returned.
+         */
+        bool IsUsable() const;
+
+        /**
+         * This method returns the number of system calls the reactor and
+         * the connections it services have made so far.  It's meant for
+         * benchmarks.
+         *
+         * @return
+         *     The number of system calls made so far to service the
+         *     connections of the reactor is returned.
+         */
+        uint64_t GetSystemCallCount() const;
+
+        /**
+         * This method returns the number of bytes received so far which
+         * were copied out of the buffers provided to the kernel, rather
+         * than lent out to the connections' receivers.  It's meant for
+         * benchmarks.
+         *
+         * @return
+         *     The number of bytes received so far which were copied
+         *     is returned.
+         */
+        uint64_t GetBytesCopied() const;
+
+        /**
+         * This function indicates whether or not the running kernel
+         * supports what UringReactor needs.  The answer is worked out
+         * the first time the function is called.
+         *
+         * @return
+         *     An indication of whether or not the running kernel supports
+         *     what UringReactor needs is returned.
+         */
+        static bool IsSupported();
+
+        /**
+         * This function returns the reactor shared by every
+         * UringConnection constructed without one of its own.
+         * It's made the first time it's needed.
+         *
+         * @return
+         *     The reactor shared by every UringConnection constructed
+         *     without one of its own is returned.
+         */
+        static std::shared_ptr< UringReactor > GetDefault();
+
+        // Private properties
+    private:
+        friend class UringConnection;
+
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+    /**
+     * This is an implementation of the Connection and ConnectionV2
+     * interfaces which uses a TCP socket serviced by a UringReactor.
+     *
+     * Data received is lent out, in the buffer the kernel received it
+     * into, to the buffer received delegate.  The data and message
+     * received delegates are instead given a copy, so that the buffer
+     * can be given back to the kernel right away.
+     *
+     * Messages sent are appended to an outbound buffer, which the reactor
+     * sends in one operation; anything sent while that operation is in
+     * progress is sent together in the next one.
+     */
+    class UringConnection
+        : public Connection
+        , public ConnectionV2
+    {
+        // Lifecycle management
+    public:
+        ~UringConnection() noexcept;
+        UringConnection(const UringConnection& other) = delete;
+        UringConnection(UringConnection&&) noexcept = delete;
+        UringConnection& operator=(const UringConnection& other) = delete;
+        UringConnection& operator=(UringConnection&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This constructs the connection.
+         *
+         * @param[in] host
+         *     This is the host name or address of the Twitch chat server.
+         *
+         * @param[in] port
+         *     This is the port number of the Twitch chat server.
+         *
+         * @param[in] reactor
+         *     This is the reactor to service the connection.  If null,
+         *     the reactor returned by UringReactor::GetDefault is used.
+         */
+        explicit UringConnection(
+            const std::string& host = "irc.chat.twitch.tv",
+            uint16_t port = 6667,
+            std::shared_ptr< UringReactor > reactor = nullptr
+        );
+
+        /**
+         * This function makes a connection to the given server which uses
+         * io_uring if the running kernel supports it, or epoll otherwise,
+         * each with its default reactor.
+         *
+         * @param[in] host
+         *     This is the host name or address of the Twitch chat server.
+         *
+         * @param[in] port
+         *     This is the port number of the Twitch chat server.
+         *
+         * @return
+         *     The connection made is returned.
+         */
+        static std::shared_ptr< Connection > Create(
+            const std::string& host = "irc.chat.twitch.tv",
+            uint16_t port = 6667
+        );
+
+        // Twitch::Connection
+    public:
+        virtual void SetMessageReceivedDelegate(MessageReceivedDelegate messageReceivedDelegate) override;
+        virtual void SetDisconnectedDelegate(DisconnectedDelegate disconnectedDelegate) override;
+        virtual bool Connect() override;
+        virtual void Disconnect() override;
+        virtual void Send(const std::string& message) override;
+
+        // Twitch::ConnectionV2
+    public:
+        virtual void SetDataReceivedDelegate(DataReceivedDelegate dataReceivedDelegate) override;
+        virtual void SetBufferReceivedDelegate(BufferReceivedDelegate bufferReceivedDelegate) override;
+        virtual void Send(const Fragment* fragments, size_t numFragments) override;
+        virtual bool IsSendPending() override;
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
+
+#endif /* TWITCH_URING_CONNECTION_HPP */
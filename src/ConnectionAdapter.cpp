@@ -0,0 +1,130 @@
+/**
+ * @file ConnectionAdapter.cpp
+ *
+ * This module contains the implementation of the
+ * Twitch::ConnectionAdapter class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <Twitch/ConnectionAdapter.hpp>
+
+namespace Twitch {
+
+    /**
+     * This contains the private properties of a ConnectionAdapter instance.
+     */
+    struct ConnectionAdapter::Impl {
+        // Properties
+
+        /**
+         * This is the connection to which everything is passed along.
+         */
+        std::shared_ptr< Connection > adaptee;
+
+        /**
+         * This is used to synchronize access to the data received
+         * delegate and the buffer handed to it.
+         */
+        std::mutex mutex;
+
+        /**
+         * This is the function to call whenever any data is received
+         * from the Twitch server.
+         */
+        DataReceivedDelegate dataReceivedDelegate;
+
+        /**
+         * This holds the data last received, as handed to the data
+         * received delegate.  It's kept so that its storage is reused,
+         * unless the delegate takes it.
+         */
+        std::string received;
+
+        /**
+         * This holds the fragments of the data last sent, put together.
+         * It's kept so that its storage is reused.
+         */
+        std::string outbound;
+
+        /**
+         * This is used to synchronize access to the outbound buffer.
+         */
+        std::mutex outboundMutex;
+
+        // Methods
+
+        /**
+         * This method is called whenever the adaptee receives data
+         * from the Twitch server.
+         *
+         * @param[in] message
+         *     This is the data received from the Twitch server.
+         */
+        void OnMessageReceived(const std::string& message) {
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            if (dataReceivedDelegate == nullptr) {
+                return;
+            }
+            // The adaptee only lends out the data, so it has to be copied
+            // into a string the delegate may take.  The copy reuses the
+            // storage of whatever the delegate left behind last time.
+            received.assign(message);
+            dataReceivedDelegate(std::move(received));
+        }
+    };
+
+    ConnectionAdapter::~ConnectionAdapter() noexcept {
+        impl_->adaptee->SetMessageReceivedDelegate(nullptr);
+        impl_->adaptee->SetDisconnectedDelegate(nullptr);
+    }
+
+    ConnectionAdapter::ConnectionAdapter(std::shared_ptr< Connection > adaptee)
+        : impl_(new Impl)
+    {
+        impl_->adaptee = adaptee;
+        impl_->adaptee->SetMessageReceivedDelegate(
+            std::bind(&Impl::OnMessageReceived, impl_.get(), std::placeholders::_1)
+        );
+    }
+
+    std::shared_ptr< ConnectionV2 > ConnectionAdapter::Adapt(std::shared_ptr< Connection > connection) {
+        const auto connectionV2 = std::dynamic_pointer_cast< ConnectionV2 >(connection);
+        if (connectionV2 != nullptr) {
+            return connectionV2;
+        }
+        return std::make_shared< ConnectionAdapter >(connection);
+    }
+
+    void ConnectionAdapter::SetDataReceivedDelegate(DataReceivedDelegate dataReceivedDelegate) {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        impl_->dataReceivedDelegate = dataReceivedDelegate;
+    }
+
+    void ConnectionAdapter::SetDisconnectedDelegate(Connection::DisconnectedDelegate disconnectedDelegate) {
+        impl_->adaptee->SetDisconnectedDelegate(disconnectedDelegate);
+    }
+
+    bool ConnectionAdapter::Connect() {
+        return impl_->adaptee->Connect();
+    }
+
+    void ConnectionAdapter::Disconnect() {
+        impl_->adaptee->Disconnect();
+    }
+
+    void ConnectionAdapter::Send(const Fragment* fragments, size_t numFragments) {
+        std::lock_guard< decltype(impl_->outboundMutex) > lock(impl_->outboundMutex);
+        // The adaptee can only send a whole string, so the fragments are
+        // gathered into one, whose storage is reused from send to send.
+        impl_->outbound.clear();
+        for (size_t i = 0; i < numFragments; ++i) {
+            impl_->outbound.append(fragments[i].data, fragments[i].length);
+        }
+        impl_->adaptee->Send(impl_->outbound);
+    }
+
+}
@@ -0,0 +1,113 @@
+/**
+ * @file ConnectionV2.cpp
+ *
+ * This module contains the implementation of the parts of the
+ * Twitch::ConnectionV2 interface which implementations may leave as
+ * they are.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <string>
+#include <Twitch/ConnectionV2.hpp>
+#include <utility>
+
+namespace Twitch {
+
+    ConnectionV2::ReceivedBuffer::~ReceivedBuffer() noexcept {
+        Release();
+    }
+
+    ConnectionV2::ReceivedBuffer::ReceivedBuffer(ReceivedBuffer&& other) noexcept
+        : length_(other.length_)
+        , owned_(std::move(other.owned_))
+        , pool_(std::move(other.pool_))
+        , returnFunction_(other.returnFunction_)
+        , token_(other.token_)
+    {
+        data_ = (returnFunction_ == nullptr) ? owned_.data() : other.data_;
+        other.data_ = nullptr;
+        other.length_ = 0;
+        other.owned_.clear();
+        other.returnFunction_ = nullptr;
+    }
+
+    ConnectionV2::ReceivedBuffer& ConnectionV2::ReceivedBuffer::operator=(ReceivedBuffer&& other) noexcept {
+        if (this != &other) {
+            Release();
+            length_ = other.length_;
+            owned_ = std::move(other.owned_);
+            pool_ = std::move(other.pool_);
+            returnFunction_ = other.returnFunction_;
+            token_ = other.token_;
+            data_ = (returnFunction_ == nullptr) ? owned_.data() : other.data_;
+            other.data_ = nullptr;
+            other.length_ = 0;
+            other.owned_.clear();
+            other.returnFunction_ = nullptr;
+        }
+        return *this;
+    }
+
+    ConnectionV2::ReceivedBuffer::ReceivedBuffer() = default;
+
+    ConnectionV2::ReceivedBuffer::ReceivedBuffer(std::string&& data)
+        : owned_(std::move(data))
+    {
+        data_ = owned_.data();
+        length_ = owned_.length();
+    }
+
+    ConnectionV2::ReceivedBuffer::ReceivedBuffer(
+        const char* data,
+        size_t length,
+        std::shared_ptr< void > pool,
+        ReturnFunction returnFunction,
+        uintptr_t token
+    )
+        : data_(data)
+        , length_(length)
+        , pool_(std::move(pool))
+        , returnFunction_(returnFunction)
+        , token_(token)
+    {
+    }
+
+    const char* ConnectionV2::ReceivedBuffer::GetData() const {
+        return data_;
+    }
+
+    size_t ConnectionV2::ReceivedBuffer::GetLength() const {
+        return length_;
+    }
+
+    void ConnectionV2::ReceivedBuffer::Truncate(size_t length) {
+        if (length < length_) {
+            length_ = length;
+        }
+    }
+
+    void ConnectionV2::ReceivedBuffer::Release() {
+        if (returnFunction_ != nullptr) {
+            returnFunction_(pool_.get(), token_);
+            returnFunction_ = nullptr;
+        }
+        pool_ = nullptr;
+        owned_.clear();
+        data_ = nullptr;
+        length_ = 0;
+    }
+
+    void ConnectionV2::SetBufferReceivedDelegate(BufferReceivedDelegate bufferReceivedDelegate) {
+        if (bufferReceivedDelegate == nullptr) {
+            SetDataReceivedDelegate(nullptr);
+            return;
+        }
+        SetDataReceivedDelegate(
+            [bufferReceivedDelegate](std::string&& data){
+                bufferReceivedDelegate(ReceivedBuffer(std::move(data)));
+            }
+        );
+    }
+
+}
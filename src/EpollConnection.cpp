@@ -0,0 +1,621 @@
+/**
+ * @file EpollConnection.cpp
+ *
+ * This module contains the implementation of the Twitch::EpollReactor and
+ * Twitch::EpollConnection classes.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "TcpSocket.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <mutex>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <thread>
+#include <Twitch/EpollConnection.hpp>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the most number of bytes read from a socket at a time.
+     */
+    constexpr size_t RECEIVE_BUFFER_SIZE = 65536;
+
+    /**
+     * This is the most number of events each reactor thread handles
+     * each time it wakes up.
+     */
+    constexpr int MAX_EVENTS_PER_WAIT = 64;
+
+    /**
+     * This is the identifier of the event used to wake up the reactor
+     * threads when the reactor is being destroyed.  No socket is given
+     * this identifier.
+     */
+    constexpr uint64_t WAKE_IDENTIFIER = 0;
+
+    /**
+     * This holds everything the reactor knows about one socket.
+     */
+    struct Socket {
+        /**
+         * This is used to synchronize reading from the socket and
+         * delivering what was read.  It's recursive so that the
+         * connection may be broken from within a delegate.
+         */
+        std::recursive_mutex readMutex;
+
+        /**
+         * This is used to synchronize access to the outbound buffer
+         * and writing to the socket.
+         */
+        std::mutex writeMutex;
+
+        /**
+         * This is the operating system handle of the socket, or -1 if
+         * there is no socket.
+         */
+        int handle = -1;
+
+        /**
+         * This identifies the socket within its reactor.
+         */
+        uint64_t identifier = 0;
+
+        /**
+         * This indicates whether or not the socket is connected and
+         * registered with the reactor.  It's only changed while holding
+         * both the read and write mutexes.
+         */
+        bool open = false;
+
+        /**
+         * This is the buffer into which data is read from the socket,
+         * and which is then handed to the message or data received
+         * delegate.  It's kept so that its storage is reused, unless the
+         * data received delegate takes it.
+         */
+        std::string received;
+
+        /**
+         * This holds data waiting to be written to the socket.
+         */
+        std::string outbound;
+
+        /**
+         * This is how much of the data at the front of the outbound
+         * buffer has already been written.
+         */
+        size_t outboundSent = 0;
+
+        /**
+         * This counts the system calls made by the reactor servicing
+         * the socket.
+         */
+        std::atomic< uint64_t >* systemCalls = nullptr;
+
+        /**
+         * This is the function to call whenever any data is received.
+         */
+        Twitch::Connection::MessageReceivedDelegate messageReceivedDelegate;
+
+        /**
+         * This is the function to call whenever any data is received,
+         * handing the data over.  It takes the place of the message
+         * received delegate, if set.
+         */
+        Twitch::ConnectionV2::DataReceivedDelegate dataReceivedDelegate;
+
+        /**
+         * This is the function to call when the other end closes
+         * the connection.
+         */
+        Twitch::Connection::DisconnectedDelegate disconnectedDelegate;
+
+        /**
+         * This method writes as much of the outbound buffer as the socket
+         * will take without blocking.  The write mutex must be held.
+         *
+         * @return
+         *     An indication of whether or not the socket is still
+         *     usable is returned.
+         */
+        bool Flush() {
+            while (outboundSent < outbound.length()) {
+                (void)systemCalls->fetch_add(1, std::memory_order_relaxed);
+                const auto amountSent = send(
+                    handle,
+                    outbound.data() + outboundSent,
+                    outbound.length() - outboundSent,
+                    MSG_NOSIGNAL
+                );
+                if (amountSent < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return (
+                        (errno == EAGAIN)
+                        || (errno == EWOULDBLOCK)
+                    );
+                }
+                outboundSent += (size_t)amountSent;
+            }
+            outbound.clear();
+            outboundSent = 0;
+            return true;
+        }
+
+        /**
+         * This method returns the events for which to wait on the socket.
+         * The write mutex must be held.
+         *
+         * @return
+         *     The events for which to wait on the socket are returned.
+         */
+        uint32_t GetEvents() const {
+            uint32_t events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+            if (outboundSent < outbound.length()) {
+                events |= EPOLLOUT;
+            }
+            return events;
+        }
+    };
+
+    /**
+     * This holds everything shared between a reactor and the
+     * connections it services.
+     */
+    struct Reactor {
+        // Properties
+
+        /**
+         * This is the operating system handle of the epoll instance.
+         */
+        int epoll = -1;
+
+        /**
+         * This is the operating system handle of the event used to wake
+         * up the reactor threads when the reactor is being destroyed.
+         */
+        int wake = -1;
+
+        /**
+         * This is used to synchronize access to the sockets registered
+         * with the reactor.
+         */
+        std::mutex mutex;
+
+        /**
+         * These are the sockets registered with the reactor, keyed by
+         * their identifiers.
+         */
+        std::unordered_map< uint64_t, std::shared_ptr< Socket > > sockets;
+
+        /**
+         * This is the identifier to give the next socket registered.
+         */
+        uint64_t nextIdentifier = WAKE_IDENTIFIER + 1;
+
+        /**
+         * This counts the system calls made to service sockets.
+         */
+        std::atomic< uint64_t > systemCalls;
+
+        // Methods
+
+        /**
+         * This is the constructor for the structure.
+         */
+        Reactor()
+            : systemCalls(0)
+        {
+        }
+
+        /**
+         * This method starts waiting for events on the given socket.
+         * The socket's read and write mutexes must be held.
+         *
+         * @param[in] socket
+         *     This is the socket on which to wait for events.
+         *
+         * @return
+         *     An indication of whether or not the socket was registered
+         *     is returned.
+         */
+        bool Add(const std::shared_ptr< Socket >& socket) {
+            {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                socket->identifier = nextIdentifier++;
+                sockets[socket->identifier] = socket;
+            }
+            struct epoll_event event;
+            event.events = socket->GetEvents();
+            event.data.u64 = socket->identifier;
+            (void)systemCalls.fetch_add(1, std::memory_order_relaxed);
+            if (epoll_ctl(epoll, EPOLL_CTL_ADD, socket->handle, &event) != 0) {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                (void)sockets.erase(socket->identifier);
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * This method resumes waiting for events on the given socket.
+         * The socket's write mutex must be held.
+         *
+         * @param[in] socket
+         *     This is the socket on which to wait for events.
+         */
+        void Rearm(Socket& socket) {
+            struct epoll_event event;
+            event.events = socket.GetEvents();
+            event.data.u64 = socket.identifier;
+            (void)systemCalls.fetch_add(1, std::memory_order_relaxed);
+            (void)epoll_ctl(epoll, EPOLL_CTL_MOD, socket.handle, &event);
+        }
+
+        /**
+         * This method stops waiting for events on the given socket.
+         * The socket's read and write mutexes must be held.
+         *
+         * @param[in] socket
+         *     This is the socket on which to stop waiting for events.
+         */
+        void Remove(Socket& socket) {
+            (void)systemCalls.fetch_add(1, std::memory_order_relaxed);
+            (void)epoll_ctl(epoll, EPOLL_CTL_DEL, socket.handle, NULL);
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            (void)sockets.erase(socket.identifier);
+        }
+
+        /**
+         * This method is called when the given socket is found to be
+         * broken, to stop servicing it and let its user know.
+         *
+         * @param[in,out] socket
+         *     This is the socket found to be broken.
+         */
+        void Break(Socket& socket) {
+            Twitch::Connection::DisconnectedDelegate disconnectedDelegate;
+            {
+                std::lock_guard< decltype(socket.readMutex) > readLock(socket.readMutex);
+                std::lock_guard< decltype(socket.writeMutex) > writeLock(socket.writeMutex);
+                if (!socket.open) {
+                    return;
+                }
+                Remove(socket);
+                socket.open = false;
+                disconnectedDelegate = socket.disconnectedDelegate;
+            }
+            if (disconnectedDelegate != nullptr) {
+                disconnectedDelegate();
+            }
+        }
+
+        /**
+         * This method handles events which happened on the given socket.
+         *
+         * @param[in,out] socket
+         *     This is the socket on which the events happened.
+         *
+         * @param[in] events
+         *     These are the events which happened.
+         */
+        void Handle(Socket& socket, uint32_t events) {
+            bool broken = false;
+            if ((events & EPOLLOUT) != 0) {
+                std::lock_guard< decltype(socket.writeMutex) > lock(socket.writeMutex);
+                if (
+                    socket.open
+                    && !socket.Flush()
+                ) {
+                    broken = true;
+                }
+            }
+            if (
+                !broken
+                && ((events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0)
+            ) {
+                std::lock_guard< decltype(socket.readMutex) > lock(socket.readMutex);
+                if (!socket.open) {
+                    return;
+                }
+                (void)systemCalls.fetch_add(1, std::memory_order_relaxed);
+                socket.received.resize(RECEIVE_BUFFER_SIZE);
+                const auto amountReceived = recv(
+                    socket.handle,
+                    &socket.received[0],
+                    socket.received.size(),
+                    0
+                );
+                if (amountReceived > 0) {
+                    socket.received.resize((size_t)amountReceived);
+                    if (socket.dataReceivedDelegate != nullptr) {
+                        socket.dataReceivedDelegate(std::move(socket.received));
+                    } else if (socket.messageReceivedDelegate != nullptr) {
+                        socket.messageReceivedDelegate(socket.received);
+                    }
+                } else if (
+                    (amountReceived == 0)
+                    || (
+                        (errno != EINTR)
+                        && (errno != EAGAIN)
+                        && (errno != EWOULDBLOCK)
+                    )
+                ) {
+                    broken = true;
+                }
+                if (amountReceived <= 0) {
+                    socket.received.clear();
+                }
+            }
+            if (broken) {
+                Break(socket);
+            } else {
+                std::lock_guard< decltype(socket.writeMutex) > lock(socket.writeMutex);
+                if (socket.open) {
+                    Rearm(socket);
+                }
+            }
+        }
+
+        /**
+         * This method is the body of each reactor thread.
+         */
+        void Run() {
+            struct epoll_event events[MAX_EVENTS_PER_WAIT];
+            for (;;) {
+                (void)systemCalls.fetch_add(1, std::memory_order_relaxed);
+                const auto numEvents = epoll_wait(epoll, events, MAX_EVENTS_PER_WAIT, -1);
+                if (numEvents < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return;
+                }
+                for (int i = 0; i < numEvents; ++i) {
+                    if (events[i].data.u64 == WAKE_IDENTIFIER) {
+                        return;
+                    }
+                    std::shared_ptr< Socket > socket;
+                    {
+                        std::lock_guard< decltype(mutex) > lock(mutex);
+                        const auto entry = sockets.find(events[i].data.u64);
+                        if (entry != sockets.end()) {
+                            socket = entry->second;
+                        }
+                    }
+                    if (socket != nullptr) {
+                        Handle(*socket, events[i].events);
+                    }
+                }
+            }
+        }
+    };
+
+}
+
+namespace Twitch {
+
+    /**
+     * This contains the private properties of an EpollReactor instance.
+     */
+    struct EpollReactor::Impl {
+        /**
+         * This holds everything shared between the reactor and the
+         * connections it services.
+         */
+        std::shared_ptr< Reactor > reactor = std::make_shared< Reactor >();
+
+        /**
+         * These are the threads which handle network events.
+         */
+        std::vector< std::thread > threads;
+    };
+
+    EpollReactor::~EpollReactor() noexcept {
+        const uint64_t one = 1;
+        if (impl_->reactor->wake >= 0) {
+            (void)write(impl_->reactor->wake, &one, sizeof(one));
+        }
+        for (auto& thread: impl_->threads) {
+            thread.join();
+        }
+        if (impl_->reactor->wake >= 0) {
+            (void)close(impl_->reactor->wake);
+        }
+        if (impl_->reactor->epoll >= 0) {
+            (void)close(impl_->reactor->epoll);
+        }
+    }
+
+    EpollReactor::EpollReactor(size_t numThreads)
+        : impl_(new Impl)
+    {
+        auto& reactor = *impl_->reactor;
+        reactor.epoll = epoll_create1(EPOLL_CLOEXEC);
+        reactor.wake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (
+            (reactor.epoll < 0)
+            || (reactor.wake < 0)
+        ) {
+            return;
+        }
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = WAKE_IDENTIFIER;
+        (void)epoll_ctl(reactor.epoll, EPOLL_CTL_ADD, reactor.wake, &event);
+        for (size_t i = 0; i < std::max(numThreads, (size_t)1); ++i) {
+            impl_->threads.emplace_back(&Reactor::Run, impl_->reactor.get());
+        }
+    }
+
+    uint64_t EpollReactor::GetSystemCallCount() const {
+        return impl_->reactor->systemCalls.load(std::memory_order_relaxed);
+    }
+
+    std::shared_ptr< EpollReactor > EpollReactor::GetDefault() {
+        static std::mutex mutex;
+        static std::shared_ptr< EpollReactor > reactor;
+        std::lock_guard< decltype(mutex) > lock(mutex);
+        if (reactor == nullptr) {
+            reactor = std::make_shared< EpollReactor >();
+        }
+        return reactor;
+    }
+
+    /**
+     * This contains the private properties of an EpollConnection instance.
+     */
+    struct EpollConnection::Impl {
+        /**
+         * This is the host name or address of the Twitch chat server.
+         */
+        std::string host;
+
+        /**
+         * This is the port number of the Twitch chat server.
+         */
+        uint16_t port = 0;
+
+        /**
+         * This is the reactor servicing the connection.  It's held
+         * so that its threads keep running as long as the connection
+         * needs them.
+         */
+        std::shared_ptr< EpollReactor > reactorOwner;
+
+        /**
+         * This holds everything shared between the reactor and the
+         * connections it services.
+         */
+        std::shared_ptr< Reactor > reactor;
+
+        /**
+         * This holds everything the reactor knows about the socket of
+         * the connection.
+         */
+        std::shared_ptr< Socket > socket = std::make_shared< Socket >();
+    };
+
+    EpollConnection::~EpollConnection() noexcept {
+        Disconnect();
+    }
+
+    EpollConnection::EpollConnection(
+        const std::string& host,
+        uint16_t port,
+        std::shared_ptr< EpollReactor > reactor
+    )
+        : impl_(new Impl)
+    {
+        if (reactor == nullptr) {
+            reactor = EpollReactor::GetDefault();
+        }
+        impl_->host = host;
+        impl_->port = port;
+        impl_->reactorOwner = reactor;
+        impl_->reactor = reactor->impl_->reactor;
+        impl_->socket->systemCalls = &impl_->reactor->systemCalls;
+    }
+
+    void EpollConnection::SetMessageReceivedDelegate(MessageReceivedDelegate messageReceivedDelegate) {
+        std::lock_guard< decltype(impl_->socket->readMutex) > lock(impl_->socket->readMutex);
+        impl_->socket->messageReceivedDelegate = messageReceivedDelegate;
+    }
+
+    void EpollConnection::SetDataReceivedDelegate(DataReceivedDelegate dataReceivedDelegate) {
+        std::lock_guard< decltype(impl_->socket->readMutex) > lock(impl_->socket->readMutex);
+        impl_->socket->dataReceivedDelegate = dataReceivedDelegate;
+    }
+
+    void EpollConnection::SetDisconnectedDelegate(DisconnectedDelegate disconnectedDelegate) {
+        std::lock_guard< decltype(impl_->socket->readMutex) > lock(impl_->socket->readMutex);
+        impl_->socket->disconnectedDelegate = disconnectedDelegate;
+    }
+
+    bool EpollConnection::Connect() {
+        Disconnect();
+        const auto handle = ConnectTcpSocket(impl_->host, impl_->port);
+        if (handle < 0) {
+            return false;
+        }
+        auto& socket = *impl_->socket;
+        std::lock_guard< decltype(socket.readMutex) > readLock(socket.readMutex);
+        std::lock_guard< decltype(socket.writeMutex) > writeLock(socket.writeMutex);
+        socket.handle = handle;
+        socket.outbound.clear();
+        socket.outboundSent = 0;
+        if (!impl_->reactor->Add(impl_->socket)) {
+            (void)close(handle);
+            socket.handle = -1;
+            return false;
+        }
+        socket.open = true;
+        return true;
+    }
+
+    void EpollConnection::Disconnect() {
+        auto& socket = *impl_->socket;
+        std::lock_guard< decltype(socket.readMutex) > readLock(socket.readMutex);
+        std::lock_guard< decltype(socket.writeMutex) > writeLock(socket.writeMutex);
+        if (socket.handle < 0) {
+            return;
+        }
+        if (socket.open) {
+            (void)socket.Flush();
+            impl_->reactor->Remove(socket);
+            socket.open = false;
+        }
+        (void)close(socket.handle);
+        socket.handle = -1;
+    }
+
+    void EpollConnection::Send(const std::string& message) {
+        auto& socket = *impl_->socket;
+        std::lock_guard< decltype(socket.writeMutex) > lock(socket.writeMutex);
+        if (!socket.open) {
+            return;
+        }
+        const auto wasIdle = (socket.outboundSent == socket.outbound.length());
+        socket.outbound += message;
+        if (wasIdle) {
+            impl_->reactor->Rearm(socket);
+        }
+    }
+
+    void EpollConnection::Send(const Fragment* fragments, size_t numFragments) {
+        auto& socket = *impl_->socket;
+        std::lock_guard< decltype(socket.writeMutex) > lock(socket.writeMutex);
+        if (!socket.open) {
+            return;
+        }
+        const auto wasIdle = (socket.outboundSent == socket.outbound.length());
+        for (size_t i = 0; i < numFragments; ++i) {
+            socket.outbound.append(fragments[i].data, fragments[i].length);
+        }
+        if (wasIdle) {
+            impl_->reactor->Rearm(socket);
+        }
+    }
+
+
+    bool EpollConnection::IsSendPending() {
+        auto& socket = *impl_->socket;
+        std::lock_guard< decltype(socket.writeMutex) > lock(socket.writeMutex);
+        return (
+            socket.open
+            && (socket.outboundSent < socket.outbound.length())
+        );
+    }
+
+}
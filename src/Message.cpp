@@ -7,6 +7,7 @@
  */
 
 #include "Message.hpp"
+#include "TimelineZone.hpp"
 
 #include <inttypes.h>
 #include <stdio.h>
@@ -62,6 +63,7 @@ namespace {
      *     The tags parsed from the given raw tags string is returned.
      */
     Twitch::Messaging::TagsInfo ParseTags(const std::string& unparsedTags) {
+        TWITCH_TIMELINE_ZONE("ParseTags");
         Twitch::Messaging::TagsInfo parsedTags;
         const auto tags = StringExtensions::Split(unparsedTags, ';');
         for (const auto& tag: tags) {
@@ -136,9 +138,9 @@ namespace Twitch {
 
     bool Message::Parse(
         std::string& dataReceived,
-        Message& message,
-        SystemAbstractions::DiagnosticsSender& diagnosticsSender
+        Message& message
     ) {
+        TWITCH_TIMELINE_ZONE("Message::Parse");
         // This tracks the current state of the state machine used
         // in this function to parse the raw text of the message.
         enum class State {
@@ -158,16 +160,15 @@ namespace Twitch {
         if (lineEnd == std::string::npos) {
             return false;
         }
-        const auto line = dataReceived.substr(0, lineEnd);
-        diagnosticsSender.SendDiagnosticInformationString(0, "> " + line);
+        message = Message();
+        message.line.assign(dataReceived, 0, lineEnd);
+        const auto& line = message.line;
 
         // Remove the line from the buffer.
-        dataReceived = dataReceived.substr(lineEnd + CRLF.length());
+        dataReceived.erase(0, lineEnd + CRLF.length());
 
         // Unpack the message from the line.
         size_t offset = 0;
-        message = Message();
-        std::string unparsedTags;
         while (offset < line.length()) {
             switch (state) {
                 // First character of the line.  It could be ':',
@@ -186,10 +187,14 @@ namespace Twitch {
 
                 // Tags
                 case State::Tags: {
-                    if (line[offset] == ' ') {
-                        state = State::PrefixOrCommandFirstCharacter;
+                    const auto tagsEnd = line.find(' ', offset);
+                    if (tagsEnd == std::string::npos) {
+                        message.rawTags.assign(line, offset, std::string::npos);
+                        offset = line.length() - 1;
                     } else {
-                        unparsedTags += line[offset];
+                        message.rawTags.assign(line, offset, tagsEnd - offset);
+                        offset = tagsEnd;
+                        state = State::PrefixOrCommandFirstCharacter;
                     }
                 } break;
 
@@ -205,10 +210,14 @@ namespace Twitch {
 
                 // Prefix
                 case State::Prefix: {
-                    if (line[offset] == ' ') {
-                        state = State::CommandFirstCharacter;
+                    const auto prefixEnd = line.find(' ', offset);
+                    if (prefixEnd == std::string::npos) {
+                        message.prefix.assign(line, offset, std::string::npos);
+                        offset = line.length() - 1;
                     } else {
-                        message.prefix += line[offset];
+                        message.prefix.assign(line, offset, prefixEnd - offset);
+                        offset = prefixEnd;
+                        state = State::CommandFirstCharacter;
                     }
                 } break;
 
@@ -251,7 +260,8 @@ namespace Twitch {
 
                 // Last Parameter (may include spaces)
                 case State::Trailer: {
-                    message.parameters.back() += line[offset];
+                    message.parameters.back().assign(line, offset, std::string::npos);
+                    offset = line.length() - 1;
                 } break;
             }
             ++offset;
@@ -265,8 +275,11 @@ namespace Twitch {
         ) {
             message.command.clear();
         }
-        message.tags = ParseTags(unparsedTags);
         return true;
     }
 
+    void Message::DecodeTags() {
+        tags = ParseTags(rawTags);
+    }
+
 }
@@ -10,7 +10,6 @@
  */
 
 #include <string>
-#include <SystemAbstractions/DiagnosticsSender.hpp>
 #include <Twitch/Messaging.hpp>
 #include <vector>
 
@@ -23,11 +22,24 @@ namespace Twitch {
     struct Message {
         // Properties
 
+        /**
+         * This is the raw line of text from which the message was parsed,
+         * without the line terminator.
+         */
+        std::string line;
+
         /**
          * This contains information provided in the message's tags.
+         * It is only filled in once DecodeTags is called.
          */
         Messaging::TagsInfo tags;
 
+        /**
+         * This is the raw string containing the message's tags, without
+         * the leading at-sign (@) character.
+         */
+        std::string rawTags;
+
         /**
          * If this is not an empty string, the message included a prefix,
          * which is stored here, without the leading colon (:) character.
@@ -51,7 +63,8 @@ namespace Twitch {
 
         /**
          * This method extracts the next message received from the
-         * Twitch server.
+         * Twitch server.  The message's tags are not decoded until
+         * DecodeTags is called.
          *
          * @param[in,out] dataReceived
          *     This is essentially just a buffer to receive raw characters
@@ -62,20 +75,23 @@ namespace Twitch {
          *     This is where to store the next message received from the
          *     Twitch server.
          *
-         * @param[in] diagnosticsSender
-         *     This is used to publish any diagnostic messages generated
-         *     by this function.
-         *
          * @return
          *     An indication of whether or not a complete line was
          *     extracted is returned.
          */
         static bool Parse(
             std::string& dataReceived,
-            Message& message,
-            SystemAbstractions::DiagnosticsSender& diagnosticsSender
+            Message& message
         );
 
+        /**
+         * This method parses the message's raw tags, and stores the
+         * information they provide in the message's tags.  It's done
+         * separately from parsing the rest of the message so that it can
+         * be skipped for messages which will be dropped.
+         */
+        void DecodeTags();
+
     };
 
 }
@@ -8,11 +8,18 @@
  */
 
 #include "Message.hpp"
+#include "Metrics.hpp"
+#include "OutboundLine.hpp"
+#include "RateLimiter.hpp"
+#include "TimelineZone.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <deque>
+#include <fstream>
+#include <functional>
 #include <inttypes.h>
 #include <list>
 #include <map>
@@ -23,8 +30,10 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string>
+#include <string.h>
 #include <StringExtensions/StringExtensions.hpp>
 #include <thread>
+#include <Twitch/ConnectionAdapter.hpp>
 #include <Twitch/Messaging.hpp>
 #include <vector>
 
@@ -43,12 +52,88 @@ namespace {
      */
     constexpr double LOG_IN_TIMEOUT_SECONDS = 5.0;
 
+    /**
+     * This is the number of bytes of lines waiting to be sent to the
+     * Twitch server at which they're sent right away, rather than at the
+     * end of the current iteration of the worker thread.
+     */
+    constexpr size_t OUTBOUND_BATCH_FLUSH_THRESHOLD = 8192;
+
+    /**
+     * This is the number of messages for which room is set aside in the
+     * batch of messages waiting to be delivered to the user, so that
+     * batching them doesn't allocate memory for each batch.
+     */
+    constexpr size_t MESSAGE_BATCH_RESERVE = 64;
+
+    /**
+     * This is the level at which summaries of measured latencies
+     * are published as diagnostic messages.
+     */
+    constexpr size_t LATENCY_SUMMARY_DIAGNOSTIC_LEVEL = 1;
+
+    /**
+     * This function formats the median and 99th percentile of the given
+     * histogram of durations in nanoseconds, in milliseconds.
+     *
+     * @param[in] histogram
+     *     This is the histogram to summarize.
+     *
+     * @return
+     *     The median and 99th percentile of the given histogram,
+     *     in milliseconds, are returned.
+     */
+    std::string FormatPercentiles(const Twitch::Messaging::HistogramSnapshot& histogram) {
+        return StringExtensions::sprintf(
+            "p50=%.3fms p99=%.3fms",
+            (double)histogram.GetPercentile(50.0) / 1e6,
+            (double)histogram.GetPercentile(99.0) / 1e6
+        );
+    }
+
     /**
      * This regular expression should only match the nickname of an anonymous
      * Twitch user.
      */
     static const std::regex ANONYMOUS_NICKNAME_PATTERN("justinfan([0-9]+)");
 
+#ifdef TWITCH_ENABLE_TRACING
+    /**
+     * This function returns the name to give, on the timeline, to the
+     * zone in which the user is called to deliver the given kind of event.
+     *
+     * @param[in] type
+     *     This is the kind of event delivered.
+     *
+     * @return
+     *     The name to give the zone on the timeline is returned.
+     */
+    const char* GetUserCallbackZoneName(Twitch::Messaging::EventMask type) {
+        using Events = Twitch::Messaging::Events;
+        switch (type) {
+            case Events::Doom: return "User::Doom";
+            case Events::Join: return "User::Join";
+            case Events::Leave: return "User::Leave";
+            case Events::NameList: return "User::NameList";
+            case Events::Message: return "User::Message";
+            case Events::PrivateMessage: return "User::PrivateMessage";
+            case Events::Whisper: return "User::Whisper";
+            case Events::Notice: return "User::Notice";
+            case Events::Host: return "User::Host";
+            case Events::RoomModeChange: return "User::RoomModeChange";
+            case Events::Clear: return "User::Clear";
+            case Events::Mod: return "User::Mod";
+            case Events::UserState: return "User::UserState";
+            case Events::Sub: return "User::Sub";
+            case Events::Raid: return "User::Raid";
+            case Events::Ritual: return "User::Ritual";
+            case Events::LogIn: return "User::LogIn";
+            case Events::LogOut: return "User::LogOut";
+            default: return "User";
+        }
+    }
+#endif /* TWITCH_ENABLE_TRACING */
+
     /**
      * This is used to convey an action for the Messaging class worker
      * to either perform or await, including any necessary context.
@@ -72,6 +157,12 @@ namespace {
              */
             RequestCaps,
 
+            /**
+             * Request the IRCv3 capabilities negotiated with the server the
+             * last time, without first asking the server to list them.
+             */
+            RequestCachedCaps,
+
             /**
              * Wait for the message of the day (MOTD) from the server.
              */
@@ -111,6 +202,38 @@ namespace {
              * Send a whisper to a channel.
              */
             SendWhisper,
+
+            /**
+             * Select the kinds of events in which the user is interested.
+             */
+            SetEventInterests,
+
+            /**
+             * Set how many chat messages received in a channel are passed
+             * along.
+             */
+            SetChannelSampling,
+
+            /**
+             * Remove any sampling set for a channel.
+             */
+            ClearChannelSampling,
+
+            /**
+             * Set the recorder of traffic with the Twitch server.
+             */
+            SetTrafficRecorder,
+
+            /**
+             * Set how often to publish a summary of measured latencies.
+             */
+            SetLatencySummaryInterval,
+
+            /**
+             * Set up the queue in which messages, whispers, and channel
+             * joins are held while they can't be sent.
+             */
+            ConfigureOutboundQueue,
         };
 
         // Properties
@@ -156,8 +279,384 @@ namespace {
          * the action will be considered timed out.
          */
         double expiration = 0.0;
+
+        /**
+         * This is used with the ProcessMessagesReceived action, while
+         * metrics are enabled, to remember when the lines were received.
+         */
+        std::chrono::steady_clock::time_point receivedTime;
+
+        /**
+         * This is used with the SetLatencySummaryInterval action to provide
+         * how often, in seconds, to publish a summary of measured latencies.
+         */
+        double interval = 0.0;
+
+        /**
+         * This is used with the ProcessMessagesReceived action to remember
+         * how many priorities of lines have already been dropped from the
+         * message, so that they don't need to be looked for again.
+         */
+        int prioritiesShed = 0;
+
+        /**
+         * This is used with the SetChannelSampling action to provide
+         * how many chat messages to pass along.
+         */
+        Twitch::Messaging::ChannelSampling sampling;
+
+        /**
+         * This is used with the SetEventInterests action to select
+         * the kinds of events in which the user is interested.
+         */
+        Twitch::Messaging::EventMask events = 0;
+
+        /**
+         * This is used with the SetTrafficRecorder action to provide
+         * the recorder of traffic with the Twitch server.
+         */
+        std::shared_ptr< Twitch::TrafficRecorder > trafficRecorder;
+
+        /**
+         * This is used with the Join, SendMessage, and SendWhisper actions,
+         * to provide the most number of seconds the action may be held in
+         * the outbound queue, or zero to use the configured expiration.
+         */
+        double maxHoldTime = 0.0;
+
+        /**
+         * This is used with the SendMessage and SendWhisper actions,
+         * if not null, to report how the message turned out.
+         */
+        Twitch::Messaging::DeliveryDelegate deliveryDelegate;
+
+        /**
+         * This is used with the ConfigureOutboundQueue action to provide
+         * the settings of the outbound queue.
+         */
+        Twitch::Messaging::OutboundQueueConfiguration outboundQueueConfiguration;
+
+        /**
+         * This is used with the LogOut action to provide the most number
+         * of seconds to spend logging out gracefully, or zero to log out
+         * right away.
+         */
+        double deadline = 0.0;
+
+        /**
+         * This is used with the ProcessMessagesReceived action to hold
+         * the lines received while they're still in the buffer the
+         * connection received them into.  Once copied out of the buffer,
+         * they're held in the message instead.
+         */
+        Twitch::ConnectionV2::ReceivedBuffer received;
+    };
+
+    /**
+     * These are the stages of logging out gracefully.
+     */
+    enum class LogOutStage {
+        /**
+         * The user agent isn't logging out gracefully.
+         */
+        None,
+
+        /**
+         * Anything held in the outbound queue is being sent before
+         * the farewell.
+         */
+        Draining,
+
+        /**
+         * The farewell was sent, and the connection will be closed
+         * once everything has been written to it.
+         */
+        Closing,
+    };
+
+    /**
+     * These are the ways the modes of a channel can bear on sending
+     * a message to it.
+     */
+    enum class ChannelSendCheck {
+        /**
+         * The message may be sent now.
+         */
+        Ready,
+
+        /**
+         * The message must wait before it may be sent, because the
+         * channel is in slow mode.
+         */
+        Wait,
+
+        /**
+         * The message would be dropped by the Twitch server,
+         * and so must not be sent.
+         */
+        Reject,
+    };
+
+    /**
+     * This holds what is tracked about the messages sent to a channel
+     * in order to schedule more of them.
+     */
+    struct ChannelSendHistory {
+        /**
+         * This is the time, according to the time keeper, at which the
+         * last message was sent to the channel.
+         */
+        double lastSendTime = 0.0;
+
+        /**
+         * This is the last message sent to the channel.
+         */
+        std::string lastMessage;
+    };
+
+    /**
+     * This holds what is tracked about the chat messages received in a
+     * channel in order to sample them.
+     */
+    struct ChannelSamplingState {
+        /**
+         * This counts the chat messages received in the channel, in order
+         * to keep one out of every so many.
+         */
+        size_t messagesReceived = 0;
+
+        /**
+         * This is the number of chat messages which may still be kept
+         * without exceeding the maximum rate at which to keep them.
+         */
+        double allowance = 0.0;
+
+        /**
+         * This is the time, according to the time keeper, at which the
+         * allowance was last updated, or a negative number if it never was.
+         */
+        double lastAllowanceUpdate = -1.0;
+    };
+
+    /**
+     * These are the priorities of lines received from the Twitch server,
+     * used to decide which lines to drop first when lines are arriving
+     * faster than they can be handled.
+     */
+    enum class LinePriority {
+        /**
+         * Membership lines (JOIN, PART, and name lists).
+         */
+        Low,
+
+        /**
+         * Chat messages (PRIVMSG).
+         */
+        Message,
+
+        /**
+         * Everything else, which is never dropped.  When the backlog
+         * can't hold these lines, the connection is held up instead.
+         */
+        Essential,
     };
 
+    /**
+     * This function determines the priority of the given raw line received
+     * from the Twitch server, by looking only at its command and first
+     * parameter, without parsing the rest of the line.
+     *
+     * @param[in] lines
+     *     This is the buffer containing the line.
+     *
+     * @param[in] begin
+     *     This is the offset of the first character of the line.
+     *
+     * @param[in] end
+     *     This is the offset just past the last character of the line,
+     *     not including the line terminator.
+     *
+     * @param[out] channel
+     *     If the line is a chat message, this is where to store the name of
+     *     the channel to which it was sent.
+     *
+     * @return
+     *     The priority of the line is returned.
+     */
+    LinePriority ClassifyLine(
+        const std::string& lines,
+        size_t begin,
+        size_t end,
+        std::string& channel
+    ) {
+        const auto skipToken = [&lines, end](size_t offset) {
+            while ((offset < end) && (lines[offset] != ' ')) {
+                ++offset;
+            }
+            while ((offset < end) && (lines[offset] == ' ')) {
+                ++offset;
+            }
+            return offset;
+        };
+        auto offset = begin;
+        if ((offset < end) && (lines[offset] == '@')) {
+            offset = skipToken(offset);
+        }
+        if ((offset < end) && (lines[offset] == ':')) {
+            offset = skipToken(offset);
+        }
+        const auto commandEnd = lines.find(' ', offset);
+        const auto command = lines.substr(offset, std::min(commandEnd, end) - offset);
+        if (
+            (command == "JOIN")
+            || (command == "PART")
+            || (command == "353")
+            || (command == "366")
+        ) {
+            return LinePriority::Low;
+        } else if (command == "PRIVMSG") {
+            offset = skipToken(offset);
+            if ((offset < end) && (lines[offset] == '#')) {
+                ++offset;
+            }
+            const auto channelEnd = std::min(lines.find(' ', offset), end);
+            channel = lines.substr(offset, channelEnd - offset);
+            return LinePriority::Message;
+        } else {
+            return LinePriority::Essential;
+        }
+    }
+
+    /**
+     * This function determines whether or not the given badges include
+     * a badge of the given kind, of any version.
+     *
+     * @param[in] badges
+     *     These are the badges to check, each in the form "kind/version".
+     *
+     * @param[in] kind
+     *     This is the kind of badge to look for.
+     *
+     * @return
+     *     An indication of whether or not the badges include a badge
+     *     of the given kind is returned.
+     */
+    bool HasBadge(
+        const std::set< std::string >& badges,
+        const std::string& kind
+    ) {
+        const auto prefix = kind + "/";
+        const auto badge = badges.lower_bound(prefix);
+        return (
+            (badge != badges.end())
+            && (badge->compare(0, prefix.length(), prefix) == 0)
+        );
+    }
+
+    /**
+     * This function removes from the given buffer of complete raw lines
+     * received from the Twitch server any lines selected by the given
+     * function.
+     *
+     * @param[in,out] lines
+     *     This is the buffer of complete raw lines.
+     *
+     * @param[in] shouldRemove
+     *     This is the function to call for each line, with the priority
+     *     of the line and the channel of any chat message, to determine
+     *     whether or not to remove the line.
+     *
+     * @return
+     *     The number of lines removed is returned.
+     */
+    size_t RemoveLines(
+        std::string& lines,
+        const std::function< bool(LinePriority priority, const std::string& channel) >& shouldRemove
+    ) {
+        std::string keptLines;
+        size_t linesRemoved = 0;
+        size_t begin = 0;
+        std::string channel;
+        while (begin < lines.length()) {
+            auto end = lines.find(CRLF, begin);
+            if (end == std::string::npos) {
+                end = lines.length();
+            }
+            const auto next = std::min(end + CRLF.length(), lines.length());
+            channel.clear();
+            const auto priority = ClassifyLine(lines, begin, end, channel);
+            if (shouldRemove(priority, channel)) {
+                ++linesRemoved;
+            } else {
+                keptLines.append(lines, begin, next - begin);
+            }
+            begin = next;
+        }
+        if (linesRemoved > 0) {
+            lines = std::move(keptLines);
+        }
+        return linesRemoved;
+    }
+
+    /**
+     * This function finds the last line terminator in the given data.
+     *
+     * @param[in] data
+     *     This points to the first byte of the data.
+     *
+     * @param[in] length
+     *     This is the number of bytes of data.
+     *
+     * @return
+     *     The offset of the last line terminator in the data is returned.
+     *
+     * @retval std::string::npos
+     *     This is returned if there is no line terminator in the data.
+     */
+    size_t FindLastLineEnd(const char* data, size_t length) {
+        for (size_t end = length; end >= CRLF.length(); --end) {
+            if (
+                (data[end - 2] == '\r')
+                && (data[end - 1] == '\n')
+            ) {
+                return end - 2;
+            }
+        }
+        return std::string::npos;
+    }
+
+    /**
+     * This function returns the number of bytes of lines held by the given
+     * ProcessMessagesReceived action, whether they're still in the buffer
+     * the connection received them into or already in its message.
+     *
+     * @param[in] action
+     *     This is the action holding the lines.
+     *
+     * @return
+     *     The number of bytes of lines held by the action is returned.
+     */
+    size_t GetReceivedLength(const Action& action) {
+        return action.received.GetLength() + action.message.length();
+    }
+
+    /**
+     * This function copies the lines held by the given
+     * ProcessMessagesReceived action out of the buffer the connection
+     * received them into, if they're still there, into the message of
+     * the action, and gives the buffer back, so that the lines may be
+     * changed.
+     *
+     * @param[in,out] action
+     *     This is the action holding the lines.
+     */
+    void TakeReceivedLines(Action& action) {
+        if (action.received.GetLength() > 0) {
+            action.message.assign(action.received.GetData(), action.received.GetLength());
+        }
+        action.received.Release();
+    }
+
     /**
      * This function replaces all escape sequences in the given string with
      * their replacements.
@@ -250,6 +749,93 @@ namespace Twitch {
          */
         typedef void(Impl::*ServerCommandHandler)(Message&& message);
 
+        /**
+         * This holds everything needed to deliver events to an observer.
+         */
+        struct Observer {
+            /**
+             * This is the function to call to deliver events to the
+             * observer.
+             */
+            ObserverDelegate delegate;
+
+            /**
+             * This selects which events the observer receives, and how
+             * they are delivered to it.
+             */
+            ObserverConfiguration configuration;
+
+            /**
+             * If the observer has its own thread, this is it.
+             */
+            std::thread thread;
+
+            /**
+             * This is used to synchronize access to the observer's queue.
+             */
+            std::mutex mutex;
+
+            /**
+             * This is used to wake up the observer's thread when an event is
+             * queued for it, or a thread waiting for room in its queue.
+             */
+            std::condition_variable wakeCondition;
+
+            /**
+             * These are the events queued for the observer's thread.
+             */
+            std::deque< std::shared_ptr< const Event > > events;
+
+            /**
+             * This flag indicates whether or not the observer has been
+             * removed, and its thread should stop.
+             */
+            bool stop = false;
+        };
+
+        /**
+         * This is the type of list holding the observers added.
+         */
+        typedef std::vector< std::shared_ptr< Observer > > Observers;
+
+        /**
+         * This holds the observers added.  It's kept separately from the
+         * rest of the object so that functions returned to remove observers
+         * may safely outlive the object.
+         */
+        struct ObserverSet {
+            /**
+             * This is used to synchronize access to the observers.
+             */
+            std::mutex mutex;
+
+            /**
+             * These are the observers added, or null if there are none.
+             * The list is replaced, rather than modified, whenever an
+             * observer is added or removed, so that events can be delivered
+             * using the list without holding the mutex.
+             */
+            std::shared_ptr< const Observers > observers;
+        };
+
+        /**
+         * This holds what is needed to decide whether or not to handle
+         * a server command, and how.
+         */
+        struct ServerCommandHandlerInfo {
+            /**
+             * This is the method to call to handle the server command.
+             */
+            ServerCommandHandler handler;
+
+            /**
+             * These are the kinds of events which may result from handling
+             * the server command, or zero if the server command must always
+             * be handled.
+             */
+            EventMask events;
+        };
+
         /**
          * This is the type of member function pointer used to map
          * action types to their message processors.
@@ -279,14 +865,105 @@ namespace Twitch {
         // Properties
 
         /**
-         * This is used to synchronize access to the object.
+         * This indicates whether or not metrics are collected.
          */
-        std::mutex mutex;
+        std::atomic< bool > metricsEnabled;
 
-        // --------------------------------------------------------------------
-        // All properties in this section are protected by the mutex.
-        // ⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇
-        // --------------------------------------------------------------------
+        /**
+         * This is the number of bytes received from the Twitch server
+         * while metrics were enabled.
+         */
+        std::atomic< uint64_t > bytesReceived;
+
+        /**
+         * This is the number of bytes sent to the Twitch server
+         * while metrics were enabled.
+         */
+        std::atomic< uint64_t > bytesSent;
+
+        /**
+         * This is the number of lines received from the Twitch server
+         * while metrics were enabled.
+         */
+        std::atomic< uint64_t > linesReceived;
+
+        /**
+         * This is the number of lines sent to the Twitch server
+         * while metrics were enabled.
+         */
+        std::atomic< uint64_t > linesSent;
+
+        /**
+         * This is the number of times lines were handed to the connection
+         * to be sent to the Twitch server while metrics were enabled.
+         */
+        std::atomic< uint64_t > sends;
+
+        /**
+         * This is the number of actions which timed out while metrics
+         * were enabled.
+         */
+        std::atomic< uint64_t > timeoutsFired;
+
+        /**
+         * This is the largest number of actions which have been waiting
+         * to be performed at one time while metrics were enabled.
+         */
+        std::atomic< size_t > peakActionsQueued;
+
+        /**
+         * This is the number of actions awaiting responses from the
+         * Twitch server, as of the last time the worker thread checked
+         * while metrics were enabled.
+         */
+        std::atomic< size_t > actionsAwaiting;
+
+        /**
+         * This is a histogram of how long it took to parse lines received
+         * from the Twitch server, in nanoseconds.
+         */
+        Histogram parseTime;
+
+        /**
+         * This is a histogram of how long lines received from the Twitch
+         * server waited before being parsed, in nanoseconds.
+         */
+        Histogram queueWaitTime;
+
+        /**
+         * This is a histogram of how long it took to handle lines received
+         * from the Twitch server, for all commands, in nanoseconds.
+         */
+        Histogram handlerTime;
+
+        /**
+         * This is a histogram of how long it took, from when lines were
+         * received from the Twitch server, until the resulting events
+         * began to be delivered, in nanoseconds.
+         */
+        Histogram endToEndTime;
+
+        /**
+         * This is a histogram of how long before they were received the
+         * Twitch server sent lines having timestamps, in nanoseconds.
+         */
+        Histogram serverLag;
+
+        /**
+         * This holds what is measured about each kind of command received
+         * from the Twitch server.
+         */
+        CommandCounters commandCounters;
+
+        /**
+         * This is used to synchronize access to the object.
+         */
+        std::mutex mutex;
+
+        // --------------------------------------------------------------------
+        // All properties in this section are protected by the mutex.
+        // ⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇⬇
+        // --------------------------------------------------------------------
 
         /**
          * This is a helper object used to generate and publish
@@ -294,6 +971,52 @@ namespace Twitch {
          */
         SystemAbstractions::DiagnosticsSender diagnosticsSender;
 
+        /**
+         * This is used to synchronize access to the queue of traced lines
+         * waiting to be delivered to diagnostic subscribers.
+         */
+        std::mutex traceMutex;
+
+        /**
+         * This is used to wake up the tracer thread when traced lines are
+         * queued, or it should stop.
+         */
+        std::condition_variable traceWakeCondition;
+
+        /**
+         * This is the storage of the ring buffer of traced lines waiting to
+         * be delivered to diagnostic subscribers.  It's empty unless
+         * asynchronous line tracing is enabled.
+         */
+        std::vector< std::string > traceQueue;
+
+        /**
+         * This is the index in the trace queue of the oldest traced line.
+         */
+        size_t traceQueueHead = 0;
+
+        /**
+         * This is the number of traced lines in the trace queue.
+         */
+        size_t traceQueueCount = 0;
+
+        /**
+         * This is the number of traced lines dropped because the trace queue
+         * was full, not yet reported.
+         */
+        size_t tracesDropped = 0;
+
+        /**
+         * This flag indicates whether or not the tracer thread should stop.
+         */
+        bool stopTracer = false;
+
+        /**
+         * This is the thread which delivers traced lines to diagnostic
+         * subscribers, while asynchronous line tracing is enabled.
+         */
+        std::thread tracer;
+
         /**
          * This is the function to call in order to make a new
          * connection to the Twitch server.
@@ -311,6 +1034,17 @@ namespace Twitch {
          */
         std::shared_ptr< User > user = std::make_shared< User >();
 
+        /**
+         * This flag indicates whether or not the user provided an object
+         * to receive notifications, events, and other callbacks.
+         */
+        bool userSet = false;
+
+        /**
+         * This holds the observers added.
+         */
+        std::shared_ptr< ObserverSet > observerSet = std::make_shared< ObserverSet >();
+
         /**
          * This is used to signal the worker thread to wake up.
          */
@@ -332,6 +1066,88 @@ namespace Twitch {
          */
         std::thread worker;
 
+        /**
+         * This flag indicates whether or not the IRCv3 capabilities
+         * negotiated with the server are remembered and requested directly
+         * on later connections.
+         */
+        bool capsCacheEnabled = false;
+
+        /**
+         * If not empty, this is the path to the file in which the IRCv3
+         * capabilities negotiated with the server are persisted.
+         */
+        std::string capsCacheFilePath;
+
+        /**
+         * These are the IRCv3 capabilities the server acknowledged the last
+         * time they were requested.
+         */
+        std::set< std::string > capsCached;
+
+        /**
+         * This holds information about the most recently completed log-in
+         * handshake with the server.
+         */
+        HandshakeInfo lastHandshake;
+
+        /**
+         * This holds any characters received from the Twitch server after
+         * the last complete line, until the rest of the line arrives.
+         */
+        std::string inboundPartialLine;
+
+        /**
+         * This is set when a line received from the Twitch server grows
+         * longer than the limit on the inbound backlog before it's
+         * complete, so that the rest of it is discarded as it arrives.
+         */
+        bool inboundLineDiscarded = false;
+
+        /**
+         * This holds the limit on the backlog of lines received from the
+         * Twitch server but not yet handled, and what to do when it's reached.
+         */
+        InboundBacklogConfiguration inboundBacklogConfiguration;
+
+        /**
+         * This holds statistics about the backlog of lines received from the
+         * Twitch server but not yet handled.
+         */
+        InboundBacklogStatistics inboundBacklogStatistics;
+
+        /**
+         * This is used with the SampleMessages inbound overload policy to
+         * count the chat messages received in each channel while the
+         * backlog is at its limit.
+         */
+        std::map< std::string, size_t > inboundMessageSampleCounters;
+
+        /**
+         * This is used to wake up a connection held up because the backlog
+         * of lines received from the Twitch server is at its limit.
+         */
+        std::condition_variable inboundBacklogSpaceAvailable;
+
+        /**
+         * This is set once the worker starts closing the connection, so
+         * that the connection isn't held up waiting for room in the
+         * backlog while the worker waits for the connection to close.
+         */
+        bool inboundBacklogUnblocked = false;
+
+        /**
+         * This holds statistics about the queue in which messages,
+         * whispers, and channel joins are held while they can't be sent.
+         */
+        OutboundQueueStatistics outboundQueueStatistics;
+
+        /**
+         * This holds what is known about each channel which bears on
+         * sending messages to it.
+         */
+        std::map< std::string, ChannelState > channelStates;
+
         // --------------------------------------------------------------------
         // ⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆
         // All properties in this section are protected by the mutex.
@@ -345,9 +1161,18 @@ namespace Twitch {
 
         /**
          * This is the interface to the current connection to the Twitch
-         * server, if we are connected.
+         * server, if we are connected.  Connections which don't implement
+         * the ConnectionV2 interface are used through an adapter.
+         */
+        std::shared_ptr< ConnectionV2 > connection;
+
+        /**
+         * This holds lines produced by the worker thread which haven't
+         * yet been handed to the connection, so that all the lines
+         * produced during one iteration of the worker thread can be
+         * sent together.
          */
-        std::shared_ptr< Connection > connection;
+        std::string outboundBatch;
 
         /**
          * This is essentially just a buffer to receive raw characters from the
@@ -356,6 +1181,56 @@ namespace Twitch {
          */
         std::string dataReceived;
 
+        /**
+         * This holds how many chat messages are passed along, for channels
+         * whose chat messages are sampled.  The entry for the empty channel
+         * name, if any, applies to every channel without an entry of its own.
+         */
+        std::map< std::string, ChannelSampling > channelSampling;
+
+        /**
+         * These are the kinds of events in which the user is interested.
+         */
+        EventMask eventInterests = Events::All;
+
+        /**
+         * If set, this records the lines sent to and received from
+         * the Twitch server.
+         */
+        std::shared_ptr< TrafficRecorder > trafficRecorder;
+
+        /**
+         * This is how often, in seconds, to publish a summary of measured
+         * latencies, or zero if summaries aren't published.
+         */
+        double latencySummaryInterval = 0.0;
+
+        /**
+         * This is the time, according to the time keeper, at which to
+         * publish the next summary of measured latencies.
+         */
+        double nextLatencySummaryTime = 0.0;
+
+        /**
+         * While metrics are enabled, this is when the lines currently
+         * being handled were received from the Twitch server.
+         */
+        std::chrono::steady_clock::time_point linesReceivedTime;
+
+        /**
+         * This holds messages sent to channels which have been received
+         * but not yet delivered to the user, so that they can be delivered
+         * together.  Its storage is kept from one batch to the next,
+         * unless the user takes it.
+         */
+        std::vector< MessageInfo > messageBatch;
+
+        /**
+         * This holds what is tracked about the chat messages received in
+         * each channel whose chat messages are sampled.
+         */
+        std::map< std::string, ChannelSamplingState > channelSamplingStates;
+
         /**
          * If true, this flag indicates that the user is not going to be
          * offering an OAuth token to authenticate as a registered user/bot,
@@ -381,6 +1256,59 @@ namespace Twitch {
          */
         std::set< std::string > capsSupported;
 
+        /**
+         * This is the time, according to the time keeper, at which the
+         * connection for the current log-in handshake was established.
+         */
+        double handshakeStartTime = 0.0;
+
+        /**
+         * This flag indicates whether or not the current log-in handshake
+         * requested cached capabilities rather than listing them first.
+         */
+        bool handshakeUsedCachedCaps = false;
+
+        /**
+         * This holds the settings of the queue in which messages,
+         * whispers, and channel joins are held while they can't be sent.
+         */
+        OutboundQueueConfiguration outboundQueueConfiguration;
+
+        /**
+         * These are the Join, SendMessage, and SendWhisper actions held
+         * while they can't be performed, oldest first.
+         */
+        std::deque< Action > outboundQueue;
+
+        /**
+         * This keeps the rate at which messages and whispers are sent
+         * under the limit configured for the outbound queue.
+         */
+        RateLimiter sendRateLimiter;
+
+        /**
+         * This holds what is tracked about the messages sent to each
+         * channel, in order to schedule more of them.
+         */
+        std::map< std::string, ChannelSendHistory > channelSendHistories;
+
+        /**
+         * This indicates how far along a graceful log-out is.
+         */
+        LogOutStage logOutStage = LogOutStage::None;
+
+        /**
+         * This is the time, according to the time keeper, by which
+         * a graceful log-out must be done.
+         */
+        double logOutDeadline = 0.0;
+
+        /**
+         * This is the message to send in the QUIT command at the end
+         * of a graceful log-out.
+         */
+        std::string logOutFarewell;
+
         // --------------------------------------------------------------------
         // ⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆⬆
         // All properties in this section should only be used by the worker
@@ -393,8 +1321,153 @@ namespace Twitch {
          * This is the constructor for the structure.
          */
         Impl()
-            : diagnosticsSender("TMI")
+            : metricsEnabled(false)
+            , bytesReceived(0)
+            , bytesSent(0)
+            , linesReceived(0)
+            , linesSent(0)
+            , sends(0)
+            , timeoutsFired(0)
+            , peakActionsQueued(0)
+            , actionsAwaiting(0)
+            , diagnosticsSender("TMI")
         {
+            messageBatch.reserve(MESSAGE_BATCH_RESERVE);
+        }
+
+        /**
+         * This method returns the number of nanoseconds elapsed
+         * since the given time.
+         *
+         * @param[in] start
+         *     This is the time from which to measure.
+         *
+         * @return
+         *     The number of nanoseconds elapsed since the given time
+         *     is returned.
+         */
+        static uint64_t NanosecondsSince(std::chrono::steady_clock::time_point start) {
+            return (uint64_t)std::chrono::duration_cast< std::chrono::nanoseconds >(
+                std::chrono::steady_clock::now() - start
+            ).count();
+        }
+
+        /**
+         * This method counts a line sent to the Twitch server,
+         * if metrics are enabled.
+         *
+         * @param[in] length
+         *     This is the length of the line, including the line terminator.
+         */
+        void CountLineSent(size_t length) {
+            if (!metricsEnabled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            (void)bytesSent.fetch_add(length, std::memory_order_relaxed);
+            (void)linesSent.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * This method updates the largest number of actions which have
+         * been waiting to be performed at one time, if metrics are enabled.
+         * The mutex must be held when calling this method.
+         */
+        void CountActionsQueued() {
+            if (!metricsEnabled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            if (actionsToBePerformed.size() > peakActionsQueued.load(std::memory_order_relaxed)) {
+                peakActionsQueued.store(actionsToBePerformed.size(), std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * This method is called to count handing lines to the connection
+         * to be sent, if metrics are enabled.
+         */
+        void CountSend() {
+            if (!metricsEnabled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            (void)sends.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * This method hands any lines waiting to be sent to the
+         * given connection.
+         *
+         * @param[in,out] connection
+         *     This is the connection to use to send the lines.
+         */
+        void FlushOutboundBatch(ConnectionV2& connection) {
+            if (outboundBatch.empty()) {
+                return;
+            }
+            CountSend();
+            const ConnectionV2::Fragment fragment(outboundBatch);
+            connection.Send(&fragment, 1);
+            outboundBatch.clear();
+        }
+
+        /**
+         * This method is called to send a line of text to the Twitch
+         * server, which has been written onto the end of the batch of
+         * lines waiting to be sent.  This method ends the line with the
+         * line terminator (CRLF), unless the line is empty or too long,
+         * in which case it's dropped.
+         *
+         * The line is held, along with any other lines produced during
+         * the current iteration of the worker thread, and they're all sent
+         * together at the end of the iteration, unless too many are held.
+         *
+         * @param[in,out] connection
+         *     This is the connection to use to send the message.
+         *
+         * @param[in,out] line
+         *     This is the line to send to the Twitch server.
+         *
+         * @param[in] flush
+         *     This indicates whether or not to send the line, along with
+         *     any other lines being held, right away.
+         *
+         * @return
+         *     An indication of whether or not the line was sent
+         *     is returned.
+         */
+        bool SendLineToTwitchServer(
+            ConnectionV2& connection,
+            OutboundLine& line,
+            bool flush = false
+        ) {
+            if (!line.Finish()) {
+                diagnosticsSender.SendDiagnosticInformationString(
+                    SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                    "Line not sent because it is empty or longer than IRC allows"
+                );
+                return false;
+            }
+            if (
+                (diagnosticsSender.GetMinLevel() == 0)
+                || (trafficRecorder != nullptr)
+            ) {
+                const auto rawLine = line.GetLine();
+                if (rawLine.compare(0, 11, "PASS oauth:") == 0) {
+                    TraceLine("< ", "PASS oauth:**********************");
+                } else {
+                    TraceLine("< ", rawLine);
+                }
+                if (trafficRecorder != nullptr) {
+                    (void)trafficRecorder->RecordSent(rawLine);
+                }
+            }
+            CountLineSent(line.GetLength() + CRLF.length());
+            if (
+                flush
+                || (outboundBatch.length() >= OUTBOUND_BATCH_FLUSH_THRESHOLD)
+            ) {
+                FlushOutboundBatch(connection);
+            }
+            return true;
         }
 
         /**
@@ -409,35 +1482,462 @@ namespace Twitch {
          *     This is the raw line of text to send to the Twitch server.
          *     Do not include the line terminator (CRLF),
          *     as this method adds one to the end when sending the line.
+         *
+         * @param[in] flush
+         *     This indicates whether or not to send the line, along with
+         *     any other lines being held, right away.
          */
         void SendLineToTwitchServer(
-            Connection& connection,
-            const std::string& rawLine
+            ConnectionV2& connection,
+            const char* rawLine,
+            bool flush = false
         ) {
-            if (rawLine.substr(0, 11) == "PASS oauth:") {
-                diagnosticsSender.SendDiagnosticInformationString(0, "< PASS oauth:**********************");
-            } else {
-                diagnosticsSender.SendDiagnosticInformationString(0, "< " + rawLine);
+            OutboundLine line(outboundBatch);
+            line.Append(rawLine);
+            SendLineToTwitchServer(connection, line, flush);
+        }
+
+        /**
+         * This method publishes a diagnostic message tracing the given line
+         * sent to or received from the Twitch server, as long as there is
+         * a subscriber to receive it.
+         *
+         * @param[in] direction
+         *     This indicates whether the line was sent ("< ") or
+         *     received ("> ").
+         *
+         * @param[in] line
+         *     This is the line to trace.
+         */
+        void TraceLine(
+            const char* direction,
+            const std::string& line
+        ) {
+            if (diagnosticsSender.GetMinLevel() > 0) {
+                return;
             }
-            connection.Send(rawLine + CRLF);
+            std::string trace;
+            trace.reserve(2 + line.length());
+            trace += direction;
+            trace += line;
+            {
+                std::lock_guard< decltype(traceMutex) > lock(traceMutex);
+                if (
+                    !traceQueue.empty()
+                    && !stopTracer
+                ) {
+                    if (traceQueueCount == traceQueue.size()) {
+                        ++tracesDropped;
+                    } else {
+                        traceQueue[(traceQueueHead + traceQueueCount) % traceQueue.size()] = std::move(trace);
+                        ++traceQueueCount;
+                    }
+                    traceWakeCondition.notify_one();
+                    return;
+                }
+            }
+            diagnosticsSender.SendDiagnosticInformationString(0, std::move(trace));
+        }
+
+        /**
+         * This runs in its own thread, while asynchronous line tracing is
+         * enabled, and delivers traced lines to diagnostic subscribers.
+         */
+        void Tracer() {
+            std::unique_lock< decltype(traceMutex) > lock(traceMutex);
+            for (;;) {
+                traceWakeCondition.wait(
+                    lock,
+                    [this]{
+                        return (
+                            stopTracer
+                            || (traceQueueCount > 0)
+                            || (tracesDropped > 0)
+                        );
+                    }
+                );
+                if (
+                    (traceQueueCount == 0)
+                    && (tracesDropped == 0)
+                ) {
+                    break;
+                }
+                const auto dropped = tracesDropped;
+                tracesDropped = 0;
+                std::string trace;
+                if (traceQueueCount > 0) {
+                    trace = std::move(traceQueue[traceQueueHead]);
+                    traceQueueHead = (traceQueueHead + 1) % traceQueue.size();
+                    --traceQueueCount;
+                }
+                lock.unlock();
+                if (dropped > 0) {
+                    diagnosticsSender.SendDiagnosticInformationFormatted(
+                        SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                        "%zu traced lines dropped",
+                        dropped
+                    );
+                }
+                if (!trace.empty()) {
+                    diagnosticsSender.SendDiagnosticInformationString(0, std::move(trace));
+                }
+                lock.lock();
+            }
+        }
+
+        /**
+         * This method stops asynchronous line tracing, if it's enabled,
+         * after delivering any traced lines still queued.
+         */
+        void StopTracer() {
+            if (!tracer.joinable()) {
+                return;
+            }
+            {
+                std::lock_guard< decltype(traceMutex) > lock(traceMutex);
+                stopTracer = true;
+                traceWakeCondition.notify_one();
+            }
+            tracer.join();
         }
 
         /**
          * This method is called whenever any message is received from the
          * Twitch server for the user agent.
          *
-         * @param[in] rawText
-         *     This is the raw text received from the Twitch server.
+         * @param[in,out] buffer
+         *     This holds the raw text received from the Twitch server.
+         *     If no partial line is left over from what was received
+         *     before, the complete lines are left in the buffer, which is
+         *     held until the lines are processed, and only what follows
+         *     the last of them is copied.
          */
-        void OnMessageReceived(const std::string& rawText) {
-            std::lock_guard< decltype(mutex) > lock(mutex);
+        void OnMessageReceived(ConnectionV2::ReceivedBuffer&& buffer) {
+            auto data = buffer.GetData();
+            auto length = buffer.GetLength();
+            const auto measure = metricsEnabled.load(std::memory_order_relaxed);
+            std::chrono::steady_clock::time_point receivedTime;
+            if (measure) {
+                receivedTime = std::chrono::steady_clock::now();
+                (void)bytesReceived.fetch_add(length, std::memory_order_relaxed);
+            }
+            std::unique_lock< decltype(mutex) > lock(mutex);
             Action action;
             action.type = Action::Type::ProcessMessagesReceived;
-            action.message = rawText;
-            actionsToBePerformed.push_back(action);
+            action.receivedTime = receivedTime;
+            bool lent = true;
+            if (inboundLineDiscarded) {
+                const auto lineEnd = (const char*)memchr(data, '\n', length);
+                if (lineEnd == nullptr) {
+                    return;
+                }
+                inboundLineDiscarded = false;
+                length -= (lineEnd + 1 - data);
+                data = lineEnd + 1;
+                lent = false;
+            }
+            if (
+                lent
+                && inboundPartialLine.empty()
+            ) {
+                const auto lastLineEnd = FindLastLineEnd(data, length);
+                if (lastLineEnd == std::string::npos) {
+                    inboundPartialLine.assign(data, length);
+                    LimitInboundPartialLine();
+                    return;
+                }
+                const auto completeLinesLength = lastLineEnd + CRLF.length();
+                inboundPartialLine.assign(data + completeLinesLength, length - completeLinesLength);
+                buffer.Truncate(completeLinesLength);
+                action.received = std::move(buffer);
+            } else {
+                inboundPartialLine.append(data, length);
+                buffer.Release();
+                const auto lastLineEnd = inboundPartialLine.rfind(CRLF);
+                if (lastLineEnd == std::string::npos) {
+                    LimitInboundPartialLine();
+                    return;
+                }
+                const auto completeLinesLength = lastLineEnd + CRLF.length();
+                if (completeLinesLength == inboundPartialLine.length()) {
+                    action.message = std::move(inboundPartialLine);
+                    inboundPartialLine.clear();
+                } else {
+                    action.message = inboundPartialLine.substr(0, completeLinesLength);
+                    inboundPartialLine.erase(0, completeLinesLength);
+                }
+            }
+            LimitInboundPartialLine();
+            if (
+                (inboundBacklogConfiguration.maxBytes > 0)
+                && (
+                    inboundBacklogStatistics.bytes + GetReceivedLength(action)
+                    > inboundBacklogConfiguration.maxBytes
+                )
+            ) {
+                TakeReceivedLines(action);
+                ApplyInboundOverloadPolicy(action, lock);
+                if (inboundBacklogConfiguration.policy != InboundOverloadPolicy::Block) {
+                    EnforceInboundBacklogLimit(action, lock);
+                }
+                if (action.message.empty()) {
+                    return;
+                }
+            }
+            inboundBacklogStatistics.bytes += GetReceivedLength(action);
+            inboundBacklogStatistics.peakBytes = std::max(
+                inboundBacklogStatistics.peakBytes,
+                inboundBacklogStatistics.bytes
+            );
+            actionsToBePerformed.push_back(std::move(action));
+            CountActionsQueued();
             wakeWorker.notify_one();
         }
 
+        /**
+         * This method discards the partial line received from the Twitch
+         * server, along with the rest of it still to come, if it's grown
+         * longer than the limit on the inbound backlog, since it could
+         * never fit.  The mutex must be held when calling this method.
+         */
+        void LimitInboundPartialLine() {
+            if (
+                (inboundBacklogConfiguration.maxBytes == 0)
+                || (inboundPartialLine.length() <= inboundBacklogConfiguration.maxBytes)
+            ) {
+                return;
+            }
+            inboundPartialLine.clear();
+            inboundPartialLine.shrink_to_fit();
+            inboundLineDiscarded = true;
+            ++inboundBacklogStatistics.oversizedLinesDropped;
+        }
+
+        /**
+         * This method holds up the connection delivering newly received
+         * lines until there is room for them in the backlog of lines not
+         * yet handled, or until the backlog is empty, or until the
+         * connection starts closing.
+         *
+         * @param[in] length
+         *     This is the number of bytes of newly received lines.
+         *
+         * @param[in,out] lock
+         *     This is the lock held on the object's mutex, which is
+         *     released while waiting.
+         */
+        void WaitForInboundBacklogRoom(
+            size_t length,
+            std::unique_lock< decltype(mutex) >& lock
+        ) {
+            ++inboundBacklogStatistics.timesBlocked;
+            inboundBacklogSpaceAvailable.wait(
+                lock,
+                [this, length]{
+                    return (
+                        stopWorker
+                        || inboundBacklogUnblocked
+                        || (inboundBacklogStatistics.bytes == 0)
+                        || (inboundBacklogConfiguration.maxBytes == 0)
+                        || (
+                            inboundBacklogStatistics.bytes + length
+                            <= inboundBacklogConfiguration.maxBytes
+                        )
+                    );
+                }
+            );
+        }
+
+        /**
+         * This method is called when newly received lines from the Twitch
+         * server don't fit within the limit on the backlog of lines not yet
+         * handled, in order to make room for them according to the
+         * configured policy.
+         *
+         * @param[in,out] action
+         *     This is the action which will process the newly received lines.
+         *
+         * @param[in,out] lock
+         *     This is the lock held on the object's mutex, which may be
+         *     released while waiting for room in the backlog.
+         */
+        void ApplyInboundOverloadPolicy(
+            Action& action,
+            std::unique_lock< decltype(mutex) >& lock
+        ) {
+            const auto maxBytes = inboundBacklogConfiguration.maxBytes;
+            const auto overLimit = [this, &action, maxBytes]{
+                return (
+                    inboundBacklogStatistics.bytes + action.message.length()
+                    > maxBytes
+                );
+            };
+            switch (inboundBacklogConfiguration.policy) {
+                case InboundOverloadPolicy::Block: {
+                    WaitForInboundBacklogRoom(action.message.length(), lock);
+                } break;
+                case InboundOverloadPolicy::DropLowPriority: {
+                    for (const auto priority: {LinePriority::Low, LinePriority::Message}) {
+                        const auto shouldRemove = [priority](
+                            LinePriority linePriority,
+                            const std::string&
+                        ) {
+                            return (linePriority == priority);
+                        };
+                        const int prioritiesShed = (int)priority + 1;
+                        for (auto& queuedAction: actionsToBePerformed) {
+                            if (!overLimit()) {
+                                return;
+                            }
+                            if (
+                                (queuedAction.type != Action::Type::ProcessMessagesReceived)
+                                || (queuedAction.prioritiesShed >= prioritiesShed)
+                            ) {
+                                continue;
+                            }
+                            TakeReceivedLines(queuedAction);
+                            inboundBacklogStatistics.bytes -= queuedAction.message.length();
+                            CountDroppedLines(
+                                priority,
+                                RemoveLines(queuedAction.message, shouldRemove)
+                            );
+                            inboundBacklogStatistics.bytes += queuedAction.message.length();
+                            queuedAction.prioritiesShed = prioritiesShed;
+                        }
+                        if (!overLimit()) {
+                            return;
+                        }
+                        CountDroppedLines(
+                            priority,
+                            RemoveLines(action.message, shouldRemove)
+                        );
+                    }
+                } break;
+
+                case InboundOverloadPolicy::SampleMessages: {
+                    const auto sampleRate = std::max(
+                        inboundBacklogConfiguration.messageSampleRate,
+                        (size_t)1
+                    );
+                    size_t messagesDropped = 0;
+                    const auto linesDropped = RemoveLines(
+                        action.message,
+                        [this, sampleRate, &messagesDropped](
+                            LinePriority linePriority,
+                            const std::string& channel
+                        ) {
+                            if (linePriority == LinePriority::Low) {
+                                return true;
+                            } else if (linePriority == LinePriority::Message) {
+                                if ((inboundMessageSampleCounters[channel]++ % sampleRate) == 0) {
+                                    return false;
+                                }
+                                ++messagesDropped;
+                                return true;
+                            } else {
+                                return false;
+                            }
+                        }
+                    );
+                    inboundBacklogStatistics.messagesDropped += messagesDropped;
+                    inboundBacklogStatistics.lowPriorityLinesDropped += linesDropped - messagesDropped;
+                } break;
+
+                default: break;
+            }
+        }
+
+        /**
+         * This method drops the newest of the given newly received lines
+         * which aren't essential until the rest fit within the limit on
+         * the backlog of lines not yet handled, and if they still don't
+         * fit, holds up the connection until they do.  It's called once
+         * a policy which drops lines has made as much room as it can.
+         * Essential lines are never dropped.
+         *
+         * @param[in,out] action
+         *     This is the action which will process the newly received lines.
+         *
+         * @param[in,out] lock
+         *     This is the lock held on the object's mutex, which may be
+         *     released while waiting for room in the backlog.
+         */
+        void EnforceInboundBacklogLimit(
+            Action& action,
+            std::unique_lock< decltype(mutex) >& lock
+        ) {
+            const auto maxBytes = inboundBacklogConfiguration.maxBytes;
+            if (inboundBacklogStatistics.bytes + action.message.length() <= maxBytes) {
+                return;
+            }
+            auto excess = inboundBacklogStatistics.bytes + action.message.length() - maxBytes;
+            std::vector< size_t > droppableLengths;
+            std::string channel;
+            for (size_t begin = 0; begin < action.message.length();) {
+                auto end = action.message.find(CRLF, begin);
+                if (end == std::string::npos) {
+                    end = action.message.length();
+                }
+                const auto next = std::min(end + CRLF.length(), action.message.length());
+                if (ClassifyLine(action.message, begin, end, channel) != LinePriority::Essential) {
+                    droppableLengths.push_back(next - begin);
+                }
+                begin = next;
+            }
+            auto keepDroppable = droppableLengths.size();
+            while (
+                (keepDroppable > 0)
+                && (excess > 0)
+            ) {
+                --keepDroppable;
+                excess -= std::min(excess, droppableLengths[keepDroppable]);
+            }
+            size_t droppable = 0;
+            (void)RemoveLines(
+                action.message,
+                [this, keepDroppable, &droppable](
+                    LinePriority priority,
+                    const std::string&
+                ) {
+                    if (priority == LinePriority::Essential) {
+                        return false;
+                    }
+                    if (droppable++ < keepDroppable) {
+                        return false;
+                    }
+                    CountDroppedLines(priority, 1);
+                    return true;
+                }
+            );
+            if (
+                !action.message.empty()
+                && (inboundBacklogStatistics.bytes + action.message.length() > maxBytes)
+            ) {
+                WaitForInboundBacklogRoom(action.message.length(), lock);
+            }
+        }
+
+        /**
+         * This method adds the given number of dropped lines of the given
+         * priority to the inbound backlog statistics.
+         *
+         * @param[in] priority
+         *     This is the priority of the dropped lines.
+         *
+         * @param[in] linesDropped
+         *     This is the number of lines dropped.
+         */
+        void CountDroppedLines(
+            LinePriority priority,
+            size_t linesDropped
+        ) {
+            if (priority == LinePriority::Low) {
+                inboundBacklogStatistics.lowPriorityLinesDropped += linesDropped;
+            } else {
+                inboundBacklogStatistics.messagesDropped += linesDropped;
+            }
+        }
+
         /**
          * This method is called when the Twitch server closes its end of the
          * connection.
@@ -446,7 +1946,7 @@ namespace Twitch {
             std::lock_guard< decltype(mutex) > lock(mutex);
             Action action;
             action.type = Action::Type::ServerDisconnected;
-            actionsToBePerformed.push_back(action);
+            actionsToBePerformed.push_back(std::move(action));
             wakeWorker.notify_one();
         }
 
@@ -457,15 +1957,97 @@ namespace Twitch {
          * @param[in] action
          *     This holds the information needed to log into Twitch chat.
          */
-        void RequestCapabilities(Action action) {
-            SendLineToTwitchServer(*connection, "CAP REQ :twitch.tv/commands twitch.tv/membership twitch.tv/tags");
-            action.type = Action::Type::RequestCaps;
+        void RequestCapabilities(Action action) {
+            SendLineToTwitchServer(*connection, "CAP REQ :twitch.tv/commands twitch.tv/membership twitch.tv/tags");
+            action.type = Action::Type::RequestCaps;
+            if (timeKeeper != nullptr) {
+                action.expiration = timeKeeper->GetCurrentTime() + LOG_IN_TIMEOUT_SECONDS;
+            }
+            actionsAwaitingResponses.push_back(std::move(action));
+        }
+
+        /**
+         * This method is called to begin the capabilities negotiation phase
+         * of logging into Twitch chat by asking the server to list the
+         * capabilities it supports.
+         *
+         * @param[in] action
+         *     This holds the information needed to log into Twitch chat.
+         */
+        void ListCapabilities(Action action) {
+            SendLineToTwitchServer(*connection, "CAP LS 302");
+            action.type = Action::Type::LogIn;
+            if (timeKeeper != nullptr) {
+                action.expiration = timeKeeper->GetCurrentTime() + LOG_IN_TIMEOUT_SECONDS;
+            }
+            actionsAwaitingResponses.push_back(std::move(action));
+        }
+
+        /**
+         * This method is called to request the IRCv3 capabilities negotiated
+         * with the server the last time, skipping the step of asking the
+         * server to list the capabilities it supports.
+         *
+         * @param[in] action
+         *     This holds the information needed to log into Twitch chat.
+         *
+         * @param[in] caps
+         *     These are the capabilities to request.
+         */
+        void RequestCachedCapabilities(
+            Action action,
+            const std::set< std::string >& caps
+        ) {
+            std::string capsList;
+            for (const auto& cap: caps) {
+                if (!capsList.empty()) {
+                    capsList += ' ';
+                }
+                capsList += cap;
+            }
+            OutboundLine line(outboundBatch);
+            line.Append("CAP REQ :").Append(capsList);
+            SendLineToTwitchServer(*connection, line);
+            action.type = Action::Type::RequestCachedCaps;
             if (timeKeeper != nullptr) {
                 action.expiration = timeKeeper->GetCurrentTime() + LOG_IN_TIMEOUT_SECONDS;
             }
             actionsAwaitingResponses.push_back(std::move(action));
         }
 
+        /**
+         * This method replaces the cached set of IRCv3 capabilities
+         * negotiated with the server, persisting them to the cache file,
+         * if one was configured.
+         *
+         * @param[in] caps
+         *     These are the capabilities to remember.
+         */
+        void UpdateCapabilitiesCache(const std::set< std::string >& caps) {
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            if (
+                !capsCacheEnabled
+                || (caps == capsCached)
+            ) {
+                return;
+            }
+            capsCached = caps;
+            if (capsCacheFilePath.empty()) {
+                return;
+            }
+            std::ofstream file(capsCacheFilePath, std::ios::trunc);
+            for (const auto& cap: capsCached) {
+                file << cap << '\n';
+            }
+            if (!file) {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                    "Unable to write capabilities cache file '%s'",
+                    capsCacheFilePath.c_str()
+                );
+            }
+        }
+
         /**
          * This method is called to finish the capabilities negotiation phase
          * of logging into Twitch chat, send the user's authentication
@@ -478,9 +2060,13 @@ namespace Twitch {
         void EndCapabilitiesHandshakeAndAuthenticate(Action action) {
             SendLineToTwitchServer(*connection, "CAP END");
             if (!anonymous) {
-                SendLineToTwitchServer(*connection, "PASS oauth:" + action.token);
+                OutboundLine line(outboundBatch);
+                line.Append("PASS oauth:").Append(action.token);
+                SendLineToTwitchServer(*connection, line);
             }
-            SendLineToTwitchServer(*connection, "NICK " + action.nickname);
+            OutboundLine line(outboundBatch);
+            line.Append("NICK ").Append(action.nickname);
+            SendLineToTwitchServer(*connection, line);
             action.type = Action::Type::AwaitMotd;
             if (timeKeeper != nullptr) {
                 action.expiration = timeKeeper->GetCurrentTime() + LOG_IN_TIMEOUT_SECONDS;
@@ -488,6 +2074,26 @@ namespace Twitch {
             actionsAwaitingResponses.push_back(std::move(action));
         }
 
+        /**
+         * This method sends the QUIT command to the Twitch server, along
+         * with any other lines being held, right away.
+         *
+         * @param[in] farewell
+         *     If not empty, this is the message to include in the
+         *     QUIT command.  Otherwise, no QUIT command is sent, but any
+         *     other lines being held are still sent.
+         */
+        void SendFarewell(const std::string& farewell) {
+            if (!farewell.empty()) {
+                OutboundLine quit(outboundBatch);
+                quit.Append("QUIT :").Append(farewell);
+                if (SendLineToTwitchServer(*connection, quit, true)) {
+                    return;
+                }
+            }
+            FlushOutboundBatch(*connection);
+        }
+
         /**
          * This method is called whenever the user agent disconnects from the
          * Twitch server.
@@ -501,17 +2107,60 @@ namespace Twitch {
             if (connection == nullptr) {
                 return;
             }
-            if (!farewell.empty()) {
-                connection->Send("QUIT :" + farewell + CRLF);
+            SendFarewell(farewell);
+            logOutStage = LogOutStage::None;
+            {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                inboundBacklogUnblocked = true;
+                inboundBacklogSpaceAvailable.notify_all();
             }
             connection->Disconnect();
-            user->LogOut();
+            ForgetChannels();
+            DeliverEvent(Events::LogOut, &User::LogOut);
             connection = nullptr;
             loggedIn = false;
             actionsAwaitingResponses.clear();
             capsSupported.clear();
         }
 
+        /**
+         * This method forgets what's known about the given channel, or
+         * every channel, which bears on sending messages to it, because
+         * the channel was left or the connection was closed.  Only the
+         * number of messages to the channel still held in the outbound
+         * queue is kept.
+         *
+         * @param[in] channel
+         *     This is the name of the channel to forget, or an empty
+         *     string to forget every channel.
+         */
+        void ForgetChannels(const std::string& channel = "") {
+            if (channel.empty()) {
+                channelSendHistories.clear();
+            } else {
+                (void)channelSendHistories.erase(channel);
+            }
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            for (
+                auto it = channelStates.begin();
+                it != channelStates.end();
+            ) {
+                if (
+                    !channel.empty()
+                    && (it->first != channel)
+                ) {
+                    ++it;
+                } else if (it->second.messagesQueued == 0) {
+                    it = channelStates.erase(it);
+                } else {
+                    ChannelState channelState;
+                    channelState.messagesQueued = it->second.messagesQueued;
+                    it->second = channelState;
+                    ++it;
+                }
+            }
+        }
+
         /**
          * This method is called to process the given message through all
          * actions awaiting responses, removing any actions that are completed
@@ -567,6 +2216,12 @@ namespace Twitch {
                     ++it;
                 }
             }
+            if (
+                !actionsToTimeOut.empty()
+                && metricsEnabled.load(std::memory_order_relaxed)
+            ) {
+                (void)timeoutsFired.fetch_add(actionsToTimeOut.size(), std::memory_order_relaxed);
+            }
             while (!actionsToTimeOut.empty()) {
                 auto& action = actionsToTimeOut.front();
                 TimeoutAction(std::move(action));
@@ -584,6 +2239,7 @@ namespace Twitch {
         void PostAction(Action&& action) {
             std::lock_guard< decltype(mutex) > lock(mutex);
             actionsToBePerformed.push_back(std::move(action));
+            CountActionsQueued();
             wakeWorker.notify_one();
         }
 
@@ -603,6 +2259,12 @@ namespace Twitch {
                 {Action::Type::Leave, &Impl::PerformActionLeave},
                 {Action::Type::SendMessage, &Impl::PerformActionSendMessage},
                 {Action::Type::SendWhisper, &Impl::PerformActionSendWhisper},
+                {Action::Type::SetEventInterests, &Impl::PerformActionSetEventInterests},
+                {Action::Type::SetChannelSampling, &Impl::PerformActionSetChannelSampling},
+                {Action::Type::ClearChannelSampling, &Impl::PerformActionClearChannelSampling},
+                {Action::Type::SetTrafficRecorder, &Impl::PerformActionSetTrafficRecorder},
+                {Action::Type::SetLatencySummaryInterval, &Impl::PerformActionSetLatencySummaryInterval},
+                {Action::Type::ConfigureOutboundQueue, &Impl::PerformActionConfigureOutboundQueue},
             };
             const auto actionPerformer = actionPerformers.find(action.type);
             if (actionPerformer != actionPerformers.end()) {
@@ -620,6 +2282,7 @@ namespace Twitch {
             static const std::map< Action::Type, ActionTimeout > actionTimeouts = {
                 {Action::Type::LogIn, &Impl::TimeoutActionLogIn},
                 {Action::Type::RequestCaps, &Impl::TimeoutActionRequestCaps},
+                {Action::Type::RequestCachedCaps, &Impl::TimeoutActionRequestCaps},
                 {Action::Type::AwaitMotd, &Impl::TimeoutActionAwaitMotd},
             };
             const auto actionTimeout = actionTimeouts.find(action.type);
@@ -657,26 +2320,43 @@ namespace Twitch {
          *     This is the action to perform.
          */
         void PerformActionLogIn(Action&& action) {
+            TWITCH_TIMELINE_ZONE("PerformActionLogIn");
             if (connection != nullptr) {
                 return;
             }
-            connection = connectionFactory();
-            connection->SetMessageReceivedDelegate(
+            connection = ConnectionAdapter::Adapt(connectionFactory());
+            outboundBatch.clear();
+            connection->SetBufferReceivedDelegate(
                 std::bind(&Impl::OnMessageReceived, this, std::placeholders::_1)
             );
             connection->SetDisconnectedDelegate(
                 std::bind(&Impl::OnServerDisconnected, this)
             );
+            {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                inboundPartialLine.clear();
+                inboundLineDiscarded = false;
+                inboundBacklogUnblocked = false;
+            }
             if (connection->Connect()) {
                 capsSupported.clear();
                 anonymous = action.anonymous;
-                SendLineToTwitchServer(*connection, "CAP LS 302");
                 if (timeKeeper != nullptr) {
-                    action.expiration = timeKeeper->GetCurrentTime() + LOG_IN_TIMEOUT_SECONDS;
+                    handshakeStartTime = timeKeeper->GetCurrentTime();
+                }
+                std::set< std::string > caps;
+                {
+                    std::lock_guard< decltype(mutex) > lock(mutex);
+                    caps = capsCached;
+                }
+                handshakeUsedCachedCaps = !caps.empty();
+                if (handshakeUsedCachedCaps) {
+                    RequestCachedCapabilities(std::move(action), caps);
+                } else {
+                    ListCapabilities(std::move(action));
                 }
-                actionsAwaitingResponses.push_back(std::move(action));
             } else {
-                user->LogOut();
+                DeliverEvent(Events::LogOut, &User::LogOut);
             }
         }
 
@@ -717,9 +2397,9 @@ namespace Twitch {
                     || (capsSupported.find("twitch.tv/membership") == capsSupported.end())
                     || (capsSupported.find("twitch.tv/tags") == capsSupported.end())
                 ) {
-                    EndCapabilitiesHandshakeAndAuthenticate(action);
+                    EndCapabilitiesHandshakeAndAuthenticate(std::move(action));
                 } else {
-                    RequestCapabilities(action);
+                    RequestCapabilities(std::move(action));
                 }
                 return true;
             }
@@ -763,10 +2443,63 @@ namespace Twitch {
             ) {
                 return false;
             }
-            EndCapabilitiesHandshakeAndAuthenticate(action);
+            if (
+                (message.parameters[1] == "ACK")
+                && (message.parameters.size() >= 3)
+            ) {
+                const auto capsAcknowledged = StringExtensions::Split(message.parameters[2], ' ');
+                UpdateCapabilitiesCache(
+                    std::set< std::string >(
+                        capsAcknowledged.begin(),
+                        capsAcknowledged.end()
+                    )
+                );
+            }
+            EndCapabilitiesHandshakeAndAuthenticate(std::move(action));
             return true;
         }
 
+        /**
+         * This method processes the given CAP message in context of the given
+         * RequestCachedCaps action.  If the server refuses any of the cached
+         * capabilities, the cache is discarded and the server is asked to
+         * list the capabilities it supports, as if there had been no cache.
+         *
+         * @param[in,out] action
+         *     This is the action for which to process the given message.
+         *
+         * @param[in] message
+         *     This holds information about the message to process
+         *     within the context of the given action.
+         *
+         * @return
+         *     An indication of whether or not the action was completed by
+         *     processing the given message is returned.
+         */
+        bool ProcessActionRequestCachedCapsCap(
+            Action& action,
+            const Message& message
+        ) {
+            if (message.parameters.size() < 2) {
+                return false;
+            }
+            if (message.parameters[1] == "ACK") {
+                EndCapabilitiesHandshakeAndAuthenticate(std::move(action));
+                return true;
+            } else if (message.parameters[1] == "NAK") {
+                diagnosticsSender.SendDiagnosticInformationString(
+                    1,
+                    "Cached capabilities refused; revalidating"
+                );
+                UpdateCapabilitiesCache({});
+                handshakeUsedCachedCaps = false;
+                ListCapabilities(std::move(action));
+                return true;
+            } else {
+                return false;
+            }
+        }
+
         /**
          * This method times out the given RequestCaps action.
          *
@@ -778,86 +2511,595 @@ namespace Twitch {
         }
 
         /**
-         * This method processes the given Message of the Day (MOTD) message in
-         * context of the given AwaitMotd action.
+         * This method processes the given Message of the Day (MOTD) message in
+         * context of the given AwaitMotd action.
+         *
+         * @param[in,out] action
+         *     This is the action for which to process the given message.
+         *
+         * @param[in] message
+         *     This holds information about the message to process
+         *     within the context of the given action.
+         *
+         * @return
+         *     An indication of whether or not the action was completed by
+         *     processing the given message is returned.
+         */
+        bool ProcessActionAwaitMotdMotd(
+            Action& action,
+            const Message& message
+        ) {
+            if (!loggedIn) {
+                loggedIn = true;
+                {
+                    std::lock_guard< decltype(mutex) > lock(mutex);
+                    lastHandshake.usedCachedCapabilities = handshakeUsedCachedCaps;
+                    if (timeKeeper == nullptr) {
+                        lastHandshake.duration = 0.0;
+                    } else {
+                        lastHandshake.duration = timeKeeper->GetCurrentTime() - handshakeStartTime;
+                    }
+                }
+                DeliverEvent(Events::LogIn, &User::LogIn);
+            }
+            return true;
+        }
+
+        /**
+         * This method times out the given AwaitMotd action.
+         *
+         * @param[in] action
+         *     This is the action to time out.
+         */
+        void TimeoutActionAwaitMotd(Action&& action) {
+            Disconnect("Timeout waiting for MOTD");
+        }
+
+        /**
+         * This method performs the given LogOut action.
+         *
+         * @param[in] action
+         *     This is the action to perform.
+         */
+        void PerformActionLogOut(Action&& action) {
+            TWITCH_TIMELINE_ZONE("PerformActionLogOut");
+            if (
+                (action.deadline <= 0.0)
+                || (timeKeeper == nullptr)
+                || (connection == nullptr)
+            ) {
+                Disconnect(action.message);
+                return;
+            }
+            if (logOutStage != LogOutStage::None) {
+                return;
+            }
+            logOutStage = LogOutStage::Draining;
+            logOutDeadline = timeKeeper->GetCurrentTime() + action.deadline;
+            logOutFarewell = action.message;
+        }
+
+        /**
+         * This method moves a graceful log-out along, if one is underway,
+         * sending the farewell once the outbound queue is empty, and then
+         * closing the connection once everything has been written to it,
+         * or doing both right away once the deadline passes.
+         */
+        void ProcessLogOut() {
+            if (
+                (logOutStage == LogOutStage::None)
+                || (connection == nullptr)
+            ) {
+                return;
+            }
+            const auto pastDeadline = (timeKeeper->GetCurrentTime() >= logOutDeadline);
+            if (logOutStage == LogOutStage::Draining) {
+                if (
+                    !pastDeadline
+                    && loggedIn
+                    && !outboundQueue.empty()
+                ) {
+                    return;
+                }
+                SendFarewell(logOutFarewell);
+                logOutStage = LogOutStage::Closing;
+                loggedIn = false;
+            }
+            if (
+                !pastDeadline
+                && connection->IsSendPending()
+            ) {
+                return;
+            }
+            Disconnect();
+        }
+
+        /**
+         * This method performs the given ProcessMessagesReceived action.
+         *
+         * @param[in] action
+         *     This is the action to perform.
+         */
+        void PerformActionProcessMessagesReceived(Action&& action) {
+            TWITCH_TIMELINE_ZONE("PerformActionProcessMessagesReceived");
+            static const std::map< std::string, ServerCommandHandlerInfo > serverCommandHandlers = {
+                {"353", {&Impl::HandleServerCommandNameList, Events::NameList}},
+                {"376", {&Impl::HandleServerCommandMotd, 0}},
+                {"PING", {&Impl::HandleServerCommandPing, 0}},
+                {"JOIN", {&Impl::HandleServerCommandJoin, Events::Join}},
+                {"PART", {&Impl::HandleServerCommandPart, Events::Leave}},
+                {"PRIVMSG", {&Impl::HandleServerCommandPrivMsg, Events::Message | Events::PrivateMessage}},
+                {"CAP", {&Impl::HandleServerCommandCap, 0}},
+                {"WHISPER", {&Impl::HandleServerCommandWhisper, Events::Whisper}},
+                {"NOTICE", {&Impl::HandleServerCommandNotice, Events::Notice}},
+                {"HOSTTARGET", {&Impl::HandleServerCommandHostTarget, Events::Host}},
+                {"ROOMSTATE", {&Impl::HandleServerCommandRoomState, Events::RoomModeChange}},
+                {"CLEARCHAT", {&Impl::HandleServerCommandClearChat, Events::Clear}},
+                {"CLEARMSG", {&Impl::HandleServerCommandClearMessage, Events::Clear}},
+                {"MODE", {&Impl::HandleServerCommandMode, Events::Mod}},
+                {"GLOBALUSERSTATE", {&Impl::HandleServerCommandGlobalUserState, Events::UserState}},
+                {"USERSTATE", {&Impl::HandleServerCommandUserState, Events::UserState}},
+                {"RECONNECT", {&Impl::HandleServerCommandReconnect, Events::Doom}},
+                {"USERNOTICE", {&Impl::HandleServerCommandUserNotice, Events::Sub | Events::Raid | Events::Ritual}},
+            };
+            if (action.received.GetLength() > 0) {
+                (void)dataReceived.append(action.received.GetData(), action.received.GetLength());
+                action.received.Release();
+            } else {
+                dataReceived += action.message;
+            }
+            Message message;
+            const auto measure = (
+                metricsEnabled.load(std::memory_order_relaxed)
+                && (action.receivedTime != std::chrono::steady_clock::time_point())
+            );
+            linesReceivedTime = action.receivedTime;
+            for (;;) {
+                std::chrono::steady_clock::time_point parseStart;
+                if (measure) {
+                    parseStart = std::chrono::steady_clock::now();
+                }
+                if (!Message::Parse(dataReceived, message)) {
+                    break;
+                }
+                CommandCounters::Counters* messageCounters = nullptr;
+                if (measure) {
+                    queueWaitTime.Record(
+                        (uint64_t)std::chrono::duration_cast< std::chrono::nanoseconds >(
+                            parseStart - linesReceivedTime
+                        ).count()
+                    );
+                    parseTime.Record(NanosecondsSince(parseStart));
+                    (void)linesReceived.fetch_add(1, std::memory_order_relaxed);
+                    messageCounters = &commandCounters.Get(message.command);
+                    (void)messageCounters->linesReceived.fetch_add(1, std::memory_order_relaxed);
+                }
+                TraceLine("> ", message.line);
+                if (trafficRecorder != nullptr) {
+                    (void)trafficRecorder->RecordReceived(message.line);
+                }
+                const auto commandHandler = serverCommandHandlers.find(message.command);
+                const auto handled = (
+                    (commandHandler != serverCommandHandlers.end())
+                    && IsOfInterest(message, commandHandler->second.events)
+                    && (
+                        channelSampling.empty()
+                        || (message.command != "PRIVMSG")
+                        || SampleChatMessage(message)
+                    )
+                );
+                if ((eventInterests & Events::RawMessage) != 0) {
+                    TWITCH_TIMELINE_ZONE("User::RawMessage");
+                    user->RawMessage(
+                        RawMessageInfo(
+                            message.line,
+                            message.rawTags,
+                            message.prefix,
+                            message.command,
+                            message.parameters,
+                            handled
+                        )
+                    );
+                }
+                if (!handled) {
+                    continue;
+                }
+                if (message.command != "PRIVMSG") {
+                    DeliverMessageBatch();
+                }
+                std::chrono::steady_clock::time_point handlerStart;
+                message.DecodeTags();
+                if (messageCounters != nullptr) {
+                    MeasureServerLag(message.tags);
+                    handlerStart = std::chrono::steady_clock::now();
+                    if (message.command != "PRIVMSG") {
+                        endToEndTime.Record(
+                            (uint64_t)std::chrono::duration_cast< std::chrono::nanoseconds >(
+                                handlerStart - linesReceivedTime
+                            ).count()
+                        );
+                    }
+                }
+                (this->*(commandHandler->second.handler))(std::move(message));
+                if (messageCounters != nullptr) {
+                    const auto handlerDuration = NanosecondsSince(handlerStart);
+                    messageCounters->handlerTime.Record(handlerDuration);
+                    handlerTime.Record(handlerDuration);
+                }
+            }
+            DeliverMessageBatch();
+            linesReceivedTime = std::chrono::steady_clock::time_point();
+        }
+
+        /**
+         * This method measures how long before it was received the Twitch
+         * server sent a line, if the line has a timestamp and there is
+         * a time keeper.
+         *
+         * @param[in] tags
+         *     These are the tags of the line.
+         */
+        void MeasureServerLag(const TagsInfo& tags) {
+            if (
+                (tags.timestamp == 0)
+                || (timeKeeper == nullptr)
+            ) {
+                return;
+            }
+            const auto sentTime = (double)tags.timestamp + (double)tags.timeMilliseconds / 1000.0;
+            const auto lag = timeKeeper->GetCurrentTime() - sentTime;
+            serverLag.Record((lag > 0.0) ? (uint64_t)(lag * 1e9) : 0);
+        }
+
+        /**
+         * This method publishes a summary of measured latencies as a
+         * diagnostic message, if one is due.
+         */
+        void PublishLatencySummaryIfDue() {
+            if (latencySummaryInterval <= 0.0) {
+                return;
+            }
+            const auto now = timeKeeper->GetCurrentTime();
+            if (now < nextLatencySummaryTime) {
+                return;
+            }
+            nextLatencySummaryTime = now + latencySummaryInterval;
+            if (!metricsEnabled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            const auto lag = serverLag.GetSnapshot();
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                LATENCY_SUMMARY_DIAGNOSTIC_LEVEL,
+                "Latency: queue wait %s, parse %s, handler %s, end-to-end %s, server lag %s (%" PRIu64 " lines)",
+                FormatPercentiles(queueWaitTime.GetSnapshot()).c_str(),
+                FormatPercentiles(parseTime.GetSnapshot()).c_str(),
+                FormatPercentiles(handlerTime.GetSnapshot()).c_str(),
+                FormatPercentiles(endToEndTime.GetSnapshot()).c_str(),
+                FormatPercentiles(lag).c_str(),
+                parseTime.GetSnapshot().count
+            );
+        }
+
+        /**
+         * This method delivers to the user any messages sent to channels
+         * which have been received but not yet delivered.  If observers
+         * are interested in them, the messages are offered to the user
+         * as the events shared with the observers, and only those the
+         * user doesn't take are copied for it.
+         */
+        void DeliverMessageBatch() {
+            if (messageBatch.empty()) {
+                return;
+            }
+            TWITCH_TIMELINE_ZONE("User::Messages");
+            if (linesReceivedTime != std::chrono::steady_clock::time_point()) {
+                const auto sinceReceived = NanosecondsSince(linesReceivedTime);
+                for (size_t i = 0; i < messageBatch.size(); ++i) {
+                    endToEndTime.Record(sinceReceived);
+                }
+            }
+            const auto currentObservers = GetObservers();
+            if (
+                (currentObservers == nullptr)
+                || !IsObserved(*currentObservers, Events::Message)
+            ) {
+                user->Messages(std::move(messageBatch));
+                messageBatch.clear();
+                return;
+            }
+            std::vector< std::shared_ptr< InfoEvent< MessageInfo > > > events;
+            events.reserve(messageBatch.size());
+            for (auto& messageInfo: messageBatch) {
+                const auto event = std::make_shared< InfoEvent< MessageInfo > >();
+                event->type = Events::Message;
+                event->info = std::move(messageInfo);
+                events.push_back(event);
+            }
+            messageBatch.clear();
+            if (userSet) {
+                for (const auto& event: events) {
+                    if (!user->SharedEvent(event)) {
+                        messageBatch.push_back(event->info);
+                    }
+                }
+                if (!messageBatch.empty()) {
+                    user->Messages(std::move(messageBatch));
+                    messageBatch.clear();
+                }
+            }
+            for (const auto& event: events) {
+                NotifyObservers(*currentObservers, event);
+            }
+        }
+
+        /**
+         * This method returns the observers currently added, if any.
+         *
+         * @return
+         *     The observers currently added are returned, or null if there
+         *     are none.
+         */
+        std::shared_ptr< const Observers > GetObservers() {
+            std::lock_guard< decltype(observerSet->mutex) > lock(observerSet->mutex);
+            return observerSet->observers;
+        }
+
+        /**
+         * This method indicates whether or not any of the given observers
+         * is interested in the given kind of event.
+         *
+         * @param[in] observersToCheck
+         *     These are the observers to check.
+         *
+         * @param[in] type
+         *     This is the kind of event to check.
+         *
+         * @return
+         *     An indication of whether or not any of the given observers
+         *     is interested in the given kind of event is returned.
+         */
+        static bool IsObserved(
+            const Observers& observersToCheck,
+            EventMask type
+        ) {
+            for (const auto& observer: observersToCheck) {
+                if ((observer->configuration.events & type) != 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * This method delivers an event which carries information
+         * to the user and then to any observers.  If no observer is
+         * interested in the event, the information is moved to the user.
+         * Otherwise, the information is moved into one event shared by
+         * the observers, which is offered to the user, if one was set,
+         * before them.  The user is only given a copy of the information
+         * if it doesn't take the shared event.
+         *
+         * @param[in] type
+         *     This is the kind of event to deliver.
+         *
+         * @param[in] info
+         *     This is the information carried by the event.
+         *
+         * @param[in] callback
+         *     This is the user method to call to deliver the event.
+         */
+        template< typename Info > void DeliverEvent(
+            EventMask type,
+            Info&& info,
+            void (User::*callback)(Info&&)
+        ) {
+            TWITCH_TIMELINE_ZONE(GetUserCallbackZoneName(type));
+            const auto currentObservers = GetObservers();
+            if (
+                (currentObservers == nullptr)
+                || !IsObserved(*currentObservers, type)
+            ) {
+                (user.get()->*callback)(std::move(info));
+                return;
+            }
+            const auto event = std::make_shared< InfoEvent< Info > >();
+            event->type = type;
+            event->info = std::move(info);
+            if (
+                userSet
+                && !user->SharedEvent(event)
+            ) {
+                (user.get()->*callback)(Info(event->info));
+            }
+            NotifyObservers(*currentObservers, event);
+        }
+
+        /**
+         * This method delivers an event which carries no information
+         * to the user and then to any observers.
          *
-         * @param[in,out] action
-         *     This is the action for which to process the given message.
-         *
-         * @param[in] message
-         *     This holds information about the message to process
-         *     within the context of the given action.
+         * @param[in] type
+         *     This is the kind of event to deliver.
          *
-         * @return
-         *     An indication of whether or not the action was completed by
-         *     processing the given message is returned.
+         * @param[in] callback
+         *     This is the user method to call to deliver the event.
          */
-        bool ProcessActionAwaitMotdMotd(
-            Action& action,
-            const Message& message
+        void DeliverEvent(
+            EventMask type,
+            void (User::*callback)()
         ) {
-            if (!loggedIn) {
-                loggedIn = true;
-                user->LogIn();
+            TWITCH_TIMELINE_ZONE(GetUserCallbackZoneName(type));
+            (user.get()->*callback)();
+            const auto currentObservers = GetObservers();
+            if (
+                (currentObservers == nullptr)
+                || !IsObserved(*currentObservers, type)
+            ) {
+                return;
             }
-            return true;
+            const auto event = std::make_shared< Event >();
+            event->type = type;
+            NotifyObservers(*currentObservers, event);
         }
 
         /**
-         * This method times out the given AwaitMotd action.
+         * This method delivers the given event to every one of the given
+         * observers which is interested in it.
          *
-         * @param[in] action
-         *     This is the action to time out.
+         * @param[in] observersToNotify
+         *     These are the observers to which to deliver the event.
+         *
+         * @param[in] event
+         *     This is the event to deliver.
          */
-        void TimeoutActionAwaitMotd(Action&& action) {
-            Disconnect("Timeout waiting for MOTD");
+        void NotifyObservers(
+            const Observers& observersToNotify,
+            std::shared_ptr< const Event > event
+        ) {
+            for (const auto& observer: observersToNotify) {
+                if ((observer->configuration.events & event->type) == 0) {
+                    continue;
+                }
+                if (!observer->configuration.ownThread) {
+                    observer->delegate(event);
+                    continue;
+                }
+                std::unique_lock< decltype(observer->mutex) > lock(observer->mutex);
+                const auto maxQueuedEvents = observer->configuration.maxQueuedEvents;
+                if (
+                    (maxQueuedEvents > 0)
+                    && (observer->events.size() >= maxQueuedEvents)
+                ) {
+                    if (observer->configuration.dropWhenFull) {
+                        continue;
+                    }
+                    observer->wakeCondition.wait(
+                        lock,
+                        [observer, maxQueuedEvents]{
+                            return (
+                                observer->stop
+                                || (observer->events.size() < maxQueuedEvents)
+                            );
+                        }
+                    );
+                    if (observer->stop) {
+                        continue;
+                    }
+                }
+                observer->events.push_back(event);
+                observer->wakeCondition.notify_all();
+            }
         }
 
         /**
-         * This method performs the given LogOut action.
+         * This method decides whether or not the given message received from
+         * the Twitch server needs to be handled, based on the kinds of events
+         * in which the user is interested.
          *
-         * @param[in] action
-         *     This is the action to perform.
+         * @param[in] message
+         *     This is the message to consider.
+         *
+         * @param[in] events
+         *     These are the kinds of events which may result from handling
+         *     the message, or zero if the message must always be handled.
+         *
+         * @return
+         *     An indication of whether or not the message needs to be handled
+         *     is returned.
          */
-        void PerformActionLogOut(Action&& action) {
-            Disconnect(action.message);
+        bool IsOfInterest(
+            const Message& message,
+            EventMask events
+        ) {
+            if (
+                (events == 0)
+                || (eventInterests == Events::All)
+            ) {
+                return true;
+            }
+            if (message.command == "PRIVMSG") {
+                // Chat messages to a channel begin with '#'; anything else
+                // is a private message to the user.
+                if (
+                    !message.parameters.empty()
+                    && !message.parameters[0].empty()
+                ) {
+                    events = (
+                        (message.parameters[0][0] == '#')
+                        ? Events::Message
+                        : Events::PrivateMessage
+                    );
+                }
+            } else if (message.command == "NOTICE") {
+                // Notices are needed to detect log-in failures.
+                if (!loggedIn) {
+                    return true;
+                }
+            } else if (
+                (message.command == "ROOMSTATE")
+                || (message.command == "USERSTATE")
+            ) {
+                // These are needed to schedule messages sent to channels.
+                return true;
+            }
+            return ((events & eventInterests) != 0);
         }
 
         /**
-         * This method performs the given ProcessMessagesReceived action.
+         * This method decides whether or not to keep the given chat message,
+         * according to the sampling set for the channel to which it was sent.
          *
-         * @param[in] action
-         *     This is the action to perform.
+         * @param[in] message
+         *     This is the chat message to consider.
+         *
+         * @return
+         *     An indication of whether or not to keep the chat message
+         *     is returned.
          */
-        void PerformActionProcessMessagesReceived(Action&& action) {
-            static const std::map< std::string, ServerCommandHandler > serverCommandHandlers = {
-                {"353", &Impl::HandleServerCommandNameList},
-                {"376", &Impl::HandleServerCommandMotd},
-                {"PING", &Impl::HandleServerCommandPing},
-                {"JOIN", &Impl::HandleServerCommandJoin},
-                {"PART", &Impl::HandleServerCommandPart},
-                {"PRIVMSG", &Impl::HandleServerCommandPrivMsg},
-                {"CAP", &Impl::HandleServerCommandCap},
-                {"WHISPER", &Impl::HandleServerCommandWhisper},
-                {"NOTICE", &Impl::HandleServerCommandNotice},
-                {"HOSTTARGET", &Impl::HandleServerCommandHostTarget},
-                {"ROOMSTATE", &Impl::HandleServerCommandRoomState},
-                {"CLEARCHAT", &Impl::HandleServerCommandClearChat},
-                {"CLEARMSG", &Impl::HandleServerCommandClearMessage},
-                {"MODE", &Impl::HandleServerCommandMode},
-                {"GLOBALUSERSTATE", &Impl::HandleServerCommandGlobalUserState},
-                {"USERSTATE", &Impl::HandleServerCommandUserState},
-                {"RECONNECT", &Impl::HandleServerCommandReconnect},
-                {"USERNOTICE", &Impl::HandleServerCommandUserNotice},
-            };
-            dataReceived += action.message;
-            Message message;
-            while (Message::Parse(dataReceived, message, diagnosticsSender)) {
-                const auto commandHandler = serverCommandHandlers.find(message.command);
-                if (commandHandler != serverCommandHandlers.end()) {
-                    (this->*(commandHandler->second))(std::move(message));
+        bool SampleChatMessage(const Message& message) {
+            if (
+                message.parameters.empty()
+                || message.parameters[0].empty()
+                || (message.parameters[0][0] != '#')
+            ) {
+                return true;
+            }
+            const auto channel = message.parameters[0].substr(1);
+            auto sampling = channelSampling.find(channel);
+            if (sampling == channelSampling.end()) {
+                sampling = channelSampling.find("");
+                if (sampling == channelSampling.end()) {
+                    return true;
+                }
+            }
+            auto& state = channelSamplingStates[channel];
+            if (
+                (sampling->second.keepOneIn > 1)
+                && ((state.messagesReceived++ % sampling->second.keepOneIn) != 0)
+            ) {
+                return false;
+            }
+            if (
+                (sampling->second.maxPerSecond > 0.0)
+                && (timeKeeper != nullptr)
+            ) {
+                const auto now = timeKeeper->GetCurrentTime();
+                const auto maxAllowance = std::max(sampling->second.maxPerSecond, 1.0);
+                if (state.lastAllowanceUpdate < 0.0) {
+                    state.allowance = maxAllowance;
+                } else {
+                    state.allowance = std::min(
+                        maxAllowance,
+                        state.allowance + (now - state.lastAllowanceUpdate) * sampling->second.maxPerSecond
+                    );
                 }
+                state.lastAllowanceUpdate = now;
+                if (state.allowance < 1.0) {
+                    return false;
+                }
+                state.allowance -= 1.0;
             }
+            return true;
         }
 
         /**
@@ -868,6 +3110,7 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandMotd(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandMotd");
             static const ActionProcessors motdActionProcessors = {
                 {Action::Type::AwaitMotd, &Impl::ProcessActionAwaitMotdMotd},
             };
@@ -885,13 +3128,14 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandNameList(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandNameList");
             if (message.parameters.size() != 4) {
                 return;
             }
             NameListInfo nameListInfo;
             nameListInfo.channel = message.parameters[2].substr(1);
             nameListInfo.names = StringExtensions::Split(message.parameters[3], ' ');
-            user->NameList(std::move(nameListInfo));
+            DeliverEvent(Events::NameList, std::move(nameListInfo), &User::NameList);
         }
 
         /**
@@ -902,12 +3146,15 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandPing(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandPing");
             if (message.parameters.size() < 1) {
                 return;
             }
             const auto server = message.parameters[0];
             if (connection != nullptr) {
-                SendLineToTwitchServer(*connection, "PONG :" + server);
+                OutboundLine line(outboundBatch);
+                line.Append("PONG :").Append(server);
+                SendLineToTwitchServer(*connection, line, true);
             }
         }
 
@@ -919,6 +3166,7 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandJoin(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandJoin");
             if (
                 (message.parameters.size() < 1)
                 || (message.parameters[0].length() < 2)
@@ -936,7 +3184,7 @@ namespace Twitch {
             MembershipInfo membershipInfo;
             membershipInfo.user = nickname;
             membershipInfo.channel = message.parameters[0].substr(1);
-            user->Join(std::move(membershipInfo));
+            DeliverEvent(Events::Join, std::move(membershipInfo), &User::Join);
         }
 
         /**
@@ -947,6 +3195,7 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandPart(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandPart");
             if (
                 (message.parameters.size() < 1)
                 || (message.parameters[0].length() < 2)
@@ -964,7 +3213,7 @@ namespace Twitch {
             MembershipInfo membershipInfo;
             membershipInfo.user = nickname;
             membershipInfo.channel = message.parameters[0].substr(1);
-            user->Leave(std::move(membershipInfo));
+            DeliverEvent(Events::Leave, std::move(membershipInfo), &User::Leave);
         }
 
         /**
@@ -975,6 +3224,7 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandPrivMsg(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandPrivMsg");
             // Ignore message unless it at least has a channel/user name and
             // message.
             if (message.parameters.size() < 2) {
@@ -983,29 +3233,27 @@ namespace Twitch {
 
             // Extract user name from message prefix.
             MessageInfo messageInfo;
-            const auto nickname = ExtractNicknameFromPrefix(message.prefix);
-            messageInfo.user = nickname;
+            messageInfo.user = ExtractNicknameFromPrefix(message.prefix);
 
-            // Copy message content.
+            // Move message content.
             // Check to see if it's an action.
+            auto& content = message.parameters[1];
             if (
-                (message.parameters[1].length() >= 8)
-                && (message.parameters[1][0] == '\x1')
-                && (message.parameters[1].substr(1, 6) == "ACTION")
-                && (message.parameters[1][message.parameters[1].length() - 1] == '\x1')
+                (content.length() >= 8)
+                && (content[0] == '\x1')
+                && (content.compare(1, 6, "ACTION") == 0)
+                && (content[content.length() - 1] == '\x1')
             ) {
                 messageInfo.isAction = true;
-                messageInfo.messageContent = message.parameters[1].substr(7, message.parameters[1].length() - 8);
+                content.pop_back();
+                content.erase(0, 7);
             } else {
                 messageInfo.isAction = false;
-                messageInfo.messageContent = message.parameters[1];
             }
+            messageInfo.messageContent = std::move(content);
 
             // Parse message ID.
-            const auto messageIdTag = message.tags.allTags.find("id");
-            if (messageIdTag != message.tags.allTags.end()) {
-                messageInfo.messageId = messageIdTag->second;
-            }
+            messageInfo.messageId = message.tags.id;
 
             // Parse bits.
             const auto bitsTag = message.tags.allTags.find("bits");
@@ -1015,17 +3263,20 @@ namespace Twitch {
                 }
             }
 
-            // Copy tags.
-            messageInfo.tags = message.tags;
+            // Move tags.
+            messageInfo.tags = std::move(message.tags);
 
             // Trigger callback; if parameter begins with '#', this is a
             // message sent to the channel; otherwise, it's a private message
             // to the user.
-            if (message.parameters[0][0] == '#') {
-                messageInfo.channel = message.parameters[0].substr(1);
-                user->Message(std::move(messageInfo));
+            auto& target = message.parameters[0];
+            if (target[0] == '#') {
+                target.erase(0, 1);
+                messageInfo.channel = std::move(target);
+                messageBatch.push_back(std::move(messageInfo));
             } else {
-                user->PrivateMessage(std::move(messageInfo));
+                DeliverMessageBatch();
+                DeliverEvent(Events::PrivateMessage, std::move(messageInfo), &User::PrivateMessage);
             }
         }
 
@@ -1037,9 +3288,11 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandCap(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandCap");
             static const ActionProcessors capActionProcessors = {
                 {Action::Type::LogIn, &Impl::ProcessActionLogInCap},
                 {Action::Type::RequestCaps, &Impl::ProcessActionRequestCapsCap},
+                {Action::Type::RequestCachedCaps, &Impl::ProcessActionRequestCachedCapsCap},
             };
             ProcessMessageWithAwaitingActions(
                 message,
@@ -1055,24 +3308,24 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandWhisper(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandWhisper");
             // Ignore message unless it at least has a user name and message.
             if (message.parameters.size() < 2) {
                 return;
             }
 
             // Extract whisper sender.
-            const auto nickname = ExtractNicknameFromPrefix(message.prefix);
             WhisperInfo whisperInfo;
-            whisperInfo.user = nickname;
+            whisperInfo.user = ExtractNicknameFromPrefix(message.prefix);
 
-            // Copy whisper message.
-            whisperInfo.message = message.parameters[1];
+            // Move whisper message.
+            whisperInfo.message = std::move(message.parameters[1]);
 
-            // Copy message tags.
-            whisperInfo.tags = message.tags;
+            // Move message tags.
+            whisperInfo.tags = std::move(message.tags);
 
             // Trigger user callback.
-            user->Whisper(std::move(whisperInfo));
+            DeliverEvent(Events::Whisper, std::move(whisperInfo), &User::Whisper);
         }
 
         /**
@@ -1083,6 +3336,7 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandNotice(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandNotice");
             if (message.parameters.size() < 2) {
                 return;
             }
@@ -1096,7 +3350,9 @@ namespace Twitch {
             if (idTag != message.tags.allTags.end()) {
                 notice.id = idTag->second;
             }
-            user->Notice(std::move(notice));
+            if ((eventInterests & Events::Notice) != 0) {
+                DeliverEvent(Events::Notice, std::move(notice), &User::Notice);
+            }
             if (
                 !loggedIn
                 && (
@@ -1104,7 +3360,7 @@ namespace Twitch {
                     || (noticeText == "Login authentication failed")
                 )
             ) {
-                user->LogOut();
+                DeliverEvent(Events::LogOut, &User::LogOut);
                 static const ActionProcessors loginFailActionProcessors = {
                     {Action::Type::AwaitMotd, &Impl::DiscardAction},
                 };
@@ -1123,6 +3379,7 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandHostTarget(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandHostTarget");
             if (
                 (message.parameters.size() < 2)
                 || (message.parameters[0].length() < 2)
@@ -1147,7 +3404,7 @@ namespace Twitch {
             ) {
                 hostInfo.viewers = 0;
             }
-            user->Host(std::move(hostInfo));
+            DeliverEvent(Events::Host, std::move(hostInfo), &User::Host);
         }
 
         /**
@@ -1158,12 +3415,14 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandRoomState(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandRoomState");
             if (
                 (message.parameters.size() < 1)
                 || (message.parameters[0].length() < 2)
             ) {
                 return;
             }
+            std::vector< RoomModeChangeInfo > roomModeChanges;
             for (const std::string& mode: { "slow", "followers-only", "r9k", "emote-only", "subs-only" }) {
                 const auto modeTag = message.tags.allTags.find(mode);
                 if (modeTag != message.tags.allTags.end()) {
@@ -1174,9 +3433,36 @@ namespace Twitch {
                     if (sscanf(modeTag->second.c_str(), "%d", &roomModeChange.parameter) != 1) {
                         roomModeChange.parameter = 0;
                     }
-                    user->RoomModeChange(std::move(roomModeChange));
+                    roomModeChanges.push_back(std::move(roomModeChange));
+                }
+            }
+
+            // Track the modes of the channel.
+            {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                auto& channelState = channelStates[message.parameters[0].substr(1)];
+                for (const auto& roomModeChange: roomModeChanges) {
+                    if (roomModeChange.mode == "slow") {
+                        channelState.slow = roomModeChange.parameter;
+                    } else if (roomModeChange.mode == "followers-only") {
+                        channelState.followersOnly = roomModeChange.parameter;
+                    } else if (roomModeChange.mode == "r9k") {
+                        channelState.r9k = (roomModeChange.parameter != 0);
+                    } else if (roomModeChange.mode == "emote-only") {
+                        channelState.emoteOnly = (roomModeChange.parameter != 0);
+                    } else if (roomModeChange.mode == "subs-only") {
+                        channelState.subsOnly = (roomModeChange.parameter != 0);
+                    }
                 }
             }
+
+            // Trigger user callbacks.
+            if ((eventInterests & Events::RoomModeChange) == 0) {
+                return;
+            }
+            for (auto& roomModeChange: roomModeChanges) {
+                DeliverEvent(Events::RoomModeChange, std::move(roomModeChange), &User::RoomModeChange);
+            }
         }
 
         /**
@@ -1187,6 +3473,7 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandClearChat(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandClearChat");
             // Ignore message unless it at least has a channel name.
             if (
                 (message.parameters.size() < 1)
@@ -1205,7 +3492,7 @@ namespace Twitch {
                 clear.type = ClearInfo::Type::ClearAll;
             } else {
                 // Extract user name.
-                clear.user = message.parameters[1];
+                clear.user = std::move(message.parameters[1]);
 
                 // Extract ban/timeout reason, if any.
                 const auto reasonTag = message.tags.allTags.find("ban-reason");
@@ -1228,11 +3515,11 @@ namespace Twitch {
                 }
             }
 
-            // Copy message tags.
-            clear.tags = message.tags;
+            // Move message tags.
+            clear.tags = std::move(message.tags);
 
             // Trigger callback to the user.
-            user->Clear(std::move(clear));
+            DeliverEvent(Events::Clear, std::move(clear), &User::Clear);
         }
 
         /**
@@ -1243,6 +3530,7 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandClearMessage(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandClearMessage");
             // Ignore message unless it at least has a channel name.
             if (
                 (message.parameters.size() < 2)
@@ -1257,7 +3545,7 @@ namespace Twitch {
             clear.channel = message.parameters[0].substr(1);
 
             // Extract offending message content.
-            clear.offendingMessageContent = message.parameters[1];
+            clear.offendingMessageContent = std::move(message.parameters[1]);
 
             // Extract offending message ID.
             const auto offendingMessageIdTag = message.tags.allTags.find("target-msg-id");
@@ -1271,11 +3559,11 @@ namespace Twitch {
                 clear.user = userNameTag->second;
             }
 
-            // Copy message tags.
-            clear.tags = message.tags;
+            // Move message tags.
+            clear.tags = std::move(message.tags);
 
             // Trigger callback to the user.
-            user->Clear(std::move(clear));
+            DeliverEvent(Events::Clear, std::move(clear), &User::Clear);
         }
 
         /**
@@ -1286,6 +3574,7 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandMode(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandMode");
             // Ignore message unless it at least has a channel name.
             if (
                 (message.parameters.size() < 3)
@@ -1309,10 +3598,10 @@ namespace Twitch {
             }
 
             // Extract user name.
-            mod.user = message.parameters[2];
+            mod.user = std::move(message.parameters[2]);
 
             // Trigger callback to the user.
-            user->Mod(std::move(mod));
+            DeliverEvent(Events::Mod, std::move(mod), &User::Mod);
         }
 
         /**
@@ -1323,15 +3612,16 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandGlobalUserState(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandGlobalUserState");
             // Start off by saying this isn't a global state for the user.
             UserStateInfo userState;
             userState.global = true;
 
-            // Copy tags.
-            userState.tags = message.tags;
+            // Move tags.
+            userState.tags = std::move(message.tags);
 
             // Trigger user callback.
-            user->UserState(std::move(userState));
+            DeliverEvent(Events::UserState, std::move(userState), &User::UserState);
         }
 
         /**
@@ -1342,6 +3632,7 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandUserState(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandUserState");
             // Ignore message unless it at least has a channel name.
             if (
                 (message.parameters.size() < 1)
@@ -1357,11 +3648,30 @@ namespace Twitch {
             // Parse channel name.
             userState.channel = message.parameters[0].substr(1);
 
-            // Copy tags.
-            userState.tags = message.tags;
+            // Track the standing of the user in the channel.
+            {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                auto& channelState = channelStates[userState.channel];
+                const auto& badges = message.tags.badges;
+                channelState.moderator = (
+                    HasBadge(badges, "moderator")
+                    || HasBadge(badges, "broadcaster")
+                );
+                channelState.vip = HasBadge(badges, "vip");
+                channelState.subscriber = (
+                    HasBadge(badges, "subscriber")
+                    || HasBadge(badges, "founder")
+                );
+            }
+            if ((eventInterests & Events::UserState) == 0) {
+                return;
+            }
+
+            // Move tags.
+            userState.tags = std::move(message.tags);
 
             // Trigger user callback.
-            user->UserState(std::move(userState));
+            DeliverEvent(Events::UserState, std::move(userState), &User::UserState);
         }
 
         /**
@@ -1372,7 +3682,8 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandReconnect(Message&& message) {
-            user->Doom();
+            TWITCH_TIMELINE_ZONE("HandleServerCommandReconnect");
+            DeliverEvent(Events::Doom, &User::Doom);
         }
 
         /**
@@ -1383,6 +3694,7 @@ namespace Twitch {
          *     This holds information about the server command to handle.
          */
         void HandleServerCommandUserNotice(Message&& message) {
+            TWITCH_TIMELINE_ZONE("HandleServerCommandUserNotice");
             // Ignore message unless it at least has a channel name.
             if (
                 (message.parameters.size() < 1)
@@ -1421,11 +3733,11 @@ namespace Twitch {
                     ritual.systemMessage = UnescapeMessage(systemMessageTag->second);
                 }
 
-                // Copy over the tags.
-                ritual.tags = message.tags;
+                // Move over the tags.
+                ritual.tags = std::move(message.tags);
 
                 // Trigger callback to the user.
-                user->Ritual(std::move(ritual));
+                DeliverEvent(Events::Ritual, std::move(ritual), &User::Ritual);
             } else if (messageId == "raid") {
                 // Extract channel name.
                 RaidInfo raid;
@@ -1452,11 +3764,11 @@ namespace Twitch {
                     raid.viewers = 0;
                 }
 
-                // Copy over the tags.
-                raid.tags = message.tags;
+                // Move over the tags.
+                raid.tags = std::move(message.tags);
 
                 // Trigger callback to the user.
-                user->Raid(std::move(raid));
+                DeliverEvent(Events::Raid, std::move(raid), &User::Raid);
             } else {
                 // Extract channel name.
                 SubInfo sub;
@@ -1470,7 +3782,7 @@ namespace Twitch {
 
                 // Extract user message, if any.
                 if (message.parameters.size() >= 2) {
-                    sub.userMessage = message.parameters[1];
+                    sub.userMessage = std::move(message.parameters[1]);
                 }
 
                 // Extract system message.
@@ -1566,84 +3878,688 @@ namespace Twitch {
                     sub.planId = 0;
                 }
 
-                // Copy over the tags.
-                sub.tags = message.tags;
+                // Move over the tags.
+                sub.tags = std::move(message.tags);
 
                 // Trigger callback to the user.
-                user->Sub(std::move(sub));
+                DeliverEvent(Events::Sub, std::move(sub), &User::Sub);
+            }
+        }
+
+        /**
+         * This method performs the given ServerDisconnected action.
+         *
+         * @param[in] action
+         *     This is the action to perform.
+         */
+        void PerformActionServerDisconnected(Action&& action) {
+            TWITCH_TIMELINE_ZONE("PerformActionServerDisconnected");
+            Disconnect();
+        }
+
+        /**
+         * This method performs the given Join action.
+         *
+         * @param[in] action
+         *     This is the action to perform.
+         */
+        void PerformActionJoin(Action&& action) {
+            TWITCH_TIMELINE_ZONE("PerformActionJoin");
+            SendOrHold(std::move(action));
+        }
+
+        /**
+         * This method performs the given SetEventInterests action.
+         *
+         * @param[in] action
+         *     This is the action to perform.
+         */
+        void PerformActionSetEventInterests(Action&& action) {
+            TWITCH_TIMELINE_ZONE("PerformActionSetEventInterests");
+            eventInterests = action.events;
+        }
+
+        /**
+         * This method performs the given SetChannelSampling action.
+         *
+         * @param[in] action
+         *     This is the action to perform.
+         */
+        void PerformActionSetChannelSampling(Action&& action) {
+            TWITCH_TIMELINE_ZONE("PerformActionSetChannelSampling");
+            channelSampling[action.nickname] = action.sampling;
+            channelSamplingStates.clear();
+        }
+
+        /**
+         * This method performs the given ClearChannelSampling action.
+         *
+         * @param[in] action
+         *     This is the action to perform.
+         */
+        void PerformActionClearChannelSampling(Action&& action) {
+            TWITCH_TIMELINE_ZONE("PerformActionClearChannelSampling");
+            (void)channelSampling.erase(action.nickname);
+            channelSamplingStates.clear();
+        }
+
+        /**
+         * This method performs the given SetTrafficRecorder action.
+         *
+         * @param[in] action
+         *     This is the action to perform.
+         */
+        void PerformActionSetTrafficRecorder(Action&& action) {
+            TWITCH_TIMELINE_ZONE("PerformActionSetTrafficRecorder");
+            trafficRecorder = std::move(action.trafficRecorder);
+        }
+
+        /**
+         * This method performs the given SetLatencySummaryInterval action.
+         *
+         * @param[in] action
+         *     This is the action to perform.
+         */
+        void PerformActionSetLatencySummaryInterval(Action&& action) {
+            TWITCH_TIMELINE_ZONE("PerformActionSetLatencySummaryInterval");
+            latencySummaryInterval = action.interval;
+            nextLatencySummaryTime = 0.0;
+            if (
+                (latencySummaryInterval > 0.0)
+                && (timeKeeper != nullptr)
+            ) {
+                nextLatencySummaryTime = timeKeeper->GetCurrentTime() + latencySummaryInterval;
+            }
+        }
+
+        /**
+         * This method performs the given Leave action.
+         *
+         * @param[in] action
+         *     This is the action to perform.
+         */
+        void PerformActionLeave(Action&& action) {
+            TWITCH_TIMELINE_ZONE("PerformActionLeave");
+            if (connection == nullptr) {
+                return;
+            }
+            ForgetChannels(action.nickname);
+            OutboundLine line(outboundBatch);
+            line.Append("PART #").Append(action.nickname);
+            SendLineToTwitchServer(*connection, line);
+        }
+
+        /**
+         * This method performs the given SendMessage action.
+         *
+         * @param[in] action
+         *     This is the action to perform.
+         */
+        void PerformActionSendMessage(Action&& action) {
+            TWITCH_TIMELINE_ZONE("PerformActionSendMessage");
+            SendOrHold(std::move(action));
+        }
+
+        /**
+         * This method performs the given SendWhisper action.
+         *
+         * @param[in] action
+         *     This is the action to perform.
+         */
+        void PerformActionSendWhisper(Action&& action) {
+            TWITCH_TIMELINE_ZONE("PerformActionSendWhisper");
+            SendOrHold(std::move(action));
+        }
+
+        /**
+         * This method performs the given ConfigureOutboundQueue action.
+         *
+         * @param[in] action
+         *     This is the action to perform.
+         */
+        void PerformActionConfigureOutboundQueue(Action&& action) {
+            TWITCH_TIMELINE_ZONE("PerformActionConfigureOutboundQueue");
+            outboundQueueConfiguration = action.outboundQueueConfiguration;
+            sendRateLimiter.Configure(
+                outboundQueueConfiguration.rateLimit,
+                outboundQueueConfiguration.rateLimitWindow
+            );
+        }
+
+        /**
+         * This method reports how the given Join, SendMessage, or
+         * SendWhisper action turned out, if the user asked to know.
+         *
+         * @param[in] action
+         *     This is the action whose outcome to report.
+         *
+         * @param[in] outcome
+         *     This is how the action turned out.
+         */
+        void ReportDelivery(
+            const Action& action,
+            DeliveryOutcome outcome
+        ) {
+            if (action.deliveryDelegate != nullptr) {
+                action.deliveryDelegate(outcome);
+            }
+        }
+
+        /**
+         * This method determines whether or not the line for the given
+         * Join, SendMessage, or SendWhisper action can be sent at all
+         * right now, so that an action which can't be sent is dropped
+         * before it's counted against the rate limit.  Only channels
+         * may be joined when logged in anonymously.
+         *
+         * @param[in] action
+         *     This is the action to check.
+         *
+         * @return
+         *     An indication of whether or not the line for the action
+         *     can be sent is returned.
+         */
+        bool CanSendActionLine(const Action& action) {
+            return (
+                (connection != nullptr)
+                && (logOutStage != LogOutStage::Closing)
+                && (
+                    !anonymous
+                    || (action.type == Action::Type::Join)
+                )
+            );
+        }
+
+        /**
+         * This method sends the line to the Twitch server for the given
+         * Join, SendMessage, or SendWhisper action.
+         *
+         * @param[in] action
+         *     This is the action whose line to send.
+         *
+         * @return
+         *     An indication of whether or not the line was sent
+         *     is returned.
+         */
+        bool SendActionLine(const Action& action) {
+            if (!CanSendActionLine(action)) {
+                return false;
+            }
+            OutboundLine line(outboundBatch);
+            switch (action.type) {
+                case Action::Type::Join: {
+                    line.Append("JOIN #").Append(action.nickname);
+                } break;
+
+                case Action::Type::SendWhisper: {
+                    line.Append("PRIVMSG #jtv :.w ").Append(action.nickname).Append(" ").Append(action.message);
+                } break;
+
+                default: {
+                    if (!action.parent.empty()) {
+                        line.AppendTag("reply-parent-msg-id", action.parent);
+                    }
+                    line.Append("PRIVMSG #").Append(action.nickname).Append(" :").Append(action.message);
+                } break;
+            }
+            return SendLineToTwitchServer(*connection, line);
+        }
+
+        /**
+         * This method determines whether or not the given action may be
+         * sent now without going over the rate limit, and if so, counts
+         * it against the limit.  Channel joins aren't counted against
+         * the limit.
+         *
+         * @param[in] action
+         *     This is the action to check.
+         *
+         * @return
+         *     An indication of whether or not the action may be sent now
+         *     is returned.
+         */
+        bool MaySendNow(const Action& action) {
+            if (
+                (action.type == Action::Type::Join)
+                || (timeKeeper == nullptr)
+            ) {
+                return true;
+            }
+            return sendRateLimiter.TryAcquire(timeKeeper->GetCurrentTime());
+        }
+
+        /**
+         * This method determines how the modes of the channel to which
+         * the given action would send a message bear on sending it now.
+         * Only SendMessage actions are affected, and only if the user
+         * isn't a moderator or VIP of the channel.
+         *
+         * @param[in] action
+         *     This is the action to check.
+         *
+         * @return
+         *     How the modes of the channel bear on sending the message
+         *     now is returned.
+         */
+        ChannelSendCheck CheckChannel(const Action& action) {
+            if (action.type != Action::Type::SendMessage) {
+                return ChannelSendCheck::Ready;
+            }
+            ChannelState channelState;
+            {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                const auto state = channelStates.find(action.nickname);
+                if (state == channelStates.end()) {
+                    return ChannelSendCheck::Ready;
+                }
+                channelState = state->second;
             }
+            if (
+                channelState.moderator
+                || channelState.vip
+            ) {
+                return ChannelSendCheck::Ready;
+            }
+            if (
+                channelState.subsOnly
+                && !channelState.subscriber
+            ) {
+                return ChannelSendCheck::Reject;
+            }
+            const auto history = channelSendHistories.find(action.nickname);
+            if (history == channelSendHistories.end()) {
+                return ChannelSendCheck::Ready;
+            }
+            if (
+                channelState.r9k
+                && (history->second.lastMessage == action.message)
+            ) {
+                return ChannelSendCheck::Reject;
+            }
+            if (
+                (channelState.slow > 0)
+                && (timeKeeper != nullptr)
+                && (
+                    timeKeeper->GetCurrentTime()
+                    < history->second.lastSendTime + (double)channelState.slow
+                )
+            ) {
+                return ChannelSendCheck::Wait;
+            }
+            return ChannelSendCheck::Ready;
         }
 
         /**
-         * This method performs the given ServerDisconnected action.
+         * This method sends the line to the Twitch server for the given
+         * Join, SendMessage, or SendWhisper action, and remembers when
+         * and what messages are sent to channels, in order to schedule
+         * more of them.
          *
          * @param[in] action
-         *     This is the action to perform.
+         *     This is the action whose line to send.
+         *
+         * @return
+         *     How the action turned out is returned.
          */
-        void PerformActionServerDisconnected(Action&& action) {
-            Disconnect();
+        DeliveryOutcome SendNow(const Action& action) {
+            if (!SendActionLine(action)) {
+                return DeliveryOutcome::Dropped;
+            }
+            if (action.type == Action::Type::SendMessage) {
+                auto& history = channelSendHistories[action.nickname];
+                history.lastSendTime = (
+                    (timeKeeper == nullptr)
+                    ? 0.0
+                    : timeKeeper->GetCurrentTime()
+                );
+                history.lastMessage = action.message;
+            }
+            return DeliveryOutcome::Sent;
         }
 
         /**
-         * This method performs the given Join action.
+         * This method drops the given action, without sending its line,
+         * because the modes of the channel to which it would send a
+         * message would cause the Twitch server to drop the message.
          *
          * @param[in] action
-         *     This is the action to perform.
+         *     This is the action to drop.
          */
-        void PerformActionJoin(Action&& action) {
-            if (connection == nullptr) {
-                return;
+        void RejectAction(const Action& action) {
+            {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                ++channelStates[action.nickname].messagesRejected;
             }
-            SendLineToTwitchServer(*connection, "JOIN #" + action.nickname);
+            ReportDelivery(action, DeliveryOutcome::Rejected);
         }
 
         /**
-         * This method performs the given Leave action.
+         * This method updates the number of messages held in the
+         * outbound queue for the channel to which the given action would
+         * send a message, if it's a SendMessage action.  The mutex must
+         * be held when calling this method.
          *
          * @param[in] action
-         *     This is the action to perform.
+         *     This is the action added to or removed from the queue.
+         *
+         * @param[in] held
+         *     This indicates whether the action was added to the queue,
+         *     rather than removed from it.
          */
-        void PerformActionLeave(Action&& action) {
-            if (connection == nullptr) {
+        void CountHeldInChannel(
+            const Action& action,
+            bool held
+        ) {
+            if (action.type != Action::Type::SendMessage) {
                 return;
             }
-            SendLineToTwitchServer(*connection, "PART #" + action.nickname);
+            auto& channelState = channelStates[action.nickname];
+            if (held) {
+                ++channelState.messagesQueued;
+            } else if (channelState.messagesQueued > 0) {
+                --channelState.messagesQueued;
+            }
         }
 
         /**
-         * This method performs the given SendMessage action.
+         * This method returns the number of bytes counted against the
+         * limit of the outbound queue for the given action.
+         *
+         * @param[in] action
+         *     This is the action to measure.
+         *
+         * @return
+         *     The number of bytes counted for the action is returned.
+         */
+        static size_t GetHeldBytes(const Action& action) {
+            return (
+                action.nickname.length()
+                + action.message.length()
+                + action.parent.length()
+            );
+        }
+
+        /**
+         * This method sends the line to the Twitch server for the given
+         * Join, SendMessage, or SendWhisper action, if possible, or holds
+         * the action in the outbound queue, if it's set up and has room.
+         * While the queue is set up, messages the Twitch server would drop
+         * because of the modes of the channel to which they're sent are
+         * rejected instead.
          *
          * @param[in] action
          *     This is the action to perform.
          */
-        void PerformActionSendMessage(Action&& action) {
-            if (connection == nullptr) {
+        void SendOrHold(Action&& action) {
+            if (outboundQueueConfiguration.maxMessages == 0) {
+                if (
+                    (connection == nullptr)
+                    || (logOutStage == LogOutStage::Closing)
+                ) {
+                    ReportDelivery(action, DeliveryOutcome::Dropped);
+                } else {
+                    ReportDelivery(action, SendNow(action));
+                }
                 return;
             }
-            if (anonymous) {
+            if (
+                loggedIn
+                && outboundQueue.empty()
+                && CanSendActionLine(action)
+            ) {
+                const auto check = CheckChannel(action);
+                if (check == ChannelSendCheck::Reject) {
+                    RejectAction(action);
+                    return;
+                }
+                if (
+                    (check == ChannelSendCheck::Ready)
+                    && MaySendNow(action)
+                ) {
+                    ReportDelivery(action, SendNow(action));
+                    return;
+                }
+            }
+            const auto bytes = GetHeldBytes(action);
+            bool held = false;
+            {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                if (
+                    (outboundQueue.size() < outboundQueueConfiguration.maxMessages)
+                    && (
+                        (outboundQueueConfiguration.maxBytes == 0)
+                        || (
+                            outboundQueueStatistics.bytes + bytes
+                            <= outboundQueueConfiguration.maxBytes
+                        )
+                    )
+                ) {
+                    held = true;
+                    CountHeldInChannel(action, true);
+                    ++outboundQueueStatistics.messages;
+                    outboundQueueStatistics.bytes += bytes;
+                    outboundQueueStatistics.peakBytes = std::max(
+                        outboundQueueStatistics.peakBytes,
+                        outboundQueueStatistics.bytes
+                    );
+                } else {
+                    ++outboundQueueStatistics.messagesDropped;
+                }
+            }
+            if (!held) {
+                ReportDelivery(action, DeliveryOutcome::Dropped);
                 return;
             }
-            if (action.parent.empty()) {
-                SendLineToTwitchServer(*connection, "PRIVMSG #" + action.nickname + " :" + action.message);
+            const auto maxHoldTime = (
+                (action.maxHoldTime > 0.0)
+                ? action.maxHoldTime
+                : outboundQueueConfiguration.expiration
+            );
+            if (
+                (maxHoldTime > 0.0)
+                && (timeKeeper != nullptr)
+            ) {
+                action.expiration = timeKeeper->GetCurrentTime() + maxHoldTime;
             } else {
-                SendLineToTwitchServer(*connection, "@reply-parent-msg-id=" + action.parent + " PRIVMSG #" + action.nickname + " :" + action.message);
+                action.expiration = 0.0;
             }
+            outboundQueue.push_back(std::move(action));
         }
 
         /**
-         * This method performs the given SendWhisper action.
+         * This method drops all actions held in the outbound queue.
+         */
+        void DropOutboundQueue() {
+            decltype(outboundQueue) actionsDropped;
+            actionsDropped.swap(outboundQueue);
+            {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                outboundQueueStatistics.messagesDropped += actionsDropped.size();
+                outboundQueueStatistics.messages = 0;
+                outboundQueueStatistics.bytes = 0;
+                for (auto& channelState: channelStates) {
+                    channelState.second.messagesQueued = 0;
+                }
+            }
+            for (const auto& action: actionsDropped) {
+                ReportDelivery(action, DeliveryOutcome::Dropped);
+            }
+        }
+
+        /**
+         * This method returns the time at which the first of the messages
+         * held in the outbound queue expires, so that the worker thread
+         * knows how long it may wait while disconnected.
          *
-         * @param[in] action
-         *     This is the action to perform.
+         * @return
+         *     The time at which the first of the messages held in the
+         *     outbound queue expires is returned, or zero if none of them
+         *     expires, or there is no time keeper to tell.
          */
-        void PerformActionSendWhisper(Action&& action) {
-            if (connection == nullptr) {
-                return;
+        double GetEarliestOutboundExpiration() const {
+            if (timeKeeper == nullptr) {
+                return 0.0;
+            }
+            double earliestExpiration = 0.0;
+            for (const auto& action: outboundQueue) {
+                if (
+                    (action.expiration > 0.0)
+                    && (
+                        (earliestExpiration == 0.0)
+                        || (action.expiration < earliestExpiration)
+                    )
+                ) {
+                    earliestExpiration = action.expiration;
+                }
             }
-            if (anonymous) {
+            return earliestExpiration;
+        }
+
+        /**
+         * This method drops any actions held in the outbound queue for
+         * too long, and then, if logged in, sends as many of the rest,
+         * in order, as the rate limit allows.  Messages to channels in
+         * slow mode are passed over until they may be sent, without
+         * holding up the others, messages the Twitch server would
+         * drop are rejected, and messages which can't be sent at all
+         * are dropped without counting them against the rate limit.
+         */
+        void ProcessOutboundQueue() {
+            if (outboundQueue.empty()) {
                 return;
             }
-            SendLineToTwitchServer(*connection, "PRIVMSG #jtv :.w " + action.nickname + " " + action.message);
+            std::vector< Action > actionsExpired;
+            if (timeKeeper != nullptr) {
+                const auto now = timeKeeper->GetCurrentTime();
+                for (
+                    auto it = outboundQueue.begin();
+                    it != outboundQueue.end();
+                ) {
+                    if (
+                        (it->expiration > 0.0)
+                        && (now >= it->expiration)
+                    ) {
+                        actionsExpired.push_back(std::move(*it));
+                        it = outboundQueue.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+            std::vector< std::pair< Action, DeliveryOutcome > > actionsReleased;
+            for (
+                auto it = outboundQueue.begin();
+                (
+                    (it != outboundQueue.end())
+                    && (connection != nullptr)
+                    && loggedIn
+                );
+            ) {
+                if (!CanSendActionLine(*it)) {
+                    actionsReleased.emplace_back(std::move(*it), DeliveryOutcome::Dropped);
+                    it = outboundQueue.erase(it);
+                    continue;
+                }
+                const auto check = CheckChannel(*it);
+                if (check == ChannelSendCheck::Wait) {
+                    ++it;
+                    continue;
+                }
+                if (
+                    (check == ChannelSendCheck::Ready)
+                    && !MaySendNow(*it)
+                ) {
+                    break;
+                }
+                auto action = std::move(*it);
+                it = outboundQueue.erase(it);
+                const auto outcome = (
+                    (check == ChannelSendCheck::Ready)
+                    ? SendNow(action)
+                    : DeliveryOutcome::Rejected
+                );
+                actionsReleased.emplace_back(std::move(action), outcome);
+            }
+            {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                for (const auto& action: actionsExpired) {
+                    CountHeldInChannel(action, false);
+                    --outboundQueueStatistics.messages;
+                    outboundQueueStatistics.bytes -= GetHeldBytes(action);
+                    ++outboundQueueStatistics.messagesExpired;
+                }
+                for (const auto& actionReleased: actionsReleased) {
+                    CountHeldInChannel(actionReleased.first, false);
+                    --outboundQueueStatistics.messages;
+                    outboundQueueStatistics.bytes -= GetHeldBytes(actionReleased.first);
+                    if (actionReleased.second == DeliveryOutcome::Sent) {
+                        ++outboundQueueStatistics.messagesSent;
+                    } else if (actionReleased.second == DeliveryOutcome::Rejected) {
+                        ++channelStates[actionReleased.first.nickname].messagesRejected;
+                    } else {
+                        ++outboundQueueStatistics.messagesDropped;
+                    }
+                }
+            }
+            for (const auto& action: actionsExpired) {
+                ReportDelivery(action, DeliveryOutcome::Expired);
+            }
+            for (const auto& actionReleased: actionsReleased) {
+                ReportDelivery(actionReleased.first, actionReleased.second);
+            }
+        }
+
+        /**
+         * This function runs in the thread of an observer which has one,
+         * delivering the events queued for it.
+         *
+         * @param[in] observer
+         *     This is the observer whose events to deliver.
+         */
+        static void ObserverWorker(std::shared_ptr< Observer > observer) {
+            std::unique_lock< decltype(observer->mutex) > lock(observer->mutex);
+            for (;;) {
+                observer->wakeCondition.wait(
+                    lock,
+                    [observer]{
+                        return (
+                            observer->stop
+                            || !observer->events.empty()
+                        );
+                    }
+                );
+                if (observer->stop) {
+                    break;
+                }
+                const auto event = std::move(observer->events.front());
+                observer->events.pop_front();
+                observer->wakeCondition.notify_all();
+                lock.unlock();
+                observer->delegate(event);
+                lock.lock();
+            }
+        }
+
+        /**
+         * This function stops delivering events to the given observer,
+         * joining its thread if it has one.
+         *
+         * @param[in] observer
+         *     This is the observer to stop.
+         */
+        static void StopObserver(std::shared_ptr< Observer > observer) {
+            {
+                std::lock_guard< decltype(observer->mutex) > lock(observer->mutex);
+                observer->stop = true;
+                observer->wakeCondition.notify_all();
+            }
+            if (observer->thread.joinable()) {
+                if (observer->thread.get_id() == std::this_thread::get_id()) {
+                    observer->thread.detach();
+                } else {
+                    observer->thread.join();
+                }
+            }
         }
 
         /**
@@ -1653,6 +4569,7 @@ namespace Twitch {
             std::lock_guard< decltype(mutex) > lock(mutex);
             stopWorker = true;
             wakeWorker.notify_one();
+            inboundBacklogSpaceAvailable.notify_all();
         }
 
         /**
@@ -1664,20 +4581,52 @@ namespace Twitch {
             while (!stopWorker) {
                 lock.unlock();
                 if (timeKeeper != nullptr) {
+                    TWITCH_TIMELINE_ZONE("Worker::ProcessTimeouts");
                     ProcessTimeouts();
+                    PublishLatencySummaryIfDue();
                 }
                 lock.lock();
-                while (!actionsToBePerformed.empty()) {
-                    auto action = actionsToBePerformed.front();
+                auto actionsThisIteration = actionsToBePerformed.size();
+                while (
+                    (actionsThisIteration-- > 0)
+                    && !actionsToBePerformed.empty()
+                ) {
+                    auto action = std::move(actionsToBePerformed.front());
                     actionsToBePerformed.pop_front();
+                    if (action.type == Action::Type::ProcessMessagesReceived) {
+                        inboundBacklogStatistics.bytes -= GetReceivedLength(action);
+                        inboundBacklogSpaceAvailable.notify_all();
+                    }
                     lock.unlock();
-                    PerformAction(std::move(action));
+                    {
+                        TWITCH_TIMELINE_ZONE("Worker::PerformAction");
+                        PerformAction(std::move(action));
+                    }
                     lock.lock();
                 }
+                lock.unlock();
+                ProcessOutboundQueue();
+                if (connection != nullptr) {
+                    FlushOutboundBatch(*connection);
+                }
+                ProcessLogOut();
+                lock.lock();
                 if (!connection) {
                     actionsAwaitingResponses.clear();
                 }
-                if (!actionsAwaitingResponses.empty()) {
+                if (metricsEnabled.load(std::memory_order_relaxed)) {
+                    actionsAwaiting.store(actionsAwaitingResponses.size(), std::memory_order_relaxed);
+                }
+                const auto outboundExpiration = GetEarliestOutboundExpiration();
+                if (
+                    !actionsAwaitingResponses.empty()
+                    || (latencySummaryInterval > 0.0)
+                    || (
+                        !outboundQueue.empty()
+                        && (connection != nullptr)
+                    )
+                    || (logOutStage != LogOutStage::None)
+                ) {
                     wakeWorker.wait_for(
                         lock,
                         std::chrono::milliseconds(50),
@@ -1688,6 +4637,18 @@ namespace Twitch {
                             );
                         }
                     );
+                } else if (outboundExpiration > 0.0) {
+                    const auto timeToExpiration = outboundExpiration - timeKeeper->GetCurrentTime();
+                    wakeWorker.wait_for(
+                        lock,
+                        std::chrono::duration< double >(std::max(timeToExpiration, 0.0)),
+                        [this]{
+                            return (
+                                stopWorker
+                                || !actionsToBePerformed.empty()
+                            );
+                        }
+                    );
                 } else {
                     wakeWorker.wait(
                         lock,
@@ -1700,12 +4661,25 @@ namespace Twitch {
                     );
                 }
             }
+            lock.unlock();
+            DropOutboundQueue();
         }
     };
 
     Messaging::~Messaging() noexcept {
         impl_->StopWorker();
         impl_->worker.join();
+        impl_->StopTracer();
+        std::shared_ptr< const Impl::Observers > observers;
+        {
+            std::lock_guard< decltype(impl_->observerSet->mutex) > lock(impl_->observerSet->mutex);
+            observers.swap(impl_->observerSet->observers);
+        }
+        if (observers != nullptr) {
+            for (const auto& observer: *observers) {
+                Impl::StopObserver(observer);
+            }
+        }
     }
 
     Messaging::Messaging()
@@ -1721,6 +4695,18 @@ namespace Twitch {
         return impl_->diagnosticsSender.SubscribeToDiagnostics(delegate, minLevel);
     }
 
+    void Messaging::SetAsynchronousLineTracing(size_t capacity) {
+        impl_->StopTracer();
+        std::lock_guard< decltype(impl_->traceMutex) > lock(impl_->traceMutex);
+        impl_->traceQueue.assign(capacity, "");
+        impl_->traceQueueHead = 0;
+        impl_->traceQueueCount = 0;
+        impl_->stopTracer = false;
+        if (capacity > 0) {
+            impl_->tracer = std::thread(&Impl::Tracer, impl_.get());
+        }
+    }
+
     void Messaging::SetConnectionFactory(ConnectionFactory connectionFactory) {
         impl_->connectionFactory = connectionFactory;
     }
@@ -1731,6 +4717,208 @@ namespace Twitch {
 
     void Messaging::SetUser(std::shared_ptr< User > user) {
         impl_->user = user;
+        impl_->userSet = true;
+    }
+
+    auto Messaging::AddObserver(ObserverDelegate delegate) -> RemoveObserverDelegate {
+        return AddObserver(delegate, ObserverConfiguration());
+    }
+
+    auto Messaging::AddObserver(
+        ObserverDelegate delegate,
+        const ObserverConfiguration& configuration
+    ) -> RemoveObserverDelegate {
+        const auto observer = std::make_shared< Impl::Observer >();
+        observer->delegate = delegate;
+        observer->configuration = configuration;
+        if (configuration.ownThread) {
+            observer->thread = std::thread(&Impl::ObserverWorker, observer);
+        }
+        const auto& observerSet = impl_->observerSet;
+        {
+            std::lock_guard< decltype(observerSet->mutex) > lock(observerSet->mutex);
+            const auto observers = std::make_shared< Impl::Observers >();
+            if (observerSet->observers != nullptr) {
+                *observers = *observerSet->observers;
+            }
+            observers->push_back(observer);
+            observerSet->observers = observers;
+        }
+        std::weak_ptr< Impl::ObserverSet > observerSetWeak(observerSet);
+        std::weak_ptr< Impl::Observer > observerWeak(observer);
+        return [observerSetWeak, observerWeak]{
+            const auto observerSet = observerSetWeak.lock();
+            const auto observer = observerWeak.lock();
+            if (
+                (observerSet == nullptr)
+                || (observer == nullptr)
+            ) {
+                return;
+            }
+            {
+                std::lock_guard< decltype(observerSet->mutex) > lock(observerSet->mutex);
+                if (observerSet->observers == nullptr) {
+                    return;
+                }
+                const auto observers = std::make_shared< Impl::Observers >();
+                for (const auto& otherObserver: *observerSet->observers) {
+                    if (otherObserver != observer) {
+                        observers->push_back(otherObserver);
+                    }
+                }
+                if (observers->size() == observerSet->observers->size()) {
+                    return;
+                }
+                if (observers->empty()) {
+                    observerSet->observers = nullptr;
+                } else {
+                    observerSet->observers = observers;
+                }
+            }
+            Impl::StopObserver(observer);
+        };
+    }
+
+    void Messaging::EnableCapabilitiesCache(const std::string& cacheFilePath) {
+        std::set< std::string > caps;
+        if (!cacheFilePath.empty()) {
+            std::ifstream file(cacheFilePath);
+            std::string line;
+            while (std::getline(file, line)) {
+                line = StringExtensions::Trim(line);
+                if (!line.empty()) {
+                    (void)caps.insert(line);
+                }
+            }
+        }
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        impl_->capsCacheEnabled = true;
+        impl_->capsCacheFilePath = cacheFilePath;
+        impl_->capsCached = std::move(caps);
+    }
+
+    auto Messaging::GetLastHandshakeInfo() -> HandshakeInfo {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        return impl_->lastHandshake;
+    }
+
+    void Messaging::ConfigureInboundBacklog(const InboundBacklogConfiguration& configuration) {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        impl_->inboundBacklogConfiguration = configuration;
+        impl_->inboundBacklogSpaceAvailable.notify_all();
+    }
+
+    auto Messaging::GetInboundBacklogStatistics() -> InboundBacklogStatistics {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        return impl_->inboundBacklogStatistics;
+    }
+
+    void Messaging::ConfigureOutboundQueue(const OutboundQueueConfiguration& configuration) {
+        Action action;
+        action.type = Action::Type::ConfigureOutboundQueue;
+        action.outboundQueueConfiguration = configuration;
+        impl_->PostAction(std::move(action));
+    }
+
+    auto Messaging::GetOutboundQueueStatistics() -> OutboundQueueStatistics {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        return impl_->outboundQueueStatistics;
+    }
+
+    auto Messaging::GetChannelState(const std::string& channel) -> ChannelState {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        const auto channelState = impl_->channelStates.find(channel);
+        if (channelState == impl_->channelStates.end()) {
+            return ChannelState();
+        }
+        return channelState->second;
+    }
+
+    void Messaging::SetEventInterests(EventMask events) {
+        Action action;
+        action.type = Action::Type::SetEventInterests;
+        action.events = events;
+        impl_->PostAction(std::move(action));
+    }
+
+    void Messaging::SetChannelSampling(
+        const std::string& channel,
+        const ChannelSampling& sampling
+    ) {
+        Action action;
+        action.type = Action::Type::SetChannelSampling;
+        action.nickname = channel;
+        action.sampling = sampling;
+        impl_->PostAction(std::move(action));
+    }
+
+    void Messaging::ClearChannelSampling(const std::string& channel) {
+        Action action;
+        action.type = Action::Type::ClearChannelSampling;
+        action.nickname = channel;
+        impl_->PostAction(std::move(action));
+    }
+
+    void Messaging::SetTrafficRecorder(std::shared_ptr< TrafficRecorder > trafficRecorder) {
+        Action action;
+        action.type = Action::Type::SetTrafficRecorder;
+        action.trafficRecorder = trafficRecorder;
+        impl_->PostAction(std::move(action));
+    }
+
+    void Messaging::EnableMetrics(bool enable) {
+        impl_->metricsEnabled = enable;
+    }
+
+    auto Messaging::GetMetrics() -> Metrics {
+        Metrics metrics;
+        metrics.enabled = impl_->metricsEnabled;
+        metrics.bytesReceived = impl_->bytesReceived;
+        metrics.bytesSent = impl_->bytesSent;
+        metrics.linesReceived = impl_->linesReceived;
+        metrics.linesSent = impl_->linesSent;
+        metrics.sends = impl_->sends;
+        metrics.commands = impl_->commandCounters.GetSnapshot();
+        metrics.parseTime = impl_->parseTime.GetSnapshot();
+        metrics.queueWaitTime = impl_->queueWaitTime.GetSnapshot();
+        metrics.handlerTime = impl_->handlerTime.GetSnapshot();
+        metrics.endToEndTime = impl_->endToEndTime.GetSnapshot();
+        metrics.serverLag = impl_->serverLag.GetSnapshot();
+        {
+            std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+            metrics.actionsQueued = impl_->actionsToBePerformed.size();
+        }
+        metrics.peakActionsQueued = impl_->peakActionsQueued;
+        metrics.actionsAwaitingResponses = impl_->actionsAwaiting;
+        metrics.timeoutsFired = impl_->timeoutsFired;
+        {
+            std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+            metrics.outboundQueued = impl_->outboundQueueStatistics.messages;
+            metrics.outboundQueuedBytes = impl_->outboundQueueStatistics.bytes;
+            metrics.outboundExpired = impl_->outboundQueueStatistics.messagesExpired;
+            metrics.outboundDropped = impl_->outboundQueueStatistics.messagesDropped;
+        }
+        return metrics;
+    }
+
+    void Messaging::SetLatencySummaryInterval(double interval) {
+        Action action;
+        action.type = Action::Type::SetLatencySummaryInterval;
+        action.interval = interval;
+        impl_->PostAction(std::move(action));
+    }
+
+    std::string Messaging::GetMetricsText() {
+        return FormatMetrics(GetMetrics());
+    }
+
+    bool Messaging::WriteMetrics(const std::string& filePath) {
+        std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+        file << GetMetricsText();
+        return (bool)file;
     }
 
     void Messaging::LogIn(
@@ -1757,9 +4945,17 @@ namespace Twitch {
     }
 
     void Messaging::LogOut(const std::string& farewell) {
+        LogOut(farewell, 0.0);
+    }
+
+    void Messaging::LogOut(
+        const std::string& farewell,
+        double deadline
+    ) {
         Action action;
         action.type = Action::Type::LogOut;
         action.message = farewell;
+        action.deadline = deadline;
         impl_->PostAction(std::move(action));
     }
 
@@ -1780,11 +4976,21 @@ namespace Twitch {
     void Messaging::SendMessage(
         const std::string& channel,
         const std::string& message
+    ) {
+        SendMessage(channel, message, SendOptions());
+    }
+
+    void Messaging::SendMessage(
+        const std::string& channel,
+        const std::string& message,
+        const SendOptions& options
     ) {
         Action action;
         action.type = Action::Type::SendMessage;
         action.nickname = channel;
         action.message = message;
+        action.maxHoldTime = options.expiration;
+        action.deliveryDelegate = options.deliveryDelegate;
         impl_->PostAction(std::move(action));
     }
 
@@ -1792,23 +4998,44 @@ namespace Twitch {
         const std::string& channel,
         const std::string& message,
         const std::string& parent
+    ) {
+        SendResponse(channel, message, parent, SendOptions());
+    }
+
+    void Messaging::SendResponse(
+        const std::string& channel,
+        const std::string& message,
+        const std::string& parent,
+        const SendOptions& options
     ) {
         Action action;
         action.type = Action::Type::SendMessage;
         action.nickname = channel;
         action.message = message;
         action.parent = parent;
+        action.maxHoldTime = options.expiration;
+        action.deliveryDelegate = options.deliveryDelegate;
         impl_->PostAction(std::move(action));
     }
 
     void Messaging::SendWhisper(
         const std::string& nickname,
         const std::string& message
+    ) {
+        SendWhisper(nickname, message, SendOptions());
+    }
+
+    void Messaging::SendWhisper(
+        const std::string& nickname,
+        const std::string& message,
+        const SendOptions& options
     ) {
         Action action;
         action.type = Action::Type::SendWhisper;
         action.nickname = nickname;
         action.message = message;
+        action.maxHoldTime = options.expiration;
+        action.deliveryDelegate = options.deliveryDelegate;
         impl_->PostAction(std::move(action));
     }
 
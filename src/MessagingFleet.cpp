@@ -0,0 +1,653 @@
+/**
+ * @file MessagingFleet.cpp
+ *
+ * This module contains the implementation of the
+ * Twitch::MessagingFleet class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <Twitch/MessagingFleet.hpp>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the time keeper used by the fleet when none is provided.
+     * It measures time with a monotonic clock.
+     */
+    struct SteadyTimeKeeper
+        : public Twitch::TimeKeeper
+    {
+        // Twitch::TimeKeeper
+
+        virtual double GetCurrentTime() override {
+            return std::chrono::duration< double >(
+                std::chrono::steady_clock::now().time_since_epoch()
+            ).count();
+        }
+    };
+
+    /**
+     * This function returns the sample at the given percentile of the given
+     * sorted samples, using the nearest-rank method.
+     *
+     * @param[in] sortedSamples
+     *     These are the samples, in ascending order.
+     *
+     * @param[in] percentile
+     *     This is the percentile, from 0 to 100, of the sample to return.
+     *
+     * @return
+     *     The sample at the given percentile is returned.
+     */
+    double Percentile(
+        const std::vector< double >& sortedSamples,
+        double percentile
+    ) {
+        auto rank = (size_t)ceil(percentile / 100.0 * sortedSamples.size());
+        if (rank > 0) {
+            --rank;
+        }
+        return sortedSamples[std::min(rank, sortedSamples.size() - 1)];
+    }
+
+    /**
+     * This function summarizes the given latency samples.
+     *
+     * @param[in] samples
+     *     These are the latency samples to summarize.
+     *
+     * @return
+     *     A summary of the given latency samples is returned.
+     */
+    Twitch::MessagingFleet::LatencyHistogram Summarize(std::vector< double > samples) {
+        Twitch::MessagingFleet::LatencyHistogram histogram;
+        histogram.count = samples.size();
+        if (samples.empty()) {
+            return histogram;
+        }
+        std::sort(samples.begin(), samples.end());
+        histogram.minimum = samples.front();
+        histogram.p50 = Percentile(samples, 50.0);
+        histogram.p90 = Percentile(samples, 90.0);
+        histogram.p99 = Percentile(samples, 99.0);
+        histogram.maximum = samples.back();
+        return histogram;
+    }
+
+}
+
+namespace Twitch {
+
+    /**
+     * This contains the private properties of a MessagingFleet instance.
+     */
+    struct MessagingFleet::Impl {
+        // Types
+
+        /**
+         * These are the states an account in the fleet can be in.
+         */
+        enum class State {
+            /**
+             * The log-in for the account hasn't started yet.
+             */
+            Waiting,
+
+            /**
+             * The log-in for the account is in progress.
+             */
+            InFlight,
+
+            /**
+             * The account is logged in.
+             */
+            LoggedIn,
+
+            /**
+             * The account failed to log in, or was logged out.
+             */
+            Failed,
+        };
+
+        /**
+         * This holds everything the fleet knows about one of its accounts.
+         */
+        struct Member {
+            /**
+             * This holds everything needed to log the account into Twitch
+             * chat.
+             */
+            Account account;
+
+            /**
+             * This is the state the account is in.
+             */
+            State state = State::Waiting;
+
+            /**
+             * This is the time, according to the time keeper, at which the
+             * log-in for the account was started.
+             */
+            double logInStartTime = 0.0;
+
+            /**
+             * This flag indicates whether or not a message has been received
+             * in a channel since the log-in for the account was started.
+             */
+            bool firstMessageReceived = false;
+
+            /**
+             * This is the Messaging instance used for the account.
+             */
+            std::unique_ptr< Messaging > messaging;
+        };
+
+        /**
+         * This is the user given to the Messaging instance of each account.
+         * It tracks the progress of the account for the fleet and passes
+         * every callback along to the user provided with the account,
+         * if any.
+         */
+        class MemberUser
+            : public Messaging::User
+        {
+        public:
+            // Lifecycle management
+
+            MemberUser(
+                Impl* fleet,
+                Member* member
+            )
+                : fleet_(fleet)
+                , member_(member)
+                , user_(member->account.user)
+            {
+                if (user_ == nullptr) {
+                    user_ = std::make_shared< Messaging::User >();
+                }
+            }
+
+            // Messaging::User
+
+            virtual void Doom() override {
+                user_->Doom();
+            }
+
+            virtual void LogIn() override {
+                fleet_->OnLogIn(member_);
+                for (const auto& channel: member_->account.channels) {
+                    member_->messaging->Join(channel);
+                }
+                user_->LogIn();
+            }
+
+            virtual void LogOut() override {
+                fleet_->OnLogOut(member_);
+                user_->LogOut();
+            }
+
+            virtual void Join(Messaging::MembershipInfo&& membershipInfo) override {
+                user_->Join(std::move(membershipInfo));
+            }
+
+            virtual void Leave(Messaging::MembershipInfo&& membershipInfo) override {
+                user_->Leave(std::move(membershipInfo));
+            }
+
+            virtual void NameList(Messaging::NameListInfo&& nameListInfo) override {
+                user_->NameList(std::move(nameListInfo));
+            }
+
+            virtual void Message(Messaging::MessageInfo&& messageInfo) override {
+                fleet_->OnMessage(member_);
+                user_->Message(std::move(messageInfo));
+            }
+
+            virtual void RawMessage(const Messaging::RawMessageInfo& rawMessageInfo) override {
+                user_->RawMessage(rawMessageInfo);
+            }
+
+            virtual void Messages(std::vector< Messaging::MessageInfo >&& messageInfos) override {
+                fleet_->OnMessage(member_);
+                user_->Messages(std::move(messageInfos));
+            }
+
+            virtual void PrivateMessage(Messaging::MessageInfo&& messageInfo) override {
+                user_->PrivateMessage(std::move(messageInfo));
+            }
+
+            virtual void Whisper(Messaging::WhisperInfo&& whisperInfo) override {
+                user_->Whisper(std::move(whisperInfo));
+            }
+
+            virtual void Notice(Messaging::NoticeInfo&& noticeInfo) override {
+                user_->Notice(std::move(noticeInfo));
+            }
+
+            virtual void Host(Messaging::HostInfo&& hostInfo) override {
+                user_->Host(std::move(hostInfo));
+            }
+
+            virtual void RoomModeChange(Messaging::RoomModeChangeInfo&& roomModeChangeInfo) override {
+                user_->RoomModeChange(std::move(roomModeChangeInfo));
+            }
+
+            virtual void Clear(Messaging::ClearInfo&& clearInfo) override {
+                user_->Clear(std::move(clearInfo));
+            }
+
+            virtual void Mod(Messaging::ModInfo&& modInfo) override {
+                user_->Mod(std::move(modInfo));
+            }
+
+            virtual void UserState(Messaging::UserStateInfo&& userStateInfo) override {
+                user_->UserState(std::move(userStateInfo));
+            }
+
+            virtual void Sub(Messaging::SubInfo&& subInfo) override {
+                user_->Sub(std::move(subInfo));
+            }
+
+            virtual void Raid(Messaging::RaidInfo&& raidInfo) override {
+                user_->Raid(std::move(raidInfo));
+            }
+
+            virtual void Ritual(Messaging::RitualInfo&& ritualInfo) override {
+                user_->Ritual(std::move(ritualInfo));
+            }
+
+        private:
+            // Properties
+
+            /**
+             * This is the fleet to which the account belongs.
+             */
+            Impl* fleet_;
+
+            /**
+             * This is the account whose callbacks are handled.
+             */
+            Member* member_;
+
+            /**
+             * This is the user provided with the account, or a user which
+             * does nothing if none was provided.
+             */
+            std::shared_ptr< Messaging::User > user_;
+        };
+
+        // Properties
+
+        /**
+         * This is used to synchronize access to the object.
+         */
+        std::mutex mutex;
+
+        /**
+         * This is a helper object used to generate and publish
+         * diagnostic messages.
+         */
+        SystemAbstractions::DiagnosticsSender diagnosticsSender;
+
+        /**
+         * This is the function to call in order to make a new
+         * connection to the Twitch server.
+         */
+        Messaging::ConnectionFactory connectionFactory;
+
+        /**
+         * This is the object to use to measure elapsed time periods.
+         */
+        std::shared_ptr< TimeKeeper > timeKeeper = std::make_shared< SteadyTimeKeeper >();
+
+        /**
+         * These are the limits the fleet observes when logging in accounts.
+         */
+        Configuration configuration;
+
+        /**
+         * These are all the accounts in the fleet, in the order they
+         * were given.
+         */
+        std::vector< std::unique_ptr< Member > > members;
+
+        /**
+         * These are the accounts whose log-ins haven't started yet,
+         * in the order in which they should be started.
+         */
+        std::deque< Member* > waiting;
+
+        /**
+         * These are the times, according to the time keeper, at which
+         * log-ins were started within the current rate limit window.
+         */
+        std::deque< double > logInStartTimes;
+
+        /**
+         * This is the number of log-ins in progress.
+         */
+        size_t inFlight = 0;
+
+        /**
+         * This is the number of accounts which are logged in.
+         */
+        size_t loggedIn = 0;
+
+        /**
+         * This is the number of accounts which failed to log in, or were
+         * logged out.
+         */
+        size_t failed = 0;
+
+        /**
+         * These are the times taken from starting each log-in to being
+         * logged in.
+         */
+        std::vector< double > timeToLogInSamples;
+
+        /**
+         * These are the times taken from starting each log-in to receiving
+         * the first message in a channel.
+         */
+        std::vector< double > timeToFirstMessageSamples;
+
+        /**
+         * This is used to signal the worker thread to wake up.
+         */
+        std::condition_variable wakeWorker;
+
+        /**
+         * This flag indicates whether or not the worker thread
+         * should be stopped.
+         */
+        bool stopWorker = false;
+
+        /**
+         * This is used to start log-ins in the background.
+         */
+        std::thread worker;
+
+        // Methods
+
+        /**
+         * This is the constructor for the structure.
+         */
+        Impl()
+            : diagnosticsSender("MessagingFleet")
+        {
+        }
+
+        /**
+         * This method is called when an account has logged in.
+         *
+         * @param[in] member
+         *     This is the account which logged in.
+         */
+        void OnLogIn(Member* member) {
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            if (member->state != State::InFlight) {
+                return;
+            }
+            member->state = State::LoggedIn;
+            --inFlight;
+            ++loggedIn;
+            timeToLogInSamples.push_back(
+                timeKeeper->GetCurrentTime() - member->logInStartTime
+            );
+            wakeWorker.notify_one();
+        }
+
+        /**
+         * This method is called when an account has logged out, or failed
+         * to log in.
+         *
+         * @param[in] member
+         *     This is the account which logged out.
+         */
+        void OnLogOut(Member* member) {
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            if (member->state == State::InFlight) {
+                --inFlight;
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                    "Log-in failed for '%s'",
+                    member->account.nickname.c_str()
+                );
+            } else if (member->state == State::LoggedIn) {
+                --loggedIn;
+            } else {
+                return;
+            }
+            member->state = State::Failed;
+            ++failed;
+            wakeWorker.notify_one();
+        }
+
+        /**
+         * This method is called when an account has received a message
+         * in a channel.
+         *
+         * @param[in] member
+         *     This is the account which received the message.
+         */
+        void OnMessage(Member* member) {
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            if (member->firstMessageReceived) {
+                return;
+            }
+            member->firstMessageReceived = true;
+            timeToFirstMessageSamples.push_back(
+                timeKeeper->GetCurrentTime() - member->logInStartTime
+            );
+        }
+
+        /**
+         * This method starts as many waiting log-ins as the configured
+         * limits allow.
+         *
+         * @param[in,out] lock
+         *     This is the lock held on the object's mutex, which is
+         *     released while log-ins are being started.
+         */
+        void StartLogIns(std::unique_lock< decltype(mutex) >& lock) {
+            const auto now = timeKeeper->GetCurrentTime();
+            while (
+                !logInStartTimes.empty()
+                && (now - logInStartTimes.front() >= configuration.rateLimitWindow)
+            ) {
+                logInStartTimes.pop_front();
+            }
+            std::vector< Member* > logInsToStart;
+            while (
+                !waiting.empty()
+                && (inFlight < configuration.maxLogInsInFlight)
+                && (logInStartTimes.size() < configuration.maxLogInsPerWindow)
+            ) {
+                const auto member = waiting.front();
+                waiting.pop_front();
+                member->state = State::InFlight;
+                member->logInStartTime = now;
+                member->firstMessageReceived = false;
+                ++inFlight;
+                logInStartTimes.push_back(now);
+                logInsToStart.push_back(member);
+            }
+            if (logInsToStart.empty()) {
+                return;
+            }
+            lock.unlock();
+            for (const auto member: logInsToStart) {
+                member->messaging->LogIn(
+                    member->account.nickname,
+                    member->account.token
+                );
+            }
+            lock.lock();
+        }
+
+        /**
+         * This method determines whether or not there are log-ins waiting
+         * which the limit on log-ins in progress would allow to be started.
+         *
+         * @return
+         *     An indication of whether or not there are log-ins waiting
+         *     which the limit on log-ins in progress would allow to be
+         *     started is returned.
+         */
+        bool CanStartLogIns() const {
+            return (
+                !waiting.empty()
+                && (inFlight < configuration.maxLogInsInFlight)
+            );
+        }
+
+        /**
+         * This runs in its own thread and starts log-ins for the fleet.
+         */
+        void Worker() {
+            std::unique_lock< decltype(mutex) > lock(mutex);
+            while (!stopWorker) {
+                StartLogIns(lock);
+                if (CanStartLogIns()) {
+                    // Only the rate limit can be holding back log-ins now,
+                    // unless some completed while they were being started.
+                    if (logInStartTimes.size() < configuration.maxLogInsPerWindow) {
+                        continue;
+                    }
+                    wakeWorker.wait_for(
+                        lock,
+                        std::chrono::milliseconds(50),
+                        [this]{ return stopWorker; }
+                    );
+                } else {
+                    wakeWorker.wait(
+                        lock,
+                        [this]{
+                            return (
+                                stopWorker
+                                || CanStartLogIns()
+                            );
+                        }
+                    );
+                }
+            }
+        }
+    };
+
+    MessagingFleet::~MessagingFleet() noexcept {
+        std::vector< std::unique_ptr< Impl::Member > > members;
+        {
+            std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+            impl_->stopWorker = true;
+            impl_->wakeWorker.notify_one();
+            members.swap(impl_->members);
+        }
+        impl_->worker.join();
+        members.clear();
+    }
+
+    MessagingFleet::MessagingFleet()
+        : impl_(new Impl())
+    {
+        impl_->worker = std::thread(&Impl::Worker, impl_.get());
+    }
+
+    SystemAbstractions::DiagnosticsSender::UnsubscribeDelegate MessagingFleet::SubscribeToDiagnostics(
+        SystemAbstractions::DiagnosticsSender::DiagnosticMessageDelegate delegate,
+        size_t minLevel
+    ) {
+        return impl_->diagnosticsSender.SubscribeToDiagnostics(delegate, minLevel);
+    }
+
+    void MessagingFleet::SetConnectionFactory(Messaging::ConnectionFactory connectionFactory) {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        impl_->connectionFactory = connectionFactory;
+    }
+
+    void MessagingFleet::SetTimeKeeper(std::shared_ptr< TimeKeeper > timeKeeper) {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        impl_->timeKeeper = timeKeeper;
+    }
+
+    void MessagingFleet::Configure(const Configuration& configuration) {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        impl_->configuration = configuration;
+        impl_->wakeWorker.notify_one();
+    }
+
+    void MessagingFleet::LogIn(const std::vector< Account >& accounts) {
+        std::unique_lock< decltype(impl_->mutex) > lock(impl_->mutex);
+        const auto connectionFactory = impl_->connectionFactory;
+        const auto timeKeeper = impl_->timeKeeper;
+        lock.unlock();
+        std::vector< std::unique_ptr< Impl::Member > > newMembers;
+        newMembers.reserve(accounts.size());
+        for (const auto& account: accounts) {
+            std::unique_ptr< Impl::Member > member(new Impl::Member());
+            member->account = account;
+            member->messaging.reset(new Messaging());
+            member->messaging->SetConnectionFactory(connectionFactory);
+            member->messaging->SetTimeKeeper(timeKeeper);
+            member->messaging->SetUser(
+                std::make_shared< Impl::MemberUser >(impl_.get(), member.get())
+            );
+            newMembers.push_back(std::move(member));
+        }
+        lock.lock();
+        for (auto& member: newMembers) {
+            impl_->waiting.push_back(member.get());
+            impl_->members.push_back(std::move(member));
+        }
+        impl_->wakeWorker.notify_one();
+    }
+
+    void MessagingFleet::LogOut(const std::string& farewell) {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        for (const auto& member: impl_->members) {
+            if (member->state == Impl::State::Waiting) {
+                member->state = Impl::State::Failed;
+                ++impl_->failed;
+            } else {
+                member->messaging->LogOut(farewell);
+            }
+        }
+        impl_->waiting.clear();
+    }
+
+    auto MessagingFleet::GetProgress() -> Progress {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        Progress progress;
+        progress.total = impl_->members.size();
+        progress.waiting = impl_->waiting.size();
+        progress.inFlight = impl_->inFlight;
+        progress.loggedIn = impl_->loggedIn;
+        progress.failed = impl_->failed;
+        return progress;
+    }
+
+    auto MessagingFleet::GetReport() -> Report {
+        Report report;
+        report.progress = GetProgress();
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        report.timeToLogIn = Summarize(impl_->timeToLogInSamples);
+        report.timeToFirstMessage = Summarize(impl_->timeToFirstMessageSamples);
+        return report;
+    }
+
+    Messaging& MessagingFleet::GetMessaging(size_t index) {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        return *impl_->members[index]->messaging;
+    }
+
+}
@@ -0,0 +1,280 @@
+/**
+ * @file Metrics.cpp
+ *
+ * This module contains the implementation of the Twitch::Histogram and
+ * Twitch::CommandCounters classes and the Twitch::FormatMetrics function.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+
+namespace {
+
+    /**
+     * This is the number of bits of each value used to pick which of the
+     * buckets covering the value's power of two counts the value.
+     */
+    constexpr size_t SUB_BUCKET_BITS = 4;
+
+    /**
+     * This is the number of buckets covering each power of two.
+     */
+    constexpr size_t SUB_BUCKETS = ((size_t)1 << SUB_BUCKET_BITS);
+
+    /**
+     * This function returns the position of the highest bit set
+     * in the given value.
+     *
+     * @param[in] value
+     *     This is the value to examine.  It must not be zero.
+     *
+     * @return
+     *     The position of the highest bit set in the given value
+     *     is returned.
+     */
+    size_t HighestBit(uint64_t value) {
+        size_t bit = 0;
+        for (size_t shift = 32; shift > 0; shift >>= 1) {
+            if ((value >> shift) != 0) {
+                value >>= shift;
+                bit += shift;
+            }
+        }
+        return bit;
+    }
+
+    /**
+     * This function formats the given number of nanoseconds
+     * as a number of seconds.
+     *
+     * @param[in] nanoseconds
+     *     This is the number of nanoseconds to format.
+     *
+     * @return
+     *     The given number of nanoseconds, formatted as a number of
+     *     seconds, is returned.
+     */
+    std::string FormatSeconds(uint64_t nanoseconds) {
+        char buffer[32];
+        (void)snprintf(buffer, sizeof(buffer), "%.9g", (double)nanoseconds / 1e9);
+        return buffer;
+    }
+
+    /**
+     * This function appends to the given output the Prometheus text
+     * format lines for the given histogram of durations in nanoseconds.
+     *
+     * @param[in,out] output
+     *     This is the text to which to append the lines.
+     *
+     * @param[in] name
+     *     This is the name of the metric.
+     *
+     * @param[in] labels
+     *     These are any labels to put on every line, separated by commas,
+     *     or an empty string if there are none.
+     *
+     * @param[in] histogram
+     *     This is the histogram to format.
+     */
+    void FormatHistogram(
+        std::string& output,
+        const std::string& name,
+        const std::string& labels,
+        const Twitch::Messaging::HistogramSnapshot& histogram
+    ) {
+        const auto separator = (labels.empty() ? "" : ",");
+        uint64_t cumulativeCount = 0;
+        for (const auto& bucket: histogram.buckets) {
+            cumulativeCount += bucket.second;
+            output += (
+                name + "_bucket{" + labels + separator
+                + "le=\"" + FormatSeconds(bucket.first) + "\"} "
+                + std::to_string(cumulativeCount) + "\n"
+            );
+        }
+        output += (
+            name + "_bucket{" + labels + separator + "le=\"+Inf\"} "
+            + std::to_string(histogram.count) + "\n"
+        );
+        const auto labelsPart = (labels.empty() ? "" : "{" + labels + "}");
+        output += name + "_sum" + labelsPart + " " + FormatSeconds(histogram.sum) + "\n";
+        output += name + "_count" + labelsPart + " " + std::to_string(histogram.count) + "\n";
+    }
+
+}
+
+namespace Twitch {
+
+    uint64_t Messaging::HistogramSnapshot::GetPercentile(double percentile) const {
+        if (count == 0) {
+            return 0;
+        }
+        const auto target = std::max(
+            (uint64_t)1,
+            (uint64_t)ceil((double)count * percentile / 100.0)
+        );
+        uint64_t cumulativeCount = 0;
+        for (const auto& bucket: buckets) {
+            cumulativeCount += bucket.second;
+            if (cumulativeCount >= target) {
+                return std::min(bucket.first, max);
+            }
+        }
+        return max;
+    }
+
+    constexpr size_t Histogram::NUM_BUCKETS;
+
+    Histogram::Histogram()
+        : count_(0)
+        , sum_(0)
+        , min_(UINT64_MAX)
+        , max_(0)
+    {
+        for (auto& bucket: buckets_) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void Histogram::Record(uint64_t value) {
+        (void)buckets_[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        (void)sum_.fetch_add(value, std::memory_order_relaxed);
+        if (value < min_.load(std::memory_order_relaxed)) {
+            min_.store(value, std::memory_order_relaxed);
+        }
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+        (void)count_.fetch_add(1, std::memory_order_release);
+    }
+
+    Messaging::HistogramSnapshot Histogram::GetSnapshot() const {
+        Messaging::HistogramSnapshot snapshot;
+        snapshot.count = count_.load(std::memory_order_acquire);
+        if (snapshot.count == 0) {
+            return snapshot;
+        }
+        snapshot.sum = sum_.load(std::memory_order_relaxed);
+        snapshot.min = min_.load(std::memory_order_relaxed);
+        snapshot.max = max_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+            const auto bucketCount = buckets_[i].load(std::memory_order_relaxed);
+            if (bucketCount > 0) {
+                snapshot.buckets.emplace_back(GetBucketUpperBound(i), bucketCount);
+            }
+        }
+        return snapshot;
+    }
+
+    size_t Histogram::GetBucketIndex(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return (size_t)value;
+        }
+        const auto highestBit = HighestBit(value);
+        const auto subBucket = (size_t)((value >> (highestBit - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+        const auto index = (highestBit - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + subBucket;
+        return std::min(index, NUM_BUCKETS - 1);
+    }
+
+    uint64_t Histogram::GetBucketUpperBound(size_t index) {
+        if (index < SUB_BUCKETS) {
+            return (uint64_t)index;
+        }
+        const auto shift = index / SUB_BUCKETS - 1;
+        const auto subBucket = index % SUB_BUCKETS;
+        const auto lowerBound = ((uint64_t)(SUB_BUCKETS + subBucket) << shift);
+        return lowerBound + ((uint64_t)1 << shift) - 1;
+    }
+
+    auto CommandCounters::Get(const std::string& command) -> Counters& {
+        auto counters = counters_.find(command);
+        if (counters != counters_.end()) {
+            return *counters->second;
+        }
+        std::lock_guard< decltype(mutex_) > lock(mutex_);
+        if (counters_.size() >= MAX_COMMANDS) {
+            auto& other = counters_["other"];
+            if (other == nullptr) {
+                other.reset(new Counters());
+            }
+            return *other;
+        }
+        auto& newCounters = counters_[command];
+        newCounters.reset(new Counters());
+        return *newCounters;
+    }
+
+    std::map< std::string, Messaging::CommandMetrics > CommandCounters::GetSnapshot() {
+        std::lock_guard< decltype(mutex_) > lock(mutex_);
+        std::map< std::string, Messaging::CommandMetrics > snapshot;
+        for (const auto& counters: counters_) {
+            auto& commandMetrics = snapshot[counters.first];
+            commandMetrics.linesReceived = counters.second->linesReceived.load(std::memory_order_relaxed);
+            commandMetrics.handlerTime = counters.second->handlerTime.GetSnapshot();
+        }
+        return snapshot;
+    }
+
+    std::string FormatMetrics(const Messaging::Metrics& metrics) {
+        std::string output;
+        output += "# TYPE twitch_bytes_received_total counter\n";
+        output += "twitch_bytes_received_total " + std::to_string(metrics.bytesReceived) + "\n";
+        output += "# TYPE twitch_bytes_sent_total counter\n";
+        output += "twitch_bytes_sent_total " + std::to_string(metrics.bytesSent) + "\n";
+        output += "# TYPE twitch_lines_sent_total counter\n";
+        output += "twitch_lines_sent_total " + std::to_string(metrics.linesSent) + "\n";
+        output += "# TYPE twitch_sends_total counter\n";
+        output += "twitch_sends_total " + std::to_string(metrics.sends) + "\n";
+        output += "# TYPE twitch_lines_received_total counter\n";
+        for (const auto& command: metrics.commands) {
+            output += (
+                "twitch_lines_received_total{command=\"" + command.first + "\"} "
+                + std::to_string(command.second.linesReceived) + "\n"
+            );
+        }
+        output += "# TYPE twitch_parse_seconds histogram\n";
+        FormatHistogram(output, "twitch_parse_seconds", "", metrics.parseTime);
+        output += "# TYPE twitch_queue_wait_seconds histogram\n";
+        FormatHistogram(output, "twitch_queue_wait_seconds", "", metrics.queueWaitTime);
+        output += "# TYPE twitch_end_to_end_seconds histogram\n";
+        FormatHistogram(output, "twitch_end_to_end_seconds", "", metrics.endToEndTime);
+        output += "# TYPE twitch_server_lag_seconds histogram\n";
+        FormatHistogram(output, "twitch_server_lag_seconds", "", metrics.serverLag);
+        output += "# TYPE twitch_all_handlers_seconds histogram\n";
+        FormatHistogram(output, "twitch_all_handlers_seconds", "", metrics.handlerTime);
+        output += "# TYPE twitch_handler_seconds histogram\n";
+        for (const auto& command: metrics.commands) {
+            FormatHistogram(
+                output,
+                "twitch_handler_seconds",
+                "command=\"" + command.first + "\"",
+                command.second.handlerTime
+            );
+        }
+        output += "# TYPE twitch_actions_queued gauge\n";
+        output += "twitch_actions_queued " + std::to_string(metrics.actionsQueued) + "\n";
+        output += "# TYPE twitch_actions_queued_peak gauge\n";
+        output += "twitch_actions_queued_peak " + std::to_string(metrics.peakActionsQueued) + "\n";
+        output += "# TYPE twitch_actions_awaiting_responses gauge\n";
+        output += "twitch_actions_awaiting_responses " + std::to_string(metrics.actionsAwaitingResponses) + "\n";
+        output += "# TYPE twitch_timeouts_total counter\n";
+        output += "twitch_timeouts_total " + std::to_string(metrics.timeoutsFired) + "\n";
+        output += "# TYPE twitch_outbound_queued gauge\n";
+        output += "twitch_outbound_queued " + std::to_string(metrics.outboundQueued) + "\n";
+        output += "# TYPE twitch_outbound_queued_bytes gauge\n";
+        output += "twitch_outbound_queued_bytes " + std::to_string(metrics.outboundQueuedBytes) + "\n";
+        output += "# TYPE twitch_outbound_expired_total counter\n";
+        output += "twitch_outbound_expired_total " + std::to_string(metrics.outboundExpired) + "\n";
+        output += "# TYPE twitch_outbound_dropped_total counter\n";
+        output += "twitch_outbound_dropped_total " + std::to_string(metrics.outboundDropped) + "\n";
+        return output;
+    }
+
+}
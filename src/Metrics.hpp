@@ -0,0 +1,217 @@
+#ifndef TWITCH_METRICS_HPP
+#define TWITCH_METRICS_HPP
+
+/**
+ * @file Metrics.hpp
+ *
+ * This module declares the Twitch::Histogram and Twitch::CommandCounters
+ * classes and the Twitch::FormatMetrics function.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <Twitch/Messaging.hpp>
+
+namespace Twitch {
+
+    /**
+     * This counts values, such as durations in nanoseconds, in buckets
+     * whose width grows with the values they hold: each power of two is
+     * split into sixteen buckets of equal width.  Recording a value
+     * takes no locks.  Values must be recorded from only one thread at
+     * a time, but snapshots may be taken from any thread.
+     */
+    class Histogram {
+        // Types
+    public:
+        /**
+         * This is the number of buckets in each histogram.  Values beyond
+         * the range of the last bucket are counted in the last bucket.
+         */
+        static constexpr size_t NUM_BUCKETS = 592;
+
+        // Lifecycle management
+    public:
+        ~Histogram() noexcept = default;
+        Histogram(const Histogram&) = delete;
+        Histogram(Histogram&&) noexcept = delete;
+        Histogram& operator=(const Histogram&) = delete;
+        Histogram& operator=(Histogram&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This is the default constructor.
+         */
+        Histogram();
+
+        /**
+         * This method counts the given value.
+         *
+         * @param[in] value
+         *     This is the value to count.
+         */
+        void Record(uint64_t value);
+
+        /**
+         * This method returns a snapshot of the values counted.
+         *
+         * @return
+         *     A snapshot of the values counted is returned.
+         */
+        Messaging::HistogramSnapshot GetSnapshot() const;
+
+        /**
+         * This function returns the index of the bucket which
+         * counts the given value.
+         *
+         * @param[in] value
+         *     This is the value whose bucket to find.
+         *
+         * @return
+         *     The index of the bucket which counts the given value
+         *     is returned.
+         */
+        static size_t GetBucketIndex(uint64_t value);
+
+        /**
+         * This function returns the largest value counted
+         * by the given bucket.
+         *
+         * @param[in] index
+         *     This is the index of the bucket.
+         *
+         * @return
+         *     The largest value counted by the given bucket is returned.
+         */
+        static uint64_t GetBucketUpperBound(size_t index);
+
+        // Private properties
+    private:
+        /**
+         * These are the numbers of values counted in each bucket.
+         */
+        std::atomic< uint64_t > buckets_[NUM_BUCKETS];
+
+        /**
+         * This is the number of values counted.
+         */
+        std::atomic< uint64_t > count_;
+
+        /**
+         * This is the sum of the values counted.
+         */
+        std::atomic< uint64_t > sum_;
+
+        /**
+         * This is the smallest value counted.
+         */
+        std::atomic< uint64_t > min_;
+
+        /**
+         * This is the largest value counted.
+         */
+        std::atomic< uint64_t > max_;
+    };
+
+    /**
+     * This holds what is measured about each kind of command received from
+     * the Twitch server.  Looking up the measurements for a command only
+     * takes a lock the first time the command is seen.  Commands must be
+     * looked up from only one thread at a time, but snapshots may be
+     * taken from any thread.
+     */
+    class CommandCounters {
+        // Types
+    public:
+        /**
+         * This holds what is measured about one kind of command.
+         */
+        struct Counters {
+            /**
+             * This is the number of lines received with the command.
+             */
+            std::atomic< uint64_t > linesReceived;
+
+            /**
+             * This is a histogram of how long it took to handle lines
+             * received with the command, in nanoseconds.
+             */
+            Histogram handlerTime;
+
+            /**
+             * This is the default constructor.
+             */
+            Counters()
+                : linesReceived(0)
+            {
+            }
+        };
+
+        /**
+         * This is the most number of different commands measured
+         * separately.  Any others are measured together, under
+         * the command "other".
+         */
+        static constexpr size_t MAX_COMMANDS = 64;
+
+        // Public methods
+    public:
+        /**
+         * This method returns the measurements for the given command,
+         * making new measurements if the command hasn't been seen before.
+         *
+         * @param[in] command
+         *     This is the command whose measurements to return.
+         *
+         * @return
+         *     The measurements for the given command are returned.
+         */
+        Counters& Get(const std::string& command);
+
+        /**
+         * This method returns a snapshot of the measurements
+         * for all commands seen.
+         *
+         * @return
+         *     A snapshot of the measurements for all commands seen,
+         *     keyed by command, is returned.
+         */
+        std::map< std::string, Messaging::CommandMetrics > GetSnapshot();
+
+        // Private properties
+    private:
+        /**
+         * This is used to synchronize adding measurements for new
+         * commands with taking snapshots.
+         */
+        std::mutex mutex_;
+
+        /**
+         * These are the measurements for each command seen.
+         */
+        std::map< std::string, std::unique_ptr< Counters > > counters_;
+    };
+
+    /**
+     * This function formats the given metrics in the Prometheus text
+     * exposition format.  Durations are converted from nanoseconds
+     * to seconds.
+     *
+     * @param[in] metrics
+     *     These are the metrics to format.
+     *
+     * @return
+     *     The metrics, in Prometheus text format, are returned.
+     */
+    std::string FormatMetrics(const Messaging::Metrics& metrics);
+
+}
+
+#endif /* TWITCH_METRICS_HPP */
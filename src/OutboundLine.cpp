@@ -0,0 +1,253 @@
+/**
+ * @file OutboundLine.cpp
+ *
+ * This module contains the implementation of the Twitch::OutboundLine
+ * class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "OutboundLine.hpp"
+
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+
+namespace {
+
+    /**
+     * This is the required line terminator for lines of text
+     * sent to Twitch chat servers.
+     */
+    constexpr const char* CRLF = "\r\n";
+
+    /**
+     * This has a bit set for each character, below 64, which must be
+     * escaped in the value of a tag, so that each character can be
+     * checked with one test instead of one comparison per character
+     * which must be escaped.  The backslash is the only other character
+     * which must be escaped.
+     */
+    constexpr uint64_t TAG_VALUE_ESCAPES_BELOW_64 = (
+        (1ULL << ';')
+        | (1ULL << ' ')
+        | (1ULL << '\r')
+        | (1ULL << '\n')
+    );
+
+    /**
+     * This function returns the escape sequence which stands in for the
+     * given character in the value of a tag, if the character must be
+     * escaped.
+     *
+     * @param[in] c
+     *     This is the character to check.
+     *
+     * @return
+     *     The escape sequence which stands in for the given character
+     *     is returned.
+     *
+     * @retval nullptr
+     *     This is returned if the character doesn't need to be escaped.
+     */
+    const char* GetTagValueEscape(char c) {
+        switch (c) {
+            case ';': return "\\:";
+            case ' ': return "\\s";
+            case '\\': return "\\\\";
+            case '\r': return "\\r";
+            case '\n': return "\\n";
+            default: return nullptr;
+        }
+    }
+
+    /**
+     * This function finds the first character in the given text
+     * which must be escaped in the value of a tag.
+     *
+     * @param[in] text
+     *     This points to the first character of the text to search.
+     *
+     * @param[in] end
+     *     This points just past the last character of the text to search.
+     *
+     * @return
+     *     A pointer to the first character in the text which must be
+     *     escaped is returned.
+     *
+     * @retval end
+     *     This is returned if no character in the text must be escaped.
+     */
+    const char* FindTagValueEscape(const char* text, const char* end) {
+        while (text < end) {
+            const auto c = (unsigned char)*text;
+            if (
+                (c == '\\')
+                || (
+                    (c < 64)
+                    && (((TAG_VALUE_ESCAPES_BELOW_64 >> c) & 1) != 0)
+                )
+            ) {
+                break;
+            }
+            ++text;
+        }
+        return text;
+    }
+
+    /**
+     * This function finds the first carriage return or line feed
+     * in the given text.
+     *
+     * @param[in] text
+     *     This points to the first character of the text to search.
+     *
+     * @param[in] end
+     *     This points just past the last character of the text to search.
+     *
+     * @return
+     *     A pointer to the first carriage return or line feed in the text
+     *     is returned.
+     *
+     * @retval end
+     *     This is returned if the text has no carriage returns
+     *     or line feeds.
+     */
+    const char* FindLineBreak(const char* text, const char* end) {
+        const auto cr = (const char*)memchr(text, '\r', (size_t)(end - text));
+        if (cr != nullptr) {
+            end = cr;
+        }
+        const auto lf = (const char*)memchr(text, '\n', (size_t)(end - text));
+        return (lf == nullptr) ? end : lf;
+    }
+
+}
+
+namespace Twitch {
+
+    constexpr size_t OutboundLine::MAX_LINE_LENGTH;
+    constexpr size_t OutboundLine::SCRATCH_SIZE;
+
+    OutboundLine::~OutboundLine() noexcept {
+        if (!finished_) {
+            buffer_.resize(lineStart_);
+        }
+    }
+
+    OutboundLine::OutboundLine(std::string& buffer)
+        : buffer_(buffer)
+        , lineStart_(buffer.length())
+        , commandStart_(buffer.length())
+        , end_(buffer.length())
+    {
+    }
+
+    OutboundLine& OutboundLine::AppendTag(const char* key, const std::string& value) {
+        Put(inTags_ ? ";" : "@", 1);
+        inTags_ = true;
+        Put(key, strlen(key));
+        Put("=", 1);
+        auto text = value.data();
+        const auto end = text + value.length();
+        while (text < end) {
+            const auto runEnd = FindTagValueEscape(text, end);
+            Put(text, (size_t)(runEnd - text));
+            if (runEnd == end) {
+                break;
+            }
+            Put(GetTagValueEscape(*runEnd), 2);
+            text = runEnd + 1;
+        }
+        commandStart_ = end_;
+        return *this;
+    }
+
+    OutboundLine& OutboundLine::Append(const std::string& text) {
+        EndTags();
+        AppendStripped(text.data(), text.length());
+        return *this;
+    }
+
+    OutboundLine& OutboundLine::Append(const char* text) {
+        EndTags();
+        AppendStripped(text, strlen(text));
+        return *this;
+    }
+
+    bool OutboundLine::Finish() {
+        if (finished_) {
+            return terminated_;
+        }
+        finished_ = true;
+        const auto commandLength = end_ - commandStart_;
+        if (
+            (commandLength == 0)
+            || (commandLength + 2 > MAX_LINE_LENGTH)
+        ) {
+            buffer_.resize(lineStart_);
+            scratchLength_ = 0;
+            commandStart_ = end_ = lineStart_;
+            return false;
+        }
+        if (scratchLength_ + 2 > SCRATCH_SIZE) {
+            Spill();
+        }
+        (void)memcpy(scratch_ + scratchLength_, CRLF, 2);
+        scratchLength_ += 2;
+        Spill();
+        terminated_ = true;
+        return true;
+    }
+
+    size_t OutboundLine::GetLength() const {
+        return end_ - lineStart_;
+    }
+
+    std::string OutboundLine::GetLine() const {
+        auto line = buffer_.substr(lineStart_, GetLength());
+        (void)line.append(scratch_, std::min(scratchLength_, GetLength() - line.length()));
+        return line;
+    }
+
+    void OutboundLine::AppendStripped(const char* text, size_t length) {
+        const auto end = text + length;
+        while (text < end) {
+            const auto runEnd = FindLineBreak(text, end);
+            Put(text, (size_t)(runEnd - text));
+            if (runEnd == end) {
+                break;
+            }
+            text = runEnd + 1;
+        }
+    }
+
+    void OutboundLine::Spill() {
+        (void)buffer_.append(scratch_, scratchLength_);
+        scratchLength_ = 0;
+    }
+
+    void OutboundLine::Put(const char* text, size_t length) {
+        if (scratchLength_ + length > SCRATCH_SIZE) {
+            Spill();
+            if (length > SCRATCH_SIZE) {
+                (void)buffer_.append(text, length);
+                end_ += length;
+                return;
+            }
+        }
+        (void)memcpy(scratch_ + scratchLength_, text, length);
+        scratchLength_ += length;
+        end_ += length;
+    }
+
+    void OutboundLine::EndTags() {
+        if (!inTags_) {
+            return;
+        }
+        Put(" ", 1);
+        inTags_ = false;
+        commandStart_ = end_;
+    }
+
+}
@@ -0,0 +1,242 @@
+#ifndef TWITCH_OUTBOUND_LINE_HPP
+#define TWITCH_OUTBOUND_LINE_HPP
+
+/**
+ * @file OutboundLine.hpp
+ *
+ * This module declares the Twitch::OutboundLine class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <stddef.h>
+#include <string>
+
+namespace Twitch {
+
+    /**
+     * This writes one line to be sent to the Twitch server, piece by
+     * piece, onto the end of a buffer owned by the caller, so that no
+     * temporary strings are needed to put the line together.  Each piece
+     * is simply copied into a fixed-size scratch area inside the line
+     * itself, which is added onto the buffer all at once when the line is
+     * finished, or earlier if the scratch area fills up.  This way the
+     * buffer doesn't need room made in it up front, which would mean
+     * filling that room with zeros for every line.
+     *
+     * Carriage returns and line feeds are left out of every piece as
+     * it's written, so that nothing given can end the line early or
+     * smuggle in another command.  Tag values are escaped as they're
+     * written.  When the line is finished, its length is checked, not
+     * counting tags, against the limit imposed by IRC.
+     */
+    class OutboundLine {
+        // Types
+    public:
+        /**
+         * This is the most number of bytes allowed in a line, not
+         * counting tags, but including the line terminator.
+         */
+        static constexpr size_t MAX_LINE_LENGTH = 512;
+
+        /**
+         * This is the number of bytes of the line which are held in the
+         * scratch area before being added onto the buffer.  It's enough
+         * for the longest line allowed along with a few tags.
+         */
+        static constexpr size_t SCRATCH_SIZE = 1024;
+
+        // Lifecycle management
+    public:
+        ~OutboundLine() noexcept;
+        OutboundLine(const OutboundLine&) = delete;
+        OutboundLine(OutboundLine&&) noexcept = delete;
+        OutboundLine& operator=(const OutboundLine&) = delete;
+        OutboundLine& operator=(OutboundLine&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This constructs the line, to be written onto the end of the
+         * given buffer.  If the line isn't finished, whatever of it
+         * was already added to the buffer is taken back out when the
+         * line is destroyed.
+         *
+         * @param[in,out] buffer
+         *     This is the buffer onto which to write the line.  It must
+         *     outlive the line, and must not be changed by anything else
+         *     until the line is finished.
+         */
+        explicit OutboundLine(std::string& buffer);
+
+        /**
+         * This method writes a tag onto the line.  All tags must be
+         * written before anything else.
+         *
+         * @param[in] key
+         *     This is the key of the tag.  It must be terminated
+         *     by a null character, and is written as-is.
+         *
+         * @param[in] value
+         *     This is the value of the tag, which is escaped as it's
+         *     written.
+         *
+         * @return
+         *     A reference to the line is returned, so that more may be
+         *     written onto it in the same expression.
+         */
+        OutboundLine& AppendTag(const char* key, const std::string& value);
+
+        /**
+         * This method writes the given text onto the line, leaving out
+         * any carriage returns or line feeds.
+         *
+         * @param[in] text
+         *     This is the text to write.
+         *
+         * @return
+         *     A reference to the line is returned, so that more may be
+         *     written onto it in the same expression.
+         */
+        OutboundLine& Append(const std::string& text);
+
+        /**
+         * This method writes the given text onto the line, leaving out
+         * any carriage returns or line feeds.
+         *
+         * @param[in] text
+         *     This is the text to write.  It must be terminated
+         *     by a null character.
+         *
+         * @return
+         *     A reference to the line is returned, so that more may be
+         *     written onto it in the same expression.
+         */
+        OutboundLine& Append(const char* text);
+
+        /**
+         * This method ends the line with the line terminator, if the line
+         * isn't empty or too long.  Otherwise, the line is taken back out
+         * of the buffer.
+         *
+         * @return
+         *     An indication of whether or not the line was ended and left
+         *     in the buffer is returned.
+         */
+        bool Finish();
+
+        /**
+         * This method returns the number of bytes in the line, including
+         * tags, but not including the line terminator.
+         *
+         * @return
+         *     The number of bytes in the line is returned.
+         */
+        size_t GetLength() const;
+
+        /**
+         * This method returns a copy of the line, including tags, but
+         * not including the line terminator.
+         *
+         * @return
+         *     A copy of the line is returned.
+         */
+        std::string GetLine() const;
+
+        // Private methods
+    private:
+        /**
+         * This method writes the given text onto the line, leaving out
+         * any carriage returns or line feeds.
+         *
+         * @param[in] text
+         *     This points to the first character of the text to write.
+         *
+         * @param[in] length
+         *     This is the number of characters of text to write.
+         */
+        void AppendStripped(const char* text, size_t length);
+
+        /**
+         * This method adds whatever is in the scratch area onto the end
+         * of the buffer, emptying the scratch area.
+         */
+        void Spill();
+
+        /**
+         * This method copies the given text into place on the line,
+         * adding what came before it onto the buffer first if the
+         * scratch area doesn't have room for it.
+         *
+         * @param[in] text
+         *     This points to the first character of the text to write.
+         *
+         * @param[in] length
+         *     This is the number of characters of text to write.
+         */
+        void Put(const char* text, size_t length);
+
+        /**
+         * This method ends the tags of the line, if any were written
+         * and haven't already been ended.
+         */
+        void EndTags();
+
+        // Private properties
+    private:
+        /**
+         * This is the buffer onto which the line is written.
+         */
+        std::string& buffer_;
+
+        /**
+         * This is where in the buffer the line begins.
+         */
+        size_t lineStart_ = 0;
+
+        /**
+         * This is where in the buffer the line begins, after any tags.
+         * Like end_, it counts what's still in the scratch area as if it
+         * had already been added onto the buffer.
+         */
+        size_t commandStart_ = 0;
+
+        /**
+         * This is where in the buffer the next piece of the line
+         * is to be written.
+         */
+        size_t end_ = 0;
+
+        /**
+         * This holds the part of the line not yet added onto the buffer.
+         */
+        char scratch_[SCRATCH_SIZE];
+
+        /**
+         * This is the number of bytes of the line held in the scratch
+         * area.
+         */
+        size_t scratchLength_ = 0;
+
+        /**
+         * This indicates whether or not tags are being written.
+         */
+        bool inTags_ = false;
+
+        /**
+         * This indicates whether or not the line was finished,
+         * either by ending it with the line terminator or by taking
+         * it back out of the buffer.
+         */
+        bool finished_ = false;
+
+        /**
+         * This indicates whether or not the line was ended with the
+         * line terminator.
+         */
+        bool terminated_ = false;
+    };
+
+}
+
+#endif /* TWITCH_OUTBOUND_LINE_HPP */
@@ -0,0 +1,39 @@
+/**
+ * @file RateLimiter.cpp
+ *
+ * This module contains the implementation of the Twitch::RateLimiter
+ * class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "RateLimiter.hpp"
+
+namespace Twitch {
+
+    void RateLimiter::Configure(size_t limit, double window) {
+        limit_ = limit;
+        window_ = window;
+        while (times_.size() > limit_) {
+            times_.pop_front();
+        }
+    }
+
+    bool RateLimiter::TryAcquire(double now) {
+        if (limit_ == 0) {
+            return true;
+        }
+        while (
+            !times_.empty()
+            && (times_.front() + window_ <= now)
+        ) {
+            times_.pop_front();
+        }
+        if (times_.size() >= limit_) {
+            return false;
+        }
+        times_.push_back(now);
+        return true;
+    }
+
+}
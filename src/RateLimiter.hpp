@@ -0,0 +1,86 @@
+#ifndef TWITCH_RATE_LIMITER_HPP
+#define TWITCH_RATE_LIMITER_HPP
+
+/**
+ * @file RateLimiter.hpp
+ *
+ * This module declares the Twitch::RateLimiter class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <deque>
+#include <stddef.h>
+
+namespace Twitch {
+
+    /**
+     * This keeps the number of things done within any window of time
+     * of a given length under a given limit, the way the Twitch server
+     * limits how many messages a user may send.
+     */
+    class RateLimiter {
+        // Lifecycle management
+    public:
+        ~RateLimiter() noexcept = default;
+        RateLimiter(const RateLimiter&) = delete;
+        RateLimiter(RateLimiter&&) noexcept = delete;
+        RateLimiter& operator=(const RateLimiter&) = delete;
+        RateLimiter& operator=(RateLimiter&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This is the default constructor.  The limiter starts out
+         * with no limit.
+         */
+        RateLimiter() = default;
+
+        /**
+         * This method sets the limit to enforce.
+         *
+         * @param[in] limit
+         *     This is the most number of things which may be done within
+         *     any window of time, or zero if there is no limit.
+         *
+         * @param[in] window
+         *     This is the length of the window of time, in seconds.
+         */
+        void Configure(size_t limit, double window);
+
+        /**
+         * This method determines whether or not one more thing may be done
+         * at the given time, and if so, counts it as done.
+         *
+         * @param[in] now
+         *     This is the current time, in seconds.
+         *
+         * @return
+         *     An indication of whether or not one more thing may be done,
+         *     and was counted as done, is returned.
+         */
+        bool TryAcquire(double now);
+
+        // Private properties
+    private:
+        /**
+         * This is the most number of things which may be done within
+         * any window of time, or zero if there is no limit.
+         */
+        size_t limit_ = 0;
+
+        /**
+         * This is the length of the window of time, in seconds.
+         */
+        double window_ = 0.0;
+
+        /**
+         * These are the times at which things were done within the
+         * current window, oldest first.
+         */
+        std::deque< double > times_;
+    };
+
+}
+
+#endif /* TWITCH_RATE_LIMITER_HPP */
@@ -0,0 +1,193 @@
+/**
+ * @file RecordingConnection.cpp
+ *
+ * This module contains the implementation of the
+ * Twitch::RecordingConnection class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <Twitch/RecordingConnection.hpp>
+#include <Twitch/TrafficRecorder.hpp>
+
+namespace Twitch {
+
+    /**
+     * This contains the private properties of a RecordingConnection instance.
+     */
+    struct RecordingConnection::Impl {
+        // Properties
+
+        /**
+         * This is the connection being decorated.
+         */
+        std::shared_ptr< Connection > connection;
+
+        /**
+         * This is the path to the file in which to capture the traffic
+         * of the connection.
+         */
+        std::string filePath;
+
+        /**
+         * This is the function to call whenever any message is received
+         * from the Twitch server.
+         */
+        MessageReceivedDelegate messageReceivedDelegate;
+
+        /**
+         * This is the function to call when the Twitch server closes
+         * its end of the connection.
+         */
+        DisconnectedDelegate disconnectedDelegate;
+
+        /**
+         * This is used to synchronize access to the capture file, since
+         * data may be received and sent on different threads.
+         */
+        std::mutex mutex;
+
+        /**
+         * This is the file in which the traffic of the connection
+         * is being captured.
+         */
+        std::ofstream file;
+
+        /**
+         * This is when the connection was established, which is the time
+         * from which all records are timed.
+         */
+        std::chrono::steady_clock::time_point connectTime;
+
+        // Methods
+
+        /**
+         * This method adds a record to the capture file, if it's open.
+         *
+         * @param[in] type
+         *     This is the type of record to add.
+         *
+         * @param[in] data
+         *     This is the data to put in the record.
+         */
+        void Capture(
+            TrafficRecorder::Record::Type type,
+            const std::string& data
+        ) {
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            if (!file.is_open()) {
+                return;
+            }
+            TrafficRecorder::Record record;
+            record.type = type;
+            record.time = (uint64_t)std::chrono::duration_cast< std::chrono::microseconds >(
+                std::chrono::steady_clock::now() - connectTime
+            ).count();
+            record.line = data;
+            (void)TrafficRecorder::WriteRecord(file, record);
+        }
+
+        /**
+         * This method closes the capture file, if it's open.
+         */
+        void CloseFile() {
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            if (file.is_open()) {
+                file.close();
+            }
+        }
+
+        /**
+         * This method is called whenever any message is received from
+         * the Twitch server.
+         *
+         * @param[in] message
+         *     This is the message received from the Twitch server.
+         */
+        void OnMessageReceived(const std::string& message) {
+            Capture(TrafficRecorder::Record::Type::ReceivedData, message);
+            if (messageReceivedDelegate != nullptr) {
+                messageReceivedDelegate(message);
+            }
+        }
+
+        /**
+         * This method is called when the Twitch server closes its end
+         * of the connection.
+         */
+        void OnDisconnected() {
+            Capture(TrafficRecorder::Record::Type::Disconnected, "");
+            CloseFile();
+            if (disconnectedDelegate != nullptr) {
+                disconnectedDelegate();
+            }
+        }
+    };
+
+    RecordingConnection::~RecordingConnection() noexcept = default;
+
+    RecordingConnection::RecordingConnection(
+        std::shared_ptr< Connection > connection,
+        const std::string& filePath
+    )
+        : impl_(new Impl)
+    {
+        impl_->connection = connection;
+        impl_->filePath = filePath;
+    }
+
+    void RecordingConnection::SetMessageReceivedDelegate(MessageReceivedDelegate messageReceivedDelegate) {
+        impl_->messageReceivedDelegate = messageReceivedDelegate;
+        impl_->connection->SetMessageReceivedDelegate(
+            std::bind(&Impl::OnMessageReceived, impl_.get(), std::placeholders::_1)
+        );
+    }
+
+    void RecordingConnection::SetDisconnectedDelegate(DisconnectedDelegate disconnectedDelegate) {
+        impl_->disconnectedDelegate = disconnectedDelegate;
+        impl_->connection->SetDisconnectedDelegate(
+            std::bind(&Impl::OnDisconnected, impl_.get())
+        );
+    }
+
+    bool RecordingConnection::Connect() {
+        {
+            std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+            if (impl_->file.is_open()) {
+                impl_->file.close();
+            }
+            impl_->file.open(impl_->filePath, std::ios::binary | std::ios::trunc);
+            if (
+                !impl_->file.is_open()
+                || !TrafficRecorder::WriteHeader(impl_->file)
+            ) {
+                impl_->file.close();
+                return false;
+            }
+            impl_->connectTime = std::chrono::steady_clock::now();
+        }
+        if (!impl_->connection->Connect()) {
+            impl_->CloseFile();
+            return false;
+        }
+        return true;
+    }
+
+    void RecordingConnection::Disconnect() {
+        impl_->connection->Disconnect();
+        impl_->CloseFile();
+    }
+
+    void RecordingConnection::Send(const std::string& message) {
+        impl_->Capture(
+            TrafficRecorder::Record::Type::SentData,
+            TrafficRecorder::Redact(message)
+        );
+        impl_->connection->Send(message);
+    }
+
+}
@@ -0,0 +1,320 @@
+/**
+ * @file ReplayConnection.cpp
+ *
+ * This module contains the implementation of the
+ * Twitch::ReplayConnection class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <Twitch/ReplayConnection.hpp>
+#include <Twitch/TrafficRecorder.hpp>
+#include <vector>
+
+namespace {
+
+    /**
+     * This holds one piece of data to play back.
+     */
+    struct Playback {
+        /**
+         * This is the type of record captured.
+         */
+        Twitch::TrafficRecorder::Record::Type type;
+
+        /**
+         * This is when the data was captured, in microseconds since
+         * the connection was established.
+         */
+        uint64_t time;
+
+        /**
+         * This is the number of lines the client had sent by the time
+         * the data was captured.
+         */
+        size_t linesSentBefore;
+
+        /**
+         * This is the data captured.
+         */
+        std::string data;
+    };
+
+}
+
+namespace Twitch {
+
+    /**
+     * This contains the private properties of a ReplayConnection instance.
+     */
+    struct ReplayConnection::Impl {
+        // Properties
+
+        /**
+         * This is the path to the capture file to play back.
+         */
+        std::string filePath;
+
+        /**
+         * This is how fast to play back the data, relative to how fast
+         * it was captured, or zero to play it back as fast as possible.
+         */
+        double speed = 1.0;
+
+        /**
+         * This is the function to call whenever any message is received
+         * from the Twitch server.
+         */
+        MessageReceivedDelegate messageReceivedDelegate;
+
+        /**
+         * This is the function to call when the Twitch server closes
+         * its end of the connection.
+         */
+        DisconnectedDelegate disconnectedDelegate;
+
+        /**
+         * This is used to synchronize access to the object.
+         */
+        std::mutex mutex;
+
+        /**
+         * This is used to wake up the player thread when the client sends
+         * data or breaks the connection, and to wake up anyone waiting
+         * for the playback to finish.
+         */
+        std::condition_variable wakeCondition;
+
+        /**
+         * This is the data to play back, loaded from the capture file
+         * when the connection is established.
+         */
+        std::vector< Playback > playbacks;
+
+        /**
+         * This is the number of records of data received which have been
+         * played back since the connection was last established.
+         */
+        size_t recordsPlayed = 0;
+
+        /**
+         * This is all the data sent by the client since the connection
+         * was last established.
+         */
+        std::string dataSent;
+
+        /**
+         * This is the number of lines sent by the client since the
+         * connection was last established.
+         */
+        size_t linesSent = 0;
+
+        /**
+         * This indicates whether or not the player thread should stop.
+         */
+        bool stopPlayer = false;
+
+        /**
+         * This indicates whether or not the playback has finished.
+         */
+        bool completed = false;
+
+        /**
+         * This is the thread which plays back the data.
+         */
+        std::thread player;
+
+        // Methods
+
+        /**
+         * This method loads the data to play back from the capture file.
+         *
+         * @return
+         *     An indication of whether or not the capture file
+         *     was loaded is returned.
+         */
+        bool Load() {
+            std::ifstream file(filePath, std::ios::binary);
+            if (!TrafficRecorder::ReadHeader(file)) {
+                return false;
+            }
+            playbacks.clear();
+            size_t linesSentBefore = 0;
+            TrafficRecorder::Record record;
+            while (TrafficRecorder::ReadRecord(file, record)) {
+                switch (record.type) {
+                    case TrafficRecorder::Record::Type::SentData: {
+                        linesSentBefore += (size_t)std::count(
+                            record.line.begin(),
+                            record.line.end(),
+                            '\n'
+                        );
+                    } break;
+
+                    case TrafficRecorder::Record::Type::ReceivedData:
+                    case TrafficRecorder::Record::Type::Disconnected: {
+                        Playback playback;
+                        playback.type = record.type;
+                        playback.time = record.time;
+                        playback.linesSentBefore = linesSentBefore;
+                        playback.data = std::move(record.line);
+                        playbacks.push_back(std::move(playback));
+                    } break;
+
+                    default: break;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * This method stops the player thread, if it's running, and waits
+         * for it to finish, unless it's the one calling the method.
+         */
+        void StopPlayer() {
+            {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                stopPlayer = true;
+                wakeCondition.notify_all();
+            }
+            if (
+                player.joinable()
+                && (player.get_id() != std::this_thread::get_id())
+            ) {
+                player.join();
+            }
+        }
+
+        /**
+         * This method is the body of the thread which plays back the data.
+         */
+        void Player() {
+            const auto start = std::chrono::steady_clock::now();
+            std::unique_lock< decltype(mutex) > lock(mutex);
+            for (const auto& playback: playbacks) {
+                wakeCondition.wait(
+                    lock,
+                    [this, &playback]{
+                        return (
+                            stopPlayer
+                            || (linesSent >= playback.linesSentBefore)
+                        );
+                    }
+                );
+                if (speed > 0.0) {
+                    const auto due = start + std::chrono::microseconds(
+                        (std::chrono::microseconds::rep)((double)playback.time / speed)
+                    );
+                    (void)wakeCondition.wait_until(
+                        lock,
+                        due,
+                        [this]{ return stopPlayer; }
+                    );
+                }
+                if (stopPlayer) {
+                    break;
+                }
+                if (playback.type == TrafficRecorder::Record::Type::Disconnected) {
+                    const auto disconnectedDelegateCopy = disconnectedDelegate;
+                    lock.unlock();
+                    if (disconnectedDelegateCopy != nullptr) {
+                        disconnectedDelegateCopy();
+                    }
+                    lock.lock();
+                    break;
+                }
+                const auto messageReceivedDelegateCopy = messageReceivedDelegate;
+                lock.unlock();
+                if (messageReceivedDelegateCopy != nullptr) {
+                    messageReceivedDelegateCopy(playback.data);
+                }
+                lock.lock();
+                ++recordsPlayed;
+            }
+            completed = true;
+            wakeCondition.notify_all();
+        }
+    };
+
+    ReplayConnection::~ReplayConnection() noexcept {
+        impl_->StopPlayer();
+        if (impl_->player.joinable()) {
+            impl_->player.detach();
+        }
+    }
+
+    ReplayConnection::ReplayConnection(
+        const std::string& filePath,
+        double speed
+    )
+        : impl_(new Impl)
+    {
+        impl_->filePath = filePath;
+        impl_->speed = std::max(speed, 0.0);
+    }
+
+    bool ReplayConnection::AwaitCompletion(double timeout) {
+        std::unique_lock< decltype(impl_->mutex) > lock(impl_->mutex);
+        return impl_->wakeCondition.wait_for(
+            lock,
+            std::chrono::microseconds((std::chrono::microseconds::rep)(timeout * 1000000.0)),
+            [this]{ return impl_->completed; }
+        );
+    }
+
+    size_t ReplayConnection::GetRecordsPlayed() {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        return impl_->recordsPlayed;
+    }
+
+    std::string ReplayConnection::GetDataSent() {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        return impl_->dataSent;
+    }
+
+    void ReplayConnection::SetMessageReceivedDelegate(MessageReceivedDelegate messageReceivedDelegate) {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        impl_->messageReceivedDelegate = messageReceivedDelegate;
+    }
+
+    void ReplayConnection::SetDisconnectedDelegate(DisconnectedDelegate disconnectedDelegate) {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        impl_->disconnectedDelegate = disconnectedDelegate;
+    }
+
+    bool ReplayConnection::Connect() {
+        impl_->StopPlayer();
+        if (impl_->player.joinable()) {
+            return false;
+        }
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        if (!impl_->Load()) {
+            return false;
+        }
+        impl_->recordsPlayed = 0;
+        impl_->dataSent.clear();
+        impl_->linesSent = 0;
+        impl_->stopPlayer = false;
+        impl_->completed = false;
+        impl_->player = std::thread(&Impl::Player, impl_.get());
+        return true;
+    }
+
+    void ReplayConnection::Disconnect() {
+        impl_->StopPlayer();
+    }
+
+    void ReplayConnection::Send(const std::string& message) {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        impl_->dataSent += message;
+        impl_->linesSent += (size_t)std::count(message.begin(), message.end(), '\n');
+        impl_->wakeCondition.notify_all();
+    }
+
+}
@@ -0,0 +1,78 @@
+/**
+ * @file TcpSocket.cpp
+ *
+ * This module contains the implementation of the Twitch::ConnectTcpSocket
+ * function.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "TcpSocket.hpp"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+    /**
+     * This is how long, in milliseconds, to wait for a connection to the
+     * Twitch server to be established.
+     */
+    constexpr int CONNECT_TIMEOUT_MILLISECONDS = 10000;
+
+}
+
+namespace Twitch {
+
+    int ConnectTcpSocket(const std::string& host, uint16_t port) {
+        struct addrinfo hints;
+        (void)memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo* addresses = NULL;
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+            return -1;
+        }
+        int handle = -1;
+        for (auto address = addresses; address != NULL; address = address->ai_next) {
+            handle = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+            if (handle < 0) {
+                continue;
+            }
+            if (connect(handle, address->ai_addr, address->ai_addrlen) != 0) {
+                int error = errno;
+                if (error == EINPROGRESS) {
+                    struct pollfd pollSocket;
+                    pollSocket.fd = handle;
+                    pollSocket.events = POLLOUT;
+                    pollSocket.revents = 0;
+                    if (poll(&pollSocket, 1, CONNECT_TIMEOUT_MILLISECONDS) == 1) {
+                        socklen_t errorLength = sizeof(error);
+                        if (getsockopt(handle, SOL_SOCKET, SO_ERROR, &error, &errorLength) != 0) {
+                            error = errno;
+                        }
+                    } else {
+                        error = ETIMEDOUT;
+                    }
+                }
+                if (error != 0) {
+                    (void)close(handle);
+                    handle = -1;
+                    continue;
+                }
+            }
+            int noDelay = 1;
+            (void)setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            break;
+        }
+        freeaddrinfo(addresses);
+        return handle;
+    }
+
+}
@@ -0,0 +1,38 @@
+#ifndef TWITCH_TCP_SOCKET_HPP
+#define TWITCH_TCP_SOCKET_HPP
+
+/**
+ * @file TcpSocket.hpp
+ *
+ * This module declares the Twitch::ConnectTcpSocket function.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <stdint.h>
+#include <string>
+
+namespace Twitch {
+
+    /**
+     * This function establishes a TCP connection to the given server,
+     * leaving the socket in non-blocking mode, with Nagle's algorithm
+     * turned off.
+     *
+     * @param[in] host
+     *     This is the host name or address of the server.
+     *
+     * @param[in] port
+     *     This is the port number of the server.
+     *
+     * @return
+     *     The operating system handle of the connected socket is returned.
+     *
+     * @retval -1
+     *     This is returned if the connection could not be established.
+     */
+    int ConnectTcpSocket(const std::string& host, uint16_t port);
+
+}
+
+#endif /* TWITCH_TCP_SOCKET_HPP */
@@ -0,0 +1,412 @@
+/**
+ * @file Timeline.cpp
+ *
+ * This module contains the implementation of the Twitch::Timeline functions
+ * and the Twitch::TimelineZone class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "TimelineZone.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <inttypes.h>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <Twitch/Timeline.hpp>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the most number of zones each thread can record before
+     * the timeline is cleared.  Any more are dropped.
+     */
+    constexpr size_t MAX_ZONES_PER_THREAD = 65536;
+
+    /**
+     * This is the number of zones in each chunk of the buffer holding
+     * the zones recorded by one thread.  Chunks are only allocated as
+     * they're needed, so that threads which record few zones take little
+     * memory.
+     */
+    constexpr size_t ZONES_PER_CHUNK = 1024;
+
+    /**
+     * This holds one zone recorded on the timeline.
+     */
+    struct Zone {
+        /**
+         * This is the name of the zone.
+         */
+        const char* name;
+
+        /**
+         * This is when the zone began, in nanoseconds since the
+         * timeline epoch.
+         */
+        uint64_t start;
+
+        /**
+         * This is how long the zone lasted, in nanoseconds.
+         */
+        uint64_t duration;
+    };
+
+    /**
+     * This holds the zones recorded by one thread.  Only the thread itself
+     * adds zones, but they may be read by any thread.  Once the thread
+     * exits, the zones are kept only until the timeline is cleared.
+     */
+    struct ThreadZones {
+        /**
+         * This is the number used to identify the thread on the timeline.
+         */
+        size_t threadId = 0;
+
+        /**
+         * This is the generation of the timeline to which the zones
+         * recorded belong.  It's compared with the current generation
+         * to find out when the timeline has been cleared.
+         */
+        std::atomic< uint64_t > generation;
+
+        /**
+         * This is the number of zones recorded.
+         */
+        std::atomic< size_t > count;
+
+        /**
+         * These are the chunks holding the zones recorded.  Each chunk is
+         * allocated the first time a zone is recorded in it, and is then
+         * kept for reuse after the timeline is cleared.  A chunk is always
+         * allocated before the count of zones recorded is increased to
+         * cover it, so readers may use any chunk covered by the count.
+         */
+        std::unique_ptr< Zone[] > chunks[MAX_ZONES_PER_THREAD / ZONES_PER_CHUNK];
+
+        /**
+         * This is the constructor for the structure.
+         */
+        ThreadZones()
+            : generation(0)
+            , count(0)
+        {
+        }
+
+        /**
+         * This method returns the zone at the given index.
+         *
+         * @param[in] index
+         *     This is the index of the zone to return.
+         *
+         * @return
+         *     The zone at the given index is returned.
+         */
+        Zone& GetZone(size_t index) {
+            return chunks[index / ZONES_PER_CHUNK][index % ZONES_PER_CHUNK];
+        }
+    };
+
+    /**
+     * This holds everything shared by all threads recording the timeline.
+     */
+    struct Registry {
+        /**
+         * This indicates whether or not the timeline is being recorded.
+         */
+        std::atomic< bool > recording;
+
+        /**
+         * This is incremented whenever the timeline is cleared, so that
+         * each thread can discard its zones the next time it records one.
+         */
+        std::atomic< uint64_t > generation;
+
+        /**
+         * This is the time from which all zones are measured.
+         */
+        const std::chrono::steady_clock::time_point epoch;
+
+        /**
+         * This is used to synchronize access to the list of the zones
+         * recorded by each thread.
+         */
+        std::mutex mutex;
+
+        /**
+         * These are the zones recorded by each thread which has recorded
+         * any and either is still running or recorded zones which haven't
+         * yet been cleared.
+         */
+        std::vector< std::shared_ptr< ThreadZones > > threads;
+
+        /**
+         * These are the zones recorded by threads which have exited,
+         * but whose zones haven't yet been cleared.
+         */
+        std::vector< std::shared_ptr< ThreadZones > > exitedThreads;
+
+        /**
+         * This is the number to use to identify the next thread to record
+         * zones on the timeline.
+         */
+        size_t nextThreadId = 1;
+
+        /**
+         * This is the constructor for the structure.
+         */
+        Registry()
+            : recording(false)
+            , generation(0)
+            , epoch(std::chrono::steady_clock::now())
+        {
+        }
+
+        /**
+         * This method stops keeping the zones recorded by the given thread.
+         * The zones themselves are released once nothing else is still
+         * reading them.
+         *
+         * Its caller must hold the mutex.
+         *
+         * @param[in] threadZones
+         *     These are the zones recorded by the thread.
+         */
+        void Forget(const std::shared_ptr< ThreadZones >& threadZones) {
+            threads.erase(
+                std::remove(threads.begin(), threads.end(), threadZones),
+                threads.end()
+            );
+        }
+    };
+
+    /**
+     * This function returns the one registry shared by all threads
+     * recording the timeline.
+     *
+     * @return
+     *     The registry shared by all threads recording the timeline
+     *     is returned.
+     */
+    Registry& GetRegistry() {
+        static Registry registry;
+        return registry;
+    }
+
+    /**
+     * This function returns the number of nanoseconds since the
+     * timeline epoch.
+     *
+     * @return
+     *     The number of nanoseconds since the timeline epoch is returned.
+     */
+    uint64_t Now() {
+        return (uint64_t)std::chrono::duration_cast< std::chrono::nanoseconds >(
+            std::chrono::steady_clock::now() - GetRegistry().epoch
+        ).count();
+    }
+
+    /**
+     * This is owned by each thread which records zones, and hands the
+     * zones it recorded back to the registry when the thread exits.
+     */
+    struct ThreadZonesOwner {
+        /**
+         * These are the zones recorded by the thread.
+         */
+        std::shared_ptr< ThreadZones > threadZones;
+
+        /**
+         * This is the destructor for the structure.  If the zones recorded
+         * by the thread have already been cleared, they're released right
+         * away.  Otherwise they're kept until the timeline is cleared,
+         * so that they still show up on the timeline.
+         */
+        ~ThreadZonesOwner() noexcept {
+            if (threadZones == nullptr) {
+                return;
+            }
+            auto& registry = GetRegistry();
+            std::lock_guard< decltype(registry.mutex) > lock(registry.mutex);
+            if (
+                (threadZones->generation.load() == registry.generation.load())
+                && (threadZones->count.load() > 0)
+            ) {
+                registry.exitedThreads.push_back(threadZones);
+            } else {
+                registry.Forget(threadZones);
+            }
+        }
+    };
+
+    /**
+     * This function returns the zones recorded by the calling thread,
+     * setting them up the first time the thread records a zone.
+     *
+     * @return
+     *     The zones recorded by the calling thread are returned.
+     */
+    ThreadZones& GetThreadZones() {
+        thread_local ThreadZonesOwner owner;
+        if (owner.threadZones == nullptr) {
+            owner.threadZones = std::make_shared< ThreadZones >();
+            auto& registry = GetRegistry();
+            std::lock_guard< decltype(registry.mutex) > lock(registry.mutex);
+            owner.threadZones->threadId = registry.nextThreadId++;
+            owner.threadZones->generation = registry.generation.load();
+            registry.threads.push_back(owner.threadZones);
+        }
+        return *owner.threadZones;
+    }
+
+    /**
+     * This function escapes the given string for use within a
+     * JSON string.
+     *
+     * @param[in] s
+     *     This is the string to escape.
+     *
+     * @return
+     *     The escaped string is returned.
+     */
+    std::string EscapeJson(const char* s) {
+        std::string escaped;
+        for (; *s != '\0'; ++s) {
+            if ((*s == '"') || (*s == '\\')) {
+                escaped += '\\';
+            }
+            escaped += *s;
+        }
+        return escaped;
+    }
+
+}
+
+namespace Twitch {
+
+    TimelineZone::~TimelineZone() noexcept {
+        if (!recording_) {
+            return;
+        }
+        auto& threadZones = GetThreadZones();
+        const auto generation = GetRegistry().generation.load(std::memory_order_relaxed);
+        if (threadZones.generation.load(std::memory_order_relaxed) != generation) {
+            threadZones.count.store(0, std::memory_order_relaxed);
+            threadZones.generation.store(generation, std::memory_order_release);
+        }
+        const auto count = threadZones.count.load(std::memory_order_relaxed);
+        if (count >= MAX_ZONES_PER_THREAD) {
+            return;
+        }
+        auto& chunk = threadZones.chunks[count / ZONES_PER_CHUNK];
+        if (chunk == nullptr) {
+            chunk.reset(new Zone[ZONES_PER_CHUNK]);
+        }
+        auto& zone = chunk[count % ZONES_PER_CHUNK];
+        zone.name = name_;
+        zone.start = start_;
+        zone.duration = Now() - start_;
+        threadZones.count.store(count + 1, std::memory_order_release);
+    }
+
+    TimelineZone::TimelineZone(const char* name)
+        : name_(name)
+    {
+        if (GetRegistry().recording.load(std::memory_order_relaxed)) {
+            recording_ = true;
+            start_ = Now();
+        }
+    }
+
+    size_t TimelineZone::GetThreadsHeld() {
+        auto& registry = GetRegistry();
+        std::lock_guard< decltype(registry.mutex) > lock(registry.mutex);
+        return registry.threads.size();
+    }
+
+    namespace Timeline {
+
+        bool IsCompiledIn() {
+#ifdef TWITCH_ENABLE_TRACING
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        void Start() {
+            GetRegistry().recording = true;
+        }
+
+        void Stop() {
+            GetRegistry().recording = false;
+        }
+
+        void Clear() {
+            auto& registry = GetRegistry();
+            std::lock_guard< decltype(registry.mutex) > lock(registry.mutex);
+            ++registry.generation;
+            for (const auto& threadZones: registry.exitedThreads) {
+                registry.Forget(threadZones);
+            }
+            registry.exitedThreads.clear();
+        }
+
+        std::string GetChromeTrace() {
+            auto& registry = GetRegistry();
+            std::vector< std::shared_ptr< ThreadZones > > threads;
+            {
+                std::lock_guard< decltype(registry.mutex) > lock(registry.mutex);
+                threads = registry.threads;
+            }
+            const auto generation = registry.generation.load();
+            std::string output = "{\"traceEvents\":[";
+            bool first = true;
+            for (const auto& threadZones: threads) {
+                if (threadZones->generation.load(std::memory_order_acquire) != generation) {
+                    continue;
+                }
+                const auto count = threadZones->count.load(std::memory_order_acquire);
+                for (size_t i = 0; i < count; ++i) {
+                    const auto& zone = threadZones->GetZone(i);
+                    char timing[96];
+                    (void)snprintf(
+                        timing,
+                        sizeof(timing),
+                        "\"ts\":%" PRIu64 ".%03u,\"dur\":%" PRIu64 ".%03u",
+                        zone.start / 1000, (unsigned int)(zone.start % 1000),
+                        zone.duration / 1000, (unsigned int)(zone.duration % 1000)
+                    );
+                    if (!first) {
+                        output += ",";
+                    }
+                    first = false;
+                    output += (
+                        "\n{\"name\":\"" + EscapeJson(zone.name)
+                        + "\",\"cat\":\"Twitch\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                        + std::to_string(threadZones->threadId)
+                        + "," + timing + "}"
+                    );
+                }
+            }
+            output += "\n],\"displayTimeUnit\":\"ns\"}\n";
+            return output;
+        }
+
+        bool WriteChromeTrace(const std::string& filePath) {
+            std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                return false;
+            }
+            file << GetChromeTrace();
+            return (bool)file;
+        }
+
+    }
+
+}
@@ -0,0 +1,93 @@
+#ifndef TWITCH_TIMELINE_ZONE_HPP
+#define TWITCH_TIMELINE_ZONE_HPP
+
+/**
+ * @file TimelineZone.hpp
+ *
+ * This module declares the Twitch::TimelineZone class and the
+ * TWITCH_TIMELINE_ZONE macro.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * This macro records, on the timeline, the time spent from where it
+ * appears until the end of the enclosing scope, if the library is built
+ * with TWITCH_ENABLE_TRACING defined.  Otherwise it expands to nothing.
+ *
+ * @param[in] name
+ *     This is the name to give the zone on the timeline.  It must remain
+ *     valid for as long as the program runs, such as a string literal.
+ */
+#ifdef TWITCH_ENABLE_TRACING
+#define TWITCH_TIMELINE_ZONE_CONCATENATE2(a, b) a##b
+#define TWITCH_TIMELINE_ZONE_CONCATENATE(a, b) TWITCH_TIMELINE_ZONE_CONCATENATE2(a, b)
+#define TWITCH_TIMELINE_ZONE(name) \
+    const Twitch::TimelineZone TWITCH_TIMELINE_ZONE_CONCATENATE(timelineZone, __LINE__)(name)
+#else
+#define TWITCH_TIMELINE_ZONE(name)
+#endif
+
+namespace Twitch {
+
+    /**
+     * This records, on the timeline, the time spent from when it's
+     * constructed until it's destroyed, if the timeline is being recorded.
+     */
+    class TimelineZone {
+        // Lifecycle management
+    public:
+        ~TimelineZone() noexcept;
+        TimelineZone(const TimelineZone&) = delete;
+        TimelineZone(TimelineZone&&) noexcept = delete;
+        TimelineZone& operator=(const TimelineZone&) = delete;
+        TimelineZone& operator=(TimelineZone&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This constructs the zone, beginning it.
+         *
+         * @param[in] name
+         *     This is the name to give the zone on the timeline.  It must
+         *     remain valid for as long as the program runs.
+         */
+        explicit TimelineZone(const char* name);
+
+        /**
+         * This function returns the number of threads whose zones the
+         * timeline is currently holding, including threads which have
+         * exited but whose zones haven't yet been cleared.
+         *
+         * @return
+         *     The number of threads whose zones the timeline is currently
+         *     holding is returned.
+         */
+        static size_t GetThreadsHeld();
+
+        // Private properties
+    private:
+        /**
+         * This is the name to give the zone on the timeline.
+         */
+        const char* name_;
+
+        /**
+         * This indicates whether or not the timeline was being recorded
+         * when the zone began.
+         */
+        bool recording_ = false;
+
+        /**
+         * This is when the zone began, in nanoseconds since the timeline
+         * epoch.
+         */
+        uint64_t start_ = 0;
+    };
+
+}
+
+#endif /* TWITCH_TIMELINE_ZONE_HPP */
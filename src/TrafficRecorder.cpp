@@ -0,0 +1,528 @@
+/**
+ * @file TrafficRecorder.cpp
+ *
+ * This module contains the implementation of the Twitch::TrafficRecorder
+ * class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <inttypes.h>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <Twitch/TrafficRecorder.hpp>
+#include <vector>
+
+namespace {
+
+    /**
+     * These are the characters at the beginning of every file
+     * of recorded traffic.
+     */
+    const char MAGIC[4] = {'T', 'T', 'R', '1'};
+
+    /**
+     * This is the number of bytes in each record ahead of the line.
+     */
+    constexpr size_t RECORD_HEADER_SIZE = 1 + 8 + 4;
+
+    /**
+     * This is how often the ring buffer is drained to the file,
+     * in milliseconds.
+     */
+    constexpr int DRAIN_INTERVAL_MILLISECONDS = 10;
+
+    /**
+     * This is the prefix of the line sent to log in, which carries
+     * the OAuth token which must not be recorded.
+     */
+    const std::string PASS_PREFIX = "PASS oauth:";
+
+    /**
+     * This is what replaces the line sent to log in, in order to keep
+     * the OAuth token out of the recording.
+     */
+    const std::string PASS_REDACTED = "PASS oauth:**********************";
+
+    /**
+     * This function returns the current time in microseconds since the
+     * UNIX epoch.
+     *
+     * @return
+     *     The current time in microseconds since the UNIX epoch is returned.
+     */
+    uint64_t Now() {
+        return (uint64_t)std::chrono::duration_cast< std::chrono::microseconds >(
+            std::chrono::system_clock::now().time_since_epoch()
+        ).count();
+    }
+
+    /**
+     * This function makes the line terminators in the given data visible,
+     * so that the data can be shown on one line.
+     *
+     * @param[in] data
+     *     This is the data to show.
+     *
+     * @return
+     *     The given data, with carriage returns and line feeds replaced
+     *     by escape sequences, is returned.
+     */
+    std::string EscapeData(const std::string& data) {
+        std::string escaped;
+        for (const auto c: data) {
+            if (c == '\r') {
+                escaped += "\\r";
+            } else if (c == '\n') {
+                escaped += "\\n";
+            } else if (c == '\\') {
+                escaped += "\\\\";
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    /**
+     * This function encodes the header of a record into the given buffer.
+     *
+     * @param[out] header
+     *     This is where to store the encoded record header.
+     *
+     * @param[in] type
+     *     This is the type of record.
+     *
+     * @param[in] time
+     *     This is the time of the record.
+     *
+     * @param[in] length
+     *     This is the length of the line in the record.
+     */
+    void EncodeRecordHeader(
+        uint8_t (&header)[RECORD_HEADER_SIZE],
+        Twitch::TrafficRecorder::Record::Type type,
+        uint64_t time,
+        uint32_t length
+    ) {
+        header[0] = (uint8_t)type;
+        for (size_t i = 0; i < 8; ++i) {
+            header[1 + i] = (uint8_t)(time >> (8 * i));
+        }
+        for (size_t i = 0; i < 4; ++i) {
+            header[9 + i] = (uint8_t)(length >> (8 * i));
+        }
+    }
+
+}
+
+namespace Twitch {
+
+    /**
+     * This contains the private properties of a TrafficRecorder instance.
+     */
+    struct TrafficRecorder::Impl {
+        // Properties
+
+        /**
+         * This is the ring buffer holding records not yet written
+         * to the file.
+         */
+        std::vector< uint8_t > ring;
+
+        /**
+         * This is used to wrap indexes into the ring buffer.
+         */
+        size_t ringMask = 0;
+
+        /**
+         * This is the total number of bytes ever put into the ring buffer.
+         * Only the recording thread writes it.
+         */
+        std::atomic< size_t > writeIndex;
+
+        /**
+         * This is the total number of bytes ever taken out of the ring
+         * buffer.  Only the drain thread writes it.
+         */
+        std::atomic< size_t > readIndex;
+
+        /**
+         * This is the number of records dropped, because the ring buffer
+         * was full, since the last Dropped record was written.
+         */
+        std::atomic< size_t > dropped;
+
+        /**
+         * This indicates whether or not lines are being recorded.
+         */
+        std::atomic< bool > recording;
+
+        /**
+         * This identifies the one thread allowed to record lines, which is
+         * the first thread to record a line after recording is started.
+         * Lines recorded from any other thread are refused, since the
+         * ring buffer has room for only one producer.
+         */
+        std::atomic< std::thread::id > producer;
+
+        /**
+         * This is the number of calls to record lines currently
+         * in progress.  Stop waits for it to reach zero before
+         * draining the ring buffer for the last time.
+         */
+        std::atomic< size_t > recordsInProgress;
+
+        /**
+         * This is the file to which records are written.
+         */
+        FILE* file = NULL;
+
+        /**
+         * This is used to synchronize access to the drain thread
+         * stop flag.
+         */
+        std::mutex mutex;
+
+        /**
+         * This is used to wake up the drain thread when it should stop.
+         */
+        std::condition_variable drainWakeCondition;
+
+        /**
+         * This flag indicates whether or not the drain thread should stop.
+         */
+        bool stopDrainer = false;
+
+        /**
+         * This thread writes records from the ring buffer to the file.
+         */
+        std::thread drainer;
+
+        // Methods
+
+        /**
+         * This is the constructor for the structure.
+         */
+        Impl()
+            : writeIndex(0)
+            , readIndex(0)
+            , dropped(0)
+            , recording(false)
+            , recordsInProgress(0)
+        {
+        }
+
+        /**
+         * This method copies the given bytes into the ring buffer at the
+         * given index, wrapping around the end of the buffer if necessary.
+         *
+         * @param[in] index
+         *     This is the total number of bytes put into the ring buffer
+         *     ahead of the bytes to copy.
+         *
+         * @param[in] data
+         *     This points to the bytes to copy.
+         *
+         * @param[in] length
+         *     This is the number of bytes to copy.
+         */
+        void CopyIntoRing(
+            size_t index,
+            const void* data,
+            size_t length
+        ) {
+            const auto offset = (index & ringMask);
+            const auto firstPart = std::min(length, ring.size() - offset);
+            (void)memcpy(ring.data() + offset, data, firstPart);
+            if (firstPart < length) {
+                (void)memcpy(
+                    ring.data(),
+                    (const uint8_t*)data + firstPart,
+                    length - firstPart
+                );
+            }
+        }
+
+        /**
+         * This method puts a record into the ring buffer, or counts it as
+         * dropped if the ring buffer doesn't have room for it.
+         *
+         * @param[in] type
+         *     This is the type of record.
+         *
+         * @param[in] line
+         *     This is the line to record.
+         *
+         * @return
+         *     An indication of whether or not the line was recorded
+         *     is returned.
+         */
+        bool RecordLine(
+            Record::Type type,
+            const std::string& line
+        ) {
+            ++recordsInProgress;
+            if (!recording) {
+                --recordsInProgress;
+                return false;
+            }
+            const auto self = std::this_thread::get_id();
+            auto expectedProducer = std::thread::id();
+            if (
+                !producer.compare_exchange_strong(expectedProducer, self)
+                && (expectedProducer != self)
+            ) {
+                --recordsInProgress;
+                return false;
+            }
+            const auto write = writeIndex.load(std::memory_order_relaxed);
+            const auto read = readIndex.load(std::memory_order_acquire);
+            const auto recordSize = RECORD_HEADER_SIZE + line.length();
+            if (recordSize > ring.size() - (write - read)) {
+                ++dropped;
+                --recordsInProgress;
+                return false;
+            }
+            uint8_t header[RECORD_HEADER_SIZE];
+            EncodeRecordHeader(header, type, Now(), (uint32_t)line.length());
+            CopyIntoRing(write, header, sizeof(header));
+            CopyIntoRing(write + sizeof(header), line.data(), line.length());
+            writeIndex.store(write + recordSize, std::memory_order_release);
+            --recordsInProgress;
+            return true;
+        }
+
+        /**
+         * This method writes to the file all records currently in the
+         * ring buffer, followed by a record of how many records were
+         * dropped, if any were.
+         */
+        void Drain() {
+            const auto write = writeIndex.load(std::memory_order_acquire);
+            const auto read = readIndex.load(std::memory_order_relaxed);
+            if (write != read) {
+                const auto offset = (read & ringMask);
+                const auto length = write - read;
+                const auto firstPart = std::min(length, ring.size() - offset);
+                (void)fwrite(ring.data() + offset, 1, firstPart, file);
+                if (firstPart < length) {
+                    (void)fwrite(ring.data(), 1, length - firstPart, file);
+                }
+                readIndex.store(write, std::memory_order_release);
+            }
+            const auto droppedNow = dropped.exchange(0);
+            if (droppedNow > 0) {
+                const auto count = std::to_string(droppedNow);
+                uint8_t header[RECORD_HEADER_SIZE];
+                EncodeRecordHeader(header, Record::Type::Dropped, Now(), (uint32_t)count.length());
+                (void)fwrite(header, 1, sizeof(header), file);
+                (void)fwrite(count.data(), 1, count.length(), file);
+            }
+            (void)fflush(file);
+        }
+
+        /**
+         * This method is called in a separate thread to periodically
+         * write records from the ring buffer to the file.
+         */
+        void Drainer() {
+            std::unique_lock< decltype(mutex) > lock(mutex);
+            while (!stopDrainer) {
+                (void)drainWakeCondition.wait_for(
+                    lock,
+                    std::chrono::milliseconds(DRAIN_INTERVAL_MILLISECONDS),
+                    [this]{ return stopDrainer; }
+                );
+                lock.unlock();
+                Drain();
+                lock.lock();
+            }
+        }
+    };
+
+    TrafficRecorder::~TrafficRecorder() noexcept {
+        Stop();
+    }
+
+    TrafficRecorder::TrafficRecorder()
+        : impl_(new Impl())
+    {
+    }
+
+    bool TrafficRecorder::Start(
+        const std::string& filePath,
+        size_t capacity
+    ) {
+        Stop();
+        impl_->file = fopen(filePath.c_str(), "wb");
+        if (impl_->file == NULL) {
+            return false;
+        }
+        (void)fwrite(MAGIC, 1, sizeof(MAGIC), impl_->file);
+        size_t ringSize = 1;
+        while (ringSize < capacity) {
+            ringSize <<= 1;
+        }
+        impl_->ring.resize(ringSize);
+        impl_->ringMask = ringSize - 1;
+        impl_->writeIndex = 0;
+        impl_->readIndex = 0;
+        impl_->dropped = 0;
+        impl_->producer = std::thread::id();
+        impl_->stopDrainer = false;
+        impl_->drainer = std::thread(&Impl::Drainer, impl_.get());
+        impl_->recording = true;
+        return true;
+    }
+
+    void TrafficRecorder::Stop() {
+        if (!impl_->drainer.joinable()) {
+            return;
+        }
+        impl_->recording = false;
+        while (impl_->recordsInProgress != 0) {
+            std::this_thread::yield();
+        }
+        {
+            std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+            impl_->stopDrainer = true;
+            impl_->drainWakeCondition.notify_all();
+        }
+        impl_->drainer.join();
+        impl_->Drain();
+        (void)fclose(impl_->file);
+        impl_->file = NULL;
+    }
+
+    bool TrafficRecorder::RecordReceived(const std::string& line) {
+        return impl_->RecordLine(Record::Type::Received, line);
+    }
+
+    bool TrafficRecorder::RecordSent(const std::string& line) {
+        if (line.compare(0, PASS_PREFIX.length(), PASS_PREFIX) == 0) {
+            return impl_->RecordLine(Record::Type::Sent, PASS_REDACTED);
+        } else {
+            return impl_->RecordLine(Record::Type::Sent, line);
+        }
+    }
+
+    std::string TrafficRecorder::Redact(const std::string& data) {
+        std::string redacted;
+        size_t lineStart = 0;
+        while (lineStart < data.length()) {
+            auto lineEnd = data.find('\n', lineStart);
+            lineEnd = ((lineEnd == std::string::npos) ? data.length() : lineEnd + 1);
+            if (data.compare(lineStart, PASS_PREFIX.length(), PASS_PREFIX) == 0) {
+                redacted += PASS_REDACTED;
+                if (
+                    (lineEnd - lineStart >= 2)
+                    && (data[lineEnd - 2] == '\r')
+                ) {
+                    redacted += "\r\n";
+                } else if (data[lineEnd - 1] == '\n') {
+                    redacted += "\n";
+                }
+            } else {
+                redacted.append(data, lineStart, lineEnd - lineStart);
+            }
+            lineStart = lineEnd;
+        }
+        return redacted;
+    }
+
+    bool TrafficRecorder::WriteHeader(std::ostream& output) {
+        return (bool)output.write(MAGIC, sizeof(MAGIC));
+    }
+
+    bool TrafficRecorder::WriteRecord(
+        std::ostream& output,
+        const Record& record
+    ) {
+        uint8_t header[RECORD_HEADER_SIZE];
+        EncodeRecordHeader(header, record.type, record.time, (uint32_t)record.line.length());
+        return (
+            output.write((const char*)header, sizeof(header))
+            && output.write(record.line.data(), record.line.length())
+        );
+    }
+
+    bool TrafficRecorder::ReadHeader(std::istream& input) {
+        char magic[sizeof(MAGIC)];
+        if (!input.read(magic, sizeof(magic))) {
+            return false;
+        }
+        return (memcmp(magic, MAGIC, sizeof(MAGIC)) == 0);
+    }
+
+    bool TrafficRecorder::ReadRecord(
+        std::istream& input,
+        Record& record
+    ) {
+        uint8_t header[RECORD_HEADER_SIZE];
+        if (!input.read((char*)header, sizeof(header))) {
+            return false;
+        }
+        if (header[0] > (uint8_t)Record::Type::Disconnected) {
+            return false;
+        }
+        record.type = (Record::Type)header[0];
+        record.time = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            record.time |= ((uint64_t)header[1 + i] << (8 * i));
+        }
+        uint32_t length = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            length |= ((uint32_t)header[9 + i] << (8 * i));
+        }
+        record.line.resize(length);
+        if (length == 0) {
+            return true;
+        }
+        return (bool)input.read(&record.line[0], length);
+    }
+
+    std::string TrafficRecorder::FormatRecord(const Record& record) {
+        char time[32];
+        (void)snprintf(
+            time,
+            sizeof(time),
+            "%" PRIu64 ".%06" PRIu64,
+            record.time / 1000000,
+            record.time % 1000000
+        );
+        switch (record.type) {
+            case Record::Type::Received: {
+                return std::string(time) + " > " + record.line;
+            }
+
+            case Record::Type::Sent: {
+                return std::string(time) + " < " + record.line;
+            }
+
+            case Record::Type::ReceivedData: {
+                return std::string(time) + " >> " + EscapeData(record.line);
+            }
+
+            case Record::Type::SentData: {
+                return std::string(time) + " << " + EscapeData(record.line);
+            }
+
+            case Record::Type::Disconnected: {
+                return std::string(time) + " ! disconnected";
+            }
+
+            case Record::Type::Dropped:
+            default: {
+                return std::string(time) + " ! " + record.line + " records dropped";
+            }
+        }
+    }
+
+}
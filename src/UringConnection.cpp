@@ -0,0 +1,1494 @@
+/**
+ * @file UringConnection.cpp
+ *
+ * This module contains the implementation of the Twitch::UringReactor and
+ * Twitch::UringConnection classes.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "TcpSocket.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <thread>
+#include <Twitch/EpollConnection.hpp>
+#include <Twitch/UringConnection.hpp>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the number of entries in the submission queue.
+     */
+    constexpr unsigned int RING_ENTRIES = 256;
+
+    /**
+     * This is the number of buffers provided to the kernel for receiving.
+     * It must be a power of two.
+     */
+    constexpr unsigned int BUFFER_COUNT = 256;
+
+    /**
+     * This is the size of each buffer provided to the kernel
+     * for receiving.
+     */
+    constexpr size_t BUFFER_SIZE = 16384;
+
+    /**
+     * This is the most number of buffers lent out to receivers at once.
+     * Anything received while this many are lent out is copied out of
+     * its buffer instead, so that the kernel is always left with buffers
+     * to receive into, however long receivers hold on to the ones they
+     * were lent.
+     */
+    constexpr unsigned int MAX_BUFFERS_LENT = BUFFER_COUNT / 2;
+
+    /**
+     * This is the identifier of the group of buffers provided to the
+     * kernel for receiving.
+     */
+    constexpr uint16_t BUFFER_GROUP = 0;
+
+    /**
+     * This is how long Disconnect waits for a send in progress to finish
+     * before breaking the connection anyway.
+     */
+    constexpr auto DISCONNECT_SEND_TIMEOUT = std::chrono::seconds(1);
+
+    /**
+     * These are the kinds of operations submitted to the kernel.  Each
+     * is stored in the low byte of the user data of the operation, with
+     * the identifier of the socket in the rest.
+     */
+    enum class Operation : uint8_t {
+        /**
+         * Read the event used to wake up the reactor thread.
+         */
+        Wake = 0,
+
+        /**
+         * Receive data from a socket, as many times as data arrives.
+         */
+        Receive = 1,
+
+        /**
+         * Send data to a socket.
+         */
+        Send = 2,
+
+        /**
+         * Cancel receiving data from a socket.
+         */
+        Cancel = 3,
+
+        /**
+         * Give buffers to the kernel to receive into.
+         */
+        Provide = 4,
+    };
+
+    /**
+     * This function returns the user data to attach to the given kind
+     * of operation on the given socket.
+     *
+     * @param[in] identifier
+     *     This is the identifier of the socket.
+     *
+     * @param[in] operation
+     *     This is the kind of operation.
+     *
+     * @return
+     *     The user data to attach to the operation is returned.
+     */
+    uint64_t MakeUserData(uint64_t identifier, Operation operation) {
+        return (identifier << 8) | (uint64_t)operation;
+    }
+
+    /**
+     * This function sets up an io_uring instance.
+     *
+     * @param[in] entries
+     *     This is the number of entries in the submission queue.
+     *
+     * @param[in,out] params
+     *     This holds the parameters of the io_uring instance.
+     *
+     * @return
+     *     The operating system handle of the io_uring instance is returned.
+     *
+     * @retval -1
+     *     This is returned if the io_uring instance could not be set up.
+     */
+    int SetUpRing(unsigned int entries, struct io_uring_params& params) {
+        return (int)syscall(__NR_io_uring_setup, entries, &params);
+    }
+
+    /**
+     * This function submits operations to, and waits for completions from,
+     * the given io_uring instance.
+     *
+     * @param[in] ring
+     *     This is the operating system handle of the io_uring instance.
+     *
+     * @param[in] toSubmit
+     *     This is the number of operations to submit.
+     *
+     * @param[in] minComplete
+     *     This is the number of completions to wait for.
+     *
+     * @param[in] flags
+     *     These are the IORING_ENTER_ flags to pass.
+     *
+     * @return
+     *     The number of operations submitted, or -1 if an error
+     *     occurred, is returned.
+     */
+    int EnterRing(int ring, unsigned int toSubmit, unsigned int minComplete, unsigned int flags) {
+        return (int)syscall(__NR_io_uring_enter, ring, toSubmit, minComplete, flags, NULL, 0);
+    }
+
+    /**
+     * This function registers something with the given io_uring instance.
+     *
+     * @param[in] ring
+     *     This is the operating system handle of the io_uring instance.
+     *
+     * @param[in] opcode
+     *     This is what to register.
+     *
+     * @param[in] arg
+     *     This points to the argument of the registration.
+     *
+     * @param[in] numArgs
+     *     This is the number of arguments.
+     *
+     * @return
+     *     Zero is returned on success, or -1 if an error occurred.
+     */
+    int RegisterWithRing(int ring, unsigned int opcode, void* arg, unsigned int numArgs) {
+        return (int)syscall(__NR_io_uring_register, ring, opcode, arg, numArgs);
+    }
+
+    /**
+     * This holds everything the reactor knows about one socket.
+     */
+    struct UringSocket {
+        // Properties
+
+        /**
+         * This is used to synchronize access to the properties which
+         * may be used outside the reactor thread.
+         */
+        std::mutex mutex;
+
+        /**
+         * This is used to wait for sends and closing to finish.
+         */
+        std::condition_variable condition;
+
+        /**
+         * This is used to synchronize access to the delegates.  It's
+         * recursive so that the connection may be broken from within
+         * a delegate.
+         */
+        std::recursive_mutex deliveryMutex;
+
+        /**
+         * This is the operating system handle of the socket, or -1 if
+         * there is no socket.
+         */
+        int handle = -1;
+
+        /**
+         * This identifies the socket within its reactor.
+         */
+        uint64_t identifier = 0;
+
+        /**
+         * This indicates whether or not the socket is connected.
+         */
+        bool open = false;
+
+        /**
+         * This indicates whether or not the socket is being closed.
+         */
+        bool closing = false;
+
+        /**
+         * This holds data waiting to be sent.
+         */
+        std::string outbound;
+
+        /**
+         * This indicates whether or not the reactor has been asked
+         * to send what's in the outbound buffer.
+         */
+        bool sendScheduled = false;
+
+        /**
+         * This indicates whether or not a send is in progress.
+         */
+        bool sendInFlight = false;
+
+        /**
+         * This holds the data being sent.  It's only used by the
+         * reactor thread.
+         */
+        std::string inflight;
+
+        /**
+         * This is how much of the data being sent has been sent.
+         * It's only used by the reactor thread.
+         */
+        size_t inflightSent = 0;
+
+        /**
+         * This is the number of operations on the socket which the kernel
+         * hasn't finished.  It's only used by the reactor thread.
+         */
+        size_t outstanding = 0;
+
+        /**
+         * This holds the data last received, as handed to the message
+         * or data received delegate.  It's kept so that its storage is
+         * reused, unless the data received delegate takes it.  It's only
+         * used by the reactor thread.
+         */
+        std::string received;
+
+        /**
+         * This is the function to call whenever any data is received.
+         */
+        Twitch::Connection::MessageReceivedDelegate messageReceivedDelegate;
+
+        /**
+         * This is the function to call whenever any data is received,
+         * handing the data over.  It takes the place of the message
+         * received delegate, if set.
+         */
+        Twitch::ConnectionV2::DataReceivedDelegate dataReceivedDelegate;
+
+        /**
+         * This is the function to call whenever any data is received,
+         * lending out the buffer holding it.  It takes the place of the
+         * data and message received delegates, if set.
+         */
+        Twitch::ConnectionV2::BufferReceivedDelegate bufferReceivedDelegate;
+
+        /**
+         * This is the function to call when the other end closes
+         * the connection.
+         */
+        Twitch::Connection::DisconnectedDelegate disconnectedDelegate;
+    };
+
+    /**
+     * This holds everything shared between a reactor and the
+     * connections it services.
+     */
+    struct UringCore
+        : public std::enable_shared_from_this< UringCore >
+    {
+        // Types
+
+        /**
+         * This holds a request from a connection for the reactor thread
+         * to do something with the connection's socket.
+         */
+        struct Request {
+            /**
+             * These are the kinds of requests.
+             */
+            enum class Type {
+                /**
+                 * Begin servicing the socket.
+                 */
+                Add,
+
+                /**
+                 * Send what's in the socket's outbound buffer.
+                 */
+                Send,
+
+                /**
+                 * Close the socket once the kernel is done with it.
+                 */
+                Close,
+            };
+
+            /**
+             * This is the kind of request.
+             */
+            Type type;
+
+            /**
+             * This is the socket concerned.
+             */
+            std::shared_ptr< UringSocket > socket;
+        };
+
+        // Properties
+
+        /**
+         * This indicates whether or not the reactor was set up.
+         */
+        bool usable = false;
+
+        /**
+         * This is the operating system handle of the io_uring instance.
+         */
+        int ring = -1;
+
+        /**
+         * This is the operating system handle of the event used to wake
+         * up the reactor thread.
+         */
+        int wake = -1;
+
+        /**
+         * This is where the reactor thread reads the event used to wake
+         * it up.
+         */
+        uint64_t wakeValue = 0;
+
+        /**
+         * These are the parameters of the io_uring instance.
+         */
+        struct io_uring_params params;
+
+        /**
+         * This is the mapping of the submission queue ring.
+         */
+        void* submissionRing = MAP_FAILED;
+
+        /**
+         * This is the size of the mapping of the submission queue ring.
+         */
+        size_t submissionRingSize = 0;
+
+        /**
+         * This is the mapping of the completion queue ring, which may
+         * be the same as the mapping of the submission queue ring.
+         */
+        void* completionRing = MAP_FAILED;
+
+        /**
+         * This is the size of the mapping of the completion queue ring.
+         */
+        size_t completionRingSize = 0;
+
+        /**
+         * This is the mapping of the submission queue entries.
+         */
+        struct io_uring_sqe* submissions = (struct io_uring_sqe*)MAP_FAILED;
+
+        /**
+         * This is the size of the mapping of the submission
+         * queue entries.
+         */
+        size_t submissionsSize = 0;
+
+        /**
+         * These point to the fields of the submission queue ring.
+         */
+        unsigned int* submissionHead = nullptr;
+        unsigned int* submissionTail = nullptr;
+        unsigned int submissionMask = 0;
+
+        /**
+         * These point to the fields of the completion queue ring.
+         */
+        unsigned int* completionHead = nullptr;
+        unsigned int* completionTail = nullptr;
+        unsigned int completionMask = 0;
+        struct io_uring_cqe* completions = nullptr;
+
+        /**
+         * This is the number of operations prepared but not yet submitted.
+         */
+        unsigned int toSubmit = 0;
+
+        /**
+         * This is the ring of buffers provided to the kernel
+         * for receiving.
+         */
+        struct io_uring_buf_ring* bufferRing = nullptr;
+
+        /**
+         * This indicates whether or not buffers are given to the kernel
+         * with operations, rather than through the ring of buffers,
+         * because the kernel doesn't take buffers from the ring.
+         */
+        bool classicBuffers = false;
+
+        /**
+         * This is the tail of the ring of buffers provided to the kernel.
+         */
+        uint16_t bufferRingTail = 0;
+
+        /**
+         * This is the memory of the buffers provided to the kernel
+         * for receiving.
+         */
+        std::vector< char > buffers;
+
+        /**
+         * This indicates whether or not the reactor thread should stop.
+         */
+        std::atomic< bool > stopping;
+
+        /**
+         * This counts the system calls made to service sockets.
+         */
+        std::atomic< uint64_t > systemCalls;
+
+        /**
+         * This counts the bytes received which were copied out of the
+         * buffers provided to the kernel, rather than lent out.
+         */
+        std::atomic< uint64_t > bytesCopied;
+
+        /**
+         * This is the number of buffers lent out to receivers and
+         * not yet given back.
+         */
+        std::atomic< unsigned int > buffersLent;
+
+        /**
+         * This is the thread which services sockets.
+         */
+        std::thread thread;
+
+        /**
+         * This is used to synchronize access to the requests.
+         */
+        std::mutex requestsMutex;
+
+        /**
+         * These are the requests waiting for the reactor thread.
+         */
+        std::vector< Request > requests;
+
+        /**
+         * These are the identifiers of the buffers given back by receivers,
+         * waiting for the reactor thread to provide them to the kernel
+         * again.  It's guarded by the requests mutex.
+         */
+        std::vector< uint16_t > buffersReturned;
+
+        /**
+         * This is the identifier to give the next socket added.
+         */
+        std::atomic< uint64_t > nextIdentifier;
+
+        /**
+         * These are the sockets serviced by the reactor, keyed by their
+         * identifiers.  It's only used by the reactor thread.
+         */
+        std::unordered_map< uint64_t, std::shared_ptr< UringSocket > > sockets;
+
+        // Methods
+
+        /**
+         * This is the constructor for the structure.
+         */
+        UringCore()
+            : stopping(false)
+            , systemCalls(0)
+            , bytesCopied(0)
+            , buffersLent(0)
+            , nextIdentifier(1)
+        {
+            (void)memset(&params, 0, sizeof(params));
+        }
+
+        /**
+         * This is the destructor for the structure.
+         */
+        ~UringCore() noexcept {
+            if (bufferRing != nullptr) {
+                struct io_uring_buf_reg registration;
+                (void)memset(&registration, 0, sizeof(registration));
+                registration.bgid = BUFFER_GROUP;
+                (void)RegisterWithRing(ring, IORING_UNREGISTER_PBUF_RING, &registration, 1);
+                free(bufferRing);
+            }
+            if (submissions != MAP_FAILED) {
+                (void)munmap(submissions, submissionsSize);
+            }
+            if (
+                (completionRing != MAP_FAILED)
+                && (completionRing != submissionRing)
+            ) {
+                (void)munmap(completionRing, completionRingSize);
+            }
+            if (submissionRing != MAP_FAILED) {
+                (void)munmap(submissionRing, submissionRingSize);
+            }
+            if (ring >= 0) {
+                (void)close(ring);
+            }
+            if (wake >= 0) {
+                (void)close(wake);
+            }
+        }
+
+        /**
+         * This method sets up the io_uring instance and the buffers
+         * provided to the kernel for receiving.
+         *
+         * @return
+         *     An indication of whether or not the reactor was set up
+         *     is returned.
+         */
+        bool SetUp() {
+            params.flags = IORING_SETUP_COOP_TASKRUN;
+            ring = SetUpRing(RING_ENTRIES, params);
+            if (ring < 0) {
+                (void)memset(&params, 0, sizeof(params));
+                ring = SetUpRing(RING_ENTRIES, params);
+                if (ring < 0) {
+                    return false;
+                }
+            }
+            if ((params.features & IORING_FEAT_NODROP) == 0) {
+                return false;
+            }
+            submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+            completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+            if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+                submissionRingSize = std::max(submissionRingSize, completionRingSize);
+                completionRingSize = submissionRingSize;
+            }
+            submissionRing = mmap(NULL, submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+            if (submissionRing == MAP_FAILED) {
+                return false;
+            }
+            if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+                completionRing = submissionRing;
+            } else {
+                completionRing = mmap(NULL, completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+                if (completionRing == MAP_FAILED) {
+                    return false;
+                }
+            }
+            submissionsSize = params.sq_entries * sizeof(struct io_uring_sqe);
+            submissions = (struct io_uring_sqe*)mmap(NULL, submissionsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+            if (submissions == MAP_FAILED) {
+                return false;
+            }
+            const auto submissionBase = (char*)submissionRing;
+            submissionHead = (unsigned int*)(submissionBase + params.sq_off.head);
+            submissionTail = (unsigned int*)(submissionBase + params.sq_off.tail);
+            submissionMask = *(unsigned int*)(submissionBase + params.sq_off.ring_mask);
+            const auto submissionArray = (unsigned int*)(submissionBase + params.sq_off.array);
+            for (unsigned int i = 0; i < params.sq_entries; ++i) {
+                submissionArray[i] = i;
+            }
+            const auto completionBase = (char*)completionRing;
+            completionHead = (unsigned int*)(completionBase + params.cq_off.head);
+            completionTail = (unsigned int*)(completionBase + params.cq_off.tail);
+            completionMask = *(unsigned int*)(completionBase + params.cq_off.ring_mask);
+            completions = (struct io_uring_cqe*)(completionBase + params.cq_off.cqes);
+            buffers.resize(BUFFER_COUNT * BUFFER_SIZE);
+            if (
+                !SetUpBufferRing()
+                && !SetUpClassicBuffers()
+            ) {
+                return false;
+            }
+            wake = eventfd(0, EFD_CLOEXEC);
+            return (wake >= 0);
+        }
+
+        /**
+         * This method registers a ring of buffers with the kernel and
+         * fills it, then checks that the kernel takes buffers from it.
+         * Some kernels accept the registration without ever handing
+         * out the buffers.
+         *
+         * @return
+         *     An indication of whether or not the kernel takes buffers
+         *     from the ring is returned.
+         */
+        bool SetUpBufferRing() {
+            const auto pageSize = (size_t)sysconf(_SC_PAGESIZE);
+            void* bufferRingMemory = nullptr;
+            if (posix_memalign(&bufferRingMemory, pageSize, BUFFER_COUNT * sizeof(struct io_uring_buf)) != 0) {
+                return false;
+            }
+            (void)memset(bufferRingMemory, 0, BUFFER_COUNT * sizeof(struct io_uring_buf));
+            struct io_uring_buf_reg registration;
+            (void)memset(&registration, 0, sizeof(registration));
+            registration.ring_addr = (uint64_t)(uintptr_t)bufferRingMemory;
+            registration.ring_entries = BUFFER_COUNT;
+            registration.bgid = BUFFER_GROUP;
+            if (RegisterWithRing(ring, IORING_REGISTER_PBUF_RING, &registration, 1) != 0) {
+                free(bufferRingMemory);
+                return false;
+            }
+            bufferRing = (struct io_uring_buf_ring*)bufferRingMemory;
+            for (unsigned int i = 0; i < BUFFER_COUNT; ++i) {
+                ProvideBuffer((uint16_t)i);
+            }
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0) {
+                return false;
+            }
+            const char probe = 0;
+            (void)write(pair[1], &probe, sizeof(probe));
+            const auto submission = GetSubmission();
+            submission->opcode = IORING_OP_RECV;
+            submission->fd = pair[0];
+            submission->flags = IOSQE_BUFFER_SELECT;
+            submission->buf_group = BUFFER_GROUP;
+            submission->user_data = MakeUserData(0, Operation::Receive);
+            const auto completion = SubmitAndAwaitCompletion();
+            (void)close(pair[0]);
+            (void)close(pair[1]);
+            if (completion.res > 0) {
+                ProvideBuffer((uint16_t)(completion.flags >> IORING_CQE_BUFFER_SHIFT));
+                return true;
+            }
+            (void)memset(&registration, 0, sizeof(registration));
+            registration.bgid = BUFFER_GROUP;
+            (void)RegisterWithRing(ring, IORING_UNREGISTER_PBUF_RING, &registration, 1);
+            free(bufferRing);
+            bufferRing = nullptr;
+            return false;
+        }
+
+        /**
+         * This method hands all the buffers to the kernel with one
+         * operation, for kernels which don't take buffers from a ring.
+         * Buffers are then given back one operation at a time, submitted
+         * along with everything else.
+         *
+         * @return
+         *     An indication of whether or not the kernel took
+         *     the buffers is returned.
+         */
+        bool SetUpClassicBuffers() {
+            classicBuffers = true;
+            const auto submission = GetSubmission();
+            submission->opcode = IORING_OP_PROVIDE_BUFFERS;
+            submission->fd = (int)BUFFER_COUNT;
+            submission->addr = (uint64_t)(uintptr_t)buffers.data();
+            submission->len = (uint32_t)BUFFER_SIZE;
+            submission->off = 0;
+            submission->buf_group = BUFFER_GROUP;
+            submission->user_data = MakeUserData(0, Operation::Provide);
+            return (SubmitAndAwaitCompletion().res >= 0);
+        }
+
+        /**
+         * This method submits what's been prepared and waits for
+         * one completion, while the reactor thread isn't running.
+         *
+         * @return
+         *     The completion is returned.
+         */
+        struct io_uring_cqe SubmitAndAwaitCompletion() {
+            struct io_uring_cqe completion;
+            (void)memset(&completion, 0, sizeof(completion));
+            completion.res = -EIO;
+            if (EnterRing(ring, toSubmit, 1, IORING_ENTER_GETEVENTS) < 0) {
+                return completion;
+            }
+            toSubmit = 0;
+            const auto head = *completionHead;
+            if (head != __atomic_load_n(completionTail, __ATOMIC_ACQUIRE)) {
+                completion = completions[head & completionMask];
+                __atomic_store_n(completionHead, head + 1, __ATOMIC_RELEASE);
+            }
+            return completion;
+        }
+
+        /**
+         * This method gives the buffer with the given identifier back
+         * to the kernel to receive into.
+         *
+         * @param[in] buffer
+         *     This is the identifier of the buffer.
+         */
+        void ProvideBuffer(uint16_t buffer) {
+            if (classicBuffers) {
+                const auto submission = GetSubmission();
+                submission->opcode = IORING_OP_PROVIDE_BUFFERS;
+                submission->fd = 1;
+                submission->addr = (uint64_t)(uintptr_t)(buffers.data() + buffer * BUFFER_SIZE);
+                submission->len = (uint32_t)BUFFER_SIZE;
+                submission->off = buffer;
+                submission->buf_group = BUFFER_GROUP;
+                submission->user_data = MakeUserData(0, Operation::Provide);
+                return;
+            }
+            auto& entry = bufferRing->bufs[bufferRingTail & (BUFFER_COUNT - 1)];
+            entry.addr = (uint64_t)(uintptr_t)(buffers.data() + buffer * BUFFER_SIZE);
+            entry.len = (uint32_t)BUFFER_SIZE;
+            entry.bid = buffer;
+            ++bufferRingTail;
+            __atomic_store_n(&bufferRing->tail, bufferRingTail, __ATOMIC_RELEASE);
+        }
+
+        /**
+         * This method returns the next free submission queue entry,
+         * submitting what's been prepared first if the queue is full.
+         *
+         * @return
+         *     The next free submission queue entry, cleared, is returned.
+         */
+        struct io_uring_sqe* GetSubmission() {
+            const auto tail = *submissionTail;
+            if (tail - __atomic_load_n(submissionHead, __ATOMIC_ACQUIRE) >= params.sq_entries) {
+                (void)systemCalls.fetch_add(1, std::memory_order_relaxed);
+                const auto submitted = EnterRing(ring, toSubmit, 0, 0);
+                if (submitted > 0) {
+                    toSubmit -= (unsigned int)submitted;
+                }
+            }
+            const auto submission = &submissions[tail & submissionMask];
+            (void)memset(submission, 0, sizeof(*submission));
+            __atomic_store_n(submissionTail, tail + 1, __ATOMIC_RELEASE);
+            ++toSubmit;
+            return submission;
+        }
+
+        /**
+         * This method prepares the operation which reads the event
+         * used to wake up the reactor thread.
+         */
+        void SubmitWake() {
+            const auto submission = GetSubmission();
+            submission->opcode = IORING_OP_READ;
+            submission->fd = wake;
+            submission->addr = (uint64_t)(uintptr_t)&wakeValue;
+            submission->len = sizeof(wakeValue);
+            submission->off = (uint64_t)-1;
+            submission->user_data = MakeUserData(0, Operation::Wake);
+        }
+
+        /**
+         * This method prepares the multishot receive on the given socket.
+         *
+         * @param[in,out] socket
+         *     This is the socket on which to receive.
+         */
+        void SubmitReceive(UringSocket& socket) {
+            const auto submission = GetSubmission();
+            submission->opcode = IORING_OP_RECV;
+            submission->fd = socket.handle;
+            submission->flags = IOSQE_BUFFER_SELECT;
+            submission->buf_group = BUFFER_GROUP;
+            submission->ioprio = IORING_RECV_MULTISHOT;
+            submission->user_data = MakeUserData(socket.identifier, Operation::Receive);
+            ++socket.outstanding;
+        }
+
+        /**
+         * This method prepares sending the rest of the data being sent
+         * on the given socket.
+         *
+         * @param[in,out] socket
+         *     This is the socket on which to send.
+         */
+        void SubmitSend(UringSocket& socket) {
+            const auto submission = GetSubmission();
+            submission->opcode = IORING_OP_SEND;
+            submission->fd = socket.handle;
+            submission->addr = (uint64_t)(uintptr_t)(socket.inflight.data() + socket.inflightSent);
+            submission->len = (uint32_t)(socket.inflight.length() - socket.inflightSent);
+            submission->msg_flags = MSG_NOSIGNAL;
+            submission->user_data = MakeUserData(socket.identifier, Operation::Send);
+            ++socket.outstanding;
+        }
+
+        /**
+         * This method prepares cancelling the receive on the given socket.
+         *
+         * @param[in] socket
+         *     This is the socket on which to cancel receiving.
+         */
+        void SubmitCancel(const UringSocket& socket) {
+            const auto submission = GetSubmission();
+            submission->opcode = IORING_OP_ASYNC_CANCEL;
+            submission->fd = -1;
+            submission->addr = MakeUserData(socket.identifier, Operation::Receive);
+            submission->user_data = MakeUserData(socket.identifier, Operation::Cancel);
+        }
+
+        /**
+         * This method queues the given request for the reactor thread,
+         * waking the thread up if it might be waiting.
+         *
+         * @param[in] type
+         *     This is the kind of request.
+         *
+         * @param[in] socket
+         *     This is the socket concerned.
+         */
+        void Post(Request::Type type, const std::shared_ptr< UringSocket >& socket) {
+            bool wakeUp = false;
+            {
+                std::lock_guard< decltype(requestsMutex) > lock(requestsMutex);
+                wakeUp = (requests.empty() && buffersReturned.empty());
+                requests.push_back({type, socket});
+            }
+            if (wakeUp) {
+                Wake();
+            }
+        }
+
+        /**
+         * This method provides the buffer with the given identifier,
+         * given back by a receiver, to the kernel again.  If given back
+         * on any other thread, the buffer is queued for the reactor
+         * thread, which is woken up if it might be waiting.
+         *
+         * @param[in] buffer
+         *     This is the identifier of the buffer.
+         */
+        void ReturnBuffer(uint16_t buffer) {
+            (void)buffersLent.fetch_sub(1, std::memory_order_relaxed);
+            if (std::this_thread::get_id() == thread.get_id()) {
+                ProvideBuffer(buffer);
+                return;
+            }
+            bool wakeUp = false;
+            {
+                std::lock_guard< decltype(requestsMutex) > lock(requestsMutex);
+                wakeUp = (requests.empty() && buffersReturned.empty());
+                buffersReturned.push_back(buffer);
+            }
+            if (wakeUp) {
+                Wake();
+            }
+        }
+
+        /**
+         * This function is called when a buffer lent out to a receiver
+         * is given back.
+         *
+         * @param[in] pool
+         *     This points to the core which lent out the buffer.
+         *
+         * @param[in] token
+         *     This is the identifier of the buffer.
+         */
+        static void ReturnLentBuffer(void* pool, uintptr_t token) {
+            static_cast< UringCore* >(pool)->ReturnBuffer((uint16_t)token);
+        }
+
+        /**
+         * This method wakes up the reactor thread.
+         */
+        void Wake() {
+            const uint64_t one = 1;
+            (void)systemCalls.fetch_add(1, std::memory_order_relaxed);
+            (void)write(wake, &one, sizeof(one));
+        }
+
+        /**
+         * This method starts sending what's in the outbound buffer of the
+         * given socket, unless a send is already in progress.
+         *
+         * @param[in,out] socket
+         *     This is the socket on which to send.
+         */
+        void StartSend(UringSocket& socket) {
+            {
+                std::lock_guard< decltype(socket.mutex) > lock(socket.mutex);
+                socket.sendScheduled = false;
+                if (
+                    socket.sendInFlight
+                    || socket.closing
+                    || !socket.open
+                    || socket.outbound.empty()
+                ) {
+                    return;
+                }
+                socket.inflight.swap(socket.outbound);
+                socket.outbound.clear();
+                socket.inflightSent = 0;
+                socket.sendInFlight = true;
+            }
+            SubmitSend(socket);
+        }
+
+        /**
+         * This method closes the given socket, once the kernel is done
+         * with it.
+         *
+         * @param[in,out] socket
+         *     This is the socket to close.
+         */
+        void FinishClose(const std::shared_ptr< UringSocket >& socket) {
+            std::lock_guard< decltype(socket->mutex) > lock(socket->mutex);
+            if (socket->handle >= 0) {
+                (void)close(socket->handle);
+                socket->handle = -1;
+            }
+            socket->open = false;
+            socket->condition.notify_all();
+            (void)sockets.erase(socket->identifier);
+        }
+
+        /**
+         * This method is called when the given socket is found to be
+         * broken, to let its user know.
+         *
+         * @param[in,out] socket
+         *     This is the socket found to be broken.
+         */
+        void Break(UringSocket& socket) {
+            {
+                std::lock_guard< decltype(socket.mutex) > lock(socket.mutex);
+                if (!socket.open) {
+                    return;
+                }
+                socket.open = false;
+                if (socket.closing) {
+                    return;
+                }
+            }
+            std::lock_guard< decltype(socket.deliveryMutex) > lock(socket.deliveryMutex);
+            if (socket.disconnectedDelegate != nullptr) {
+                socket.disconnectedDelegate();
+            }
+        }
+
+        /**
+         * This method handles the requests waiting for the reactor thread.
+         */
+        void ProcessRequests() {
+            std::vector< Request > requestsToProcess;
+            std::vector< uint16_t > buffersToProvide;
+            {
+                std::lock_guard< decltype(requestsMutex) > lock(requestsMutex);
+                requestsToProcess.swap(requests);
+                buffersToProvide.swap(buffersReturned);
+            }
+            for (const auto buffer: buffersToProvide) {
+                ProvideBuffer(buffer);
+            }
+            for (const auto& request: requestsToProcess) {
+                const auto& socket = request.socket;
+                switch (request.type) {
+                    case Request::Type::Add: {
+                        sockets[socket->identifier] = socket;
+                        SubmitReceive(*socket);
+                    } break;
+
+                    case Request::Type::Send: {
+                        StartSend(*socket);
+                    } break;
+
+                    case Request::Type::Close: {
+                        if (sockets.find(socket->identifier) == sockets.end()) {
+                            break;
+                        }
+                        if (socket->outstanding == 0) {
+                            FinishClose(socket);
+                        } else {
+                            SubmitCancel(*socket);
+                        }
+                    } break;
+
+                    default: break;
+                }
+            }
+        }
+
+        /**
+         * This method handles the completion of a receive.
+         *
+         * @param[in,out] socket
+         *     This is the socket on which data was received.
+         *
+         * @param[in] completion
+         *     This is the completion of the receive.
+         */
+        void CompleteReceive(UringSocket& socket, const struct io_uring_cqe& completion) {
+            if (completion.res > 0) {
+                const auto buffer = (uint16_t)(completion.flags >> IORING_CQE_BUFFER_SHIFT);
+                const auto data = buffers.data() + buffer * BUFFER_SIZE;
+                const auto length = (size_t)completion.res;
+                std::lock_guard< decltype(socket.deliveryMutex) > lock(socket.deliveryMutex);
+                if (
+                    (socket.bufferReceivedDelegate != nullptr)
+                    && (buffersLent.load(std::memory_order_relaxed) < MAX_BUFFERS_LENT)
+                ) {
+                    (void)buffersLent.fetch_add(1, std::memory_order_relaxed);
+                    socket.bufferReceivedDelegate(
+                        Twitch::ConnectionV2::ReceivedBuffer(
+                            data,
+                            length,
+                            shared_from_this(),
+                            &UringCore::ReturnLentBuffer,
+                            buffer
+                        )
+                    );
+                } else {
+                    // Receivers which can't be lent the buffer, or which
+                    // already hold too many, get a copy, so that the
+                    // buffer can be given back to the kernel right away.
+                    socket.received.assign(data, length);
+                    (void)bytesCopied.fetch_add(length, std::memory_order_relaxed);
+                    ProvideBuffer(buffer);
+                    if (socket.bufferReceivedDelegate != nullptr) {
+                        socket.bufferReceivedDelegate(
+                            Twitch::ConnectionV2::ReceivedBuffer(std::move(socket.received))
+                        );
+                    } else if (socket.dataReceivedDelegate != nullptr) {
+                        socket.dataReceivedDelegate(std::move(socket.received));
+                    } else if (socket.messageReceivedDelegate != nullptr) {
+                        socket.messageReceivedDelegate(socket.received);
+                    }
+                }
+            }
+            if ((completion.flags & IORING_CQE_F_MORE) != 0) {
+                return;
+            }
+            --socket.outstanding;
+            bool closing = false;
+            {
+                std::lock_guard< decltype(socket.mutex) > lock(socket.mutex);
+                closing = (socket.closing || !socket.open);
+            }
+            if (
+                (completion.res > 0)
+                || (completion.res == -ENOBUFS)
+            ) {
+                if (!closing) {
+                    SubmitReceive(socket);
+                }
+            } else {
+                Break(socket);
+            }
+        }
+
+        /**
+         * This method handles the completion of a send.
+         *
+         * @param[in,out] socket
+         *     This is the socket on which data was sent.
+         *
+         * @param[in] completion
+         *     This is the completion of the send.
+         */
+        void CompleteSend(UringSocket& socket, const struct io_uring_cqe& completion) {
+            --socket.outstanding;
+            if (completion.res < 0) {
+                {
+                    std::lock_guard< decltype(socket.mutex) > lock(socket.mutex);
+                    socket.sendInFlight = false;
+                    socket.condition.notify_all();
+                }
+                Break(socket);
+                return;
+            }
+            socket.inflightSent += (size_t)completion.res;
+            if (socket.inflightSent < socket.inflight.length()) {
+                SubmitSend(socket);
+                return;
+            }
+            socket.inflight.clear();
+            {
+                std::lock_guard< decltype(socket.mutex) > lock(socket.mutex);
+                socket.sendInFlight = false;
+                socket.condition.notify_all();
+                if (
+                    socket.closing
+                    || !socket.open
+                    || socket.outbound.empty()
+                ) {
+                    return;
+                }
+                socket.inflight.swap(socket.outbound);
+                socket.outbound.clear();
+                socket.inflightSent = 0;
+                socket.sendInFlight = true;
+            }
+            SubmitSend(socket);
+        }
+
+        /**
+         * This method handles all the completions waiting in the
+         * completion queue.
+         */
+        void ProcessCompletions() {
+            auto head = *completionHead;
+            const auto tail = __atomic_load_n(completionTail, __ATOMIC_ACQUIRE);
+            while (head != tail) {
+                const auto completion = completions[head & completionMask];
+                ++head;
+                const auto operation = (Operation)(completion.user_data & 0xFF);
+                const auto identifier = (completion.user_data >> 8);
+                if (operation == Operation::Wake) {
+                    if (!stopping) {
+                        SubmitWake();
+                    }
+                    continue;
+                }
+                const auto entry = sockets.find(identifier);
+                if (entry == sockets.end()) {
+                    if (
+                        (operation == Operation::Receive)
+                        && ((completion.flags & IORING_CQE_F_BUFFER) != 0)
+                    ) {
+                        ProvideBuffer((uint16_t)(completion.flags >> IORING_CQE_BUFFER_SHIFT));
+                    }
+                    continue;
+                }
+                const auto socket = entry->second;
+                switch (operation) {
+                    case Operation::Receive: {
+                        CompleteReceive(*socket, completion);
+                    } break;
+
+                    case Operation::Send: {
+                        CompleteSend(*socket, completion);
+                    } break;
+
+                    default: break;
+                }
+                bool closing = false;
+                {
+                    std::lock_guard< decltype(socket->mutex) > lock(socket->mutex);
+                    closing = socket->closing;
+                }
+                if (
+                    closing
+                    && (socket->outstanding == 0)
+                ) {
+                    FinishClose(socket);
+                }
+            }
+            __atomic_store_n(completionHead, head, __ATOMIC_RELEASE);
+        }
+
+        /**
+         * This method is the body of the reactor thread.
+         */
+        void Run() {
+            SubmitWake();
+            while (!stopping) {
+                ProcessRequests();
+                (void)systemCalls.fetch_add(1, std::memory_order_relaxed);
+                const auto submitted = EnterRing(ring, toSubmit, 1, IORING_ENTER_GETEVENTS);
+                if (submitted > 0) {
+                    toSubmit -= (unsigned int)submitted;
+                }
+                ProcessCompletions();
+            }
+        }
+    };
+
+    /**
+     * This function works out whether or not the running kernel supports
+     * what UringReactor needs.
+     *
+     * @return
+     *     An indication of whether or not the running kernel supports
+     *     what UringReactor needs is returned.
+     */
+    bool ProbeKernel() {
+        // Multishot receive arrived in Linux 6.0.
+        struct utsname name;
+        if (uname(&name) != 0) {
+            return false;
+        }
+        unsigned int major = 0;
+        unsigned int minor = 0;
+        if (sscanf(name.release, "%u.%u", &major, &minor) != 2) {
+            return false;
+        }
+        if (major < 6) {
+            return false;
+        }
+        UringCore core;
+        return core.SetUp();
+    }
+
+}
+
+namespace Twitch {
+
+    /**
+     * This contains the private properties of a UringReactor instance.
+     */
+    struct UringReactor::Impl {
+        /**
+         * This holds everything shared between the reactor and the
+         * connections it services.
+         */
+        std::shared_ptr< UringCore > core = std::make_shared< UringCore >();
+    };
+
+    UringReactor::~UringReactor() noexcept {
+        auto& core = *impl_->core;
+        if (core.thread.joinable()) {
+            core.stopping = true;
+            const uint64_t one = 1;
+            (void)write(core.wake, &one, sizeof(one));
+            core.thread.join();
+        }
+        for (const auto& socket: core.sockets) {
+            if (socket.second->handle >= 0) {
+                (void)close(socket.second->handle);
+                socket.second->handle = -1;
+            }
+        }
+        core.sockets.clear();
+    }
+
+    UringReactor::UringReactor()
+        : impl_(new Impl)
+    {
+        auto& core = *impl_->core;
+        if (!core.SetUp()) {
+            return;
+        }
+        core.usable = true;
+        core.thread = std::thread(&UringCore::Run, impl_->core.get());
+    }
+
+    bool UringReactor::IsUsable() const {
+        return impl_->core->usable;
+    }
+
+    uint64_t UringReactor::GetSystemCallCount() const {
+        return impl_->core->systemCalls.load(std::memory_order_relaxed);
+    }
+
+    uint64_t UringReactor::GetBytesCopied() const {
+        return impl_->core->bytesCopied.load(std::memory_order_relaxed);
+    }
+
+    bool UringReactor::IsSupported() {
+        static const bool supported = ProbeKernel();
+        return supported;
+    }
+
+    std::shared_ptr< UringReactor > UringReactor::GetDefault() {
+        static std::mutex mutex;
+        static std::shared_ptr< UringReactor > reactor;
+        std::lock_guard< decltype(mutex) > lock(mutex);
+        if (reactor == nullptr) {
+            reactor = std::make_shared< UringReactor >();
+        }
+        return reactor;
+    }
+
+    /**
+     * This contains the private properties of a UringConnection instance.
+     */
+    struct UringConnection::Impl {
+        /**
+         * This is the host name or address of the Twitch chat server.
+         */
+        std::string host;
+
+        /**
+         * This is the port number of the Twitch chat server.
+         */
+        uint16_t port = 0;
+
+        /**
+         * This is the reactor servicing the connection.  It's held
+         * so that its thread keeps running as long as the connection
+         * needs it.
+         */
+        std::shared_ptr< UringReactor > reactorOwner;
+
+        /**
+         * This holds everything shared between the reactor and the
+         * connections it services.
+         */
+        std::shared_ptr< UringCore > core;
+
+        /**
+         * This holds everything the reactor knows about the socket of
+         * the connection.
+         */
+        std::shared_ptr< UringSocket > socket = std::make_shared< UringSocket >();
+    };
+
+    UringConnection::~UringConnection() noexcept {
+        Disconnect();
+    }
+
+    UringConnection::UringConnection(
+        const std::string& host,
+        uint16_t port,
+        std::shared_ptr< UringReactor > reactor
+    )
+        : impl_(new Impl)
+    {
+        if (reactor == nullptr) {
+            reactor = UringReactor::GetDefault();
+        }
+        impl_->host = host;
+        impl_->port = port;
+        impl_->reactorOwner = reactor;
+        impl_->core = reactor->impl_->core;
+    }
+
+    std::shared_ptr< Connection > UringConnection::Create(
+        const std::string& host,
+        uint16_t port
+    ) {
+        if (UringReactor::IsSupported()) {
+            return std::make_shared< UringConnection >(host, port);
+        } else {
+            return std::make_shared< EpollConnection >(host, port);
+        }
+    }
+
+    void UringConnection::SetMessageReceivedDelegate(MessageReceivedDelegate messageReceivedDelegate) {
+        std::lock_guard< decltype(impl_->socket->deliveryMutex) > lock(impl_->socket->deliveryMutex);
+        impl_->socket->messageReceivedDelegate = messageReceivedDelegate;
+    }
+
+    void UringConnection::SetDataReceivedDelegate(DataReceivedDelegate dataReceivedDelegate) {
+        std::lock_guard< decltype(impl_->socket->deliveryMutex) > lock(impl_->socket->deliveryMutex);
+        impl_->socket->dataReceivedDelegate = dataReceivedDelegate;
+    }
+
+    void UringConnection::SetBufferReceivedDelegate(BufferReceivedDelegate bufferReceivedDelegate) {
+        std::lock_guard< decltype(impl_->socket->deliveryMutex) > lock(impl_->socket->deliveryMutex);
+        impl_->socket->bufferReceivedDelegate = bufferReceivedDelegate;
+    }
+
+    void UringConnection::SetDisconnectedDelegate(DisconnectedDelegate disconnectedDelegate) {
+        std::lock_guard< decltype(impl_->socket->deliveryMutex) > lock(impl_->socket->deliveryMutex);
+        impl_->socket->disconnectedDelegate = disconnectedDelegate;
+    }
+
+    bool UringConnection::Connect() {
+        Disconnect();
+        if (!impl_->core->usable) {
+            return false;
+        }
+        const auto handle = ConnectTcpSocket(impl_->host, impl_->port);
+        if (handle < 0) {
+            return false;
+        }
+
+        // The kernel fails operations on non-blocking sockets rather than
+        // waiting for them to be ready, so make the socket blocking.
+        (void)fcntl(handle, F_SETFL, fcntl(handle, F_GETFL) & ~O_NONBLOCK);
+        {
+            auto& socket = *impl_->socket;
+            std::lock_guard< decltype(socket.mutex) > lock(socket.mutex);
+            socket.handle = handle;
+            socket.identifier = impl_->core->nextIdentifier++;
+            socket.open = true;
+            socket.closing = false;
+            socket.outbound.clear();
+            socket.sendScheduled = false;
+            socket.sendInFlight = false;
+        }
+        impl_->core->Post(UringCore::Request::Type::Add, impl_->socket);
+        return true;
+    }
+
+    void UringConnection::Disconnect() {
+        auto& socket = *impl_->socket;
+        const auto onReactorThread = (std::this_thread::get_id() == impl_->core->thread.get_id());
+        std::unique_lock< decltype(socket.mutex) > lock(socket.mutex);
+        if (socket.handle < 0) {
+            return;
+        }
+        if (!socket.closing) {
+            socket.closing = true;
+            if (!onReactorThread) {
+                (void)socket.condition.wait_for(
+                    lock,
+                    DISCONNECT_SEND_TIMEOUT,
+                    [&socket]{ return !socket.sendInFlight; }
+                );
+            }
+            if (
+                !socket.sendInFlight
+                && !socket.outbound.empty()
+            ) {
+                (void)impl_->core->systemCalls.fetch_add(1, std::memory_order_relaxed);
+                (void)send(socket.handle, socket.outbound.data(), socket.outbound.length(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            }
+            socket.outbound.clear();
+            (void)shutdown(socket.handle, SHUT_RDWR);
+            impl_->core->Post(UringCore::Request::Type::Close, impl_->socket);
+        }
+        if (!onReactorThread) {
+            socket.condition.wait(
+                lock,
+                [&socket]{ return socket.handle < 0; }
+            );
+        }
+    }
+
+    void UringConnection::Send(const std::string& message) {
+        const Fragment fragment(message);
+        Send(&fragment, 1);
+    }
+
+    void UringConnection::Send(const Fragment* fragments, size_t numFragments) {
+        auto& socket = *impl_->socket;
+        bool schedule = false;
+        {
+            std::lock_guard< decltype(socket.mutex) > lock(socket.mutex);
+            if (
+                !socket.open
+                || socket.closing
+            ) {
+                return;
+            }
+            for (size_t i = 0; i < numFragments; ++i) {
+                socket.outbound.append(fragments[i].data, fragments[i].length);
+            }
+            if (
+                !socket.sendInFlight
+                && !socket.sendScheduled
+            ) {
+                socket.sendScheduled = true;
+                schedule = true;
+            }
+        }
+        if (schedule) {
+            impl_->core->Post(UringCore::Request::Type::Send, impl_->socket);
+        }
+    }
+
+
+    bool UringConnection::IsSendPending() {
+        auto& socket = *impl_->socket;
+        std::lock_guard< decltype(socket.mutex) > lock(socket.mutex);
+        return (
+            socket.open
+            && (
+                socket.sendInFlight
+                || socket.sendScheduled
+                || !socket.outbound.empty()
+            )
+        );
+    }
+
+}
@@ -0,0 +1,250 @@
+/**
+ * @file ConnectionAdapterTests.cpp
+ *
+ * This module contains the unit tests of the Twitch::ConnectionAdapter
+ * class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <Twitch/ConnectionAdapter.hpp>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is a fake connection to adapt in the tests.
+     */
+    struct MockConnection
+        : public Twitch::Connection
+    {
+        // Properties
+
+        MessageReceivedDelegate messageReceivedDelegate;
+        DisconnectedDelegate disconnectedDelegate;
+        bool failConnectionAttempt = false;
+        bool isConnected = false;
+        std::vector< std::string > messagesSent;
+
+        // Twitch::Connection
+
+        virtual void SetMessageReceivedDelegate(MessageReceivedDelegate messageReceivedDelegate) override {
+            this->messageReceivedDelegate = messageReceivedDelegate;
+        }
+
+        virtual void SetDisconnectedDelegate(DisconnectedDelegate disconnectedDelegate) override {
+            this->disconnectedDelegate = disconnectedDelegate;
+        }
+
+        virtual bool Connect() override {
+            if (failConnectionAttempt) {
+                return false;
+            }
+            isConnected = true;
+            return true;
+        }
+
+        virtual void Disconnect() override {
+            isConnected = false;
+        }
+
+        virtual void Send(const std::string& message) override {
+            messagesSent.push_back(message);
+        }
+    };
+
+    /**
+     * This is a fake connection which implements both versions of the
+     * connection interface.
+     */
+    struct MockConnectionV2
+        : public MockConnection
+        , public Twitch::ConnectionV2
+    {
+        // Twitch::Connection
+
+        virtual void SetDisconnectedDelegate(DisconnectedDelegate disconnectedDelegate) override {
+            MockConnection::SetDisconnectedDelegate(disconnectedDelegate);
+        }
+
+        virtual bool Connect() override {
+            return MockConnection::Connect();
+        }
+
+        virtual void Disconnect() override {
+            MockConnection::Disconnect();
+        }
+
+        virtual void Send(const std::string& message) override {
+            MockConnection::Send(message);
+        }
+
+        // Twitch::ConnectionV2
+
+        virtual void SetDataReceivedDelegate(DataReceivedDelegate dataReceivedDelegate) override {
+        }
+
+        virtual void Send(const Fragment* fragments, size_t numFragments) override {
+        }
+    };
+
+}
+
+/**
+ * This is the test fixture for these tests, providing common
+ * setup and teardown for each test.
+ */
+struct ConnectionAdapterTests
+    : public ::testing::Test
+{
+    // Properties
+
+    /**
+     * This is the connection adapted by the unit under test.
+     */
+    std::shared_ptr< MockConnection > mockConnection = std::make_shared< MockConnection >();
+
+    /**
+     * This is the unit under test.
+     */
+    Twitch::ConnectionAdapter adapter{mockConnection};
+
+    /**
+     * This holds the data handed over by the unit under test.
+     */
+    std::vector< std::string > dataReceived;
+
+    // Methods
+
+    // ::testing::Test
+
+    virtual void SetUp() {
+        adapter.SetDataReceivedDelegate(
+            [this](std::string&& data){
+                dataReceived.push_back(std::move(data));
+            }
+        );
+    }
+
+    virtual void TearDown() {
+    }
+};
+
+TEST_F(ConnectionAdapterTests, ConnectAndDisconnectPassedAlong) {
+    EXPECT_TRUE(adapter.Connect());
+    EXPECT_TRUE(mockConnection->isConnected);
+    adapter.Disconnect();
+    EXPECT_FALSE(mockConnection->isConnected);
+    mockConnection->failConnectionAttempt = true;
+    EXPECT_FALSE(adapter.Connect());
+}
+
+TEST_F(ConnectionAdapterTests, FragmentsSentAsOneMessage) {
+    ASSERT_TRUE(adapter.Connect());
+    const std::string line = "PING :hello";
+    const Twitch::ConnectionV2::Fragment fragments[] = {
+        line,
+        {"\r\n", 2},
+    };
+    adapter.Send(fragments, 2);
+    adapter.Send(fragments, 1);
+    EXPECT_EQ(
+        std::vector< std::string >({
+            "PING :hello\r\n",
+            "PING :hello",
+        }),
+        mockConnection->messagesSent
+    );
+}
+
+TEST_F(ConnectionAdapterTests, DataReceivedHandedOver) {
+    ASSERT_TRUE(adapter.Connect());
+    mockConnection->messageReceivedDelegate("Hello\r\n");
+    mockConnection->messageReceivedDelegate("World\r\n");
+    EXPECT_EQ(
+        std::vector< std::string >({
+            "Hello\r\n",
+            "World\r\n",
+        }),
+        dataReceived
+    );
+}
+
+TEST_F(ConnectionAdapterTests, DataNotTakenIsReplacedByNextData) {
+    adapter.SetDataReceivedDelegate(
+        [this](std::string&& data){
+            dataReceived.push_back(data);
+        }
+    );
+    ASSERT_TRUE(adapter.Connect());
+    mockConnection->messageReceivedDelegate("Hello, World!\r\n");
+    mockConnection->messageReceivedDelegate("Hi\r\n");
+    EXPECT_EQ(
+        std::vector< std::string >({
+            "Hello, World!\r\n",
+            "Hi\r\n",
+        }),
+        dataReceived
+    );
+}
+
+TEST_F(ConnectionAdapterTests, DataReceivedHandedOverInBuffer) {
+    std::vector< Twitch::ConnectionV2::ReceivedBuffer > buffersReceived;
+    adapter.SetBufferReceivedDelegate(
+        [&buffersReceived](Twitch::ConnectionV2::ReceivedBuffer&& buffer){
+            buffersReceived.push_back(std::move(buffer));
+        }
+    );
+    ASSERT_TRUE(adapter.Connect());
+    mockConnection->messageReceivedDelegate("Hello\r\n");
+    mockConnection->messageReceivedDelegate("Hello, World! This is longer than a short string.\r\n");
+    ASSERT_EQ(2, buffersReceived.size());
+    EXPECT_EQ(
+        "Hello\r\n",
+        std::string(buffersReceived[0].GetData(), buffersReceived[0].GetLength())
+    );
+    EXPECT_EQ(
+        "Hello, World! This is longer than a short string.\r\n",
+        std::string(buffersReceived[1].GetData(), buffersReceived[1].GetLength())
+    );
+    EXPECT_TRUE(dataReceived.empty());
+}
+
+TEST_F(ConnectionAdapterTests, DisconnectedPassedAlong) {
+    bool disconnected = false;
+    adapter.SetDisconnectedDelegate(
+        [&disconnected]{
+            disconnected = true;
+        }
+    );
+    ASSERT_TRUE(adapter.Connect());
+    mockConnection->disconnectedDelegate();
+    EXPECT_TRUE(disconnected);
+}
+
+TEST_F(ConnectionAdapterTests, AdaptReturnsConnectionV2WhenImplemented) {
+    const auto connectionV2 = std::make_shared< MockConnectionV2 >();
+    std::shared_ptr< Twitch::Connection > connection = connectionV2;
+    EXPECT_EQ(
+        static_cast< Twitch::ConnectionV2* >(connectionV2.get()),
+        Twitch::ConnectionAdapter::Adapt(connection).get()
+    );
+    EXPECT_FALSE(
+        std::dynamic_pointer_cast< Twitch::ConnectionAdapter >(
+            Twitch::ConnectionAdapter::Adapt(mockConnection)
+        ) == nullptr
+    );
+}
+
+TEST_F(ConnectionAdapterTests, DelegatesReleasedWhenAdapterDestroyed) {
+    const auto otherConnection = std::make_shared< MockConnection >();
+    {
+        Twitch::ConnectionAdapter otherAdapter(otherConnection);
+        EXPECT_FALSE(otherConnection->messageReceivedDelegate == nullptr);
+    }
+    EXPECT_TRUE(otherConnection->messageReceivedDelegate == nullptr);
+    EXPECT_TRUE(otherConnection->disconnectedDelegate == nullptr);
+}
@@ -0,0 +1,160 @@
+#ifndef TWITCH_CONNECTION_TESTS_HPP
+#define TWITCH_CONNECTION_TESTS_HPP
+
+/**
+ * @file ConnectionTests.hpp
+ *
+ * This module declares what is shared by the unit tests of the
+ * connection implementations which talk to a SyntheticServer over
+ * the loopback interface.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <string>
+#include <SyntheticServer.hpp>
+#include <Twitch/Connection.hpp>
+#include <Twitch/Messaging.hpp>
+
+namespace ConnectionTests {
+
+    /**
+     * This is the line terminator used by the Twitch server.
+     */
+    const std::string CRLF = "\r\n";
+
+    /**
+     * This collects what a connection delivers.
+     */
+    struct Receiver {
+        // Properties
+
+        std::condition_variable wakeCondition;
+        std::mutex mutex;
+        std::string dataReceived;
+        bool disconnected = false;
+
+        // Methods
+
+        void Listen(Twitch::Connection& connection) {
+            connection.SetMessageReceivedDelegate(
+                [this](const std::string& message){
+                    std::lock_guard< std::mutex > lock(mutex);
+                    dataReceived += message;
+                    wakeCondition.notify_all();
+                }
+            );
+            connection.SetDisconnectedDelegate(
+                [this]{
+                    std::lock_guard< std::mutex > lock(mutex);
+                    disconnected = true;
+                    wakeCondition.notify_all();
+                }
+            );
+        }
+
+        bool AwaitData(const std::string& data) {
+            std::unique_lock< std::mutex > lock(mutex);
+            return wakeCondition.wait_for(
+                lock,
+                std::chrono::seconds(5),
+                [this, data]{ return dataReceived.find(data) != std::string::npos; }
+            );
+        }
+
+        bool AwaitDisconnect() {
+            std::unique_lock< std::mutex > lock(mutex);
+            return wakeCondition.wait_for(
+                lock,
+                std::chrono::seconds(5),
+                [this]{ return disconnected; }
+            );
+        }
+    };
+
+    /**
+     * This is a fake user of the Messaging class.
+     */
+    struct User
+        : public Twitch::Messaging::User
+    {
+        // Properties
+
+        std::condition_variable wakeCondition;
+        std::mutex mutex;
+        bool loggedIn = false;
+        size_t numMessages = 0;
+
+        // Methods
+
+        bool AwaitLogIn() {
+            std::unique_lock< std::mutex > lock(mutex);
+            return wakeCondition.wait_for(
+                lock,
+                std::chrono::seconds(5),
+                [this]{ return loggedIn; }
+            );
+        }
+
+        bool AwaitMessages(size_t numMessagesExpected) {
+            std::unique_lock< std::mutex > lock(mutex);
+            return wakeCondition.wait_for(
+                lock,
+                std::chrono::seconds(5),
+                [this, numMessagesExpected]{ return numMessages >= numMessagesExpected; }
+            );
+        }
+
+        // Twitch::Messaging::User
+
+        virtual void LogIn() override {
+            std::lock_guard< std::mutex > lock(mutex);
+            loggedIn = true;
+            wakeCondition.notify_all();
+        }
+
+        virtual void Message(Twitch::Messaging::MessageInfo&&) override {
+            std::lock_guard< std::mutex > lock(mutex);
+            ++numMessages;
+            wakeCondition.notify_all();
+        }
+    };
+
+    /**
+     * This is the base of the test fixtures for the connection tests,
+     * providing common setup and teardown for each test.
+     */
+    struct Fixture
+        : public ::testing::Test
+    {
+        // Properties
+
+        /**
+         * This is used to stand in for the Twitch server.
+         */
+        Twitch::SyntheticServer server;
+
+        /**
+         * These are the settings of the server.
+         */
+        Twitch::SyntheticServer::Configuration configuration;
+
+        // Methods
+
+        // ::testing::Test
+
+        virtual void SetUp() {
+        }
+
+        virtual void TearDown() {
+            server.Stop();
+        }
+    };
+
+}
+
+#endif /* TWITCH_CONNECTION_TESTS_HPP */
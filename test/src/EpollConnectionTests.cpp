@@ -0,0 +1,116 @@
+/**
+ * @file EpollConnectionTests.cpp
+ *
+ * This module contains the unit tests of the Twitch::EpollReactor and
+ * Twitch::EpollConnection classes.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "ConnectionTests.hpp"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <Twitch/EpollConnection.hpp>
+#include <Twitch/Messaging.hpp>
+#include <vector>
+
+using ConnectionTests::CRLF;
+using ConnectionTests::Receiver;
+using ConnectionTests::User;
+
+/**
+ * This is the test fixture for these tests, providing common
+ * setup and teardown for each test.
+ */
+struct EpollConnectionTests
+    : public ConnectionTests::Fixture
+{
+};
+
+TEST_F(EpollConnectionTests, SendAndReceive) {
+    ASSERT_TRUE(server.Start(configuration));
+    Twitch::EpollConnection connection("127.0.0.1", server.GetPort());
+    Receiver receiver;
+    receiver.Listen(connection);
+    ASSERT_TRUE(connection.Connect());
+    connection.Send("PASS oauth:alskdfjasdf87sdfsdffsd" + CRLF);
+    connection.Send("NICK foobar1124" + CRLF);
+    ASSERT_TRUE(receiver.AwaitData(":tmi.twitch.tv 376 foobar1124 :>" + CRLF));
+    connection.Send("PING :hello" + CRLF);
+    ASSERT_TRUE(receiver.AwaitData(":tmi.twitch.tv PONG tmi.twitch.tv :hello" + CRLF));
+    connection.Disconnect();
+    EXPECT_FALSE(receiver.disconnected);
+}
+
+TEST_F(EpollConnectionTests, SendPendingUntilWritten) {
+    ASSERT_TRUE(server.Start(configuration));
+    Twitch::EpollConnection connection("127.0.0.1", server.GetPort());
+    Receiver receiver;
+    receiver.Listen(connection);
+    EXPECT_FALSE(connection.IsSendPending());
+    ASSERT_TRUE(connection.Connect());
+    connection.Send("PING :hello" + CRLF);
+    ASSERT_TRUE(receiver.AwaitData(":tmi.twitch.tv PONG tmi.twitch.tv :hello" + CRLF));
+    EXPECT_FALSE(connection.IsSendPending());
+    connection.Send("PING :again" + CRLF);
+    connection.Disconnect();
+    EXPECT_FALSE(connection.IsSendPending());
+}
+
+TEST_F(EpollConnectionTests, ConnectFailsWhenNoServer) {
+    ASSERT_TRUE(server.Start(configuration));
+    const auto port = server.GetPort();
+    server.Stop();
+    Twitch::EpollConnection connection("127.0.0.1", port);
+    EXPECT_FALSE(connection.Connect());
+}
+
+TEST_F(EpollConnectionTests, ServerDisconnectDelivered) {
+    ASSERT_TRUE(server.Start(configuration));
+    Twitch::EpollConnection connection("127.0.0.1", server.GetPort());
+    Receiver receiver;
+    receiver.Listen(connection);
+    ASSERT_TRUE(connection.Connect());
+    connection.Send("QUIT" + CRLF);
+    EXPECT_TRUE(receiver.AwaitDisconnect());
+}
+
+TEST_F(EpollConnectionTests, ManyConnectionsOnFewThreads) {
+    ASSERT_TRUE(server.Start(configuration));
+    const auto reactor = std::make_shared< Twitch::EpollReactor >(2);
+    constexpr size_t numConnections = 100;
+    std::vector< std::unique_ptr< Twitch::EpollConnection > > connections;
+    std::vector< std::unique_ptr< Receiver > > receivers;
+    for (size_t i = 0; i < numConnections; ++i) {
+        connections.emplace_back(new Twitch::EpollConnection("127.0.0.1", server.GetPort(), reactor));
+        receivers.emplace_back(new Receiver());
+        receivers.back()->Listen(*connections.back());
+        ASSERT_TRUE(connections.back()->Connect());
+        connections.back()->Send("NICK justinfan" + std::to_string(i) + CRLF);
+    }
+    for (size_t i = 0; i < numConnections; ++i) {
+        EXPECT_TRUE(receivers[i]->AwaitData(" 376 justinfan" + std::to_string(i) + " :>" + CRLF));
+    }
+    EXPECT_EQ(numConnections, server.GetStatistics().clientsConnected);
+}
+
+TEST_F(EpollConnectionTests, MessagingOverLoopback) {
+    configuration.maxLines = 500;
+    ASSERT_TRUE(server.Start(configuration));
+    const auto port = server.GetPort();
+    const auto user = std::make_shared< User >();
+    Twitch::Messaging tmi;
+    tmi.SetConnectionFactory(
+        [port]() -> std::shared_ptr< Twitch::Connection > {
+            return std::make_shared< Twitch::EpollConnection >("127.0.0.1", port);
+        }
+    );
+    tmi.SetUser(user);
+    tmi.LogIn("foobar1124", "alskdfjasdf87sdfsdffsd");
+    ASSERT_TRUE(user->AwaitLogIn());
+    tmi.Join("foobar1125");
+    EXPECT_TRUE(user->AwaitMessages(configuration.maxLines));
+    tmi.LogOut("Bye");
+}
@@ -0,0 +1,430 @@
+/**
+ * @file MessagingFleetTests.cpp
+ *
+ * This module contains the unit tests of the Twitch::MessagingFleet class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <chrono>
+#include <functional>
+#include <gtest/gtest.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <StringExtensions/StringExtensions.hpp>
+#include <thread>
+#include <Twitch/Connection.hpp>
+#include <Twitch/MessagingFleet.hpp>
+#include <Twitch/TimeKeeper.hpp>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the required line terminator for lines of text
+     * sent to or from Twitch chat servers.
+     */
+    const std::string CRLF = "\r\n";
+
+    /**
+     * This holds statistics shared by all connections made to the fake
+     * Twitch server.
+     */
+    struct ServerStatistics {
+        // Properties
+
+        std::mutex mutex;
+        size_t connections = 0;
+        size_t logInsInProgress = 0;
+        size_t peakLogInsInProgress = 0;
+        bool failConnectionAttempts = false;
+        bool holdMotd = false;
+    };
+
+    /**
+     * This is a fake Twitch server which answers the log-in handshake and
+     * channel joins on its own, used to test the MessagingFleet class.
+     */
+    struct MockServer
+        : public Twitch::Connection
+    {
+        // Properties
+
+        std::shared_ptr< ServerStatistics > statistics;
+        MessageReceivedDelegate messageReceivedDelegate;
+        DisconnectedDelegate disconnectedDelegate;
+        std::string dataReceived;
+        std::string nickname;
+        bool motdHeld = false;
+
+        // Methods
+
+        explicit MockServer(std::shared_ptr< ServerStatistics > statistics)
+            : statistics(statistics)
+        {
+        }
+
+        void ReturnToClient(const std::string& line) {
+            if (messageReceivedDelegate != nullptr) {
+                messageReceivedDelegate(line + CRLF);
+            }
+        }
+
+        void SendMotd() {
+            {
+                std::lock_guard< std::mutex > lock(statistics->mutex);
+                --statistics->logInsInProgress;
+            }
+            ReturnToClient(":tmi.twitch.tv 376 " + nickname + " :>");
+        }
+
+        void ReleaseMotd() {
+            if (motdHeld) {
+                motdHeld = false;
+                SendMotd();
+            }
+        }
+
+        void HandleLine(const std::string& line) {
+            if (line == "CAP LS 302") {
+                ReturnToClient(":tmi.twitch.tv CAP * LS :twitch.tv/membership twitch.tv/tags twitch.tv/commands");
+            } else if (line.substr(0, 9) == "CAP REQ :") {
+                ReturnToClient(":tmi.twitch.tv CAP * ACK :" + line.substr(9));
+            } else if (line.substr(0, 5) == "NICK ") {
+                nickname = line.substr(5);
+                bool holdMotd;
+                {
+                    std::lock_guard< std::mutex > lock(statistics->mutex);
+                    holdMotd = statistics->holdMotd;
+                }
+                if (holdMotd) {
+                    motdHeld = true;
+                } else {
+                    SendMotd();
+                }
+            } else if (line.substr(0, 6) == "JOIN #") {
+                const auto channel = line.substr(6);
+                ReturnToClient(
+                    StringExtensions::sprintf(
+                        ":%s!%s@%s.tmi.twitch.tv JOIN #%s",
+                        nickname.c_str(), nickname.c_str(), nickname.c_str(),
+                        channel.c_str()
+                    )
+                );
+                ReturnToClient(
+                    ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #" + channel + " :Hello, World!"
+                );
+            }
+        }
+
+        // Twitch::Connection
+
+        virtual void SetMessageReceivedDelegate(MessageReceivedDelegate messageReceivedDelegate) override {
+            this->messageReceivedDelegate = messageReceivedDelegate;
+        }
+
+        virtual void SetDisconnectedDelegate(DisconnectedDelegate disconnectedDelegate) override {
+            this->disconnectedDelegate = disconnectedDelegate;
+        }
+
+        virtual bool Connect() override {
+            std::lock_guard< std::mutex > lock(statistics->mutex);
+            if (statistics->failConnectionAttempts) {
+                return false;
+            }
+            ++statistics->connections;
+            ++statistics->logInsInProgress;
+            statistics->peakLogInsInProgress = std::max(
+                statistics->peakLogInsInProgress,
+                statistics->logInsInProgress
+            );
+            return true;
+        }
+
+        virtual void Send(const std::string& message) override {
+            dataReceived += message;
+            for (;;) {
+                const auto lineEnd = dataReceived.find(CRLF);
+                if (lineEnd == std::string::npos) {
+                    break;
+                }
+                const auto line = dataReceived.substr(0, lineEnd);
+                dataReceived = dataReceived.substr(lineEnd + CRLF.length());
+                HandleLine(line);
+            }
+        }
+
+        virtual void Disconnect() override {
+        }
+    };
+
+    /**
+     * This is a fake time-keeper which is used to test the MessagingFleet
+     * class.
+     */
+    struct MockTimeKeeper
+        : public Twitch::TimeKeeper
+    {
+        // Properties
+
+        double currentTime = 0.0;
+
+        // Methods
+
+        // Twitch::TimeKeeper
+
+        virtual double GetCurrentTime() override {
+            return currentTime;
+        }
+    };
+
+}
+
+/**
+ * This is the test fixture for these tests, providing common
+ * setup and teardown for each test.
+ */
+struct MessagingFleetTests
+    : public ::testing::Test
+{
+    // Properties
+
+    /**
+     * This is used to simulate real time, when testing rate limiting.
+     */
+    std::shared_ptr< MockTimeKeeper > mockTimeKeeper = std::make_shared< MockTimeKeeper >();
+
+    /**
+     * This holds statistics about the connections made to the fake
+     * Twitch server.
+     */
+    std::shared_ptr< ServerStatistics > serverStatistics = std::make_shared< ServerStatistics >();
+
+    /**
+     * These are the connections made to the fake Twitch server.
+     */
+    std::vector< std::shared_ptr< MockServer > > mockServers;
+
+    /**
+     * This is used to synchronize access to the connections made to the
+     * fake Twitch server.
+     */
+    std::mutex mockServersMutex;
+
+    /**
+     * This is the unit under test.
+     */
+    Twitch::MessagingFleet fleet;
+
+    // Methods
+
+    /**
+     * This is a convenience method which makes the given number of accounts
+     * for the fleet to log in.
+     */
+    std::vector< Twitch::MessagingFleet::Account > MakeAccounts(size_t numAccounts) {
+        std::vector< Twitch::MessagingFleet::Account > accounts;
+        for (size_t i = 0; i < numAccounts; ++i) {
+            Twitch::MessagingFleet::Account account;
+            account.nickname = StringExtensions::sprintf("foobar%zu", i);
+            account.token = "alskdfjasdf87sdfsdffsd";
+            account.channels = {"foobar1125"};
+            accounts.push_back(account);
+        }
+        return accounts;
+    }
+
+    /**
+     * This is a convenience method which waits up to one second for the
+     * fleet to reach the given progress.
+     */
+    bool AwaitProgress(
+        std::function< bool(const Twitch::MessagingFleet::Progress& progress) > condition
+    ) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (std::chrono::steady_clock::now() < deadline) {
+            if (condition(fleet.GetProgress())) {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return false;
+    }
+
+    // ::testing::Test
+
+    virtual void SetUp() override {
+        fleet.SetConnectionFactory(
+            [this]() -> std::shared_ptr< Twitch::Connection > {
+                const auto mockServer = std::make_shared< MockServer >(serverStatistics);
+                std::lock_guard< std::mutex > lock(mockServersMutex);
+                mockServers.push_back(mockServer);
+                return mockServer;
+            }
+        );
+        fleet.SetTimeKeeper(mockTimeKeeper);
+    }
+
+    virtual void TearDown() override {
+    }
+};
+
+TEST_F(MessagingFleetTests, LogInAllAccountsWithBoundedConcurrency) {
+    Twitch::MessagingFleet::Configuration configuration;
+    configuration.maxLogInsInFlight = 4;
+    configuration.maxLogInsPerWindow = 1000;
+    fleet.Configure(configuration);
+    fleet.LogIn(MakeAccounts(50));
+    ASSERT_TRUE(
+        AwaitProgress(
+            [](const Twitch::MessagingFleet::Progress& progress){
+                return progress.loggedIn == 50;
+            }
+        )
+    );
+    const auto report = fleet.GetReport();
+    EXPECT_EQ(50, report.progress.total);
+    EXPECT_EQ(0, report.progress.waiting);
+    EXPECT_EQ(0, report.progress.inFlight);
+    EXPECT_EQ(0, report.progress.failed);
+    EXPECT_EQ(50, report.timeToLogIn.count);
+    EXPECT_EQ(50, serverStatistics->connections);
+    EXPECT_LE(serverStatistics->peakLogInsInProgress, 4);
+}
+
+TEST_F(MessagingFleetTests, LogInsAreRateLimited) {
+    Twitch::MessagingFleet::Configuration configuration;
+    configuration.maxLogInsInFlight = 100;
+    configuration.maxLogInsPerWindow = 5;
+    configuration.rateLimitWindow = 10.0;
+    fleet.Configure(configuration);
+    fleet.LogIn(MakeAccounts(12));
+    ASSERT_TRUE(
+        AwaitProgress(
+            [](const Twitch::MessagingFleet::Progress& progress){
+                return progress.loggedIn == 5;
+            }
+        )
+    );
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto progress = fleet.GetProgress();
+    EXPECT_EQ(5, progress.loggedIn);
+    EXPECT_EQ(7, progress.waiting);
+    mockTimeKeeper->currentTime = 10.0;
+    ASSERT_TRUE(
+        AwaitProgress(
+            [](const Twitch::MessagingFleet::Progress& progress){
+                return progress.loggedIn == 10;
+            }
+        )
+    );
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    progress = fleet.GetProgress();
+    EXPECT_EQ(10, progress.loggedIn);
+    EXPECT_EQ(2, progress.waiting);
+    mockTimeKeeper->currentTime = 20.0;
+    ASSERT_TRUE(
+        AwaitProgress(
+            [](const Twitch::MessagingFleet::Progress& progress){
+                return progress.loggedIn == 12;
+            }
+        )
+    );
+}
+
+TEST_F(MessagingFleetTests, LatencyHistograms) {
+    serverStatistics->holdMotd = true;
+    fleet.LogIn(MakeAccounts(4));
+    ASSERT_TRUE(
+        AwaitProgress(
+            [](const Twitch::MessagingFleet::Progress& progress){
+                return progress.inFlight == 4;
+            }
+        )
+    );
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::vector< std::shared_ptr< MockServer > > mockServers;
+    {
+        std::lock_guard< std::mutex > lock(mockServersMutex);
+        mockServers = this->mockServers;
+    }
+    ASSERT_EQ(4, mockServers.size());
+    for (size_t i = 0; i < mockServers.size(); ++i) {
+        mockTimeKeeper->currentTime = (double)(i + 1);
+        mockServers[i]->ReleaseMotd();
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (
+            (fleet.GetReport().timeToFirstMessage.count < i + 1)
+            && (std::chrono::steady_clock::now() < deadline)
+        ) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        ASSERT_EQ(i + 1, fleet.GetProgress().loggedIn);
+    }
+    const auto report = fleet.GetReport();
+    EXPECT_EQ(4, report.timeToLogIn.count);
+    EXPECT_EQ(1.0, report.timeToLogIn.minimum);
+    EXPECT_EQ(2.0, report.timeToLogIn.p50);
+    EXPECT_EQ(4.0, report.timeToLogIn.p90);
+    EXPECT_EQ(4.0, report.timeToLogIn.p99);
+    EXPECT_EQ(4.0, report.timeToLogIn.maximum);
+    EXPECT_EQ(4, report.timeToFirstMessage.count);
+    EXPECT_EQ(1.0, report.timeToFirstMessage.minimum);
+    EXPECT_EQ(4.0, report.timeToFirstMessage.maximum);
+}
+
+TEST_F(MessagingFleetTests, FailedLogInsAreCounted) {
+    serverStatistics->failConnectionAttempts = true;
+    fleet.LogIn(MakeAccounts(3));
+    ASSERT_TRUE(
+        AwaitProgress(
+            [](const Twitch::MessagingFleet::Progress& progress){
+                return progress.failed == 3;
+            }
+        )
+    );
+    const auto progress = fleet.GetProgress();
+    EXPECT_EQ(0, progress.loggedIn);
+    EXPECT_EQ(0, progress.inFlight);
+    EXPECT_EQ(0, progress.waiting);
+}
+
+TEST_F(MessagingFleetTests, UserCallbacksArePassedAlong) {
+    struct User
+        : public Twitch::Messaging::User
+    {
+        std::mutex mutex;
+        bool loggedIn = false;
+        std::vector< std::string > messages;
+
+        virtual void LogIn() override {
+            std::lock_guard< std::mutex > lock(mutex);
+            loggedIn = true;
+        }
+
+        virtual void Message(Twitch::Messaging::MessageInfo&& messageInfo) override {
+            std::lock_guard< std::mutex > lock(mutex);
+            messages.push_back(messageInfo.messageContent);
+        }
+    };
+    const auto user = std::make_shared< User >();
+    auto accounts = MakeAccounts(1);
+    accounts[0].user = user;
+    fleet.LogIn(accounts);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (std::chrono::steady_clock::now() < deadline) {
+        std::lock_guard< std::mutex > lock(user->mutex);
+        if (!user->messages.empty()) {
+            break;
+        }
+    }
+    std::lock_guard< std::mutex > lock(user->mutex);
+    EXPECT_TRUE(user->loggedIn);
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "Hello, World!",
+        }),
+        user->messages
+    );
+}
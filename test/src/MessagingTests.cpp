@@ -7,17 +7,25 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <condition_variable>
+#include <fstream>
 #include <future>
+#include <stdio.h>
 #include <gtest/gtest.h>
 #include <memory>
 #include <mutex>
+#include <new>
 #include <regex>
+#include <set>
+#include <stdlib.h>
 #include <string>
+#include <thread>
 #include <StringExtensions/StringExtensions.hpp>
 #include <Twitch/Connection.hpp>
 #include <Twitch/Messaging.hpp>
 #include <Twitch/TimeKeeper.hpp>
+#include <Twitch/Timeline.hpp>
 #include <vector>
 
 namespace {
@@ -28,12 +36,74 @@ namespace {
      */
     const std::string CRLF = "\r\n";
 
+    /**
+     * This flag indicates whether or not memory allocations are being
+     * counted.
+     */
+    std::atomic< bool > countingAllocations(false);
+
+    /**
+     * This is the number of memory allocations made while counting
+     * memory allocations.
+     */
+    std::atomic< size_t > allocationCount(0);
+
     /**
      * This regular expression should only match the nickname of an anonymous
      * Twitch user.
      */
     static const std::regex ANONYMOUS_NICKNAME_PATTERN("justinfan([0-9]+)");
 
+}
+
+/**
+ * This replaces the default memory allocation function, in order
+ * to count memory allocations.
+ *
+ * @param[in] size
+ *     This is the number of bytes to allocate.
+ *
+ * @return
+ *     The allocated memory is returned.
+ */
+void* operator new(size_t size) {
+    if (countingAllocations) {
+        ++allocationCount;
+    }
+    const auto memory = malloc((size == 0) ? 1 : size);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+/**
+ * This replaces the default memory deallocation function, to match
+ * the replacement of the memory allocation function.
+ *
+ * @param[in] memory
+ *     This is the memory to deallocate.
+ */
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+/**
+ * This replaces the default sized memory deallocation function, to match
+ * the replacement of the memory allocation function.
+ *
+ * @param[in] memory
+ *     This is the memory to deallocate.
+ *
+ * @param[in] size
+ *     This is the number of bytes which were allocated.
+ */
+void operator delete(void* memory, size_t size) noexcept {
+    free(memory);
+}
+
+namespace {
+
     /**
      * This is a fake Twitch server used to test the Messaging class.
      */
@@ -61,6 +131,7 @@ namespace {
         std::string nicknameOffered;
         std::string passwordOffered;
         std::vector< std::string > linesReceived;
+        std::vector< std::string > sendsReceived;
 
         // Methods
 
@@ -131,6 +202,11 @@ namespace {
             return linesReceived;
         }
 
+        std::vector< std::string > GetSendsReceived() {
+            std::lock_guard< std::mutex > lock(mutex);
+            return sendsReceived;
+        }
+
         void ClearLinesReceived() {
             linesReceived.clear();
         }
@@ -190,33 +266,36 @@ namespace {
                 connectionProblem = true;
                 return;
             }
-            dataReceived += message;
-            const auto lineEnd = dataReceived.find(CRLF);
-            if (lineEnd == std::string::npos) {
-                return;
-            }
-            const auto line = dataReceived.substr(0, lineEnd);
             std::lock_guard< std::mutex > lock(mutex);
-            linesReceived.push_back(line);
-            dataReceived = dataReceived.substr(lineEnd + CRLF.length());
-            if (line.substr(0, 5) == "PASS ") {
-                wasPasswordOffered = true;
-                passwordOffered = line.substr(5);
-                passwordOffered = StringExtensions::Trim(passwordOffered);
-            } else if (line.substr(0, 5) == "NICK ") {
-                if (!capEndReceived) {
-                    nickSetBeforeCapEnd = true;
+            sendsReceived.push_back(message);
+            dataReceived += message;
+            for (;;) {
+                const auto lineEnd = dataReceived.find(CRLF);
+                if (lineEnd == std::string::npos) {
+                    break;
+                }
+                const auto line = dataReceived.substr(0, lineEnd);
+                linesReceived.push_back(line);
+                dataReceived = dataReceived.substr(lineEnd + CRLF.length());
+                if (line.substr(0, 5) == "PASS ") {
+                    wasPasswordOffered = true;
+                    passwordOffered = line.substr(5);
+                    passwordOffered = StringExtensions::Trim(passwordOffered);
+                } else if (line.substr(0, 5) == "NICK ") {
+                    if (!capEndReceived) {
+                        nickSetBeforeCapEnd = true;
+                    }
+                    nicknameOffered = line.substr(5);
+                    nicknameOffered = StringExtensions::Trim(nicknameOffered);
+                } else if (line.substr(0, 7) == "CAP LS ") {
+                    capLsReceived = true;
+                    capLsArg = line.substr(7);
+                } else if (line.substr(0, 9) == "CAP REQ :") {
+                    wasCapsRequested = true;
+                    capsRequested = line.substr(9);
+                } else if (line == "CAP END") {
+                    capEndReceived = true;
                 }
-                nicknameOffered = line.substr(5);
-                nicknameOffered = StringExtensions::Trim(nicknameOffered);
-            } else if (line.substr(0, 7) == "CAP LS ") {
-                capLsReceived = true;
-                capLsArg = line.substr(7);
-            } else if (line.substr(0, 9) == "CAP REQ :") {
-                wasCapsRequested = true;
-                capsRequested = line.substr(9);
-            } else if (line == "CAP END") {
-                capEndReceived = true;
             }
             wakeCondition.notify_one();
         }
@@ -245,6 +324,30 @@ namespace {
         }
     };
 
+    /**
+     * This is a time keeper which measures real time, and counts how many
+     * times it's asked for the current time.
+     */
+    struct ClockTimeKeeper
+        : public Twitch::TimeKeeper
+    {
+        // Properties
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::atomic< size_t > timesAsked{0};
+
+        // Methods
+
+        // Twitch::TimeKeeper
+
+        virtual double GetCurrentTime() override {
+            ++timesAsked;
+            return std::chrono::duration< double >(
+                std::chrono::steady_clock::now() - start
+            ).count();
+        }
+    };
+
     /**
      * This represents the user of the unit under test, and receives all
      * notifications, events, and other callbacks from the unit under test.
@@ -255,12 +358,22 @@ namespace {
         // Properties
 
         bool loggedIn = false;
+        std::thread::id logInThread;
         bool loggedOut = false;
         bool doom = false;
         std::vector< Twitch::Messaging::NameListInfo > nameLists;
         std::vector< Twitch::Messaging::MembershipInfo > joins;
         std::vector< Twitch::Messaging::MembershipInfo > parts;
         std::vector< Twitch::Messaging::MessageInfo > messages;
+        std::vector< size_t > messageBatchSizes;
+        bool takeSharedEvents = false;
+        std::vector< std::shared_ptr< const Twitch::Messaging::Event > > sharedEvents;
+        bool recordRawMessages = false;
+        std::vector< std::string > rawLines;
+        std::vector< std::string > rawCommands;
+        std::vector< std::vector< std::string > > rawParameters;
+        std::vector< bool > rawHandled;
+        std::vector< size_t > messagesBeforeNotices;
         std::vector< Twitch::Messaging::MessageInfo > privateMessages;
         std::vector< Twitch::Messaging::WhisperInfo > whispers;
         std::vector< Twitch::Messaging::NoticeInfo > notices;
@@ -272,11 +385,29 @@ namespace {
         std::vector< Twitch::Messaging::SubInfo > subs;
         std::vector< Twitch::Messaging::RaidInfo > raids;
         std::vector< Twitch::Messaging::RitualInfo > rituals;
+        bool messagesBlocked = false;
+        bool messageHeld = false;
+        std::condition_variable messagesUnblocked;
         std::condition_variable wakeCondition;
         std::mutex mutex;
 
         // Methods
 
+        void BlockMessages(bool block) {
+            std::lock_guard< std::mutex > lock(mutex);
+            messagesBlocked = block;
+            messagesUnblocked.notify_all();
+        }
+
+        bool AwaitMessageHeld() {
+            std::unique_lock< std::mutex > lock(mutex);
+            return wakeCondition.wait_for(
+                lock,
+                std::chrono::milliseconds(100),
+                [this]{ return messageHeld; }
+            );
+        }
+
         bool AwaitLogIn() {
             std::unique_lock< std::mutex > lock(mutex);
             return wakeCondition.wait_for(
@@ -450,6 +581,7 @@ namespace {
         virtual void LogIn() override {
             std::lock_guard< std::mutex > lock(mutex);
             loggedIn = true;
+            logInThread = std::this_thread::get_id();
             wakeCondition.notify_one();
         }
 
@@ -486,11 +618,72 @@ namespace {
         virtual void Message(
             Twitch::Messaging::MessageInfo&& messageInfo
         ) override {
-            std::lock_guard< std::mutex > lock(mutex);
+            std::unique_lock< std::mutex > lock(mutex);
+            messageHeld = true;
+            wakeCondition.notify_all();
+            messagesUnblocked.wait(
+                lock,
+                [this]{ return !messagesBlocked; }
+            );
+            messageHeld = false;
             messages.push_back(std::move(messageInfo));
             wakeCondition.notify_one();
         }
 
+        virtual void RawMessage(
+            const Twitch::Messaging::RawMessageInfo& rawMessageInfo
+        ) override {
+            std::lock_guard< std::mutex > lock(mutex);
+            if (!recordRawMessages) {
+                return;
+            }
+            rawLines.push_back(rawMessageInfo.line);
+            rawCommands.push_back(rawMessageInfo.command);
+            rawParameters.push_back(rawMessageInfo.parameters);
+            rawHandled.push_back(rawMessageInfo.handled);
+            wakeCondition.notify_one();
+        }
+
+        bool AwaitSharedEvents(size_t numSharedEvents) {
+            std::unique_lock< std::mutex > lock(mutex);
+            return wakeCondition.wait_for(
+                lock,
+                std::chrono::milliseconds(100),
+                [this, numSharedEvents]{ return sharedEvents.size() == numSharedEvents; }
+            );
+        }
+
+        bool AwaitRawMessages(size_t numRawMessages) {
+            std::unique_lock< std::mutex > lock(mutex);
+            return wakeCondition.wait_for(
+                lock,
+                std::chrono::milliseconds(100),
+                [this, numRawMessages]{ return rawLines.size() == numRawMessages; }
+            );
+        }
+
+        virtual bool SharedEvent(
+            const std::shared_ptr< const Twitch::Messaging::Event >& event
+        ) override {
+            std::lock_guard< std::mutex > lock(mutex);
+            if (!takeSharedEvents) {
+                return false;
+            }
+            sharedEvents.push_back(event);
+            wakeCondition.notify_one();
+            return true;
+        }
+
+        virtual void Messages(
+            std::vector< Twitch::Messaging::MessageInfo >&& messageInfos
+        ) override {
+            {
+                std::lock_guard< std::mutex > lock(mutex);
+                messageBatchSizes.push_back(messageInfos.size());
+            }
+            Twitch::Messaging::User::Messages(std::move(messageInfos));
+        }
+
         virtual void PrivateMessage(
             Twitch::Messaging::MessageInfo&& messageInfo
         ) override {
@@ -511,6 +704,7 @@ namespace {
             Twitch::Messaging::NoticeInfo&& noticeInfo
         ) override {
             std::lock_guard< std::mutex > lock(mutex);
+            messagesBeforeNotices.push_back(messages.size());
             notices.push_back(std::move(noticeInfo));
             wakeCondition.notify_one();
         }
@@ -628,8 +822,15 @@ struct MessagingTests
      *
      * @param[in] includeTags
      *     If true, also request the twitch.tv/tags capability from the server
+     *
+     * @param[in] clearLinesReceived
+     *     If true, clear the lines received by the mock server once
+     *     logged in.
      */
-    void LogIn(bool includeTags = false) {
+    void LogIn(
+        bool includeTags = false,
+        bool clearLinesReceived = true
+    ) {
         const std::string nickname = "foobar1124";
         const std::string token = "alskdfjasdf87sdfsdffsd";
         tmi.LogIn(nickname, token);
@@ -653,7 +854,65 @@ struct MessagingTests
             + ":tmi.twitch.tv 376 <user> :>" + CRLF
         );
         (void)user->AwaitLogIn();
-        mockServer->ClearLinesReceived();
+        if (clearLinesReceived) {
+            mockServer->ClearLinesReceived();
+        }
+    }
+
+    /**
+     * This is a convenience method which returns options for sending
+     * a message which report how the message turned out.
+     *
+     * @param[out] outcome
+     *     This is where to store the future which becomes ready once
+     *     the message turns out one way or another.
+     *
+     * @param[in] expiration
+     *     This is the most number of seconds the message may be held.
+     *
+     * @return
+     *     The options for sending the message are returned.
+     */
+    Twitch::Messaging::SendOptions TrackDelivery(
+        std::future< Twitch::Messaging::DeliveryOutcome >& outcome,
+        double expiration = 0.0
+    ) {
+        const auto promise = std::make_shared< std::promise< Twitch::Messaging::DeliveryOutcome > >();
+        outcome = promise->get_future();
+        Twitch::Messaging::SendOptions options;
+        options.expiration = expiration;
+        options.deliveryDelegate = [promise](Twitch::Messaging::DeliveryOutcome outcome){
+            promise->set_value(outcome);
+        };
+        return options;
+    }
+
+    /**
+     * This is a convenience method which waits for a message to turn out
+     * one way or another.
+     *
+     * @param[in] outcome
+     *     This is the future which becomes ready once the message
+     *     turns out one way or another.
+     *
+     * @param[in] expected
+     *     This is how the message is expected to turn out.
+     *
+     * @return
+     *     An indication of whether or not the message turned out
+     *     as expected is returned.
+     */
+    bool AwaitDelivery(
+        std::future< Twitch::Messaging::DeliveryOutcome >& outcome,
+        Twitch::Messaging::DeliveryOutcome expected
+    ) {
+        if (
+            outcome.wait_for(std::chrono::seconds(1))
+            != std::future_status::ready
+        ) {
+            return false;
+        }
+        return (outcome.get() == expected);
     }
 
     /**
@@ -860,6 +1119,145 @@ TEST_F(MessagingTests, LogInAfterDisconnect) {
     EXPECT_TRUE(user->AwaitLogIn());
 }
 
+TEST_F(MessagingTests, LogInAfterDisconnectWithCachedCapabilities) {
+    tmi.EnableCapabilitiesCache();
+    LogIn(true);
+    EXPECT_FALSE(tmi.GetLastHandshakeInfo().usedCachedCapabilities);
+    user->loggedIn = false;
+    mockServer->DisconnectClient();
+    ASSERT_TRUE(user->AwaitLogOut());
+    newConnectionMade = std::make_shared< std::promise< void > >();
+    const std::string nickname = "foobar1124";
+    const std::string token = "alskdfjasdf87sdfsdffsd";
+    tmi.LogIn(nickname, token);
+    ASSERT_TRUE(
+        newConnectionMade->get_future().wait_for(std::chrono::milliseconds(100))
+        == std::future_status::ready
+    );
+    ASSERT_TRUE(mockServer->AwaitCapReq());
+    EXPECT_FALSE(mockServer->capLsReceived);
+    EXPECT_EQ(
+        "twitch.tv/commands twitch.tv/tags",
+        mockServer->capsRequested
+    );
+    EXPECT_FALSE(mockServer->AwaitCapEnd());
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv CAP * ACK :twitch.tv/commands twitch.tv/tags" + CRLF
+    );
+    ASSERT_TRUE(mockServer->AwaitCapEnd());
+    ASSERT_TRUE(mockServer->AwaitNickname());
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv 372 <user> :You are in a maze of twisty passages." + CRLF
+        + ":tmi.twitch.tv 376 <user> :>" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitLogIn());
+    EXPECT_TRUE(tmi.GetLastHandshakeInfo().usedCachedCapabilities);
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "CAP REQ :twitch.tv/commands twitch.tv/tags",
+            "CAP END",
+            "PASS oauth:" + token,
+            "NICK " + nickname,
+        }),
+        mockServer->GetLinesReceived()
+    );
+}
+
+TEST_F(MessagingTests, CachedCapabilitiesRefusedAreRevalidated) {
+    tmi.EnableCapabilitiesCache();
+    LogIn(true);
+    user->loggedIn = false;
+    mockServer->DisconnectClient();
+    ASSERT_TRUE(user->AwaitLogOut());
+    newConnectionMade = std::make_shared< std::promise< void > >();
+    tmi.LogIn("foobar1124", "alskdfjasdf87sdfsdffsd");
+    ASSERT_TRUE(
+        newConnectionMade->get_future().wait_for(std::chrono::milliseconds(100))
+        == std::future_status::ready
+    );
+    ASSERT_TRUE(mockServer->AwaitCapReq());
+    mockServer->wasCapsRequested = false;
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv CAP * NAK :twitch.tv/commands twitch.tv/tags" + CRLF
+    );
+    ASSERT_TRUE(mockServer->AwaitCapLs());
+    EXPECT_FALSE(mockServer->capEndReceived);
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv CAP * LS :twitch.tv/membership twitch.tv/tags twitch.tv/commands" + CRLF
+    );
+    ASSERT_TRUE(mockServer->AwaitCapReq());
+    EXPECT_EQ(
+        "twitch.tv/commands twitch.tv/membership twitch.tv/tags",
+        mockServer->capsRequested
+    );
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv CAP * ACK :twitch.tv/commands twitch.tv/membership twitch.tv/tags" + CRLF
+    );
+    ASSERT_TRUE(mockServer->AwaitNickname());
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv 376 <user> :>" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitLogIn());
+    EXPECT_FALSE(tmi.GetLastHandshakeInfo().usedCachedCapabilities);
+}
+
+TEST_F(MessagingTests, CapabilitiesCachePersistedToFile) {
+    const std::string cacheFilePath = "TwitchCapabilitiesCacheTest.txt";
+    (void)remove(cacheFilePath.c_str());
+    tmi.EnableCapabilitiesCache(cacheFilePath);
+    LogIn(true);
+    std::ifstream cacheFile(cacheFilePath);
+    std::vector< std::string > cachedCaps;
+    std::string line;
+    while (std::getline(cacheFile, line)) {
+        cachedCaps.push_back(line);
+    }
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "twitch.tv/commands",
+            "twitch.tv/tags",
+        }),
+        cachedCaps
+    );
+    Twitch::Messaging tmi2;
+    const auto mockServer2 = std::make_shared< MockServer >();
+    tmi2.SetConnectionFactory(
+        [mockServer2]{ return mockServer2; }
+    );
+    tmi2.EnableCapabilitiesCache(cacheFilePath);
+    tmi2.LogIn("foobar1124", "alskdfjasdf87sdfsdffsd");
+    ASSERT_TRUE(mockServer2->AwaitCapReq());
+    EXPECT_FALSE(mockServer2->capLsReceived);
+    EXPECT_EQ(
+        "twitch.tv/commands twitch.tv/tags",
+        mockServer2->capsRequested
+    );
+    (void)remove(cacheFilePath.c_str());
+}
+
+TEST_F(MessagingTests, HandshakeDurationMeasured) {
+    mockTimeKeeper->currentTime = 10.0;
+    tmi.LogIn("foobar1124", "alskdfjasdf87sdfsdffsd");
+    ASSERT_TRUE(mockServer->AwaitCapLs());
+    mockTimeKeeper->currentTime = 10.25;
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv CAP * LS :twitch.tv/membership twitch.tv/tags twitch.tv/commands" + CRLF
+    );
+    ASSERT_TRUE(mockServer->AwaitCapReq());
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv CAP * ACK :twitch.tv/commands" + CRLF
+    );
+    ASSERT_TRUE(mockServer->AwaitNickname());
+    mockTimeKeeper->currentTime = 10.75;
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv 376 <user> :>" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitLogIn());
+    const auto handshake = tmi.GetLastHandshakeInfo();
+    EXPECT_EQ(0.75, handshake.duration);
+    EXPECT_FALSE(handshake.usedCachedCapabilities);
+}
+
 TEST_F(MessagingTests, LogIntoChat) {
     const std::string nickname = "foobar1124";
     const std::string token = "alskdfjasdf87sdfsdffsd";
@@ -919,6 +1317,66 @@ TEST_F(MessagingTests, LogOutOfChat) {
     EXPECT_TRUE(mockServer->IsDisconnected());
 }
 
+TEST_F(MessagingTests, LogOutGracefullyDrainsOutboundQueue) {
+    Twitch::Messaging::OutboundQueueConfiguration configuration;
+    configuration.maxMessages = 10;
+    configuration.rateLimit = 1;
+    configuration.rateLimitWindow = 30.0;
+    tmi.ConfigureOutboundQueue(configuration);
+    LogIn();
+    std::future< Twitch::Messaging::DeliveryOutcome > outcomes[3];
+    for (size_t i = 0; i < 3; ++i) {
+        tmi.SendMessage("foobar1125", "Message " + std::to_string(i), TrackDelivery(outcomes[i]));
+    }
+    EXPECT_TRUE(AwaitDelivery(outcomes[0], Twitch::Messaging::DeliveryOutcome::Sent));
+    tmi.LogOut("Bye", 100.0);
+    EXPECT_FALSE(mockServer->AwaitLineReceived("QUIT :Bye"));
+    EXPECT_FALSE(user->AwaitLogOut());
+    mockTimeKeeper->currentTime = 30.0;
+    EXPECT_TRUE(AwaitDelivery(outcomes[1], Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_FALSE(mockServer->AwaitLineReceived("QUIT :Bye"));
+    mockTimeKeeper->currentTime = 60.0;
+    EXPECT_TRUE(AwaitDelivery(outcomes[2], Twitch::Messaging::DeliveryOutcome::Sent));
+    ASSERT_TRUE(user->AwaitLogOut());
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "PRIVMSG #foobar1125 :Message 0",
+            "PRIVMSG #foobar1125 :Message 1",
+            "PRIVMSG #foobar1125 :Message 2",
+            "QUIT :Bye",
+        }),
+        mockServer->GetLinesReceived()
+    );
+    EXPECT_TRUE(mockServer->IsDisconnected());
+}
+
+TEST_F(MessagingTests, LogOutGracefullyStopsAtDeadline) {
+    Twitch::Messaging::OutboundQueueConfiguration configuration;
+    configuration.maxMessages = 10;
+    configuration.rateLimit = 1;
+    configuration.rateLimitWindow = 30.0;
+    tmi.ConfigureOutboundQueue(configuration);
+    LogIn();
+    std::future< Twitch::Messaging::DeliveryOutcome > outcomes[3];
+    for (size_t i = 0; i < 3; ++i) {
+        tmi.SendMessage("foobar1125", "Message " + std::to_string(i), TrackDelivery(outcomes[i]));
+    }
+    EXPECT_TRUE(AwaitDelivery(outcomes[0], Twitch::Messaging::DeliveryOutcome::Sent));
+    tmi.LogOut("Bye", 10.0);
+    EXPECT_FALSE(user->AwaitLogOut());
+    mockTimeKeeper->currentTime = 10.0;
+    ASSERT_TRUE(user->AwaitLogOut());
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "PRIVMSG #foobar1125 :Message 0",
+            "QUIT :Bye",
+        }),
+        mockServer->GetLinesReceived()
+    );
+    EXPECT_TRUE(mockServer->IsDisconnected());
+    EXPECT_EQ(2, tmi.GetOutboundQueueStatistics().messages);
+}
+
 TEST_F(MessagingTests, LogInWhenAlreadyLoggedIn) {
     // Log in normally, before the "test" begins.
     LogIn();
@@ -1325,33 +1783,330 @@ TEST_F(MessagingTests, SendResponse) {
     EXPECT_TRUE(mockServer->AwaitLineReceived("@reply-parent-msg-id=xyz PRIVMSG #foobar1125 :Hello, World!"));
 }
 
-TEST_F(MessagingTests, SendMessageWhenNotConnected) {
-    tmi.SendMessage("foobar1125", "Hello, World!");
-    EXPECT_FALSE(mockServer->AwaitLineReceived("PRIVMSG #foobar1125 :Hello, World!"));
+TEST_F(MessagingTests, SendMessageWithLineBreaks) {
+    // Log in and join a channel.
+    LogIn();
+    Join("foobar1125");
+
+    // Send a message which tries to sneak in another command.
+    tmi.SendMessage("foobar1125", "Hello!\r\nPART #foobar1125");
+    EXPECT_TRUE(mockServer->AwaitLineReceived("PRIVMSG #foobar1125 :Hello!PART #foobar1125"));
 }
 
-TEST_F(MessagingTests, Ping) {
-    // Log in and then clear the received lines buffer.
+TEST_F(MessagingTests, SendMessageTooLong) {
+    // Log in and join a channel.
     LogIn();
+    Join("foobar1125");
     mockServer->ClearLinesReceived();
 
-    // Have the pretend Twitch server simulate a PING message.
-    mockServer->ReturnToClient(
-        "PING :Hello!" + CRLF
-        + "PING :Are you there?" + CRLF
-    );
-
-    // Wait for the user agent to respond with a corresponding PONG message.
-    ASSERT_TRUE(mockServer->AwaitLineReceived("PONG :Are you there?")) << mockServer->GetLinesReceived().size();
+    // Send a message which is too long, followed by one which isn't.
+    tmi.SendMessage("foobar1125", std::string(512, 'x'));
+    tmi.SendMessage("foobar1125", "Hello, World!");
+    ASSERT_TRUE(mockServer->AwaitLineReceived("PRIVMSG #foobar1125 :Hello, World!"));
     EXPECT_EQ(
         (std::vector< std::string >{
-            "PONG :Hello!",
+            "PRIVMSG #foobar1125 :Hello, World!",
+        }),
+        mockServer->GetLinesReceived()
+    );
+}
+
+TEST_F(MessagingTests, SendMessageWhenNotConnected) {
+    tmi.SendMessage("foobar1125", "Hello, World!");
+    EXPECT_FALSE(mockServer->AwaitLineReceived("PRIVMSG #foobar1125 :Hello, World!"));
+}
+
+TEST_F(MessagingTests, SendMessageReportsDelivery) {
+    std::future< Twitch::Messaging::DeliveryOutcome > notConnected, connected;
+    tmi.SendMessage("foobar1125", "Hello?", TrackDelivery(notConnected));
+    EXPECT_TRUE(AwaitDelivery(notConnected, Twitch::Messaging::DeliveryOutcome::Dropped));
+    LogIn();
+    tmi.SendMessage("foobar1125", "Hello!", TrackDelivery(connected));
+    EXPECT_TRUE(AwaitDelivery(connected, Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_TRUE(mockServer->AwaitLineReceived("PRIVMSG #foobar1125 :Hello!"));
+}
+
+TEST_F(MessagingTests, OutboundQueueHoldsSendsUntilLoggedIn) {
+    Twitch::Messaging::OutboundQueueConfiguration configuration;
+    configuration.maxMessages = 10;
+    tmi.ConfigureOutboundQueue(configuration);
+    std::future< Twitch::Messaging::DeliveryOutcome > message, whisper;
+    tmi.Join("foobar1125");
+    tmi.SendMessage("foobar1125", "Hello, World!", TrackDelivery(message));
+    tmi.SendWhisper("foobar1126", "Psst!", TrackDelivery(whisper));
+    ASSERT_FALSE(mockServer->AwaitLineReceived("JOIN #foobar1125"));
+    auto statistics = tmi.GetOutboundQueueStatistics();
+    EXPECT_EQ(3, statistics.messages);
+    EXPECT_EQ(10 + 10 + 13 + 10 + 5, statistics.bytes);
+    LogIn(false, false);
+    EXPECT_TRUE(AwaitDelivery(message, Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_TRUE(AwaitDelivery(whisper, Twitch::Messaging::DeliveryOutcome::Sent));
+    ASSERT_TRUE(mockServer->AwaitLineReceived("PRIVMSG #jtv :.w foobar1126 Psst!"));
+    const auto linesReceived = mockServer->GetLinesReceived();
+    ASSERT_GE(linesReceived.size(), 3);
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "JOIN #foobar1125",
+            "PRIVMSG #foobar1125 :Hello, World!",
+            "PRIVMSG #jtv :.w foobar1126 Psst!",
+        }),
+        std::vector< std::string >(linesReceived.end() - 3, linesReceived.end())
+    );
+    statistics = tmi.GetOutboundQueueStatistics();
+    EXPECT_EQ(0, statistics.messages);
+    EXPECT_EQ(0, statistics.bytes);
+    EXPECT_EQ(48, statistics.peakBytes);
+    EXPECT_EQ(3, statistics.messagesSent);
+}
+
+TEST_F(MessagingTests, OutboundQueueHeldAcrossDisconnect) {
+    Twitch::Messaging::OutboundQueueConfiguration configuration;
+    configuration.maxMessages = 10;
+    tmi.ConfigureOutboundQueue(configuration);
+    LogIn();
+    user->loggedIn = false;
+    mockServer->DisconnectClient();
+    ASSERT_TRUE(user->AwaitLogOut());
+    std::future< Twitch::Messaging::DeliveryOutcome > outcome;
+    tmi.SendMessage("foobar1125", "Back soon!", TrackDelivery(outcome));
+    ASSERT_NE(
+        std::future_status::ready,
+        outcome.wait_for(std::chrono::milliseconds(100))
+    );
+    newConnectionMade = std::make_shared< std::promise< void > >();
+    tmi.LogIn("foobar1124", "alskdfjasdf87sdfsdffsd");
+    ASSERT_TRUE(
+        newConnectionMade->get_future().wait_for(std::chrono::milliseconds(100))
+        == std::future_status::ready
+    );
+    ASSERT_TRUE(mockServer->AwaitCapLs());
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv CAP * LS :twitch.tv/membership twitch.tv/tags twitch.tv/commands" + CRLF
+    );
+    ASSERT_TRUE(mockServer->AwaitCapReq());
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv CAP * ACK :twitch.tv/commands" + CRLF
+    );
+    ASSERT_TRUE(mockServer->AwaitNickname());
+    EXPECT_FALSE(mockServer->AwaitLineReceived("PRIVMSG #foobar1125 :Back soon!"));
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv 372 <user> :You are in a maze of twisty passages." + CRLF
+        + ":tmi.twitch.tv 376 <user> :>" + CRLF
+    );
+    EXPECT_TRUE(AwaitDelivery(outcome, Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_TRUE(mockServer->AwaitLineReceived("PRIVMSG #foobar1125 :Back soon!"));
+}
+
+TEST_F(MessagingTests, OutboundQueueRateLimit) {
+    Twitch::Messaging::OutboundQueueConfiguration configuration;
+    configuration.maxMessages = 10;
+    configuration.rateLimit = 2;
+    configuration.rateLimitWindow = 30.0;
+    tmi.ConfigureOutboundQueue(configuration);
+    LogIn();
+    std::future< Twitch::Messaging::DeliveryOutcome > outcomes[3];
+    for (size_t i = 0; i < 3; ++i) {
+        tmi.SendMessage("foobar1125", "Message " + std::to_string(i), TrackDelivery(outcomes[i]));
+    }
+    EXPECT_TRUE(AwaitDelivery(outcomes[0], Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_TRUE(AwaitDelivery(outcomes[1], Twitch::Messaging::DeliveryOutcome::Sent));
+    ASSERT_TRUE(mockServer->AwaitLineReceived("PRIVMSG #foobar1125 :Message 1"));
+    EXPECT_FALSE(mockServer->AwaitLineReceived("PRIVMSG #foobar1125 :Message 2"));
+    EXPECT_EQ(1, tmi.GetOutboundQueueStatistics().messages);
+    mockTimeKeeper->currentTime = 30.0;
+    EXPECT_TRUE(AwaitDelivery(outcomes[2], Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_TRUE(mockServer->AwaitLineReceived("PRIVMSG #foobar1125 :Message 2"));
+}
+
+TEST_F(MessagingTests, OutboundQueueExpiration) {
+    const auto clockTimeKeeper = std::make_shared< ClockTimeKeeper >();
+    tmi.SetTimeKeeper(clockTimeKeeper);
+    Twitch::Messaging::OutboundQueueConfiguration configuration;
+    configuration.maxMessages = 10;
+    configuration.expiration = 1.0;
+    tmi.ConfigureOutboundQueue(configuration);
+    std::future< Twitch::Messaging::DeliveryOutcome > shortLived, longLived;
+    tmi.SendMessage("foobar1125", "Now or never!", TrackDelivery(shortLived, 0.1));
+    tmi.SendMessage("foobar1125", "Whenever.", TrackDelivery(longLived));
+    ASSERT_NE(
+        std::future_status::ready,
+        shortLived.wait_for(std::chrono::milliseconds(50))
+    );
+    EXPECT_TRUE(AwaitDelivery(shortLived, Twitch::Messaging::DeliveryOutcome::Expired));
+    ASSERT_NE(
+        std::future_status::ready,
+        longLived.wait_for(std::chrono::milliseconds(100))
+    );
+    EXPECT_TRUE(AwaitDelivery(longLived, Twitch::Messaging::DeliveryOutcome::Expired));
+    const auto statistics = tmi.GetOutboundQueueStatistics();
+    EXPECT_EQ(0, statistics.messages);
+    EXPECT_EQ(0, statistics.bytes);
+    EXPECT_EQ(2, statistics.messagesExpired);
+
+    // Verify that, while disconnected, the messages were held without
+    // polling, by waiting for each one to expire instead.
+    EXPECT_LE(clockTimeKeeper->timesAsked.load(), 16);
+}
+
+TEST_F(MessagingTests, OutboundQueueDropsWhatCannotBeSent) {
+    Twitch::Messaging::OutboundQueueConfiguration configuration;
+    configuration.maxMessages = 10;
+    configuration.rateLimit = 1;
+    configuration.rateLimitWindow = 30.0;
+    tmi.ConfigureOutboundQueue(configuration);
+    tmi.LogInAnonymously();
+    (void)mockServer->AwaitCapLs();
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv CAP * LS :twitch.tv/membership twitch.tv/tags twitch.tv/commands" + CRLF
+    );
+    (void)mockServer->AwaitCapReq();
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv CAP * ACK :twitch.tv/commands twitch.tv/membership twitch.tv/tags" + CRLF
+    );
+    (void)mockServer->AwaitNickname();
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv 372 <user> :You are in a maze of twisty passages." + CRLF
+        + ":tmi.twitch.tv 376 <user> :>" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitLogIn());
+    std::future< Twitch::Messaging::DeliveryOutcome > outcomes[2];
+    tmi.SendMessage("foobar1125", "Hello!", TrackDelivery(outcomes[0]));
+    tmi.SendWhisper("foobar1126", "Psst!", TrackDelivery(outcomes[1]));
+    EXPECT_TRUE(AwaitDelivery(outcomes[0], Twitch::Messaging::DeliveryOutcome::Dropped));
+    EXPECT_TRUE(AwaitDelivery(outcomes[1], Twitch::Messaging::DeliveryOutcome::Dropped));
+    const auto statistics = tmi.GetOutboundQueueStatistics();
+    EXPECT_EQ(0, statistics.messages);
+    EXPECT_EQ(0, statistics.bytes);
+    EXPECT_EQ(0, statistics.messagesSent);
+    EXPECT_EQ(2, statistics.messagesDropped);
+}
+
+TEST_F(MessagingTests, OutboundQueueLimits) {
+    Twitch::Messaging::OutboundQueueConfiguration configuration;
+    configuration.maxMessages = 2;
+    configuration.maxBytes = 30;
+    tmi.ConfigureOutboundQueue(configuration);
+    std::future< Twitch::Messaging::DeliveryOutcome > outcomes[4];
+    tmi.SendMessage("foobar1125", "Hello!", TrackDelivery(outcomes[0]));
+    tmi.SendMessage("foobar1125", "This is too long.", TrackDelivery(outcomes[1]));
+    tmi.SendMessage("foobar1125", "Hi!", TrackDelivery(outcomes[2]));
+    tmi.SendMessage("foobar1125", "No room.", TrackDelivery(outcomes[3]));
+    EXPECT_TRUE(AwaitDelivery(outcomes[1], Twitch::Messaging::DeliveryOutcome::Dropped));
+    EXPECT_TRUE(AwaitDelivery(outcomes[3], Twitch::Messaging::DeliveryOutcome::Dropped));
+    const auto statistics = tmi.GetOutboundQueueStatistics();
+    EXPECT_EQ(2, statistics.messages);
+    EXPECT_EQ(10 + 6 + 10 + 3, statistics.bytes);
+    EXPECT_EQ(2, statistics.messagesDropped);
+    tmi.EnableMetrics(true);
+    const auto metrics = tmi.GetMetrics();
+    EXPECT_EQ(2, metrics.outboundQueued);
+    EXPECT_EQ(29, metrics.outboundQueuedBytes);
+    EXPECT_EQ(2, metrics.outboundDropped);
+    const auto text = tmi.GetMetricsText();
+    EXPECT_NE(
+        std::string::npos,
+        text.find("twitch_outbound_queued_bytes 29\n")
+    );
+    EXPECT_NE(
+        std::string::npos,
+        text.find("twitch_outbound_dropped_total 2\n")
+    );
+}
+
+TEST_F(MessagingTests, Ping) {
+    // Log in and then clear the received lines buffer.
+    LogIn();
+    mockServer->ClearLinesReceived();
+
+    // Have the pretend Twitch server simulate a PING message.
+    mockServer->ReturnToClient(
+        "PING :Hello!" + CRLF
+        + "PING :Are you there?" + CRLF
+    );
+
+    // Wait for the user agent to respond with a corresponding PONG message.
+    ASSERT_TRUE(mockServer->AwaitLineReceived("PONG :Are you there?")) << mockServer->GetLinesReceived().size();
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "PONG :Hello!",
             "PONG :Are you there?"
         }),
         mockServer->GetLinesReceived()
     );
 }
 
+TEST_F(MessagingTests, PongSentRightAway) {
+    // Log in and then clear the received lines buffer.
+    LogIn();
+    const auto sendsBefore = mockServer->GetSendsReceived().size();
+
+    // Have the pretend Twitch server simulate two PING messages arriving
+    // together.
+    mockServer->ReturnToClient(
+        "PING :Hello!" + CRLF
+        + "PING :Are you there?" + CRLF
+    );
+
+    // Expect each PONG to have been sent on its own, rather than held
+    // until the end of the worker thread iteration.
+    ASSERT_TRUE(mockServer->AwaitLineReceived("PONG :Are you there?"));
+    const auto sends = mockServer->GetSendsReceived();
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "PONG :Hello!" + CRLF,
+            "PONG :Are you there?" + CRLF,
+        }),
+        std::vector< std::string >(sends.begin() + sendsBefore, sends.end())
+    );
+}
+
+TEST_F(MessagingTests, LinesProducedTogetherAreSentTogether) {
+    // Log in, which sends the nickname and password in the same worker
+    // thread iteration as the end of capability negotiation.
+    LogIn();
+
+    // Expect those lines to have been sent together.
+    const auto sends = mockServer->GetSendsReceived();
+    EXPECT_NE(
+        sends.end(),
+        std::find(
+            sends.begin(),
+            sends.end(),
+            "CAP END" + CRLF
+            + "PASS oauth:alskdfjasdf87sdfsdffsd" + CRLF
+            + "NICK foobar1124" + CRLF
+        )
+    );
+}
+
+TEST_F(MessagingTests, FarewellSentWithLinesNotYetSent) {
+    // Log in, and hold up the worker thread delivering a message while
+    // joining a channel, sending a message, and logging out, so that the
+    // worker thread does all of them in its next iteration.
+    LogIn();
+    mockServer->ClearLinesReceived();
+    user->BlockMessages(true);
+    mockServer->ReturnToClient(
+        ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :Hello, World!" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitMessageHeld());
+    tmi.Join("foobar1125");
+    tmi.SendMessage("foobar1125", "Hi");
+    tmi.LogOut("Bye");
+    user->BlockMessages(false);
+
+    // Expect the lines to have gone out together with the farewell.
+    ASSERT_TRUE(mockServer->AwaitLineReceived("QUIT :Bye"));
+    const auto sends = mockServer->GetSendsReceived();
+    ASSERT_FALSE(sends.empty());
+    EXPECT_EQ(
+        "JOIN #foobar1125" + CRLF
+        + "PRIVMSG #foobar1125 :Hi" + CRLF
+        + "QUIT :Bye" + CRLF,
+        sends.back()
+    );
+}
+
 TEST_F(MessagingTests, CommandCapabilityNotRequestedWhenNotSupported) {
     const std::string nickname = "foobar1124";
     const std::string token = "alskdfjasdf87sdfsdffsd";
@@ -1918,6 +2673,243 @@ TEST_F(MessagingTests, ChannelUserState) {
     EXPECT_EQ(0xFFFFFF, user->userStates[0].tags.color);
 }
 
+TEST_F(MessagingTests, ChannelStateTracked) {
+    // Log in (with tags capability) and join a channel.
+    LogIn(true);
+    Join("foobar1125");
+    auto channelState = tmi.GetChannelState("foobar1125");
+    EXPECT_EQ(0, channelState.slow);
+    EXPECT_EQ(-1, channelState.followersOnly);
+    EXPECT_FALSE(channelState.moderator);
+
+    // Have the pretend Twitch server send the channel's modes and the
+    // user's channel-specific state.
+    mockServer->ReturnToClient(
+        "@emote-only=1;followers-only=10;r9k=1;rituals=0;room-id=12345;slow=30;subs-only=1 "
+        ":tmi.twitch.tv ROOMSTATE #foobar1125" + CRLF
+        + "@badges=vip/1,subscriber/12;color=;display-name=FooBar1124;emote-sets=0;mod=0;subscriber=1;user-type= "
+        ":tmi.twitch.tv USERSTATE #foobar1125" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitUserState(1));
+    channelState = tmi.GetChannelState("foobar1125");
+    EXPECT_EQ(30, channelState.slow);
+    EXPECT_EQ(10, channelState.followersOnly);
+    EXPECT_TRUE(channelState.subsOnly);
+    EXPECT_TRUE(channelState.emoteOnly);
+    EXPECT_TRUE(channelState.r9k);
+    EXPECT_FALSE(channelState.moderator);
+    EXPECT_TRUE(channelState.vip);
+    EXPECT_TRUE(channelState.subscriber);
+
+    // Have the pretend Twitch server turn off slow mode, and make the user
+    // a moderator instead of a VIP.
+    mockServer->ReturnToClient(
+        "@room-id=12345;slow=0 :tmi.twitch.tv ROOMSTATE #foobar1125" + CRLF
+        + "@badges=moderator/1;color=;display-name=FooBar1124;emote-sets=0;mod=1;subscriber=0;user-type=mod "
+        ":tmi.twitch.tv USERSTATE #foobar1125" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitUserState(2));
+    channelState = tmi.GetChannelState("foobar1125");
+    EXPECT_EQ(0, channelState.slow);
+    EXPECT_TRUE(channelState.subsOnly);
+    EXPECT_TRUE(channelState.moderator);
+    EXPECT_FALSE(channelState.vip);
+    EXPECT_FALSE(channelState.subscriber);
+}
+
+TEST_F(MessagingTests, ChannelStateForgottenOnLeaveAndDisconnect) {
+    // Set up the outbound queue, so that messages are checked against the
+    // modes of channels.
+    Twitch::Messaging::OutboundQueueConfiguration configuration;
+    configuration.maxMessages = 10;
+    tmi.ConfigureOutboundQueue(configuration);
+
+    // Log in (with tags capability), have the pretend Twitch server put
+    // two channels in r9k mode, and send a message to each.
+    LogIn(true);
+    mockServer->ReturnToClient(
+        "@r9k=1;room-id=12345 :tmi.twitch.tv ROOMSTATE #foobar1125" + CRLF
+        + "@r9k=1;room-id=12346 :tmi.twitch.tv ROOMSTATE #foobar1126" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitRoomModeChanges(2));
+    std::future< Twitch::Messaging::DeliveryOutcome > outcomes[2];
+    tmi.SendMessage("foobar1125", "Hi", TrackDelivery(outcomes[0]));
+    tmi.SendMessage("foobar1126", "Hi", TrackDelivery(outcomes[1]));
+    EXPECT_TRUE(AwaitDelivery(outcomes[0], Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_TRUE(AwaitDelivery(outcomes[1], Twitch::Messaging::DeliveryOutcome::Sent));
+
+    // Leave one channel, and verify its modes and the last message sent
+    // to it are forgotten, while the other channel is still known.
+    tmi.Leave("foobar1125");
+    ASSERT_TRUE(mockServer->AwaitLineReceived("PART #foobar1125"));
+    EXPECT_FALSE(tmi.GetChannelState("foobar1125").r9k);
+    EXPECT_TRUE(tmi.GetChannelState("foobar1126").r9k);
+    tmi.SendMessage("foobar1125", "Hi", TrackDelivery(outcomes[0]));
+    tmi.SendMessage("foobar1126", "Hi", TrackDelivery(outcomes[1]));
+    EXPECT_TRUE(AwaitDelivery(outcomes[0], Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_TRUE(AwaitDelivery(outcomes[1], Twitch::Messaging::DeliveryOutcome::Rejected));
+    EXPECT_EQ(1, tmi.GetChannelState("foobar1126").messagesRejected);
+
+    // Lose the connection, and verify every channel is forgotten.
+    mockServer->DisconnectClient();
+    ASSERT_TRUE(user->AwaitLogOut());
+    const auto channelState = tmi.GetChannelState("foobar1126");
+    EXPECT_FALSE(channelState.r9k);
+    EXPECT_EQ(0, channelState.messagesRejected);
+}
+
+TEST_F(MessagingTests, SlowModeHoldsMessagesPerChannel) {
+    Twitch::Messaging::OutboundQueueConfiguration configuration;
+    configuration.maxMessages = 10;
+    tmi.ConfigureOutboundQueue(configuration);
+    LogIn(true);
+    mockTimeKeeper->currentTime = 1.0;
+    mockServer->ReturnToClient(
+        "@room-id=12345;slow=10 :tmi.twitch.tv ROOMSTATE #foobar1125" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitRoomModeChanges(1));
+
+    // Send two messages to the channel in slow mode, and one to another
+    // channel, and verify only the second message to the channel in slow
+    // mode is held.
+    std::future< Twitch::Messaging::DeliveryOutcome > first, second, elsewhere;
+    tmi.SendMessage("foobar1125", "First", TrackDelivery(first));
+    tmi.SendMessage("foobar1125", "Second", TrackDelivery(second));
+    tmi.SendMessage("foobar1126", "Elsewhere", TrackDelivery(elsewhere));
+    EXPECT_TRUE(AwaitDelivery(first, Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_TRUE(AwaitDelivery(elsewhere, Twitch::Messaging::DeliveryOutcome::Sent));
+    ASSERT_NE(
+        std::future_status::ready,
+        second.wait_for(std::chrono::milliseconds(100))
+    );
+    EXPECT_EQ(1, tmi.GetChannelState("foobar1125").messagesQueued);
+    EXPECT_EQ(0, tmi.GetChannelState("foobar1126").messagesQueued);
+
+    // Verify the held message is sent once enough time has passed.
+    mockTimeKeeper->currentTime = 11.0;
+    EXPECT_TRUE(AwaitDelivery(second, Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_EQ(0, tmi.GetChannelState("foobar1125").messagesQueued);
+    ASSERT_TRUE(mockServer->AwaitLineReceived("PRIVMSG #foobar1125 :Second"));
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "PRIVMSG #foobar1125 :First",
+            "PRIVMSG #foobar1126 :Elsewhere",
+            "PRIVMSG #foobar1125 :Second",
+        }),
+        mockServer->GetLinesReceived()
+    );
+}
+
+TEST_F(MessagingTests, SlowModeDoesNotHoldModerators) {
+    Twitch::Messaging::OutboundQueueConfiguration configuration;
+    configuration.maxMessages = 10;
+    tmi.ConfigureOutboundQueue(configuration);
+    LogIn(true);
+    mockTimeKeeper->currentTime = 1.0;
+    mockServer->ReturnToClient(
+        "@room-id=12345;slow=10 :tmi.twitch.tv ROOMSTATE #foobar1125" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitRoomModeChanges(1));
+
+    // A message sent too soon is held.
+    std::future< Twitch::Messaging::DeliveryOutcome > outcomes[3];
+    tmi.SendMessage("foobar1125", "First", TrackDelivery(outcomes[0]));
+    tmi.SendMessage("foobar1125", "Second", TrackDelivery(outcomes[1]));
+    EXPECT_TRUE(AwaitDelivery(outcomes[0], Twitch::Messaging::DeliveryOutcome::Sent));
+    ASSERT_NE(
+        std::future_status::ready,
+        outcomes[1].wait_for(std::chrono::milliseconds(100))
+    );
+
+    // Moderators aren't held back by slow mode, so once the user is one,
+    // the held message is sent, and so is the next one.
+    mockServer->ReturnToClient(
+        "@badges=moderator/1;color=;display-name=FooBar1124;emote-sets=0;mod=1;subscriber=0;user-type=mod "
+        ":tmi.twitch.tv USERSTATE #foobar1125" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitUserState(1));
+    tmi.SendMessage("foobar1125", "Third", TrackDelivery(outcomes[2]));
+    EXPECT_TRUE(AwaitDelivery(outcomes[1], Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_TRUE(AwaitDelivery(outcomes[2], Twitch::Messaging::DeliveryOutcome::Sent));
+    ASSERT_TRUE(mockServer->AwaitLineReceived("PRIVMSG #foobar1125 :Third"));
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "PRIVMSG #foobar1125 :First",
+            "PRIVMSG #foobar1125 :Second",
+            "PRIVMSG #foobar1125 :Third",
+        }),
+        mockServer->GetLinesReceived()
+    );
+    EXPECT_EQ(0, tmi.GetChannelState("foobar1125").messagesRejected);
+}
+
+TEST_F(MessagingTests, ChannelModesIgnoredWithoutOutboundQueue) {
+    LogIn(true);
+    mockTimeKeeper->currentTime = 1.0;
+    mockServer->ReturnToClient(
+        "@r9k=1;room-id=12345;slow=10;subs-only=1 :tmi.twitch.tv ROOMSTATE #foobar1125" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitRoomModeChanges(3));
+
+    // Without an outbound queue, messages are sent right away, just as
+    // they were before channel modes were tracked.
+    std::future< Twitch::Messaging::DeliveryOutcome > outcomes[3];
+    tmi.SendMessage("foobar1125", "Hi", TrackDelivery(outcomes[0]));
+    tmi.SendMessage("foobar1125", "Hi", TrackDelivery(outcomes[1]));
+    tmi.SendMessage("foobar1125", "Bye", TrackDelivery(outcomes[2]));
+    EXPECT_TRUE(AwaitDelivery(outcomes[0], Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_TRUE(AwaitDelivery(outcomes[1], Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_TRUE(AwaitDelivery(outcomes[2], Twitch::Messaging::DeliveryOutcome::Sent));
+    ASSERT_TRUE(mockServer->AwaitLineReceived("PRIVMSG #foobar1125 :Bye"));
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "PRIVMSG #foobar1125 :Hi",
+            "PRIVMSG #foobar1125 :Hi",
+            "PRIVMSG #foobar1125 :Bye",
+        }),
+        mockServer->GetLinesReceived()
+    );
+    EXPECT_EQ(0, tmi.GetChannelState("foobar1125").messagesRejected);
+}
+
+TEST_F(MessagingTests, SubsOnlyAndR9kModesRejectMessages) {
+    Twitch::Messaging::OutboundQueueConfiguration configuration;
+    configuration.maxMessages = 10;
+    tmi.ConfigureOutboundQueue(configuration);
+    LogIn(true);
+    mockServer->ReturnToClient(
+        "@r9k=1;room-id=12345;subs-only=1 :tmi.twitch.tv ROOMSTATE #foobar1125" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitRoomModeChanges(2));
+
+    // Until the user is a subscriber, every message is rejected.
+    std::future< Twitch::Messaging::DeliveryOutcome > outcomes[4];
+    tmi.SendMessage("foobar1125", "Hi", TrackDelivery(outcomes[0]));
+    EXPECT_TRUE(AwaitDelivery(outcomes[0], Twitch::Messaging::DeliveryOutcome::Rejected));
+
+    // Once the user is a subscriber, only repeated messages are rejected.
+    mockServer->ReturnToClient(
+        "@badges=subscriber/3;color=;display-name=FooBar1124;emote-sets=0;mod=0;subscriber=1;user-type= "
+        ":tmi.twitch.tv USERSTATE #foobar1125" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitUserState(1));
+    tmi.SendMessage("foobar1125", "Hi", TrackDelivery(outcomes[1]));
+    tmi.SendMessage("foobar1125", "Hi", TrackDelivery(outcomes[2]));
+    tmi.SendMessage("foobar1125", "Hello", TrackDelivery(outcomes[3]));
+    EXPECT_TRUE(AwaitDelivery(outcomes[1], Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_TRUE(AwaitDelivery(outcomes[2], Twitch::Messaging::DeliveryOutcome::Rejected));
+    EXPECT_TRUE(AwaitDelivery(outcomes[3], Twitch::Messaging::DeliveryOutcome::Sent));
+    EXPECT_EQ(2, tmi.GetChannelState("foobar1125").messagesRejected);
+    ASSERT_TRUE(mockServer->AwaitLineReceived("PRIVMSG #foobar1125 :Hello"));
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "PRIVMSG #foobar1125 :Hi",
+            "PRIVMSG #foobar1125 :Hello",
+        }),
+        mockServer->GetLinesReceived()
+    );
+}
+
 TEST_F(MessagingTests, Reconnect) {
     // Log into chat.  We (probably?) don't need to be in any chat room in
     // order to get told about the server's imminent doom!
@@ -2330,3 +3322,1211 @@ TEST_F(MessagingTests, ReceivePrivateMessage) {
     EXPECT_EQ("jtv", user->privateMessages[0].user);
     EXPECT_EQ("foobar1126 is now hosting you.", user->privateMessages[0].messageContent);
 }
+
+TEST_F(MessagingTests, ReceiveMessageSplitAcrossChunks) {
+    // Log in and join a channel.
+    LogIn();
+    Join("foobar1125");
+
+    // Have the pretend Twitch server deliver a message in two pieces.
+    mockServer->ReturnToClient(
+        ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foob"
+    );
+    mockServer->ReturnToClient(
+        "ar1125 :Hello, World!" + CRLF
+    );
+
+    // Wait for the message to be received.
+    ASSERT_TRUE(user->AwaitMessages(1));
+    ASSERT_EQ(1, user->messages.size());
+    EXPECT_EQ("foobar1125", user->messages[0].channel);
+    EXPECT_EQ("Hello, World!", user->messages[0].messageContent);
+}
+
+TEST_F(MessagingTests, InboundBacklogDropsLowPriorityLinesFirst) {
+    // Log in and join a channel.
+    LogIn();
+    Join("foobar1125");
+    const auto joinsBefore = user->joins.size();
+
+    // Hold up the handling of chat messages so that lines received
+    // afterwards back up.
+    user->BlockMessages(true);
+    const auto messageLine = [](const std::string& content) {
+        return ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :" + content + CRLF;
+    };
+    const std::string joinLine = ":foobar1127!foobar1127@foobar1127.tmi.twitch.tv JOIN #foobar1125" + CRLF;
+    mockServer->ReturnToClient(messageLine("msg1"));
+    ASSERT_TRUE(user->AwaitMessageHeld());
+
+    // Limit the backlog to two chat messages and a bit.
+    Twitch::Messaging::InboundBacklogConfiguration configuration;
+    configuration.maxBytes = messageLine("msg1").length() * 2 + joinLine.length() / 2;
+    configuration.policy = Twitch::Messaging::InboundOverloadPolicy::DropLowPriority;
+    tmi.ConfigureInboundBacklog(configuration);
+
+    // Have the pretend Twitch server send more than fits in the backlog.
+    mockServer->ReturnToClient(joinLine + messageLine("msg2"));
+    auto statistics = tmi.GetInboundBacklogStatistics();
+    EXPECT_EQ(joinLine.length() + messageLine("msg2").length(), statistics.bytes);
+    EXPECT_EQ(0, statistics.lowPriorityLinesDropped);
+    mockServer->ReturnToClient(messageLine("msg3"));
+    statistics = tmi.GetInboundBacklogStatistics();
+    EXPECT_EQ(messageLine("msg2").length() * 2, statistics.bytes);
+    EXPECT_EQ(1, statistics.lowPriorityLinesDropped);
+    EXPECT_EQ(0, statistics.messagesDropped);
+    mockServer->ReturnToClient(messageLine("msg4"));
+    statistics = tmi.GetInboundBacklogStatistics();
+    EXPECT_EQ(1, statistics.lowPriorityLinesDropped);
+    EXPECT_EQ(1, statistics.messagesDropped);
+    EXPECT_EQ(0, statistics.timesBlocked);
+    EXPECT_LE(statistics.peakBytes, configuration.maxBytes);
+
+    // Let the backlog drain, and verify the oldest message and the
+    // membership line were the ones dropped.
+    user->BlockMessages(false);
+    ASSERT_TRUE(user->AwaitMessages(3));
+    EXPECT_EQ("msg1", user->messages[0].messageContent);
+    EXPECT_EQ("msg3", user->messages[1].messageContent);
+    EXPECT_EQ("msg4", user->messages[2].messageContent);
+    EXPECT_EQ(joinsBefore, user->joins.size());
+    EXPECT_EQ(0, tmi.GetInboundBacklogStatistics().bytes);
+}
+
+TEST_F(MessagingTests, InboundBacklogSamplesMessages) {
+    // Log in and join a channel.
+    LogIn();
+    Join("foobar1125");
+    const auto joinsBefore = user->joins.size();
+
+    // Make up a burst of lines.
+    std::string lines = ":foobar1127!foobar1127@foobar1127.tmi.twitch.tv JOIN #foobar1125" + CRLF;
+    for (int i = 0; i < 6; ++i) {
+        lines += StringExtensions::sprintf(
+            ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :msg%d",
+            i
+        ) + CRLF;
+    }
+    lines += "PING :tmi.twitch.tv" + CRLF;
+
+    // Limit the backlog to less than the lines about to arrive.
+    Twitch::Messaging::InboundBacklogConfiguration configuration;
+    configuration.maxBytes = lines.length() - 1;
+    configuration.policy = Twitch::Messaging::InboundOverloadPolicy::SampleMessages;
+    configuration.messageSampleRate = 3;
+    tmi.ConfigureInboundBacklog(configuration);
+
+    // Have the pretend Twitch server send the burst of lines.
+    mockServer->ReturnToClient(lines);
+
+    // Verify only one in three messages, and none of the membership lines,
+    // made it through, but essential lines weren't touched.
+    ASSERT_TRUE(mockServer->AwaitLineReceived("PONG :tmi.twitch.tv"));
+    ASSERT_TRUE(user->AwaitMessages(2));
+    EXPECT_EQ("msg0", user->messages[0].messageContent);
+    EXPECT_EQ("msg3", user->messages[1].messageContent);
+    EXPECT_EQ(joinsBefore, user->joins.size());
+    const auto statistics = tmi.GetInboundBacklogStatistics();
+    EXPECT_EQ(1, statistics.lowPriorityLinesDropped);
+    EXPECT_EQ(4, statistics.messagesDropped);
+    EXPECT_EQ(0, statistics.oversizedLinesDropped);
+}
+
+TEST_F(MessagingTests, InboundBacklogNeverDropsEssentialLines) {
+    // Log in and join a channel.
+    LogIn();
+    Join("foobar1125");
+
+    // Hold up the handling of chat messages so that lines received
+    // afterwards back up.
+    user->BlockMessages(true);
+    const auto messageLine = [](const std::string& content) {
+        return ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :" + content + CRLF;
+    };
+    mockServer->ReturnToClient(messageLine("msg1"));
+    ASSERT_TRUE(user->AwaitMessageHeld());
+
+    // Limit the backlog to three notices, which are never dropped to
+    // make room, and then flood it with them, along with chat messages,
+    // which are.
+    const auto noticeLine = [](int i) {
+        return StringExtensions::sprintf(
+            "@msg-id=flood :tmi.twitch.tv NOTICE #foobar1125 :notice%02d",
+            i
+        ) + CRLF;
+    };
+    Twitch::Messaging::InboundBacklogConfiguration configuration;
+    configuration.maxBytes = noticeLine(0).length() * 3;
+    configuration.policy = Twitch::Messaging::InboundOverloadPolicy::DropLowPriority;
+    tmi.ConfigureInboundBacklog(configuration);
+    std::thread connectionThread(
+        [this, &noticeLine, &messageLine]{
+            for (int i = 0; i < 10; ++i) {
+                mockServer->ReturnToClient(
+                    noticeLine(i * 2)
+                    + messageLine("flood")
+                    + noticeLine(i * 2 + 1)
+                );
+            }
+        }
+    );
+
+    // Verify the connection is held up, rather than notices dropped, once
+    // dropping chat messages doesn't make enough room.
+    const auto startTime = std::chrono::steady_clock::now();
+    while (
+        (tmi.GetInboundBacklogStatistics().timesBlocked == 0)
+        && (std::chrono::steady_clock::now() - startTime < std::chrono::seconds(1))
+    ) {
+        std::this_thread::yield();
+    }
+    auto statistics = tmi.GetInboundBacklogStatistics();
+    EXPECT_EQ(1, statistics.timesBlocked);
+    EXPECT_LE(statistics.bytes, configuration.maxBytes);
+
+    // Let the backlog drain, and verify every notice was handled, in
+    // order, and the backlog never went over its limit.
+    user->BlockMessages(false);
+    connectionThread.join();
+    ASSERT_TRUE(user->AwaitNotices(20));
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_EQ(
+            StringExtensions::sprintf("notice%02d", i),
+            user->notices[i].message
+        );
+    }
+    statistics = tmi.GetInboundBacklogStatistics();
+    EXPECT_LE(statistics.peakBytes, configuration.maxBytes);
+    EXPECT_GE(statistics.messagesDropped, 2);
+    EXPECT_EQ(0, statistics.oversizedLinesDropped);
+}
+
+TEST_F(MessagingTests, InboundBacklogDiscardsOversizedLines) {
+    // Log in and join a channel.
+    LogIn();
+    Join("foobar1125");
+
+    // Limit the backlog to less than a line which is about to arrive.
+    Twitch::Messaging::InboundBacklogConfiguration configuration;
+    configuration.maxBytes = 100;
+    tmi.ConfigureInboundBacklog(configuration);
+
+    // Have the pretend Twitch server send a line longer than the limit,
+    // in pieces, followed by a chat message.
+    const std::string oversizedLine = (
+        ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :"
+        + std::string(100, 'x')
+    );
+    mockServer->ReturnToClient(oversizedLine.substr(0, 60));
+    mockServer->ReturnToClient(oversizedLine.substr(60, 60));
+    mockServer->ReturnToClient(oversizedLine.substr(120));
+    mockServer->ReturnToClient(
+        CRLF
+        + ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :Hello!" + CRLF
+    );
+
+    // Verify only the chat message made it through, and the oversized
+    // line was counted.
+    ASSERT_TRUE(user->AwaitMessages(1));
+    EXPECT_EQ("Hello!", user->messages[0].messageContent);
+    const auto statistics = tmi.GetInboundBacklogStatistics();
+    EXPECT_EQ(1, statistics.oversizedLinesDropped);
+    EXPECT_EQ(0, statistics.messagesDropped);
+}
+
+TEST_F(MessagingTests, InboundBacklogBlocksConnection) {
+    // Log in and join a channel.
+    LogIn();
+    Join("foobar1125");
+
+    // Hold up the handling of chat messages so that lines received
+    // afterwards back up.
+    user->BlockMessages(true);
+    const auto messageLine = [](const std::string& content) {
+        return ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :" + content + CRLF;
+    };
+    mockServer->ReturnToClient(messageLine("msg1"));
+    ASSERT_TRUE(user->AwaitMessageHeld());
+
+    // Limit the backlog to one chat message.
+    Twitch::Messaging::InboundBacklogConfiguration configuration;
+    configuration.maxBytes = messageLine("msg1").length();
+    configuration.policy = Twitch::Messaging::InboundOverloadPolicy::Block;
+    tmi.ConfigureInboundBacklog(configuration);
+
+    // Fill the backlog, and then have the pretend Twitch server send one
+    // more message, which should hold up the connection.
+    mockServer->ReturnToClient(messageLine("msg2"));
+    std::thread connectionThread(
+        [this, &messageLine]{
+            mockServer->ReturnToClient(messageLine("msg3"));
+        }
+    );
+    const auto startTime = std::chrono::steady_clock::now();
+    while (
+        (tmi.GetInboundBacklogStatistics().timesBlocked == 0)
+        && (std::chrono::steady_clock::now() - startTime < std::chrono::milliseconds(100))
+    ) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(1, tmi.GetInboundBacklogStatistics().timesBlocked);
+
+    // Let the backlog drain, and verify nothing was dropped.
+    user->BlockMessages(false);
+    connectionThread.join();
+    ASSERT_TRUE(user->AwaitMessages(3));
+    EXPECT_EQ("msg1", user->messages[0].messageContent);
+    EXPECT_EQ("msg2", user->messages[1].messageContent);
+    EXPECT_EQ("msg3", user->messages[2].messageContent);
+    const auto statistics = tmi.GetInboundBacklogStatistics();
+    EXPECT_EQ(0, statistics.lowPriorityLinesDropped);
+    EXPECT_EQ(0, statistics.messagesDropped);
+    EXPECT_EQ(1, statistics.timesBlocked);
+}
+
+TEST_F(MessagingTests, InboundBacklogBlockKeepsChunksLargerThanLimit) {
+    // Log in and join a channel.
+    LogIn();
+    Join("foobar1125");
+
+    // Limit the backlog to one chat message, and then have the pretend
+    // Twitch server send three at once.
+    const auto messageLine = [](const std::string& content) {
+        return ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :" + content + CRLF;
+    };
+    Twitch::Messaging::InboundBacklogConfiguration configuration;
+    configuration.maxBytes = messageLine("msg1").length();
+    configuration.policy = Twitch::Messaging::InboundOverloadPolicy::Block;
+    tmi.ConfigureInboundBacklog(configuration);
+    mockServer->ReturnToClient(messageLine("msg1") + messageLine("msg2") + messageLine("msg3"));
+
+    // Verify nothing was dropped.
+    ASSERT_TRUE(user->AwaitMessages(3));
+    EXPECT_EQ("msg1", user->messages[0].messageContent);
+    EXPECT_EQ("msg2", user->messages[1].messageContent);
+    EXPECT_EQ("msg3", user->messages[2].messageContent);
+    const auto statistics = tmi.GetInboundBacklogStatistics();
+    EXPECT_EQ(0, statistics.messagesDropped);
+    EXPECT_EQ(0, statistics.oversizedLinesDropped);
+}
+
+TEST_F(MessagingTests, ChannelSamplingKeepsOneInN) {
+    // Log in and join two channels.
+    LogIn();
+    Join("foobar1125");
+    Join("foobar1127");
+
+    // Sample one in three messages in every channel except one, in which
+    // one in two messages are sampled.
+    Twitch::Messaging::ChannelSampling sampling;
+    sampling.keepOneIn = 3;
+    tmi.SetChannelSampling("", sampling);
+    sampling.keepOneIn = 2;
+    tmi.SetChannelSampling("foobar1127", sampling);
+
+    // Have the pretend Twitch server send a burst of chat messages to
+    // both channels.
+    std::string lines;
+    for (int i = 0; i < 6; ++i) {
+        lines += StringExtensions::sprintf(
+            ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :a%d",
+            i
+        ) + CRLF;
+        lines += StringExtensions::sprintf(
+            ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1127 :b%d",
+            i
+        ) + CRLF;
+    }
+    mockServer->ReturnToClient(lines);
+
+    // Verify the right messages were kept.
+    ASSERT_TRUE(user->AwaitMessages(5));
+    std::vector< std::string > messagesKept;
+    for (const auto& message: user->messages) {
+        messagesKept.push_back(message.messageContent);
+    }
+    EXPECT_EQ(
+        std::vector< std::string >({"a0", "b0", "b2", "a3", "b4"}),
+        messagesKept
+    );
+
+    // Remove sampling for the channel with its own sampling, and verify
+    // the sampling for every other channel now applies to it.
+    tmi.ClearChannelSampling("foobar1127");
+    lines.clear();
+    for (int i = 6; i < 9; ++i) {
+        lines += StringExtensions::sprintf(
+            ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1127 :b%d",
+            i
+        ) + CRLF;
+    }
+    mockServer->ReturnToClient(lines);
+    ASSERT_TRUE(user->AwaitMessages(6));
+    EXPECT_EQ("b6", user->messages[5].messageContent);
+    EXPECT_FALSE(user->AwaitMessages(7));
+}
+
+TEST_F(MessagingTests, ChannelSamplingCapsRate) {
+    // Log in and join a channel.
+    LogIn();
+    Join("foobar1125");
+
+    // Keep no more than two messages per second.
+    Twitch::Messaging::ChannelSampling sampling;
+    sampling.maxPerSecond = 2.0;
+    tmi.SetChannelSampling("foobar1125", sampling);
+
+    // Have the pretend Twitch server send a burst of chat messages, and
+    // verify only the first two are kept.
+    mockTimeKeeper->currentTime = 1.0;
+    std::string lines;
+    for (int i = 0; i < 4; ++i) {
+        lines += StringExtensions::sprintf(
+            ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :msg%d",
+            i
+        ) + CRLF;
+    }
+    mockServer->ReturnToClient(lines + "PING :tmi.twitch.tv" + CRLF);
+    ASSERT_TRUE(mockServer->AwaitLineReceived("PONG :tmi.twitch.tv"));
+    ASSERT_TRUE(user->AwaitMessages(2));
+
+    // Half a second later, have the pretend Twitch server send another
+    // burst of chat messages, and verify only one more is kept.
+    mockTimeKeeper->currentTime = 1.5;
+    mockServer->ReturnToClient(lines);
+    ASSERT_TRUE(user->AwaitMessages(3));
+    EXPECT_FALSE(user->AwaitMessages(4));
+    EXPECT_EQ("msg0", user->messages[0].messageContent);
+    EXPECT_EQ("msg1", user->messages[1].messageContent);
+    EXPECT_EQ("msg0", user->messages[2].messageContent);
+}
+
+TEST_F(MessagingTests, ChannelSamplingNeverDropsModerationEvents) {
+    // Log in (with tags capability) and join a channel.
+    LogIn(true);
+    Join("foobar1125");
+
+    // Sample only one in a thousand messages.
+    Twitch::Messaging::ChannelSampling sampling;
+    sampling.keepOneIn = 1000;
+    tmi.SetChannelSampling("foobar1125", sampling);
+
+    // Have the pretend Twitch server send a chat message followed by
+    // moderation events.
+    mockServer->ReturnToClient(
+        ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :msg0" + CRLF
+        + ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :msg1" + CRLF
+        + "@ban-duration=1 :tmi.twitch.tv CLEARCHAT #foobar1125 :foobar1126" + CRLF
+        + "@login=foobar1126;target-msg-id=11223344-5566-7788-99aa-bbccddeeff00 :tmi.twitch.tv CLEARMSG #foobar1125 :msg1" + CRLF
+    );
+
+    // Verify the moderation events were all passed along.
+    ASSERT_TRUE(user->AwaitClears(2));
+    ASSERT_TRUE(user->AwaitMessages(1));
+    EXPECT_EQ("msg0", user->messages[0].messageContent);
+    EXPECT_EQ(Twitch::Messaging::ClearInfo::Type::Timeout, user->clears[0].type);
+    EXPECT_EQ(Twitch::Messaging::ClearInfo::Type::ClearMessage, user->clears[1].type);
+}
+
+TEST_F(MessagingTests, EventInterestsDropUninterestingLines) {
+    // Log in (with tags capability) and join a channel.
+    LogIn(true);
+    Join("foobar1125");
+    const auto joinsBefore = user->joins.size();
+
+    // Express interest only in chat messages.
+    tmi.SetEventInterests(Twitch::Messaging::Events::Message);
+
+    // Have the pretend Twitch server send a mix of lines.
+    mockServer->ReturnToClient(
+        ":foobar1127!foobar1127@foobar1127.tmi.twitch.tv JOIN #foobar1125" + CRLF
+        + "@ban-duration=1 :tmi.twitch.tv CLEARCHAT #foobar1125 :foobar1126" + CRLF
+        + "@msg-id=slow_off :tmi.twitch.tv NOTICE #foobar1125 :This room is no longer in slow mode." + CRLF
+        + ":jtv!jtv@jtv.tmi.twitch.tv PRIVMSG foobar1124 :foobar1126 is now hosting you." + CRLF
+        + ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :Hello, World!" + CRLF
+        + "PING :tmi.twitch.tv" + CRLF
+    );
+
+    // Verify only the chat message was passed along, but the server was
+    // still answered.
+    ASSERT_TRUE(mockServer->AwaitLineReceived("PONG :tmi.twitch.tv"));
+    ASSERT_TRUE(user->AwaitMessages(1));
+    EXPECT_EQ("Hello, World!", user->messages[0].messageContent);
+    EXPECT_EQ(joinsBefore, user->joins.size());
+    EXPECT_TRUE(user->clears.empty());
+    EXPECT_TRUE(user->notices.empty());
+    EXPECT_TRUE(user->privateMessages.empty());
+
+    // Express interest in all events again, and verify the lines which
+    // were dropped are now passed along.
+    tmi.SetEventInterests(Twitch::Messaging::Events::All);
+    mockServer->ReturnToClient(
+        "@ban-duration=1 :tmi.twitch.tv CLEARCHAT #foobar1125 :foobar1126" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitClears(1));
+}
+
+TEST_F(MessagingTests, EventInterestsStillDetectLogInFailure) {
+    // Express interest only in chat messages, and then try to log in.
+    tmi.SetEventInterests(Twitch::Messaging::Events::Message);
+    const std::string nickname = "foobar1124";
+    const std::string token = "alskdfjasdf87sdfsdffsd";
+    tmi.LogIn(nickname, token);
+    (void)mockServer->AwaitCapLs();
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv CAP * LS :twitch.tv/membership twitch.tv/tags twitch.tv/commands" + CRLF
+    );
+    (void)mockServer->AwaitCapReq();
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv CAP * ACK :twitch.tv/commands" + CRLF
+    );
+    EXPECT_TRUE(mockServer->AwaitNickname());
+
+    // Have the pretend Twitch server reject our credentials, and verify
+    // the failure is detected even though the notice isn't passed along.
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv NOTICE * :Login authentication failed" + CRLF
+    );
+    EXPECT_TRUE(user->AwaitLogOut());
+    EXPECT_FALSE(user->loggedIn);
+    EXPECT_TRUE(user->notices.empty());
+}
+
+TEST_F(MessagingTests, EventInterestsStillTrackChannelState) {
+    // Log in (with tags capability), and express interest only in chat
+    // messages.
+    LogIn(true);
+    tmi.SetEventInterests(Twitch::Messaging::Events::Message);
+
+    // Have the pretend Twitch server change the channel's modes, followed
+    // by a chat message to know when the modes have been handled.
+    mockServer->ReturnToClient(
+        "@room-id=12345;slow=30 :tmi.twitch.tv ROOMSTATE #foobar1125" + CRLF
+        + "@badges=vip/1;color=;display-name=FooBar1124;emote-sets=0;mod=0;subscriber=0;user-type= "
+        ":tmi.twitch.tv USERSTATE #foobar1125" + CRLF
+        + ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :Hello, World!" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitMessages(1));
+
+    // Verify the modes were tracked, though not passed along.
+    const auto channelState = tmi.GetChannelState("foobar1125");
+    EXPECT_EQ(30, channelState.slow);
+    EXPECT_TRUE(channelState.vip);
+    EXPECT_TRUE(user->roomModeChanges.empty());
+    EXPECT_TRUE(user->userStates.empty());
+}
+
+TEST_F(MessagingTests, ReceiveMessageAllocations) {
+    // Log in (with tags capability) and join a channel.
+    LogIn(true);
+    Join("foobar1125");
+    user->messages.reserve(2);
+
+    // Have the pretend Twitch server simulate someone else chatting in the
+    // room, counting the memory allocations made while handling it.
+    const std::string line = (
+        "@badges=moderator/1,subscriber/12,partner/1;"
+        "color=#5B99FF;"
+        "display-name=FooBarMaster;"
+        "emotes=30259:6-12,54-60/64138:29-37;"
+        "flags=;"
+        "id=1122aa44-55ff-ee88-11cc-1122dd44bb66;"
+        "mod=1;"
+        "room-id=12345;"
+        "subscriber=1;"
+        "tmi-sent-ts=1539652354185;"
+        "turbo=0;"
+        "user-id=54321;"
+        "user-type=mod "
+        ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv "
+        "PRIVMSG "
+        "#foobar1125 :Hello HeyGuys This is a test SeemsGood Also did I say HeyGuys hello?" + CRLF
+    );
+    allocationCount = 0;
+    countingAllocations = true;
+    mockServer->ReturnToClient(line);
+    const auto messageReceived = user->AwaitMessages(1);
+    countingAllocations = false;
+    ASSERT_TRUE(messageReceived);
+
+    // Verify the tags and message content were moved, rather than copied,
+    // into the message delivered.  Decoding the tags accounts for most of
+    // the allocations remaining; copying them would add dozens more.
+    EXPECT_LE((size_t)allocationCount, 64);
+    EXPECT_EQ("Hello HeyGuys This is a test SeemsGood Also did I say HeyGuys hello?", user->messages[0].messageContent);
+    EXPECT_EQ(13, user->messages[0].tags.allTags.size());
+}
+
+TEST_F(MessagingTests, ReceiveMessagesInBatches) {
+    // Log in and join a channel.
+    LogIn();
+    Join("foobar1125");
+
+    // Have the pretend Twitch server send several messages at once,
+    // with a notice in between.
+    std::string lines;
+    for (int i = 0; i < 3; ++i) {
+        lines += StringExtensions::sprintf(
+            ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :msg%d",
+            i
+        ) + CRLF;
+    }
+    lines += ":tmi.twitch.tv NOTICE #foobar1125 :This room is no longer in slow mode." + CRLF;
+    for (int i = 3; i < 5; ++i) {
+        lines += StringExtensions::sprintf(
+            ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :msg%d",
+            i
+        ) + CRLF;
+    }
+    mockServer->ReturnToClient(lines);
+
+    // Verify the messages were delivered in two batches, in order, with
+    // the notice delivered in between.
+    ASSERT_TRUE(user->AwaitMessages(5));
+    EXPECT_EQ(
+        (std::vector< size_t >{3, 2}),
+        user->messageBatchSizes
+    );
+    for (size_t i = 0; i < 5; ++i) {
+        EXPECT_EQ(StringExtensions::sprintf("msg%zu", i), user->messages[i].messageContent);
+    }
+    ASSERT_EQ(1, user->notices.size());
+    EXPECT_EQ(
+        (std::vector< size_t >{3}),
+        user->messagesBeforeNotices
+    );
+}
+
+TEST_F(MessagingTests, ObserversShareEvents) {
+    // Add two observers.
+    std::mutex observersMutex;
+    std::condition_variable observersWakeCondition;
+    std::vector< std::shared_ptr< const Twitch::Messaging::Event > > firstObserverEvents;
+    std::vector< std::shared_ptr< const Twitch::Messaging::Event > > secondObserverEvents;
+    (void)tmi.AddObserver(
+        [&](std::shared_ptr< const Twitch::Messaging::Event > event) {
+            std::lock_guard< std::mutex > lock(observersMutex);
+            firstObserverEvents.push_back(event);
+            observersWakeCondition.notify_all();
+        }
+    );
+    Twitch::Messaging::ObserverConfiguration configuration;
+    configuration.events = Twitch::Messaging::Events::Message;
+    configuration.ownThread = true;
+    (void)tmi.AddObserver(
+        [&](std::shared_ptr< const Twitch::Messaging::Event > event) {
+            std::lock_guard< std::mutex > lock(observersMutex);
+            secondObserverEvents.push_back(event);
+            observersWakeCondition.notify_all();
+        },
+        configuration
+    );
+
+    // Log in and join a channel.
+    LogIn();
+    Join("foobar1125");
+
+    // Have the pretend Twitch server simulate someone else chatting in the
+    // room.
+    mockServer->ReturnToClient(
+        ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :Hello, World!" + CRLF
+    );
+
+    // Verify the user was given its own copy of the message, and both
+    // observers were given the same event.
+    ASSERT_TRUE(user->AwaitMessages(1));
+    EXPECT_EQ("Hello, World!", user->messages[0].messageContent);
+    std::unique_lock< std::mutex > lock(observersMutex);
+    ASSERT_TRUE(
+        observersWakeCondition.wait_for(
+            lock,
+            std::chrono::milliseconds(100),
+            [&]{ return !secondObserverEvents.empty(); }
+        )
+    );
+    ASSERT_EQ(1, secondObserverEvents.size());
+    ASSERT_EQ(3, firstObserverEvents.size());
+    EXPECT_EQ(Twitch::Messaging::Events::LogIn, firstObserverEvents[0]->type);
+    EXPECT_EQ(Twitch::Messaging::Events::Join, firstObserverEvents[1]->type);
+    EXPECT_EQ(Twitch::Messaging::Events::Message, firstObserverEvents[2]->type);
+    EXPECT_EQ(firstObserverEvents[2], secondObserverEvents[0]);
+    const auto& messageEvent = static_cast< const Twitch::Messaging::InfoEvent< Twitch::Messaging::MessageInfo >& >(
+        *secondObserverEvents[0]
+    );
+    EXPECT_EQ("foobar1125", messageEvent.info.channel);
+    EXPECT_EQ("foobar1126", messageEvent.info.user);
+    EXPECT_EQ("Hello, World!", messageEvent.info.messageContent);
+}
+
+TEST_F(MessagingTests, UserGivenEventsBeforeObservers) {
+    // Add an observer which notes, for each event, whether or not the
+    // user had already been given it.
+    std::mutex observersMutex;
+    std::condition_variable observersWakeCondition;
+    std::vector< std::pair< Twitch::Messaging::EventMask, bool > > observed;
+    std::string observedContent;
+    Twitch::Messaging::ObserverConfiguration configuration;
+    configuration.events = (
+        Twitch::Messaging::Events::LogIn
+        | Twitch::Messaging::Events::Message
+    );
+    (void)tmi.AddObserver(
+        [&](std::shared_ptr< const Twitch::Messaging::Event > event) {
+            bool userGivenEvent;
+            {
+                std::lock_guard< std::mutex > lock(user->mutex);
+                if (event->type == Twitch::Messaging::Events::LogIn) {
+                    userGivenEvent = user->loggedIn;
+                } else {
+                    userGivenEvent = !user->messages.empty();
+                }
+            }
+            std::lock_guard< std::mutex > lock(observersMutex);
+            observed.emplace_back(event->type, userGivenEvent);
+            if (event->type == Twitch::Messaging::Events::Message) {
+                const auto& messageEvent = static_cast< const Twitch::Messaging::InfoEvent< Twitch::Messaging::MessageInfo >& >(
+                    *event
+                );
+                observedContent = messageEvent.info.messageContent;
+            }
+            observersWakeCondition.notify_all();
+        },
+        configuration
+    );
+
+    // Log in and join a channel.
+    LogIn();
+    Join("foobar1125");
+
+    // Have the pretend Twitch server simulate someone else chatting in the
+    // room.
+    mockServer->ReturnToClient(
+        ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :Hello, World!" + CRLF
+    );
+
+    // Verify the user was given both events, with and without
+    // information, before the observer, and that the observer was
+    // still given all the information.
+    ASSERT_TRUE(user->AwaitMessages(1));
+    EXPECT_EQ("Hello, World!", user->messages[0].messageContent);
+    std::unique_lock< std::mutex > lock(observersMutex);
+    ASSERT_TRUE(
+        observersWakeCondition.wait_for(
+            lock,
+            std::chrono::milliseconds(100),
+            [&]{ return (observed.size() == 2); }
+        )
+    );
+    EXPECT_EQ(
+        (std::vector< std::pair< Twitch::Messaging::EventMask, bool > >{
+            {Twitch::Messaging::Events::LogIn, true},
+            {Twitch::Messaging::Events::Message, true},
+        }),
+        observed
+    );
+    EXPECT_EQ("Hello, World!", observedContent);
+}
+
+TEST_F(MessagingTests, UserTakesSharedEventsWithoutCopying) {
+    // Add an observer which looks at messages but doesn't keep them, and
+    // have the user take the events shared with observers.
+    std::promise< const Twitch::Messaging::Event* > eventObserved;
+    Twitch::Messaging::ObserverConfiguration configuration;
+    configuration.events = Twitch::Messaging::Events::Message;
+    (void)tmi.AddObserver(
+        [&](std::shared_ptr< const Twitch::Messaging::Event > event) {
+            eventObserved.set_value(event.get());
+        },
+        configuration
+    );
+    user->takeSharedEvents = true;
+    user->sharedEvents.reserve(1);
+
+    // Log in (with tags capability) and join a channel.
+    LogIn(true);
+    Join("foobar1125");
+
+    // Have the pretend Twitch server simulate someone else chatting in the
+    // room, counting the memory allocations made while handling it.
+    const std::string line = (
+        "@badges=moderator/1,subscriber/12,partner/1;"
+        "color=#5B99FF;"
+        "display-name=FooBarMaster;"
+        "emotes=30259:6-12,54-60/64138:29-37;"
+        "flags=;"
+        "id=1122aa44-55ff-ee88-11cc-1122dd44bb66;"
+        "mod=1;"
+        "room-id=12345;"
+        "subscriber=1;"
+        "tmi-sent-ts=1539652354185;"
+        "turbo=0;"
+        "user-id=54321;"
+        "user-type=mod "
+        ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv "
+        "PRIVMSG "
+        "#foobar1125 :Hello HeyGuys This is a test SeemsGood Also did I say HeyGuys hello?" + CRLF
+    );
+    allocationCount = 0;
+    countingAllocations = true;
+    mockServer->ReturnToClient(line);
+    auto observedEvent = eventObserved.get_future();
+    const auto eventObservedInTime = (
+        observedEvent.wait_for(std::chrono::milliseconds(100))
+        == std::future_status::ready
+    );
+    countingAllocations = false;
+    ASSERT_TRUE(eventObservedInTime);
+    ASSERT_TRUE(user->AwaitSharedEvents(1));
+
+    // Verify the user took the very event the observer saw, instead of
+    // being given a copy of the message.  Only the shared event itself and
+    // the list of events shared should be allocated beyond what delivering
+    // to the user alone takes.
+    EXPECT_LE((size_t)allocationCount, 64 + 2);
+    EXPECT_TRUE(user->messages.empty());
+    EXPECT_EQ(observedEvent.get(), user->sharedEvents[0].get());
+    const auto& messageEvent = static_cast< const Twitch::Messaging::InfoEvent< Twitch::Messaging::MessageInfo >& >(
+        *user->sharedEvents[0]
+    );
+    EXPECT_EQ("Hello HeyGuys This is a test SeemsGood Also did I say HeyGuys hello?", messageEvent.info.messageContent);
+    EXPECT_EQ(13, messageEvent.info.tags.allTags.size());
+}
+
+TEST_F(MessagingTests, ObserverQueueBounded) {
+    // Add an observer with its own thread and a queue holding only one
+    // event, which holds up handling events until told to continue.
+    std::mutex observerMutex;
+    std::condition_variable observerWakeCondition;
+    bool observerBlocked = true;
+    bool observerHeld = false;
+    std::vector< std::string > messagesObserved;
+    Twitch::Messaging::ObserverConfiguration configuration;
+    configuration.events = Twitch::Messaging::Events::Message;
+    configuration.ownThread = true;
+    configuration.maxQueuedEvents = 1;
+    configuration.dropWhenFull = true;
+    const auto removeObserver = tmi.AddObserver(
+        [&](std::shared_ptr< const Twitch::Messaging::Event > event) {
+            std::unique_lock< std::mutex > lock(observerMutex);
+            observerHeld = true;
+            observerWakeCondition.notify_all();
+            observerWakeCondition.wait(
+                lock,
+                [&]{ return !observerBlocked; }
+            );
+            messagesObserved.push_back(
+                static_cast< const Twitch::Messaging::InfoEvent< Twitch::Messaging::MessageInfo >& >(
+                    *event
+                ).info.messageContent
+            );
+            observerWakeCondition.notify_all();
+        },
+        configuration
+    );
+
+    // Log in and join a channel.
+    LogIn();
+    Join("foobar1125");
+
+    // Have the pretend Twitch server send a message, and wait for the
+    // observer to be held up by it.
+    const auto messageLine = [](const std::string& content) {
+        return ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :" + content + CRLF;
+    };
+    mockServer->ReturnToClient(messageLine("msg1"));
+    {
+        std::unique_lock< std::mutex > lock(observerMutex);
+        ASSERT_TRUE(
+            observerWakeCondition.wait_for(
+                lock,
+                std::chrono::milliseconds(100),
+                [&]{ return observerHeld; }
+            )
+        );
+    }
+
+    // Have the pretend Twitch server send two more messages, which should
+    // fill the observer's queue and then overflow it.
+    // Since the user is given each message before the observer, follow
+    // them with a PING, so that once it's answered, the observer is known
+    // to have been offered both messages.
+    mockServer->ReturnToClient(messageLine("msg2") + messageLine("msg3"));
+    ASSERT_TRUE(user->AwaitMessages(3));
+    mockServer->ReturnToClient("PING :tmi.twitch.tv" + CRLF);
+    ASSERT_TRUE(mockServer->AwaitLineReceived("PONG :tmi.twitch.tv"));
+
+    // Let the observer continue, and verify the last message was dropped.
+    {
+        std::unique_lock< std::mutex > lock(observerMutex);
+        observerBlocked = false;
+        observerWakeCondition.notify_all();
+        ASSERT_TRUE(
+            observerWakeCondition.wait_for(
+                lock,
+                std::chrono::milliseconds(100),
+                [&]{ return messagesObserved.size() == 2; }
+            )
+        );
+    }
+    EXPECT_EQ(
+        (std::vector< std::string >{"msg1", "msg2"}),
+        messagesObserved
+    );
+
+    // Remove the observer, and verify it no longer receives events.
+    removeObserver();
+    mockServer->ReturnToClient(messageLine("msg4"));
+    ASSERT_TRUE(user->AwaitMessages(4));
+    std::lock_guard< std::mutex > lock(observerMutex);
+    EXPECT_EQ(2, messagesObserved.size());
+}
+
+TEST_F(MessagingTests, ReceiveRawMessages) {
+    // Log in and join a channel.
+    LogIn();
+    Join("foobar1125");
+
+    // Have the pretend Twitch server send lines with commands both
+    // handled and not handled, after expressing interest in every event
+    // except chat messages.
+    {
+        std::lock_guard< std::mutex > lock(user->mutex);
+        user->recordRawMessages = true;
+    }
+    tmi.SetEventInterests(
+        Twitch::Messaging::Events::All
+        & ~Twitch::Messaging::Events::Message
+    );
+    mockServer->ReturnToClient(
+        ":foobar1124.tmi.twitch.tv 366 foobar1124 #foobar1125 :End of /NAMES list" + CRLF
+        + "@msg-id=announcement;system-msg=Announcement :tmi.twitch.tv USERNOTICE #foobar1125 :Hello!" + CRLF
+        + ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :Hello, World!" + CRLF
+        + "PING :tmi.twitch.tv" + CRLF
+    );
+
+    // Verify every line was passed along, already broken into its parts.
+    ASSERT_TRUE(user->AwaitRawMessages(4));
+    EXPECT_EQ(
+        (std::vector< std::string >{"366", "USERNOTICE", "PRIVMSG", "PING"}),
+        user->rawCommands
+    );
+    EXPECT_EQ(
+        "@msg-id=announcement;system-msg=Announcement :tmi.twitch.tv USERNOTICE #foobar1125 :Hello!",
+        user->rawLines[1]
+    );
+    EXPECT_EQ(
+        (std::vector< std::string >{"foobar1124", "#foobar1125", "End of /NAMES list"}),
+        user->rawParameters[0]
+    );
+    EXPECT_EQ(
+        (std::vector< bool >{false, true, false, true}),
+        user->rawHandled
+    );
+    EXPECT_TRUE(user->messages.empty());
+}
+
+TEST_F(MessagingTests, DiagnosticsNotTracedBelowSubscriberLevel) {
+    std::vector< std::string > capturedDiagnosticMessages;
+    tmi.SubscribeToDiagnostics(
+        [&capturedDiagnosticMessages](
+            std::string senderName,
+            size_t level,
+            std::string message
+        ){
+            capturedDiagnosticMessages.push_back(message);
+        },
+        1
+    );
+    LogIn();
+    EXPECT_TRUE(capturedDiagnosticMessages.empty());
+}
+
+TEST_F(MessagingTests, AsynchronousLineTracing) {
+    std::mutex diagnosticsMutex;
+    std::condition_variable diagnosticsWakeCondition;
+    std::vector< std::string > capturedDiagnosticMessages;
+    std::set< std::thread::id > diagnosticsThreads;
+    tmi.SubscribeToDiagnostics(
+        [&](
+            std::string senderName,
+            size_t level,
+            std::string message
+        ){
+            std::lock_guard< std::mutex > lock(diagnosticsMutex);
+            capturedDiagnosticMessages.push_back(message);
+            diagnosticsThreads.insert(std::this_thread::get_id());
+            diagnosticsWakeCondition.notify_all();
+        }
+    );
+    tmi.SetAsynchronousLineTracing(100);
+    LogIn();
+
+    // Verify the lines were traced in order, from a thread other than the
+    // one handling them.
+    std::unique_lock< std::mutex > lock(diagnosticsMutex);
+    ASSERT_TRUE(
+        diagnosticsWakeCondition.wait_for(
+            lock,
+            std::chrono::milliseconds(100),
+            [&]{ return capturedDiagnosticMessages.size() == 9; }
+        )
+    );
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "< CAP LS 302",
+            "> :tmi.twitch.tv CAP * LS :twitch.tv/membership twitch.tv/tags twitch.tv/commands",
+            "< CAP REQ :twitch.tv/commands twitch.tv/membership twitch.tv/tags",
+            "> :tmi.twitch.tv CAP * ACK :twitch.tv/commands",
+            "< CAP END",
+            "< PASS oauth:**********************",
+            "< NICK foobar1124",
+            "> :tmi.twitch.tv 372 <user> :You are in a maze of twisty passages.",
+            "> :tmi.twitch.tv 376 <user> :>",
+        }),
+        capturedDiagnosticMessages
+    );
+    ASSERT_EQ(1, diagnosticsThreads.size());
+    EXPECT_NE(user->logInThread, *diagnosticsThreads.begin());
+}
+
+TEST_F(MessagingTests, TrafficRecorded) {
+    // Start recording before logging in.
+    const std::string recordingFilePath = "TwitchTrafficRecordingTest.bin";
+    (void)remove(recordingFilePath.c_str());
+    const auto recorder = std::make_shared< Twitch::TrafficRecorder >();
+    ASSERT_TRUE(recorder->Start(recordingFilePath));
+    tmi.SetTrafficRecorder(recorder);
+    LogIn();
+    tmi.LogOut("Bye");
+    ASSERT_TRUE(user->AwaitLogOut());
+    recorder->Stop();
+
+    // Verify lines both sent and received were recorded, with the
+    // OAuth token redacted, up to and including the farewell.
+    std::ifstream recording(recordingFilePath, std::ios::binary);
+    ASSERT_TRUE(Twitch::TrafficRecorder::ReadHeader(recording));
+    std::vector< std::string > lines;
+    Twitch::TrafficRecorder::Record record;
+    while (Twitch::TrafficRecorder::ReadRecord(recording, record)) {
+        lines.push_back(Twitch::TrafficRecorder::FormatRecord(record).substr(18));
+    }
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "< CAP LS 302",
+            "> :tmi.twitch.tv CAP * LS :twitch.tv/membership twitch.tv/tags twitch.tv/commands",
+            "< CAP REQ :twitch.tv/commands twitch.tv/membership twitch.tv/tags",
+            "> :tmi.twitch.tv CAP * ACK :twitch.tv/commands",
+            "< CAP END",
+            "< PASS oauth:**********************",
+            "< NICK foobar1124",
+            "> :tmi.twitch.tv 372 <user> :You are in a maze of twisty passages.",
+            "> :tmi.twitch.tv 376 <user> :>",
+            "< QUIT :Bye",
+        }),
+        lines
+    );
+    recording.close();
+    (void)remove(recordingFilePath.c_str());
+}
+
+TEST_F(MessagingTests, MetricsCollected) {
+    // Turn on metrics, log in, join a channel, and have the pretend Twitch
+    // server send a notice and a couple of messages.
+    tmi.EnableMetrics(true);
+    LogIn();
+    Join("foobar1125");
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv NOTICE #foobar1125 :This room is no longer in slow mode." + CRLF
+        + ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :Hello, World!" + CRLF
+        + ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :Goodbye, World!" + CRLF
+    );
+    ASSERT_TRUE(user->AwaitMessages(2));
+
+    // Verify what was measured.
+    const auto metrics = tmi.GetMetrics();
+    EXPECT_TRUE(metrics.enabled);
+    ASSERT_EQ(1, metrics.commands.count("PRIVMSG"));
+    EXPECT_EQ(2, metrics.commands.at("PRIVMSG").linesReceived);
+    EXPECT_EQ(2, metrics.commands.at("PRIVMSG").handlerTime.count);
+    ASSERT_EQ(1, metrics.commands.count("NOTICE"));
+    EXPECT_EQ(1, metrics.commands.at("NOTICE").linesReceived);
+    EXPECT_EQ(metrics.linesReceived, metrics.parseTime.count);
+    EXPECT_GE(metrics.linesReceived, 7);
+    EXPECT_GT(metrics.bytesReceived, 0);
+    EXPECT_EQ(6, metrics.linesSent);
+    EXPECT_EQ(4, metrics.sends);
+    EXPECT_GT(metrics.bytesSent, 0);
+    EXPECT_GE(metrics.peakActionsQueued, 1);
+    EXPECT_LE(metrics.parseTime.min, metrics.parseTime.GetPercentile(50.0));
+    EXPECT_LE(metrics.parseTime.GetPercentile(50.0), metrics.parseTime.max);
+
+    // Verify the metrics in Prometheus text format.
+    const auto text = tmi.GetMetricsText();
+    EXPECT_NE(
+        std::string::npos,
+        text.find("twitch_lines_received_total{command=\"PRIVMSG\"} 2\n")
+    );
+    const auto handlerType = text.find("# TYPE twitch_handler_seconds histogram\n");
+    ASSERT_NE(std::string::npos, handlerType);
+    EXPECT_EQ(
+        std::string::npos,
+        text.find("# TYPE twitch_handler_seconds histogram\n", handlerType + 1)
+    );
+    EXPECT_LT(handlerType, text.find("twitch_handler_seconds_bucket{"));
+    EXPECT_NE(
+        std::string::npos,
+        text.find("twitch_handler_seconds_count{command=\"PRIVMSG\"} 2\n")
+    );
+    EXPECT_NE(
+        std::string::npos,
+        text.find("twitch_handler_seconds_bucket{command=\"PRIVMSG\",le=\"+Inf\"} 2\n")
+    );
+    EXPECT_NE(
+        std::string::npos,
+        text.find("twitch_lines_sent_total 6\n")
+    );
+    EXPECT_NE(
+        std::string::npos,
+        text.find("twitch_sends_total 4\n")
+    );
+}
+
+TEST_F(MessagingTests, MetricsOffByDefault) {
+    LogIn();
+    const auto metrics = tmi.GetMetrics();
+    EXPECT_FALSE(metrics.enabled);
+    EXPECT_TRUE(metrics.commands.empty());
+    EXPECT_EQ(0, metrics.linesReceived);
+    EXPECT_EQ(0, metrics.bytesReceived);
+    EXPECT_EQ(0, metrics.linesSent);
+    EXPECT_EQ(0, metrics.parseTime.count);
+}
+
+TEST_F(MessagingTests, MetricsCountTimeouts) {
+    tmi.EnableMetrics(true);
+    tmi.LogIn("foobar1124", "alskdfjasdf87sdfsdffsd");
+    (void)mockServer->AwaitCapLs();
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv CAP * LS :twitch.tv/membership twitch.tv/tags twitch.tv/commands" + CRLF
+    );
+    (void)mockServer->AwaitCapReq();
+    mockServer->ReturnToClient(
+        ":tmi.twitch.tv CAP * ACK :twitch.tv/commands" + CRLF
+    );
+    (void)mockServer->AwaitNickname();
+    ASSERT_FALSE(user->AwaitLogOut());
+    mockTimeKeeper->currentTime = 5.0;
+    ASSERT_TRUE(user->AwaitLogOut());
+    EXPECT_EQ(1, tmi.GetMetrics().timeoutsFired);
+}
+
+TEST_F(MessagingTests, MetricsWrittenToFile) {
+    const std::string metricsFilePath = "TwitchMetricsTest.txt";
+    (void)remove(metricsFilePath.c_str());
+    tmi.EnableMetrics(true);
+    LogIn();
+    ASSERT_TRUE(tmi.WriteMetrics(metricsFilePath));
+    std::ifstream metricsFile(metricsFilePath);
+    std::string line;
+    std::vector< std::string > lines;
+    while (std::getline(metricsFile, line)) {
+        lines.push_back(line);
+    }
+    EXPECT_NE(
+        lines.end(),
+        std::find(lines.begin(), lines.end(), "twitch_lines_sent_total 5")
+    );
+    metricsFile.close();
+    (void)remove(metricsFilePath.c_str());
+}
+
+TEST_F(MessagingTests, LatenciesMeasured) {
+    // Turn on metrics, log in, join a channel, and have the pretend Twitch
+    // server send a message stamped a quarter second before it arrives.
+    tmi.EnableMetrics(true);
+    LogIn(true);
+    Join("foobar1125");
+    mockTimeKeeper->currentTime = 1539652354.25;
+    mockServer->ReturnToClient(
+        "@tmi-sent-ts=1539652354000 :foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :Hello, World!" + CRLF
+        + ":tmi.twitch.tv NOTICE #foobar1125 :This room is no longer in slow mode." + CRLF
+    );
+    ASSERT_TRUE(user->AwaitNotices(1));
+    ASSERT_TRUE(user->AwaitMessages(1));
+
+    // Verify the latencies were measured.  Handler time is only recorded
+    // once the handler returns, which may be after the user is called,
+    // so give it a moment to catch up.
+    auto metrics = tmi.GetMetrics();
+    for (int i = 0; (i < 100) && (metrics.handlerTime.count < metrics.endToEndTime.count); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        metrics = tmi.GetMetrics();
+    }
+    EXPECT_EQ(metrics.parseTime.count, metrics.queueWaitTime.count);
+    uint64_t linesHandled = 0;
+    for (const auto& command: metrics.commands) {
+        linesHandled += command.second.handlerTime.count;
+    }
+    EXPECT_EQ(linesHandled, metrics.handlerTime.count);
+    EXPECT_EQ(linesHandled, metrics.endToEndTime.count);
+    EXPECT_GE(metrics.endToEndTime.max, metrics.queueWaitTime.min);
+    ASSERT_EQ(1, metrics.serverLag.count);
+    EXPECT_NEAR(250e6, (double)metrics.serverLag.max, 250e6 / 16.0);
+}
+
+TEST_F(MessagingTests, LatencySummaryPublished) {
+    std::vector< std::string > summaries;
+    std::mutex summariesMutex;
+    const auto unsubscribeDelegate = tmi.SubscribeToDiagnostics(
+        [&summaries, &summariesMutex](
+            std::string senderName,
+            size_t level,
+            std::string message
+        ){
+            std::lock_guard< std::mutex > lock(summariesMutex);
+            summaries.push_back(message);
+        },
+        1
+    );
+    tmi.EnableMetrics(true);
+    tmi.SetLatencySummaryInterval(1.0);
+    LogIn();
+    mockTimeKeeper->currentTime = 1.5;
+    bool published = false;
+    for (int i = 0; (i < 100) && !published; ++i) {
+        {
+            std::lock_guard< std::mutex > lock(summariesMutex);
+            published = !summaries.empty();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    unsubscribeDelegate();
+    ASSERT_TRUE(published);
+    EXPECT_EQ(0, summaries[0].find("Latency: queue wait p50="));
+    EXPECT_NE(std::string::npos, summaries[0].find("server lag p50=0.000ms"));
+}
+
+TEST_F(MessagingTests, TimelineRecorded) {
+    if (!Twitch::Timeline::IsCompiledIn()) {
+        return;
+    }
+    Twitch::Timeline::Clear();
+    Twitch::Timeline::Start();
+    LogIn();
+    Twitch::Timeline::Stop();
+    const auto trace = Twitch::Timeline::GetChromeTrace();
+    Twitch::Timeline::Clear();
+    for (const auto& name: {
+        "Worker::PerformAction",
+        "PerformActionLogIn",
+        "PerformActionProcessMessagesReceived",
+        "Message::Parse",
+        "ParseTags",
+        "HandleServerCommandCap",
+    }) {
+        EXPECT_NE(
+            std::string::npos,
+            trace.find(std::string("\"name\":\"") + name + "\"")
+        ) << name;
+    }
+}
@@ -0,0 +1,66 @@
+/**
+ * @file MetricsTests.cpp
+ *
+ * This module contains the unit tests of the Twitch::Histogram class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <gtest/gtest.h>
+#include <src/Metrics.hpp>
+#include <stdint.h>
+
+TEST(MetricsTests, BucketsCoverEveryValueOnce) {
+    uint64_t previousUpperBound = 0;
+    for (size_t i = 0; i < Twitch::Histogram::NUM_BUCKETS; ++i) {
+        const auto upperBound = Twitch::Histogram::GetBucketUpperBound(i);
+        if (i > 0) {
+            EXPECT_EQ(i, Twitch::Histogram::GetBucketIndex(previousUpperBound + 1));
+        }
+        EXPECT_EQ(i, Twitch::Histogram::GetBucketIndex(upperBound));
+        previousUpperBound = upperBound;
+    }
+    EXPECT_EQ(
+        Twitch::Histogram::NUM_BUCKETS - 1,
+        Twitch::Histogram::GetBucketIndex(UINT64_MAX)
+    );
+}
+
+TEST(MetricsTests, BucketPrecision) {
+    for (uint64_t value = 1; value < ((uint64_t)1 << 39); value = value * 3 + 1) {
+        const auto upperBound = Twitch::Histogram::GetBucketUpperBound(
+            Twitch::Histogram::GetBucketIndex(value)
+        );
+        EXPECT_GE(upperBound, value);
+        EXPECT_LE((double)(upperBound - value), (double)value / 16.0);
+    }
+}
+
+TEST(MetricsTests, Snapshot) {
+    Twitch::Histogram histogram;
+    for (uint64_t value = 1; value <= 100; ++value) {
+        histogram.Record(value * 1000);
+    }
+    const auto snapshot = histogram.GetSnapshot();
+    EXPECT_EQ(100, snapshot.count);
+    EXPECT_EQ(5050000, snapshot.sum);
+    EXPECT_EQ(1000, snapshot.min);
+    EXPECT_EQ(100000, snapshot.max);
+    uint64_t total = 0;
+    for (const auto& bucket: snapshot.buckets) {
+        total += bucket.second;
+    }
+    EXPECT_EQ(100, total);
+    EXPECT_NEAR(50000.0, (double)snapshot.GetPercentile(50.0), 50000.0 / 16.0);
+    EXPECT_NEAR(99000.0, (double)snapshot.GetPercentile(99.0), 99000.0 / 16.0);
+    EXPECT_EQ(100000, snapshot.GetPercentile(100.0));
+}
+
+TEST(MetricsTests, EmptySnapshot) {
+    Twitch::Histogram histogram;
+    const auto snapshot = histogram.GetSnapshot();
+    EXPECT_EQ(0, snapshot.count);
+    EXPECT_EQ(0, snapshot.min);
+    EXPECT_TRUE(snapshot.buckets.empty());
+    EXPECT_EQ(0, snapshot.GetPercentile(50.0));
+}
@@ -0,0 +1,109 @@
+/**
+ * @file OutboundLineTests.cpp
+ *
+ * This module contains the unit tests of the Twitch::OutboundLine class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <gtest/gtest.h>
+#include <src/OutboundLine.hpp>
+#include <string>
+
+TEST(OutboundLineTests, PiecesWrittenOntoBuffer) {
+    std::string buffer;
+    Twitch::OutboundLine line(buffer);
+    line.Append("PRIVMSG #").Append(std::string("foobar")).Append(" :").Append("Hello!");
+    EXPECT_EQ("PRIVMSG #foobar :Hello!", line.GetLine());
+    EXPECT_EQ(23, line.GetLength());
+    EXPECT_TRUE(line.Finish());
+    EXPECT_EQ("PRIVMSG #foobar :Hello!\r\n", buffer);
+    EXPECT_EQ("PRIVMSG #foobar :Hello!", line.GetLine());
+    EXPECT_EQ(23, line.GetLength());
+}
+
+TEST(OutboundLineTests, CarriageReturnsAndLineFeedsLeftOut) {
+    std::string buffer;
+    Twitch::OutboundLine line(buffer);
+    line.Append("PRIVMSG #foobar :").Append("Hello!\r\nQUIT\r").Append(std::string("\nBye\n"));
+    EXPECT_TRUE(line.Finish());
+    EXPECT_EQ("PRIVMSG #foobar :Hello!QUITBye\r\n", buffer);
+}
+
+TEST(OutboundLineTests, TagsEscapedAndSeparatedFromCommand) {
+    std::string buffer;
+    Twitch::OutboundLine line(buffer);
+    line
+        .AppendTag("reply-parent-msg-id", "abc")
+        .AppendTag("x", "a; b\\c\r\nd")
+        .Append("PRIVMSG #foobar :Hi");
+    EXPECT_TRUE(line.Finish());
+    EXPECT_EQ("@reply-parent-msg-id=abc;x=a\\:\\sb\\\\c\\r\\nd PRIVMSG #foobar :Hi\r\n", buffer);
+}
+
+TEST(OutboundLineTests, LongestLineAllowed) {
+    std::string buffer;
+    Twitch::OutboundLine line(buffer);
+    line.Append(std::string(Twitch::OutboundLine::MAX_LINE_LENGTH - 2, 'x'));
+    EXPECT_TRUE(line.Finish());
+    EXPECT_EQ(Twitch::OutboundLine::MAX_LINE_LENGTH, buffer.length());
+}
+
+TEST(OutboundLineTests, LineTooLongTakenBackOut) {
+    std::string buffer = "NICK foobar\r\n";
+    Twitch::OutboundLine line(buffer);
+    line.Append(std::string(Twitch::OutboundLine::MAX_LINE_LENGTH - 1, 'x'));
+    EXPECT_FALSE(line.Finish());
+    EXPECT_EQ("NICK foobar\r\n", buffer);
+}
+
+TEST(OutboundLineTests, TagsNotCountedAgainstLengthLimit) {
+    std::string buffer;
+    Twitch::OutboundLine line(buffer);
+    line
+        .AppendTag("reply-parent-msg-id", std::string(100, 'y'))
+        .Append(std::string(Twitch::OutboundLine::MAX_LINE_LENGTH - 2, 'x'));
+    EXPECT_TRUE(line.Finish());
+}
+
+TEST(OutboundLineTests, EmptyLineTakenBackOut) {
+    std::string buffer = "NICK foobar\r\n";
+    Twitch::OutboundLine line(buffer);
+    line.AppendTag("x", "y").Append("\r\n");
+    EXPECT_FALSE(line.Finish());
+    EXPECT_EQ("NICK foobar\r\n", buffer);
+}
+
+TEST(OutboundLineTests, LinesWrittenOneAfterAnother) {
+    std::string buffer;
+    {
+        Twitch::OutboundLine line(buffer);
+        line.Append("JOIN #foobar");
+        EXPECT_TRUE(line.Finish());
+    }
+    {
+        Twitch::OutboundLine line(buffer);
+        line.Append("PRIVMSG #foobar :Hi");
+        EXPECT_TRUE(line.Finish());
+        EXPECT_EQ("PRIVMSG #foobar :Hi", line.GetLine());
+    }
+    EXPECT_EQ("JOIN #foobar\r\nPRIVMSG #foobar :Hi\r\n", buffer);
+}
+
+TEST(OutboundLineTests, LineNotFinishedTakenBackOut) {
+    std::string buffer = "NICK foobar\r\n";
+    {
+        Twitch::OutboundLine line(buffer);
+        line.AppendTag("x", "y").Append("JOIN #foobar");
+    }
+    EXPECT_EQ("NICK foobar\r\n", buffer);
+}
+
+TEST(OutboundLineTests, LongTagsMakeMoreRoom) {
+    std::string buffer;
+    const std::string value(Twitch::OutboundLine::MAX_LINE_LENGTH * 3, 'y');
+    Twitch::OutboundLine line(buffer);
+    line.AppendTag("x", value).Append("PRIVMSG #foobar :Hi");
+    EXPECT_TRUE(line.Finish());
+    EXPECT_EQ("@x=" + value + " PRIVMSG #foobar :Hi\r\n", buffer);
+}
@@ -0,0 +1,52 @@
+/**
+ * @file RateLimiterTests.cpp
+ *
+ * This module contains the unit tests of the Twitch::RateLimiter class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <gtest/gtest.h>
+#include <src/RateLimiter.hpp>
+
+TEST(RateLimiterTests, NoLimitByDefault) {
+    Twitch::RateLimiter limiter;
+    for (size_t i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(limiter.TryAcquire(0.0));
+    }
+}
+
+TEST(RateLimiterTests, LimitWithinWindow) {
+    Twitch::RateLimiter limiter;
+    limiter.Configure(3, 30.0);
+    EXPECT_TRUE(limiter.TryAcquire(0.0));
+    EXPECT_TRUE(limiter.TryAcquire(10.0));
+    EXPECT_TRUE(limiter.TryAcquire(20.0));
+    EXPECT_FALSE(limiter.TryAcquire(20.0));
+    EXPECT_FALSE(limiter.TryAcquire(29.9));
+    EXPECT_TRUE(limiter.TryAcquire(30.0));
+    EXPECT_FALSE(limiter.TryAcquire(30.0));
+    EXPECT_FALSE(limiter.TryAcquire(39.9));
+    EXPECT_TRUE(limiter.TryAcquire(40.0));
+}
+
+TEST(RateLimiterTests, RefusedAttemptsNotCounted) {
+    Twitch::RateLimiter limiter;
+    limiter.Configure(1, 10.0);
+    EXPECT_TRUE(limiter.TryAcquire(0.0));
+    for (double now = 1.0; now < 10.0; now += 1.0) {
+        EXPECT_FALSE(limiter.TryAcquire(now));
+    }
+    EXPECT_TRUE(limiter.TryAcquire(10.0));
+}
+
+TEST(RateLimiterTests, LoweringLimitKeepsNewestTimes) {
+    Twitch::RateLimiter limiter;
+    limiter.Configure(3, 30.0);
+    EXPECT_TRUE(limiter.TryAcquire(0.0));
+    EXPECT_TRUE(limiter.TryAcquire(10.0));
+    EXPECT_TRUE(limiter.TryAcquire(20.0));
+    limiter.Configure(1, 30.0);
+    EXPECT_FALSE(limiter.TryAcquire(45.0));
+    EXPECT_TRUE(limiter.TryAcquire(50.0));
+}
@@ -0,0 +1,210 @@
+/**
+ * @file RecordingConnectionTests.cpp
+ *
+ * This module contains the unit tests of the Twitch::RecordingConnection
+ * class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <Twitch/RecordingConnection.hpp>
+#include <Twitch/TrafficRecorder.hpp>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the path to the file used to capture traffic in the tests.
+     */
+    const std::string CAPTURE_FILE_PATH = "TwitchRecordingConnectionTest.bin";
+
+    /**
+     * This is a fake connection to decorate in the tests.
+     */
+    struct MockConnection
+        : public Twitch::Connection
+    {
+        // Properties
+
+        MessageReceivedDelegate messageReceivedDelegate;
+        DisconnectedDelegate disconnectedDelegate;
+        bool failConnectionAttempt = false;
+        bool isConnected = false;
+        std::string dataSent;
+
+        // Twitch::Connection
+
+        virtual void SetMessageReceivedDelegate(MessageReceivedDelegate messageReceivedDelegate) override {
+            this->messageReceivedDelegate = messageReceivedDelegate;
+        }
+
+        virtual void SetDisconnectedDelegate(DisconnectedDelegate disconnectedDelegate) override {
+            this->disconnectedDelegate = disconnectedDelegate;
+        }
+
+        virtual bool Connect() override {
+            if (failConnectionAttempt) {
+                return false;
+            }
+            isConnected = true;
+            return true;
+        }
+
+        virtual void Disconnect() override {
+            isConnected = false;
+        }
+
+        virtual void Send(const std::string& message) override {
+            dataSent += message;
+        }
+    };
+
+    /**
+     * This function reads back all the records in the file used
+     * to capture traffic in the tests.
+     *
+     * @param[out] records
+     *     This is where to store the records read.
+     *
+     * @return
+     *     An indication of whether or not the file began with what's
+     *     expected at the beginning of a file of recorded traffic
+     *     is returned.
+     */
+    bool ReadRecords(std::vector< Twitch::TrafficRecorder::Record >& records) {
+        std::ifstream input(CAPTURE_FILE_PATH, std::ios::binary);
+        if (!Twitch::TrafficRecorder::ReadHeader(input)) {
+            return false;
+        }
+        Twitch::TrafficRecorder::Record record;
+        while (Twitch::TrafficRecorder::ReadRecord(input, record)) {
+            records.push_back(record);
+        }
+        return true;
+    }
+
+}
+
+/**
+ * This is the test fixture for these tests, providing common
+ * setup and teardown for each test.
+ */
+struct RecordingConnectionTests
+    : public ::testing::Test
+{
+    // Properties
+
+    /**
+     * This is the connection decorated by the unit under test.
+     */
+    std::shared_ptr< MockConnection > mockConnection = std::make_shared< MockConnection >();
+
+    /**
+     * This is the unit under test.
+     */
+    Twitch::RecordingConnection connection{mockConnection, CAPTURE_FILE_PATH};
+
+    /**
+     * These are the messages passed on by the unit under test.
+     */
+    std::vector< std::string > messagesReceived;
+
+    /**
+     * This indicates whether or not the unit under test passed on
+     * the server closing its end of the connection.
+     */
+    bool disconnected = false;
+
+    // Methods
+
+    // ::testing::Test
+
+    virtual void SetUp() {
+        (void)remove(CAPTURE_FILE_PATH.c_str());
+        connection.SetMessageReceivedDelegate(
+            [this](const std::string& message){
+                messagesReceived.push_back(message);
+            }
+        );
+        connection.SetDisconnectedDelegate(
+            [this]{
+                disconnected = true;
+            }
+        );
+    }
+
+    virtual void TearDown() {
+        connection.Disconnect();
+        (void)remove(CAPTURE_FILE_PATH.c_str());
+    }
+};
+
+TEST_F(RecordingConnectionTests, DataCapturedAndPassedThrough) {
+    ASSERT_TRUE(connection.Connect());
+    EXPECT_TRUE(mockConnection->isConnected);
+    connection.Send("CAP LS 302\r\n");
+    mockConnection->messageReceivedDelegate(":tmi.twitch.tv CAP * LS :twitch.tv/membership\r\n:tmi.twitch.tv 372 <user> :Hi");
+    connection.Send("PASS oauth:alskdfjasdf87sdfsdffsd\r\nNICK foobar1124\r\n");
+    connection.Disconnect();
+    EXPECT_FALSE(mockConnection->isConnected);
+
+    // Verify everything was passed through untouched.
+    EXPECT_EQ(
+        "CAP LS 302\r\nPASS oauth:alskdfjasdf87sdfsdffsd\r\nNICK foobar1124\r\n",
+        mockConnection->dataSent
+    );
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            ":tmi.twitch.tv CAP * LS :twitch.tv/membership\r\n:tmi.twitch.tv 372 <user> :Hi",
+        }),
+        messagesReceived
+    );
+
+    // Verify everything was captured exactly, except the OAuth token.
+    std::vector< Twitch::TrafficRecorder::Record > records;
+    ASSERT_TRUE(ReadRecords(records));
+    ASSERT_EQ(3, records.size());
+    EXPECT_EQ(Twitch::TrafficRecorder::Record::Type::SentData, records[0].type);
+    EXPECT_EQ("CAP LS 302\r\n", records[0].line);
+    EXPECT_EQ(Twitch::TrafficRecorder::Record::Type::ReceivedData, records[1].type);
+    EXPECT_EQ(":tmi.twitch.tv CAP * LS :twitch.tv/membership\r\n:tmi.twitch.tv 372 <user> :Hi", records[1].line);
+    EXPECT_EQ(Twitch::TrafficRecorder::Record::Type::SentData, records[2].type);
+    EXPECT_EQ("PASS oauth:**********************\r\nNICK foobar1124\r\n", records[2].line);
+    EXPECT_LE(records[0].time, records[1].time);
+    EXPECT_LE(records[1].time, records[2].time);
+}
+
+TEST_F(RecordingConnectionTests, ServerDisconnectCaptured) {
+    ASSERT_TRUE(connection.Connect());
+    mockConnection->disconnectedDelegate();
+    EXPECT_TRUE(disconnected);
+    std::vector< Twitch::TrafficRecorder::Record > records;
+    ASSERT_TRUE(ReadRecords(records));
+    ASSERT_EQ(1, records.size());
+    EXPECT_EQ(Twitch::TrafficRecorder::Record::Type::Disconnected, records[0].type);
+    EXPECT_EQ("", records[0].line);
+}
+
+TEST_F(RecordingConnectionTests, ConnectFailsIfDecoratedConnectionFails) {
+    mockConnection->failConnectionAttempt = true;
+    EXPECT_FALSE(connection.Connect());
+}
+
+TEST_F(RecordingConnectionTests, FormatCapturedData) {
+    Twitch::TrafficRecorder::Record record;
+    record.type = Twitch::TrafficRecorder::Record::Type::ReceivedData;
+    record.time = 1500042;
+    record.line = "PING :tmi.twitch.tv\r\n";
+    EXPECT_EQ("1.500042 >> PING :tmi.twitch.tv\\r\\n", Twitch::TrafficRecorder::FormatRecord(record));
+    record.type = Twitch::TrafficRecorder::Record::Type::SentData;
+    record.line = "PONG :tmi.twitch.tv\r\n";
+    EXPECT_EQ("1.500042 << PONG :tmi.twitch.tv\\r\\n", Twitch::TrafficRecorder::FormatRecord(record));
+    record.type = Twitch::TrafficRecorder::Record::Type::Disconnected;
+    record.line.clear();
+    EXPECT_EQ("1.500042 ! disconnected", Twitch::TrafficRecorder::FormatRecord(record));
+}
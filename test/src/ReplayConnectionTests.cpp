@@ -0,0 +1,338 @@
+/**
+ * @file ReplayConnectionTests.cpp
+ *
+ * This module contains the unit tests of the Twitch::ReplayConnection
+ * class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <Twitch/Messaging.hpp>
+#include <Twitch/ReplayConnection.hpp>
+#include <Twitch/TrafficRecorder.hpp>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the path to the file used to hold captured traffic
+     * in the tests.
+     */
+    const std::string CAPTURE_FILE_PATH = "TwitchReplayConnectionTest.bin";
+
+    /**
+     * This is the line terminator used by the Twitch server.
+     */
+    const std::string CRLF = "\r\n";
+
+    /**
+     * This is a fake user of the Messaging class driven by the unit
+     * under test.
+     */
+    struct User
+        : public Twitch::Messaging::User
+    {
+        // Properties
+
+        std::condition_variable wakeCondition;
+        std::mutex mutex;
+        bool loggedIn = false;
+        bool loggedOut = false;
+        std::vector< Twitch::Messaging::MessageInfo > messages;
+
+        // Methods
+
+        bool AwaitLogIn() {
+            std::unique_lock< std::mutex > lock(mutex);
+            return wakeCondition.wait_for(
+                lock,
+                std::chrono::milliseconds(1000),
+                [this]{ return loggedIn; }
+            );
+        }
+
+        bool AwaitLogOut() {
+            std::unique_lock< std::mutex > lock(mutex);
+            return wakeCondition.wait_for(
+                lock,
+                std::chrono::milliseconds(1000),
+                [this]{ return loggedOut; }
+            );
+        }
+
+        bool AwaitMessages(size_t numMessages) {
+            std::unique_lock< std::mutex > lock(mutex);
+            return wakeCondition.wait_for(
+                lock,
+                std::chrono::milliseconds(1000),
+                [this, numMessages]{ return messages.size() >= numMessages; }
+            );
+        }
+
+        // Twitch::Messaging::User
+
+        virtual void LogIn() override {
+            std::lock_guard< std::mutex > lock(mutex);
+            loggedIn = true;
+            wakeCondition.notify_all();
+        }
+
+        virtual void LogOut() override {
+            std::lock_guard< std::mutex > lock(mutex);
+            loggedOut = true;
+            wakeCondition.notify_all();
+        }
+
+        virtual void Message(
+            Twitch::Messaging::MessageInfo&& messageInfo
+        ) override {
+            std::lock_guard< std::mutex > lock(mutex);
+            messages.push_back(std::move(messageInfo));
+            wakeCondition.notify_all();
+        }
+    };
+
+    /**
+     * This function writes a capture file holding the given records.
+     *
+     * @param[in] records
+     *     These are the records to put in the capture file.
+     */
+    void WriteCapture(const std::vector< Twitch::TrafficRecorder::Record >& records) {
+        std::ofstream output(CAPTURE_FILE_PATH, std::ios::binary | std::ios::trunc);
+        (void)Twitch::TrafficRecorder::WriteHeader(output);
+        for (const auto& record: records) {
+            (void)Twitch::TrafficRecorder::WriteRecord(output, record);
+        }
+    }
+
+    /**
+     * This function makes a record of captured traffic.
+     *
+     * @param[in] type
+     *     This is the type of record to make.
+     *
+     * @param[in] time
+     *     This is the time of the record, in microseconds since
+     *     the connection was established.
+     *
+     * @param[in] data
+     *     This is the data to put in the record.
+     *
+     * @return
+     *     The record made is returned.
+     */
+    Twitch::TrafficRecorder::Record MakeRecord(
+        Twitch::TrafficRecorder::Record::Type type,
+        uint64_t time,
+        const std::string& data = ""
+    ) {
+        Twitch::TrafficRecorder::Record record;
+        record.type = type;
+        record.time = time;
+        record.line = data;
+        return record;
+    }
+
+}
+
+/**
+ * This is the test fixture for these tests, providing common
+ * setup and teardown for each test.
+ */
+struct ReplayConnectionTests
+    : public ::testing::Test
+{
+    // Properties
+
+    /**
+     * These are the messages played back by the unit under test.
+     */
+    std::vector< std::string > messagesReceived;
+
+    /**
+     * This indicates whether or not the unit under test played back
+     * the server closing its end of the connection.
+     */
+    bool disconnected = false;
+
+    /**
+     * This is used to synchronize access to what the unit under test
+     * plays back.
+     */
+    std::mutex mutex;
+
+    // Methods
+
+    /**
+     * This method sets up the given connection to store what it
+     * plays back in the test fixture.
+     *
+     * @param[in,out] connection
+     *     This is the connection to set up.
+     */
+    void Listen(Twitch::ReplayConnection& connection) {
+        connection.SetMessageReceivedDelegate(
+            [this](const std::string& message){
+                std::lock_guard< std::mutex > lock(mutex);
+                messagesReceived.push_back(message);
+            }
+        );
+        connection.SetDisconnectedDelegate(
+            [this]{
+                std::lock_guard< std::mutex > lock(mutex);
+                disconnected = true;
+            }
+        );
+    }
+
+    // ::testing::Test
+
+    virtual void SetUp() {
+        (void)remove(CAPTURE_FILE_PATH.c_str());
+    }
+
+    virtual void TearDown() {
+        (void)remove(CAPTURE_FILE_PATH.c_str());
+    }
+};
+
+TEST_F(ReplayConnectionTests, ConnectFailsWithoutCaptureFile) {
+    Twitch::ReplayConnection connection(CAPTURE_FILE_PATH);
+    EXPECT_FALSE(connection.Connect());
+}
+
+TEST_F(ReplayConnectionTests, DataHeldBackUntilClientSendsWhatItDidWhenCaptured) {
+    WriteCapture({
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::ReceivedData, 0, "Hello" + CRLF),
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::SentData, 0, "PING :1" + CRLF + "PING :2" + CRLF),
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::ReceivedData, 0, "PONG :1" + CRLF + "PONG :2" + CRLF),
+    });
+    Twitch::ReplayConnection connection(CAPTURE_FILE_PATH, 0.0);
+    Listen(connection);
+    ASSERT_TRUE(connection.Connect());
+    EXPECT_FALSE(connection.AwaitCompletion(0.05));
+    EXPECT_EQ(1, connection.GetRecordsPlayed());
+    connection.Send("PING :1" + CRLF);
+    EXPECT_FALSE(connection.AwaitCompletion(0.05));
+    EXPECT_EQ(1, connection.GetRecordsPlayed());
+    connection.Send("PING :2" + CRLF);
+    ASSERT_TRUE(connection.AwaitCompletion(1.0));
+    EXPECT_EQ(2, connection.GetRecordsPlayed());
+    EXPECT_EQ("PING :1" + CRLF + "PING :2" + CRLF, connection.GetDataSent());
+    std::lock_guard< std::mutex > lock(mutex);
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            "Hello" + CRLF,
+            "PONG :1" + CRLF + "PONG :2" + CRLF,
+        }),
+        messagesReceived
+    );
+    EXPECT_FALSE(disconnected);
+}
+
+TEST_F(ReplayConnectionTests, PlaybackSpeedScaled) {
+    WriteCapture({
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::ReceivedData, 0, "Hello" + CRLF),
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::ReceivedData, 500000, "World" + CRLF),
+    });
+
+    // Ten times as fast should take about 50 milliseconds.
+    Twitch::ReplayConnection fastConnection(CAPTURE_FILE_PATH, 10.0);
+    Listen(fastConnection);
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(fastConnection.Connect());
+    ASSERT_TRUE(fastConnection.AwaitCompletion(1.0));
+    EXPECT_GE(
+        std::chrono::steady_clock::now() - start,
+        std::chrono::milliseconds(50)
+    );
+
+    // As fast as possible shouldn't take anywhere near half a second.
+    Twitch::ReplayConnection fastestConnection(CAPTURE_FILE_PATH, 0.0);
+    Listen(fastestConnection);
+    start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(fastestConnection.Connect());
+    ASSERT_TRUE(fastestConnection.AwaitCompletion(1.0));
+    EXPECT_LT(
+        std::chrono::steady_clock::now() - start,
+        std::chrono::milliseconds(250)
+    );
+    std::lock_guard< std::mutex > lock(mutex);
+    EXPECT_EQ(4, messagesReceived.size());
+}
+
+TEST_F(ReplayConnectionTests, DisconnectStopsPlayback) {
+    WriteCapture({
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::ReceivedData, 0, "Hello" + CRLF),
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::ReceivedData, 60000000, "World" + CRLF),
+    });
+    Twitch::ReplayConnection connection(CAPTURE_FILE_PATH);
+    Listen(connection);
+    ASSERT_TRUE(connection.Connect());
+    EXPECT_FALSE(connection.AwaitCompletion(0.05));
+    connection.Disconnect();
+    EXPECT_TRUE(connection.AwaitCompletion(0.0));
+    EXPECT_EQ(1, connection.GetRecordsPlayed());
+}
+
+TEST_F(ReplayConnectionTests, MessagingDrivenEndToEnd) {
+    WriteCapture({
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::SentData, 100, "CAP LS 302" + CRLF),
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::ReceivedData, 200, ":tmi.twitch.tv CAP * LS :twitch.tv/membership twitch.tv/tags twitch.tv/commands" + CRLF),
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::SentData, 300, "CAP REQ :twitch.tv/commands twitch.tv/membership twitch.tv/tags" + CRLF),
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::ReceivedData, 400, ":tmi.twitch.tv CAP * ACK :twitch.tv/commands" + CRLF),
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::SentData, 500, "CAP END" + CRLF),
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::SentData, 500, "PASS oauth:**********************" + CRLF),
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::SentData, 500, "NICK foobar1124" + CRLF),
+        MakeRecord(
+            Twitch::TrafficRecorder::Record::Type::ReceivedData,
+            600,
+            ":tmi.twitch.tv 372 <user> :You are in a maze of twisty passages." + CRLF
+            + ":tmi.twitch.tv 376 <user> :>" + CRLF
+        ),
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::SentData, 700, "JOIN #foobar1125" + CRLF),
+        MakeRecord(
+            Twitch::TrafficRecorder::Record::Type::ReceivedData,
+            800,
+            ":foobar1124!foobar1124@foobar1124.tmi.twitch.tv JOIN #foobar1125" + CRLF
+            + ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :Hello, World!" + CRLF
+            + ":foobar1126!foobar1126@foobar1126.tmi.twitch.tv PRIVMSG #foobar1125 :Goodbye, World!" + CRLF
+        ),
+        MakeRecord(Twitch::TrafficRecorder::Record::Type::Disconnected, 900),
+    });
+    const auto connection = std::make_shared< Twitch::ReplayConnection >(CAPTURE_FILE_PATH, 0.0);
+    const auto user = std::make_shared< User >();
+    Twitch::Messaging tmi;
+    tmi.SetConnectionFactory(
+        [connection]() -> std::shared_ptr< Twitch::Connection > {
+            return connection;
+        }
+    );
+    tmi.SetUser(user);
+    tmi.LogIn("foobar1124", "alskdfjasdf87sdfsdffsd");
+    ASSERT_TRUE(user->AwaitLogIn());
+    tmi.Join("foobar1125");
+    ASSERT_TRUE(user->AwaitMessages(2));
+    EXPECT_EQ("Hello, World!", user->messages[0].messageContent);
+    EXPECT_EQ("Goodbye, World!", user->messages[1].messageContent);
+    ASSERT_TRUE(user->AwaitLogOut());
+    EXPECT_TRUE(connection->AwaitCompletion(1.0));
+    EXPECT_EQ(
+        "CAP LS 302" + CRLF
+        + "CAP REQ :twitch.tv/commands twitch.tv/membership twitch.tv/tags" + CRLF
+        + "CAP END" + CRLF
+        + "PASS oauth:alskdfjasdf87sdfsdffsd" + CRLF
+        + "NICK foobar1124" + CRLF
+        + "JOIN #foobar1125" + CRLF,
+        connection->GetDataSent()
+    );
+}
@@ -0,0 +1,245 @@
+/**
+ * @file SyntheticServerTests.cpp
+ *
+ * This module contains the unit tests of the Twitch::SyntheticServer class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <string.h>
+#include <sys/socket.h>
+#include <SyntheticServer.hpp>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the line terminator used by the Twitch server.
+     */
+    const std::string CRLF = "\r\n";
+
+    /**
+     * This is a simple blocking client of the synthetic server.
+     */
+    struct Client {
+        // Properties
+
+        int socket = -1;
+        std::string inbound;
+
+        // Methods
+
+        ~Client() {
+            if (socket >= 0) {
+                (void)close(socket);
+            }
+        }
+
+        bool Connect(uint16_t port) {
+            socket = ::socket(AF_INET, SOCK_STREAM, 0);
+            struct sockaddr_in address;
+            (void)memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = htons(port);
+            return (connect(socket, (struct sockaddr*)&address, sizeof(address)) == 0);
+        }
+
+        void SendLine(const std::string& line) {
+            const auto data = line + CRLF;
+            (void)send(socket, data.data(), data.length(), MSG_NOSIGNAL);
+        }
+
+        bool ReceiveLine(std::string& line) {
+            for (;;) {
+                const auto lineEnd = inbound.find(CRLF);
+                if (lineEnd != std::string::npos) {
+                    line = inbound.substr(0, lineEnd);
+                    inbound.erase(0, lineEnd + CRLF.length());
+                    return true;
+                }
+                struct pollfd pollSocket;
+                pollSocket.fd = socket;
+                pollSocket.events = POLLIN;
+                pollSocket.revents = 0;
+                if (poll(&pollSocket, 1, 1000) <= 0) {
+                    return false;
+                }
+                char buffer[4096];
+                const auto amountReceived = recv(socket, buffer, sizeof(buffer), 0);
+                if (amountReceived <= 0) {
+                    return false;
+                }
+                inbound.append(buffer, (size_t)amountReceived);
+            }
+        }
+
+        bool ReceiveUntil(const std::string& ending, std::vector< std::string >& lines) {
+            std::string line;
+            while (ReceiveLine(line)) {
+                lines.push_back(line);
+                if (line.find(ending) != std::string::npos) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool LogIn(bool tags) {
+            std::vector< std::string > lines;
+            SendLine("CAP LS 302");
+            if (!ReceiveUntil("CAP * LS", lines)) {
+                return false;
+            }
+            SendLine(
+                tags
+                ? "CAP REQ :twitch.tv/commands twitch.tv/tags"
+                : "CAP REQ :twitch.tv/commands"
+            );
+            if (!ReceiveUntil("CAP * ACK", lines)) {
+                return false;
+            }
+            SendLine("CAP END");
+            SendLine("PASS oauth:alskdfjasdf87sdfsdffsd");
+            SendLine("NICK foobar1124");
+            return ReceiveUntil(" 376 ", lines);
+        }
+    };
+
+}
+
+/**
+ * This is the test fixture for these tests, providing common
+ * setup and teardown for each test.
+ */
+struct SyntheticServerTests
+    : public ::testing::Test
+{
+    // Properties
+
+    /**
+     * This is the unit under test.
+     */
+    Twitch::SyntheticServer server;
+
+    /**
+     * These are the settings of the unit under test.
+     */
+    Twitch::SyntheticServer::Configuration configuration;
+
+    // Methods
+
+    // ::testing::Test
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+        server.Stop();
+    }
+};
+
+TEST_F(SyntheticServerTests, LogInJoinAndPing) {
+    configuration.maxLines = 10;
+    ASSERT_TRUE(server.Start(configuration));
+    ASSERT_NE(0, server.GetPort());
+    Client client;
+    ASSERT_TRUE(client.Connect(server.GetPort()));
+    ASSERT_TRUE(client.LogIn(false));
+    client.SendLine("PING :hello");
+    std::vector< std::string > lines;
+    ASSERT_TRUE(client.ReceiveUntil("PONG", lines));
+    EXPECT_EQ(":tmi.twitch.tv PONG tmi.twitch.tv :hello", lines.back());
+    lines.clear();
+    client.SendLine("JOIN #foobar1125,#foobar1126");
+    ASSERT_TRUE(client.ReceiveUntil("366 foobar1124 #foobar1126", lines));
+    EXPECT_EQ(
+        (std::vector< std::string >{
+            ":foobar1124!foobar1124@foobar1124.tmi.twitch.tv JOIN #foobar1125",
+            ":foobar1124.tmi.twitch.tv 353 foobar1124 = #foobar1125 :foobar1124",
+            ":foobar1124.tmi.twitch.tv 366 foobar1124 #foobar1125 :End of /NAMES list",
+            ":foobar1124!foobar1124@foobar1124.tmi.twitch.tv JOIN #foobar1126",
+            ":foobar1124.tmi.twitch.tv 353 foobar1124 = #foobar1126 :foobar1124",
+            ":foobar1124.tmi.twitch.tv 366 foobar1124 #foobar1126 :End of /NAMES list",
+        }),
+        lines
+    );
+}
+
+TEST_F(SyntheticServerTests, LogInFailsWithoutToken) {
+    ASSERT_TRUE(server.Start(configuration));
+    Client client;
+    ASSERT_TRUE(client.Connect(server.GetPort()));
+    client.SendLine("NICK foobar1124");
+    std::string line;
+    ASSERT_TRUE(client.ReceiveLine(line));
+    EXPECT_EQ(":tmi.twitch.tv NOTICE * :Login authentication failed", line);
+    EXPECT_FALSE(client.ReceiveLine(line));
+}
+
+TEST_F(SyntheticServerTests, TrafficMixGenerated) {
+    configuration.maxLines = 2000;
+    configuration.mix.messages = 1.0;
+    configuration.mix.subBombs = 0.1;
+    configuration.mix.raids = 0.1;
+    configuration.mix.clearChatStorms = 0.1;
+    configuration.mix.subBombSize = 5;
+    configuration.mix.clearChatStormSize = 5;
+    ASSERT_TRUE(server.Start(configuration));
+    Client client;
+    ASSERT_TRUE(client.Connect(server.GetPort()));
+    ASSERT_TRUE(client.LogIn(true));
+    client.SendLine("JOIN #foobar1125");
+    std::vector< std::string > lines;
+    ASSERT_TRUE(client.ReceiveUntil("ROOMSTATE #foobar1125", lines));
+    size_t messages = 0;
+    size_t subGifts = 0;
+    size_t raids = 0;
+    size_t clears = 0;
+    std::string line;
+    for (size_t i = 0; i < configuration.maxLines; ++i) {
+        ASSERT_TRUE(client.ReceiveLine(line));
+        ASSERT_EQ('@', line[0]) << line;
+        if (line.find(" PRIVMSG #foobar1125 :") != std::string::npos) {
+            ++messages;
+        } else if (line.find(";msg-id=subgift;") != std::string::npos) {
+            ++subGifts;
+        } else if (line.find(";msg-id=raid;") != std::string::npos) {
+            ++raids;
+        } else if (line.find(" CLEARCHAT #foobar1125 :chatter") != std::string::npos) {
+            ++clears;
+        }
+    }
+    EXPECT_GT(messages, 0);
+    EXPECT_GT(subGifts, 0);
+    EXPECT_GT(raids, 0);
+    EXPECT_GT(clears, 0);
+    EXPECT_EQ(1, server.GetStatistics().clientsConnected);
+}
+
+TEST_F(SyntheticServerTests, RateLimited) {
+    configuration.linesPerSecond = 1000;
+    ASSERT_TRUE(server.Start(configuration));
+    Client client;
+    ASSERT_TRUE(client.Connect(server.GetPort()));
+    ASSERT_TRUE(client.LogIn(false));
+    client.SendLine("JOIN #foobar1125");
+    std::vector< std::string > lines;
+    ASSERT_TRUE(client.ReceiveUntil(" 366 ", lines));
+    const auto start = std::chrono::steady_clock::now();
+    std::string line;
+    for (size_t i = 0; i < 100; ++i) {
+        ASSERT_TRUE(client.ReceiveLine(line));
+    }
+    EXPECT_GE(
+        std::chrono::steady_clock::now() - start,
+        std::chrono::milliseconds(90)
+    );
+}
@@ -0,0 +1,129 @@
+/**
+ * @file TimelineTests.cpp
+ *
+ * This module contains the unit tests of the Twitch::Timeline functions
+ * and the Twitch::TimelineZone class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <gtest/gtest.h>
+#include <regex>
+#include <set>
+#include <src/TimelineZone.hpp>
+#include <string>
+#include <thread>
+#include <Twitch/Timeline.hpp>
+
+/**
+ * This is the test fixture for these tests, providing common
+ * setup and teardown for each test.
+ */
+struct TimelineTests
+    : public ::testing::Test
+{
+    // ::testing::Test
+
+    virtual void SetUp() {
+        Twitch::Timeline::Clear();
+    }
+
+    virtual void TearDown() {
+        Twitch::Timeline::Stop();
+        Twitch::Timeline::Clear();
+    }
+};
+
+TEST_F(TimelineTests, ZonesRecordedPerThread) {
+    Twitch::Timeline::Start();
+    {
+        Twitch::TimelineZone outer("Outer");
+        {
+            Twitch::TimelineZone inner("Inner");
+        }
+    }
+    std::thread other(
+        []{
+            Twitch::TimelineZone zone("Other");
+        }
+    );
+    other.join();
+    Twitch::Timeline::Stop();
+    {
+        Twitch::TimelineZone zone("AfterStop");
+    }
+    const auto trace = Twitch::Timeline::GetChromeTrace();
+    EXPECT_EQ(0, trace.find("{\"traceEvents\":["));
+    EXPECT_NE(std::string::npos, trace.find("\"name\":\"Outer\""));
+    EXPECT_NE(std::string::npos, trace.find("\"name\":\"Inner\""));
+    EXPECT_NE(std::string::npos, trace.find("\"name\":\"Other\""));
+    EXPECT_EQ(std::string::npos, trace.find("\"name\":\"AfterStop\""));
+    const std::regex tidPattern("\"tid\":([0-9]+)");
+    std::set< std::string > threadIds;
+    for (
+        auto match = std::sregex_iterator(trace.begin(), trace.end(), tidPattern);
+        match != std::sregex_iterator();
+        ++match
+    ) {
+        (void)threadIds.insert((*match)[1].str());
+    }
+    EXPECT_EQ(2, threadIds.size());
+}
+
+TEST_F(TimelineTests, ClearDiscardsZones) {
+    Twitch::Timeline::Start();
+    {
+        Twitch::TimelineZone zone("BeforeClear");
+    }
+    Twitch::Timeline::Clear();
+    {
+        Twitch::TimelineZone zone("AfterClear");
+    }
+    const auto trace = Twitch::Timeline::GetChromeTrace();
+    EXPECT_EQ(std::string::npos, trace.find("\"name\":\"BeforeClear\""));
+    EXPECT_NE(std::string::npos, trace.find("\"name\":\"AfterClear\""));
+}
+
+TEST_F(TimelineTests, NothingRecordedUntilStarted) {
+    {
+        Twitch::TimelineZone zone("NotStarted");
+    }
+    EXPECT_EQ(
+        "{\"traceEvents\":[\n],\"displayTimeUnit\":\"ns\"}\n",
+        Twitch::Timeline::GetChromeTrace()
+    );
+}
+
+TEST_F(TimelineTests, ExitedThreadZonesReleasedWhenCleared) {
+    // Have another thread record a zone and exit.
+    Twitch::Timeline::Start();
+    const auto threadsHeldBefore = Twitch::TimelineZone::GetThreadsHeld();
+    std::thread other(
+        []{
+            Twitch::TimelineZone zone("Exited");
+        }
+    );
+    other.join();
+
+    // Verify the zones of the thread are kept until cleared.
+    EXPECT_EQ(threadsHeldBefore + 1, Twitch::TimelineZone::GetThreadsHeld());
+    EXPECT_NE(
+        std::string::npos,
+        Twitch::Timeline::GetChromeTrace().find("\"name\":\"Exited\"")
+    );
+    Twitch::Timeline::Clear();
+    EXPECT_EQ(threadsHeldBefore, Twitch::TimelineZone::GetThreadsHeld());
+
+    // Verify a thread exiting after its zones were cleared releases them
+    // right away.
+    std::thread cleared(
+        []{
+            {
+                Twitch::TimelineZone zone("Cleared");
+            }
+            Twitch::Timeline::Clear();
+        }
+    );
+    cleared.join();
+    EXPECT_EQ(threadsHeldBefore, Twitch::TimelineZone::GetThreadsHeld());
+}
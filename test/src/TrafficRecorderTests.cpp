@@ -0,0 +1,200 @@
+/**
+ * @file TrafficRecorderTests.cpp
+ *
+ * This module contains the unit tests of the Twitch::TrafficRecorder class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <Twitch/TrafficRecorder.hpp>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the path to the file used to record traffic in the tests.
+     */
+    const std::string RECORDING_FILE_PATH = "TwitchTrafficRecorderTest.bin";
+
+    /**
+     * This function reads back all the records in the file used
+     * to record traffic in the tests.
+     *
+     * @param[out] records
+     *     This is where to store the records read.
+     *
+     * @return
+     *     An indication of whether or not the file began with what's
+     *     expected at the beginning of a file of recorded traffic
+     *     is returned.
+     */
+    bool ReadRecords(std::vector< Twitch::TrafficRecorder::Record >& records) {
+        std::ifstream input(RECORDING_FILE_PATH, std::ios::binary);
+        if (!Twitch::TrafficRecorder::ReadHeader(input)) {
+            return false;
+        }
+        Twitch::TrafficRecorder::Record record;
+        while (Twitch::TrafficRecorder::ReadRecord(input, record)) {
+            records.push_back(record);
+        }
+        return true;
+    }
+
+}
+
+/**
+ * This is the test fixture for these tests, providing common
+ * setup and teardown for each test.
+ */
+struct TrafficRecorderTests
+    : public ::testing::Test
+{
+    // Properties
+
+    /**
+     * This is the unit under test.
+     */
+    Twitch::TrafficRecorder recorder;
+
+    // Methods
+
+    // ::testing::Test
+
+    virtual void SetUp() {
+        (void)remove(RECORDING_FILE_PATH.c_str());
+    }
+
+    virtual void TearDown() {
+        recorder.Stop();
+        (void)remove(RECORDING_FILE_PATH.c_str());
+    }
+};
+
+TEST_F(TrafficRecorderTests, RecordAndReadBack) {
+    ASSERT_TRUE(recorder.Start(RECORDING_FILE_PATH));
+    EXPECT_TRUE(recorder.RecordSent("NICK foobar1124"));
+    EXPECT_TRUE(recorder.RecordReceived(":tmi.twitch.tv 376 <user> :>"));
+    recorder.Stop();
+    std::vector< Twitch::TrafficRecorder::Record > records;
+    ASSERT_TRUE(ReadRecords(records));
+    ASSERT_EQ(2, records.size());
+    EXPECT_EQ(Twitch::TrafficRecorder::Record::Type::Sent, records[0].type);
+    EXPECT_EQ("NICK foobar1124", records[0].line);
+    EXPECT_EQ(Twitch::TrafficRecorder::Record::Type::Received, records[1].type);
+    EXPECT_EQ(":tmi.twitch.tv 376 <user> :>", records[1].line);
+    EXPECT_NE(0, records[0].time);
+    EXPECT_LE(records[0].time, records[1].time);
+}
+
+TEST_F(TrafficRecorderTests, OAuthTokenRedacted) {
+    ASSERT_TRUE(recorder.Start(RECORDING_FILE_PATH));
+    EXPECT_TRUE(recorder.RecordSent("PASS oauth:alskdfjasdf87sdfsdffsd"));
+    recorder.Stop();
+    std::vector< Twitch::TrafficRecorder::Record > records;
+    ASSERT_TRUE(ReadRecords(records));
+    ASSERT_EQ(1, records.size());
+    EXPECT_EQ("PASS oauth:**********************", records[0].line);
+}
+
+TEST_F(TrafficRecorderTests, NotRecordingUntilStarted) {
+    EXPECT_FALSE(recorder.RecordSent("NICK foobar1124"));
+    EXPECT_FALSE(recorder.Start("no/such/directory/recording.bin"));
+    EXPECT_FALSE(recorder.RecordSent("NICK foobar1124"));
+}
+
+TEST_F(TrafficRecorderTests, RecordsDroppedWhenRingBufferFull) {
+    // Make the ring buffer only big enough to hold two of the records.
+    const std::string line = "PRIVMSG #foobar1125 :Hello, World!";
+    ASSERT_TRUE(recorder.Start(RECORDING_FILE_PATH, 2 * (13 + line.length())));
+    size_t recorded = 0;
+    for (size_t i = 0; i < 10; ++i) {
+        if (recorder.RecordSent(line)) {
+            ++recorded;
+        }
+    }
+    recorder.Stop();
+    std::vector< Twitch::TrafficRecorder::Record > records;
+    ASSERT_TRUE(ReadRecords(records));
+    size_t sent = 0;
+    size_t dropped = 0;
+    for (const auto& record: records) {
+        if (record.type == Twitch::TrafficRecorder::Record::Type::Sent) {
+            ++sent;
+        } else if (record.type == Twitch::TrafficRecorder::Record::Type::Dropped) {
+            dropped += (size_t)std::stoul(record.line);
+        }
+    }
+    EXPECT_LT(recorded, 10);
+    EXPECT_EQ(recorded, sent);
+    EXPECT_EQ(10 - recorded, dropped);
+}
+
+TEST_F(TrafficRecorderTests, OnlyOneThreadRecords) {
+    // Record a line from this thread, and then try to record another from
+    // a different thread.
+    ASSERT_TRUE(recorder.Start(RECORDING_FILE_PATH));
+    EXPECT_TRUE(recorder.RecordSent("NICK foobar1124"));
+    bool recordedFromOtherThread = true;
+    std::thread otherThread(
+        [this, &recordedFromOtherThread]{
+            recordedFromOtherThread = recorder.RecordReceived(":tmi.twitch.tv 376 <user> :>");
+        }
+    );
+    otherThread.join();
+    EXPECT_FALSE(recordedFromOtherThread);
+    EXPECT_TRUE(recorder.RecordSent("JOIN #foobar1125"));
+
+    // Verify only the lines from this thread were recorded.
+    recorder.Stop();
+    std::vector< Twitch::TrafficRecorder::Record > records;
+    ASSERT_TRUE(ReadRecords(records));
+    ASSERT_EQ(2, records.size());
+    EXPECT_EQ("NICK foobar1124", records[0].line);
+    EXPECT_EQ("JOIN #foobar1125", records[1].line);
+
+    // Verify another thread may record once recording is started again.
+    ASSERT_TRUE(recorder.Start(RECORDING_FILE_PATH));
+    std::thread newThread(
+        [this, &recordedFromOtherThread]{
+            recordedFromOtherThread = recorder.RecordReceived(":tmi.twitch.tv 376 <user> :>");
+        }
+    );
+    newThread.join();
+    EXPECT_TRUE(recordedFromOtherThread);
+}
+
+TEST_F(TrafficRecorderTests, FormatRecord) {
+    Twitch::TrafficRecorder::Record record;
+    record.type = Twitch::TrafficRecorder::Record::Type::Received;
+    record.time = 1539652354000042;
+    record.line = "PING :tmi.twitch.tv";
+    EXPECT_EQ(
+        "1539652354.000042 > PING :tmi.twitch.tv",
+        Twitch::TrafficRecorder::FormatRecord(record)
+    );
+    record.type = Twitch::TrafficRecorder::Record::Type::Sent;
+    record.line = "PONG :tmi.twitch.tv";
+    EXPECT_EQ(
+        "1539652354.000042 < PONG :tmi.twitch.tv",
+        Twitch::TrafficRecorder::FormatRecord(record)
+    );
+    record.type = Twitch::TrafficRecorder::Record::Type::Dropped;
+    record.line = "3";
+    EXPECT_EQ(
+        "1539652354.000042 ! 3 records dropped",
+        Twitch::TrafficRecorder::FormatRecord(record)
+    );
+}
+
+TEST_F(TrafficRecorderTests, ReadRecordRejectsTruncatedRecord) {
+    std::istringstream input(std::string("TTR1\x01\x00\x00", 7));
+    ASSERT_TRUE(Twitch::TrafficRecorder::ReadHeader(input));
+    Twitch::TrafficRecorder::Record record;
+    EXPECT_FALSE(Twitch::TrafficRecorder::ReadRecord(input, record));
+}
@@ -0,0 +1,150 @@
+/**
+ * @file TypedUserTests.cpp
+ *
+ * This module contains the unit tests of the Twitch::TypedUser class
+ * template.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <Twitch/Messaging.hpp>
+#include <Twitch/TypedUser.hpp>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is a handler which is only interested in logging in and
+     * chat messages, one at a time.
+     */
+    struct ChatHandler {
+        // Properties
+
+        bool loggedIn = false;
+        std::vector< Twitch::Messaging::MessageInfo > messages;
+
+        // Methods
+
+        void LogIn() {
+            loggedIn = true;
+        }
+
+        void Message(Twitch::Messaging::MessageInfo&& messageInfo) {
+            messages.push_back(std::move(messageInfo));
+        }
+    };
+
+    /**
+     * This is a handler which is only interested in batches of chat
+     * messages and moderation events.
+     */
+    struct BatchHandler {
+        // Properties
+
+        std::vector< size_t > messageBatchSizes;
+        std::vector< Twitch::Messaging::ClearInfo > clears;
+
+        // Methods
+
+        void Messages(std::vector< Twitch::Messaging::MessageInfo >&& messageInfos) {
+            messageBatchSizes.push_back(messageInfos.size());
+        }
+
+        void Clear(Twitch::Messaging::ClearInfo&& clearInfo) {
+            clears.push_back(std::move(clearInfo));
+        }
+    };
+
+}
+
+TEST(TypedUserTests, DetectHandlerMethods) {
+    static_assert(
+        Twitch::TypedUser< ChatHandler >::GetEventInterests() == (
+            Twitch::Messaging::Events::LogIn
+            | Twitch::Messaging::Events::Message
+        ),
+        "interests should be known at compile time"
+    );
+    EXPECT_TRUE(Twitch::TypedUser< ChatHandler >::HasMessage());
+    EXPECT_FALSE(Twitch::TypedUser< ChatHandler >::HasMessages());
+    EXPECT_FALSE(Twitch::TypedUser< ChatHandler >::HasJoin());
+    const Twitch::Messaging::EventMask batchHandlerInterests = Twitch::TypedUser< BatchHandler >::GetEventInterests();
+    EXPECT_EQ(
+        Twitch::Messaging::Events::Message | Twitch::Messaging::Events::Clear,
+        batchHandlerInterests
+    );
+}
+
+TEST(TypedUserTests, VirtualUserHasEveryMethod) {
+    const Twitch::Messaging::EventMask userInterests = Twitch::TypedUser< Twitch::Messaging::User >::GetEventInterests();
+    EXPECT_EQ(
+        (
+            Twitch::Messaging::Events::Doom
+            | Twitch::Messaging::Events::Join
+            | Twitch::Messaging::Events::Leave
+            | Twitch::Messaging::Events::NameList
+            | Twitch::Messaging::Events::Message
+            | Twitch::Messaging::Events::PrivateMessage
+            | Twitch::Messaging::Events::Whisper
+            | Twitch::Messaging::Events::Notice
+            | Twitch::Messaging::Events::Host
+            | Twitch::Messaging::Events::RoomModeChange
+            | Twitch::Messaging::Events::Clear
+            | Twitch::Messaging::Events::Mod
+            | Twitch::Messaging::Events::UserState
+            | Twitch::Messaging::Events::Sub
+            | Twitch::Messaging::Events::Raid
+            | Twitch::Messaging::Events::Ritual
+            | Twitch::Messaging::Events::LogIn
+            | Twitch::Messaging::Events::LogOut
+            | Twitch::Messaging::Events::RawMessage
+        ),
+        userInterests
+    );
+}
+
+TEST(TypedUserTests, ForwardEventsToHandler) {
+    const auto handler = std::make_shared< ChatHandler >();
+    Twitch::TypedUser< ChatHandler > typedUser(handler);
+    Twitch::Messaging::User& user = typedUser;
+    user.LogIn();
+    EXPECT_TRUE(handler->loggedIn);
+    Twitch::Messaging::MessageInfo messageInfo;
+    messageInfo.messageContent = "Hello, World!";
+    user.Message(std::move(messageInfo));
+    std::vector< Twitch::Messaging::MessageInfo > messageInfos(2);
+    messageInfos[0].messageContent = "foo";
+    messageInfos[1].messageContent = "bar";
+    user.Messages(std::move(messageInfos));
+    user.Join(Twitch::Messaging::MembershipInfo());
+    ASSERT_EQ(3, handler->messages.size());
+    EXPECT_EQ("Hello, World!", handler->messages[0].messageContent);
+    EXPECT_EQ("foo", handler->messages[1].messageContent);
+    EXPECT_EQ("bar", handler->messages[2].messageContent);
+}
+
+TEST(TypedUserTests, ForwardBatchesToHandlerHandlingBatches) {
+    const auto handler = std::make_shared< BatchHandler >();
+    Twitch::TypedUser< BatchHandler > typedUser(handler);
+    Twitch::Messaging::User& user = typedUser;
+    user.Messages(std::vector< Twitch::Messaging::MessageInfo >(3));
+    user.Message(Twitch::Messaging::MessageInfo());
+    user.Clear(Twitch::Messaging::ClearInfo());
+    EXPECT_EQ(
+        (std::vector< size_t >{3}),
+        handler->messageBatchSizes
+    );
+    EXPECT_EQ(1, handler->clears.size());
+}
+
+TEST(TypedUserTests, SetUpMessagingWithHandler) {
+    const auto handler = std::make_shared< ChatHandler >();
+    Twitch::Messaging tmi;
+    tmi.SetUser(std::make_shared< Twitch::TypedUser< ChatHandler > >(handler));
+    tmi.SetEventInterests(Twitch::TypedUser< ChatHandler >::GetEventInterests());
+    tmi.LogOut("Bye");
+    EXPECT_FALSE(handler->loggedIn);
+}
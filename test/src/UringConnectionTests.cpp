@@ -0,0 +1,214 @@
+/**
+ * @file UringConnectionTests.cpp
+ *
+ * This module contains the unit tests of the Twitch::UringReactor and
+ * Twitch::UringConnection classes.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "ConnectionTests.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <gtest/gtest.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <Twitch/UringConnection.hpp>
+#include <Twitch/Messaging.hpp>
+#include <vector>
+
+using ConnectionTests::CRLF;
+using ConnectionTests::Receiver;
+using ConnectionTests::User;
+
+/**
+ * This is the test fixture for these tests, providing common
+ * setup and teardown for each test.
+ */
+struct UringConnectionTests
+    : public ConnectionTests::Fixture
+{
+};
+
+TEST_F(UringConnectionTests, SendAndReceive) {
+    if (!Twitch::UringReactor::IsSupported()) {
+        GTEST_SKIP();
+    }
+    ASSERT_TRUE(server.Start(configuration));
+    Twitch::UringConnection connection("127.0.0.1", server.GetPort());
+    Receiver receiver;
+    receiver.Listen(connection);
+    ASSERT_TRUE(connection.Connect());
+    connection.Send("PASS oauth:alskdfjasdf87sdfsdffsd" + CRLF);
+    connection.Send("NICK foobar1124" + CRLF);
+    ASSERT_TRUE(receiver.AwaitData(":tmi.twitch.tv 376 foobar1124 :>" + CRLF));
+    connection.Send("PING :hello" + CRLF);
+    ASSERT_TRUE(receiver.AwaitData(":tmi.twitch.tv PONG tmi.twitch.tv :hello" + CRLF));
+    connection.Disconnect();
+    EXPECT_FALSE(receiver.disconnected);
+}
+
+TEST_F(UringConnectionTests, ConnectFailsWhenNoServer) {
+    if (!Twitch::UringReactor::IsSupported()) {
+        GTEST_SKIP();
+    }
+    ASSERT_TRUE(server.Start(configuration));
+    const auto port = server.GetPort();
+    server.Stop();
+    Twitch::UringConnection connection("127.0.0.1", port);
+    EXPECT_FALSE(connection.Connect());
+}
+
+TEST_F(UringConnectionTests, ServerDisconnectDelivered) {
+    if (!Twitch::UringReactor::IsSupported()) {
+        GTEST_SKIP();
+    }
+    ASSERT_TRUE(server.Start(configuration));
+    Twitch::UringConnection connection("127.0.0.1", server.GetPort());
+    Receiver receiver;
+    receiver.Listen(connection);
+    ASSERT_TRUE(connection.Connect());
+    connection.Send("QUIT" + CRLF);
+    EXPECT_TRUE(receiver.AwaitDisconnect());
+}
+
+TEST_F(UringConnectionTests, ManyConnectionsOnOneReactor) {
+    if (!Twitch::UringReactor::IsSupported()) {
+        GTEST_SKIP();
+    }
+    ASSERT_TRUE(server.Start(configuration));
+    const auto reactor = std::make_shared< Twitch::UringReactor >();
+    constexpr size_t numConnections = 100;
+    std::vector< std::unique_ptr< Twitch::UringConnection > > connections;
+    std::vector< std::unique_ptr< Receiver > > receivers;
+    for (size_t i = 0; i < numConnections; ++i) {
+        connections.emplace_back(new Twitch::UringConnection("127.0.0.1", server.GetPort(), reactor));
+        receivers.emplace_back(new Receiver());
+        receivers.back()->Listen(*connections.back());
+        ASSERT_TRUE(connections.back()->Connect());
+        connections.back()->Send("NICK justinfan" + std::to_string(i) + CRLF);
+    }
+    for (size_t i = 0; i < numConnections; ++i) {
+        EXPECT_TRUE(receivers[i]->AwaitData(" 376 justinfan" + std::to_string(i) + " :>" + CRLF));
+    }
+    EXPECT_EQ(numConnections, server.GetStatistics().clientsConnected);
+}
+
+TEST_F(UringConnectionTests, MessagingOverLoopback) {
+    if (!Twitch::UringReactor::IsSupported()) {
+        GTEST_SKIP();
+    }
+    configuration.maxLines = 500;
+    ASSERT_TRUE(server.Start(configuration));
+    const auto port = server.GetPort();
+    const auto user = std::make_shared< User >();
+    Twitch::Messaging tmi;
+    tmi.SetConnectionFactory(
+        [port]() -> std::shared_ptr< Twitch::Connection > {
+            return std::make_shared< Twitch::UringConnection >("127.0.0.1", port);
+        }
+    );
+    tmi.SetUser(user);
+    tmi.LogIn("foobar1124", "alskdfjasdf87sdfsdffsd");
+    ASSERT_TRUE(user->AwaitLogIn());
+    tmi.Join("foobar1125");
+    EXPECT_TRUE(user->AwaitMessages(configuration.maxLines));
+    tmi.LogOut("Bye");
+}
+
+TEST_F(UringConnectionTests, SendsMadeWhileSendingAreBatched) {
+    if (!Twitch::UringReactor::IsSupported()) {
+        GTEST_SKIP();
+    }
+    ASSERT_TRUE(server.Start(configuration));
+    const auto reactor = std::make_shared< Twitch::UringReactor >();
+    Twitch::UringConnection connection("127.0.0.1", server.GetPort(), reactor);
+    Receiver receiver;
+    receiver.Listen(connection);
+    ASSERT_TRUE(connection.Connect());
+    connection.Send("NICK justinfan1" + CRLF);
+    ASSERT_TRUE(receiver.AwaitData(" 376 justinfan1 :>" + CRLF));
+    constexpr size_t numPings = 1000;
+    const auto systemCallsBefore = reactor->GetSystemCallCount();
+    for (size_t i = 0; i < numPings; ++i) {
+        connection.Send("PING :" + std::to_string(i) + CRLF);
+    }
+    ASSERT_TRUE(receiver.AwaitData(":tmi.twitch.tv PONG tmi.twitch.tv :" + std::to_string(numPings - 1) + CRLF));
+    EXPECT_LT(reactor->GetSystemCallCount() - systemCallsBefore, numPings);
+}
+
+TEST_F(UringConnectionTests, ReceivedBuffersLentOutAndGivenBack) {
+    if (!Twitch::UringReactor::IsSupported()) {
+        GTEST_SKIP();
+    }
+    ASSERT_TRUE(server.Start(configuration));
+    const auto reactor = std::make_shared< Twitch::UringReactor >();
+    Twitch::UringConnection connection("127.0.0.1", server.GetPort(), reactor);
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::string dataReceived;
+    std::vector< Twitch::ConnectionV2::ReceivedBuffer > buffersHeld;
+    bool holdBuffers = true;
+    connection.SetBufferReceivedDelegate(
+        [&](Twitch::ConnectionV2::ReceivedBuffer&& buffer){
+            std::lock_guard< std::mutex > lock(mutex);
+            dataReceived.append(buffer.GetData(), buffer.GetLength());
+            if (holdBuffers) {
+                buffersHeld.push_back(std::move(buffer));
+            }
+            wakeCondition.notify_all();
+        }
+    );
+    const auto awaitData = [&](const std::string& data){
+        std::unique_lock< std::mutex > lock(mutex);
+        return wakeCondition.wait_for(
+            lock,
+            std::chrono::seconds(5),
+            [&]{ return dataReceived.find(data) != std::string::npos; }
+        );
+    };
+    ASSERT_TRUE(connection.Connect());
+    connection.Send("NICK justinfan1" + CRLF);
+    ASSERT_TRUE(awaitData(" 376 justinfan1 :>" + CRLF));
+
+    // Hold on to many more buffers than the reactor lends out at once.
+    // Everything is still delivered, but some of it is copied.
+    constexpr size_t numPings = 300;
+    for (size_t i = 0; i < numPings; ++i) {
+        connection.Send("PING :" + std::to_string(i) + CRLF);
+        ASSERT_TRUE(awaitData(":tmi.twitch.tv PONG tmi.twitch.tv :" + std::to_string(i) + CRLF));
+    }
+    EXPECT_GT(reactor->GetBytesCopied(), 0);
+
+    // Once the buffers are given back, data is lent out again.
+    {
+        std::lock_guard< std::mutex > lock(mutex);
+        holdBuffers = false;
+        buffersHeld.clear();
+    }
+    const auto bytesCopiedBefore = reactor->GetBytesCopied();
+    for (size_t i = 0; i < numPings; ++i) {
+        connection.Send("PING :again" + std::to_string(i) + CRLF);
+        ASSERT_TRUE(awaitData(":tmi.twitch.tv PONG tmi.twitch.tv :again" + std::to_string(i) + CRLF));
+    }
+    EXPECT_EQ(bytesCopiedBefore, reactor->GetBytesCopied());
+    connection.Disconnect();
+}
+
+TEST_F(UringConnectionTests, CreateFallsBackWhenUnsupported) {
+    ASSERT_TRUE(server.Start(configuration));
+    const auto connection = Twitch::UringConnection::Create("127.0.0.1", server.GetPort());
+    ASSERT_FALSE(connection == nullptr);
+    EXPECT_EQ(
+        Twitch::UringReactor::IsSupported(),
+        std::dynamic_pointer_cast< Twitch::UringConnection >(connection) != nullptr
+    );
+    Receiver receiver;
+    receiver.Listen(*connection);
+    ASSERT_TRUE(connection->Connect());
+    connection->Send("NICK justinfan1" + CRLF);
+    EXPECT_TRUE(receiver.AwaitData(" 376 justinfan1 :>" + CRLF));
+    connection->Disconnect();
+}
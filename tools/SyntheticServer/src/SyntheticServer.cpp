@@ -0,0 +1,987 @@
+/**
+ * @file SyntheticServer.cpp
+ *
+ * This module contains the implementation of the Twitch::SyntheticServer
+ * class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "SyntheticServer.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the line terminator used by the Twitch server.
+     */
+    const std::string CRLF = "\r\n";
+
+    /**
+     * This is how long, in milliseconds, each thread of the server waits
+     * for something to happen before checking whether the server is
+     * being stopped.
+     */
+    constexpr int POLL_TIMEOUT_MILLISECONDS = 50;
+
+    /**
+     * This is the most number of bytes read from a client at once.
+     */
+    constexpr size_t RECEIVE_BUFFER_SIZE = 65536;
+
+    /**
+     * This is the number of bytes of traffic waiting to be sent to
+     * a client below which more traffic is generated.
+     */
+    constexpr size_t OUTBOUND_LOW_WATER_MARK = 65536;
+
+    /**
+     * This is the most number of lines of synthetic traffic generated
+     * for a client at once.
+     */
+    constexpr size_t GENERATE_BATCH_LINES = 1024;
+
+    /**
+     * These are the contents of the chat messages generated.
+     */
+    const char* const MESSAGE_CONTENTS[] = {
+        "Hello, World!",
+        "PogChamp PogChamp PogChamp",
+        "gg",
+        "LUL that was close",
+        "what game is this?",
+        "first time here, love the stream",
+        "Kappa",
+        "!uptime",
+        "can you play that song again please",
+        "HYPE HYPE HYPE HYPE HYPE HYPE HYPE HYPE HYPE HYPE HYPE HYPE",
+    };
+
+    /**
+     * This is a small, fast pseudo-random number generator (xorshift64*),
+     * good enough for generating traffic.
+     */
+    class Random {
+        // Public methods
+    public:
+        /**
+         * This constructs the generator.
+         *
+         * @param[in] seed
+         *     This is the seed of the generator.
+         */
+        explicit Random(uint64_t seed)
+            : state_(seed | 1)
+        {
+        }
+
+        /**
+         * This method returns the next pseudo-random number.
+         *
+         * @return
+         *     The next pseudo-random number is returned.
+         */
+        uint64_t Next() {
+            state_ ^= state_ >> 12;
+            state_ ^= state_ << 25;
+            state_ ^= state_ >> 27;
+            return state_ * 2685821657736338717ULL;
+        }
+
+        /**
+         * This method returns a pseudo-random number less than
+         * the given bound.
+         *
+         * @param[in] bound
+         *     This is the bound on the number returned.  It must not
+         *     be zero.
+         *
+         * @return
+         *     A pseudo-random number less than the given bound
+         *     is returned.
+         */
+        size_t Below(size_t bound) {
+            return (size_t)(Next() % bound);
+        }
+
+        /**
+         * This method returns a pseudo-random number in [0, 1).
+         *
+         * @return
+         *     A pseudo-random number in [0, 1) is returned.
+         */
+        double Fraction() {
+            return (double)(Next() >> 11) / 9007199254740992.0;
+        }
+
+        // Private properties
+    private:
+        /**
+         * This is the state of the generator.
+         */
+        uint64_t state_;
+    };
+
+    /**
+     * This function appends the given formatted text to the given string.
+     *
+     * @param[in,out] output
+     *     This is the string to which to append the text.
+     *
+     * @param[in] format
+     *     This is the format of the text, as for printf.
+     */
+    void AppendFormatted(std::string& output, const char* format, ...) {
+        char buffer[1024];
+        va_list args;
+        va_start(args, format);
+        const auto length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (length > 0) {
+            output.append(buffer, std::min((size_t)length, sizeof(buffer) - 1));
+        }
+    }
+
+}
+
+namespace Twitch {
+
+    /**
+     * This contains the private properties of a SyntheticServer instance.
+     */
+    struct SyntheticServer::Impl {
+        // Types
+
+        /**
+         * This holds everything the server knows about one client.
+         */
+        struct Client {
+            /**
+             * This is the socket connected to the client.
+             */
+            int socket = -1;
+
+            /**
+             * This holds data received from the client which doesn't yet
+             * make up a complete line.
+             */
+            std::string inbound;
+
+            /**
+             * This holds data waiting to be sent to the client.
+             */
+            std::string outbound;
+
+            /**
+             * This is how much of the data at the front of the outbound
+             * buffer has already been sent.
+             */
+            size_t outboundSent = 0;
+
+            /**
+             * This is the password the client offered, if any.
+             */
+            std::string password;
+
+            /**
+             * This is the nickname of the client, once it's logged in.
+             */
+            std::string nickname;
+
+            /**
+             * This indicates whether or not the client requested
+             * the twitch.tv/tags capability.
+             */
+            bool tags = false;
+
+            /**
+             * This indicates whether or not the client has logged in.
+             */
+            bool loggedIn = false;
+
+            /**
+             * This indicates whether or not the client sent QUIT.
+             */
+            bool quit = false;
+
+            /**
+             * These are the channels the client has joined.
+             */
+            std::vector< std::string > channels;
+
+            /**
+             * This is the number of lines of synthetic traffic generated
+             * for the client so far.
+             */
+            size_t linesGenerated = 0;
+
+            /**
+             * This is when synthetic traffic began to be generated
+             * for the client.
+             */
+            std::chrono::steady_clock::time_point trafficStart;
+
+            /**
+             * This is used to generate the client's traffic.
+             */
+            Random random;
+
+            /**
+             * This constructs the client.
+             *
+             * @param[in] seed
+             *     This is the seed used to generate the client's traffic.
+             */
+            explicit Client(uint64_t seed)
+                : random(seed)
+            {
+            }
+        };
+
+        // Properties
+
+        /**
+         * These are the settings of the server.
+         */
+        Configuration configuration;
+
+        /**
+         * This is the socket on which the server listens for clients.
+         */
+        int listener = -1;
+
+        /**
+         * This is the port on which the server listens for clients.
+         */
+        uint16_t port = 0;
+
+        /**
+         * This indicates whether or not the server is being stopped.
+         */
+        std::atomic< bool > stopping;
+
+        /**
+         * This is the thread which accepts clients.
+         */
+        std::thread acceptor;
+
+        /**
+         * This is used to synchronize access to the list of threads
+         * serving clients.
+         */
+        std::mutex mutex;
+
+        /**
+         * These are the threads serving clients.
+         */
+        std::vector< std::thread > clientThreads;
+
+        /**
+         * This is the number of clients which have connected.
+         */
+        std::atomic< size_t > clientsConnected;
+
+        /**
+         * This is the number of lines received from clients.
+         */
+        std::atomic< size_t > linesReceived;
+
+        /**
+         * This is the number of lines sent to clients.
+         */
+        std::atomic< size_t > linesSent;
+
+        /**
+         * This is the number of bytes sent to clients.
+         */
+        std::atomic< size_t > bytesSent;
+
+        // Methods
+
+        /**
+         * This is the constructor for the structure.
+         */
+        Impl()
+            : stopping(false)
+            , clientsConnected(0)
+            , linesReceived(0)
+            , linesSent(0)
+            , bytesSent(0)
+        {
+        }
+
+        /**
+         * This method queues the given line to be sent to the given client.
+         *
+         * @param[in,out] client
+         *     This is the client to which to send the line.
+         *
+         * @param[in] line
+         *     This is the line to send, without its line terminator.
+         */
+        void SendLine(Client& client, const std::string& line) {
+            client.outbound += line;
+            client.outbound += CRLF;
+            ++linesSent;
+        }
+
+        /**
+         * This method handles a JOIN command from the given client.
+         *
+         * @param[in,out] client
+         *     This is the client which sent the command.
+         *
+         * @param[in] channels
+         *     These are the channels to join, separated by commas.
+         */
+        void HandleJoin(Client& client, const std::string& channels) {
+            size_t start = 0;
+            while (start < channels.length()) {
+                auto end = channels.find(',', start);
+                if (end == std::string::npos) {
+                    end = channels.length();
+                }
+                auto channel = channels.substr(start, end - start);
+                start = end + 1;
+                if (
+                    (channel.length() < 2)
+                    || (channel[0] != '#')
+                ) {
+                    continue;
+                }
+                channel = channel.substr(1);
+                if (
+                    std::find(
+                        client.channels.begin(),
+                        client.channels.end(),
+                        channel
+                    ) != client.channels.end()
+                ) {
+                    continue;
+                }
+                client.channels.push_back(channel);
+                const auto& nickname = client.nickname;
+                SendLine(client, ":" + nickname + "!" + nickname + "@" + nickname + ".tmi.twitch.tv JOIN #" + channel);
+                SendLine(client, ":" + nickname + ".tmi.twitch.tv 353 " + nickname + " = #" + channel + " :" + nickname);
+                SendLine(client, ":" + nickname + ".tmi.twitch.tv 366 " + nickname + " #" + channel + " :End of /NAMES list");
+                if (client.tags) {
+                    SendLine(
+                        client,
+                        (
+                            "@emote-only=0;followers-only=-1;r9k=0;rituals=0;room-id="
+                            + std::to_string(client.channels.size())
+                            + ";slow=0;subs-only=0 :tmi.twitch.tv ROOMSTATE #" + channel
+                        )
+                    );
+                }
+            }
+            if (
+                !client.channels.empty()
+                && (client.linesGenerated == 0)
+            ) {
+                client.trafficStart = std::chrono::steady_clock::now();
+            }
+        }
+
+        /**
+         * This method handles a PART command from the given client.
+         *
+         * @param[in,out] client
+         *     This is the client which sent the command.
+         *
+         * @param[in] channel
+         *     This is the channel to leave.
+         */
+        void HandlePart(Client& client, const std::string& channel) {
+            if (
+                (channel.length() < 2)
+                || (channel[0] != '#')
+            ) {
+                return;
+            }
+            const auto joined = std::find(
+                client.channels.begin(),
+                client.channels.end(),
+                channel.substr(1)
+            );
+            if (joined == client.channels.end()) {
+                return;
+            }
+            client.channels.erase(joined);
+            const auto& nickname = client.nickname;
+            SendLine(client, ":" + nickname + "!" + nickname + "@" + nickname + ".tmi.twitch.tv PART " + channel);
+        }
+
+        /**
+         * This method handles one line received from the given client.
+         *
+         * @param[in,out] client
+         *     This is the client which sent the line.
+         *
+         * @param[in] line
+         *     This is the line received, without its line terminator.
+         */
+        void HandleLine(Client& client, std::string line) {
+            ++linesReceived;
+            if (
+                !line.empty()
+                && (line[0] == '@')
+            ) {
+                const auto tagsEnd = line.find(' ');
+                line = ((tagsEnd == std::string::npos) ? "" : line.substr(tagsEnd + 1));
+            }
+            const auto commandEnd = line.find(' ');
+            const auto command = line.substr(0, commandEnd);
+            const auto parameters = (
+                (commandEnd == std::string::npos)
+                ? ""
+                : line.substr(commandEnd + 1)
+            );
+            if (command == "CAP") {
+                if (parameters.compare(0, 2, "LS") == 0) {
+                    SendLine(client, ":tmi.twitch.tv CAP * LS :twitch.tv/membership twitch.tv/tags twitch.tv/commands");
+                } else if (parameters.compare(0, 4, "REQ ") == 0) {
+                    auto capabilities = parameters.substr(4);
+                    if (
+                        !capabilities.empty()
+                        && (capabilities[0] == ':')
+                    ) {
+                        capabilities = capabilities.substr(1);
+                    }
+                    client.tags = (capabilities.find("twitch.tv/tags") != std::string::npos);
+                    SendLine(client, ":tmi.twitch.tv CAP * ACK :" + capabilities);
+                }
+            } else if (command == "PASS") {
+                client.password = parameters;
+            } else if (command == "NICK") {
+                const auto anonymous = (parameters.compare(0, 9, "justinfan") == 0);
+                if (
+                    !anonymous
+                    && (client.password.compare(0, 6, "oauth:") != 0)
+                ) {
+                    SendLine(client, ":tmi.twitch.tv NOTICE * :Login authentication failed");
+                    client.quit = true;
+                    return;
+                }
+                client.nickname = parameters;
+                client.loggedIn = true;
+                SendLine(client, ":tmi.twitch.tv 001 " + parameters + " :Welcome, GLHF!");
+                SendLine(client, ":tmi.twitch.tv 002 " + parameters + " :Your host is tmi.twitch.tv");
+                SendLine(client, ":tmi.twitch.tv 003 " + parameters + " :This server is rather new");
+                SendLine(client, ":tmi.twitch.tv 004 " + parameters + " :-");
+                SendLine(client, ":tmi.twitch.tv 375 " + parameters + " :-");
+                SendLine(client, ":tmi.twitch.tv 372 " + parameters + " :You are in a maze of twisty passages, all alike.");
+                SendLine(client, ":tmi.twitch.tv 376 " + parameters + " :>");
+            } else if (command == "JOIN") {
+                if (client.loggedIn) {
+                    HandleJoin(client, parameters.substr(0, parameters.find(' ')));
+                }
+            } else if (command == "PART") {
+                if (client.loggedIn) {
+                    HandlePart(client, parameters.substr(0, parameters.find(' ')));
+                }
+            } else if (command == "PING") {
+                SendLine(client, ":tmi.twitch.tv PONG tmi.twitch.tv " + ((!parameters.empty() && (parameters[0] == ':')) ? parameters : ":" + parameters));
+            } else if (command == "QUIT") {
+                client.quit = true;
+            }
+        }
+
+        /**
+         * This method generates one chat message from a chatter in the
+         * given channel.
+         *
+         * @param[in,out] client
+         *     This is the client to which to send the traffic.
+         *
+         * @param[in] channel
+         *     This is the index of the channel in which to generate
+         *     the traffic.
+         */
+        void GenerateMessage(Client& client, size_t channel) {
+            const auto chatter = client.random.Below(configuration.chattersPerChannel);
+            const auto content = MESSAGE_CONTENTS[client.random.Below(sizeof(MESSAGE_CONTENTS) / sizeof(MESSAGE_CONTENTS[0]))];
+            const auto& channelName = client.channels[channel];
+            if (client.tags) {
+                AppendFormatted(
+                    client.outbound,
+                    (
+                        "@badge-info=;badges=;color=#%06X;display-name=Chatter%zu;emotes=;flags=;"
+                        "id=%016" PRIx64 "-%04zx;mod=0;room-id=%zu;subscriber=0;tmi-sent-ts=%" PRIu64 ";"
+                        "turbo=0;user-id=%zu;user-type= "
+                    ),
+                    (unsigned int)(client.random.Next() & 0xFFFFFF),
+                    chatter,
+                    client.random.Next(), client.linesGenerated & 0xFFFF,
+                    channel + 1,
+                    (uint64_t)std::chrono::duration_cast< std::chrono::milliseconds >(
+                        std::chrono::system_clock::now().time_since_epoch()
+                    ).count(),
+                    (channel + 1) * 1000000 + chatter
+                );
+            }
+            AppendFormatted(
+                client.outbound,
+                ":chatter%zu!chatter%zu@chatter%zu.tmi.twitch.tv PRIVMSG #%s :%s\r\n",
+                chatter, chatter, chatter,
+                channelName.c_str(),
+                content
+            );
+            ++client.linesGenerated;
+        }
+
+        /**
+         * This method generates a sub bomb in the given channel.
+         *
+         * @param[in,out] client
+         *     This is the client to which to send the traffic.
+         *
+         * @param[in] channel
+         *     This is the index of the channel in which to generate
+         *     the traffic.
+         */
+        void GenerateSubBomb(Client& client, size_t channel) {
+            const auto gifter = client.random.Below(configuration.chattersPerChannel);
+            const auto& channelName = client.channels[channel];
+            const auto size = configuration.mix.subBombSize;
+            if (client.tags) {
+                AppendFormatted(
+                    client.outbound,
+                    (
+                        "@badge-info=;badges=;display-name=Chatter%zu;login=chatter%zu;"
+                        "msg-id=submysterygift;msg-param-mass-gift-count=%zu;"
+                        "msg-param-sub-plan=1000;room-id=%zu;"
+                        "system-msg=Chatter%zu\\sis\\sgifting\\s%zu\\sTier\\s1\\sSubs!;"
+                        "user-id=%zu "
+                    ),
+                    gifter, gifter, size, channel + 1, gifter, size,
+                    (channel + 1) * 1000000 + gifter
+                );
+            }
+            AppendFormatted(client.outbound, ":tmi.twitch.tv USERNOTICE #%s\r\n", channelName.c_str());
+            ++client.linesGenerated;
+            for (size_t i = 0; i < size; ++i) {
+                const auto recipient = client.random.Below(configuration.chattersPerChannel);
+                if (client.tags) {
+                    AppendFormatted(
+                        client.outbound,
+                        (
+                            "@badge-info=;badges=;display-name=Chatter%zu;login=chatter%zu;"
+                            "msg-id=subgift;msg-param-months=1;msg-param-recipient-display-name=Chatter%zu;"
+                            "msg-param-recipient-id=%zu;msg-param-recipient-user-name=chatter%zu;"
+                            "msg-param-sub-plan=1000;room-id=%zu;"
+                            "system-msg=Chatter%zu\\sgifted\\sa\\sTier\\s1\\ssub\\sto\\sChatter%zu!;"
+                            "user-id=%zu "
+                        ),
+                        gifter, gifter, recipient,
+                        (channel + 1) * 1000000 + recipient, recipient,
+                        channel + 1, gifter, recipient,
+                        (channel + 1) * 1000000 + gifter
+                    );
+                }
+                AppendFormatted(client.outbound, ":tmi.twitch.tv USERNOTICE #%s\r\n", channelName.c_str());
+                ++client.linesGenerated;
+            }
+        }
+
+        /**
+         * This method generates a raid of the given channel.
+         *
+         * @param[in,out] client
+         *     This is the client to which to send the traffic.
+         *
+         * @param[in] channel
+         *     This is the index of the channel in which to generate
+         *     the traffic.
+         */
+        void GenerateRaid(Client& client, size_t channel) {
+            const auto raider = client.random.Below(configuration.chattersPerChannel);
+            const auto viewers = 1 + client.random.Below(10000);
+            const auto& channelName = client.channels[channel];
+            if (client.tags) {
+                AppendFormatted(
+                    client.outbound,
+                    (
+                        "@badge-info=;badges=;display-name=Chatter%zu;login=chatter%zu;"
+                        "msg-id=raid;msg-param-displayName=Chatter%zu;msg-param-login=chatter%zu;"
+                        "msg-param-viewerCount=%zu;room-id=%zu;"
+                        "system-msg=%zu\\sraiders\\sfrom\\sChatter%zu\\shave\\sjoined\\n!;"
+                        "user-id=%zu "
+                    ),
+                    raider, raider, raider, raider, viewers, channel + 1,
+                    viewers, raider,
+                    (channel + 1) * 1000000 + raider
+                );
+            }
+            AppendFormatted(client.outbound, ":tmi.twitch.tv USERNOTICE #%s\r\n", channelName.c_str());
+            ++client.linesGenerated;
+        }
+
+        /**
+         * This method generates a CLEARCHAT storm in the given channel.
+         *
+         * @param[in,out] client
+         *     This is the client to which to send the traffic.
+         *
+         * @param[in] channel
+         *     This is the index of the channel in which to generate
+         *     the traffic.
+         */
+        void GenerateClearChatStorm(Client& client, size_t channel) {
+            const auto& channelName = client.channels[channel];
+            for (size_t i = 0; i < configuration.mix.clearChatStormSize; ++i) {
+                const auto chatter = client.random.Below(configuration.chattersPerChannel);
+                if (client.tags) {
+                    AppendFormatted(
+                        client.outbound,
+                        "@ban-duration=600;room-id=%zu;target-user-id=%zu;tmi-sent-ts=%" PRIu64 " ",
+                        channel + 1,
+                        (channel + 1) * 1000000 + chatter,
+                        (uint64_t)std::chrono::duration_cast< std::chrono::milliseconds >(
+                            std::chrono::system_clock::now().time_since_epoch()
+                        ).count()
+                    );
+                }
+                AppendFormatted(
+                    client.outbound,
+                    ":tmi.twitch.tv CLEARCHAT #%s :chatter%zu\r\n",
+                    channelName.c_str(),
+                    chatter
+                );
+                ++client.linesGenerated;
+            }
+        }
+
+        /**
+         * This method generates synthetic traffic for the given client,
+         * in the channels it has joined, according to the mix of traffic
+         * configured.
+         *
+         * @param[in,out] client
+         *     This is the client to which to send the traffic.
+         *
+         * @param[in] lines
+         *     This is the number of lines to generate.  A sub bomb or
+         *     CLEARCHAT storm begun before this many lines are generated
+         *     is finished, so slightly more may be generated.
+         */
+        void GenerateTraffic(Client& client, size_t lines) {
+            const auto& mix = configuration.mix;
+            const auto clearChatStormsWeight = (
+                (mix.clearChatStormSize == 0)
+                ? 0.0
+                : std::max(mix.clearChatStorms, 0.0)
+            );
+            const auto totalWeight = (
+                std::max(mix.messages, 0.0)
+                + std::max(mix.subBombs, 0.0)
+                + std::max(mix.raids, 0.0)
+                + clearChatStormsWeight
+            );
+            if (totalWeight <= 0.0) {
+                return;
+            }
+            const auto linesBefore = client.linesGenerated;
+            const auto goal = client.linesGenerated + lines;
+            while (client.linesGenerated < goal) {
+                const auto channel = client.random.Below(client.channels.size());
+                auto pick = client.random.Fraction() * totalWeight;
+                if ((pick -= std::max(mix.messages, 0.0)) < 0.0) {
+                    GenerateMessage(client, channel);
+                } else if ((pick -= std::max(mix.subBombs, 0.0)) < 0.0) {
+                    GenerateSubBomb(client, channel);
+                } else if ((pick -= std::max(mix.raids, 0.0)) < 0.0) {
+                    GenerateRaid(client, channel);
+                } else {
+                    GenerateClearChatStorm(client, channel);
+                }
+            }
+            linesSent += client.linesGenerated - linesBefore;
+        }
+
+        /**
+         * This method returns the number of lines of synthetic traffic
+         * which may be generated for the given client right now.
+         *
+         * @param[in] client
+         *     This is the client for which to generate traffic.
+         *
+         * @return
+         *     The number of lines of synthetic traffic which may be
+         *     generated for the given client right now is returned.
+         */
+        size_t GetTrafficBudget(const Client& client) {
+            if (
+                !client.loggedIn
+                || client.quit
+                || client.channels.empty()
+                || (client.outbound.length() - client.outboundSent >= OUTBOUND_LOW_WATER_MARK)
+            ) {
+                return 0;
+            }
+            size_t budget = GENERATE_BATCH_LINES;
+            if (configuration.linesPerSecond > 0) {
+                const auto elapsed = std::chrono::duration< double >(
+                    std::chrono::steady_clock::now() - client.trafficStart
+                ).count();
+                const auto allowed = (size_t)(elapsed * (double)configuration.linesPerSecond);
+                budget = (
+                    (allowed > client.linesGenerated)
+                    ? std::min(budget, allowed - client.linesGenerated)
+                    : 0
+                );
+            }
+            if (configuration.maxLines > 0) {
+                budget = (
+                    (configuration.maxLines > client.linesGenerated)
+                    ? std::min(budget, configuration.maxLines - client.linesGenerated)
+                    : 0
+                );
+            }
+            return budget;
+        }
+
+        /**
+         * This method sends as much data waiting to be sent to the given
+         * client as the network will take without blocking.
+         *
+         * @param[in,out] client
+         *     This is the client to which to send data.
+         *
+         * @return
+         *     An indication of whether or not the client is still
+         *     connected is returned.
+         */
+        bool Flush(Client& client) {
+            while (client.outboundSent < client.outbound.length()) {
+                const auto amountSent = send(
+                    client.socket,
+                    client.outbound.data() + client.outboundSent,
+                    client.outbound.length() - client.outboundSent,
+                    MSG_NOSIGNAL
+                );
+                if (amountSent < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return (
+                        (errno == EAGAIN)
+                        || (errno == EWOULDBLOCK)
+                    );
+                }
+                client.outboundSent += (size_t)amountSent;
+                bytesSent += (size_t)amountSent;
+            }
+            client.outbound.clear();
+            client.outboundSent = 0;
+            return true;
+        }
+
+        /**
+         * This method is the body of each thread which serves a client.
+         *
+         * @param[in] socket
+         *     This is the socket connected to the client.
+         *
+         * @param[in] seed
+         *     This is the seed used to generate the client's traffic.
+         */
+        void ServeClient(int socket, uint64_t seed) {
+            Client client(seed);
+            client.socket = socket;
+            std::vector< char > buffer(RECEIVE_BUFFER_SIZE);
+            while (!stopping) {
+                const auto budget = GetTrafficBudget(client);
+                if (budget > 0) {
+                    GenerateTraffic(client, budget);
+                }
+                if (!Flush(client)) {
+                    break;
+                }
+                if (
+                    client.quit
+                    && client.outbound.empty()
+                ) {
+                    break;
+                }
+                struct pollfd pollSocket;
+                pollSocket.fd = socket;
+                pollSocket.events = POLLIN;
+                pollSocket.revents = 0;
+                int timeout = POLL_TIMEOUT_MILLISECONDS;
+                if (!client.outbound.empty()) {
+                    pollSocket.events |= POLLOUT;
+                } else if (GetTrafficBudget(client) > 0) {
+                    timeout = 0;
+                } else if (
+                    client.loggedIn
+                    && !client.channels.empty()
+                    && (configuration.linesPerSecond > 0)
+                    && (
+                        (configuration.maxLines == 0)
+                        || (client.linesGenerated < configuration.maxLines)
+                    )
+                ) {
+                    timeout = 1;
+                }
+                if (poll(&pollSocket, 1, timeout) < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    break;
+                }
+                if ((pollSocket.revents & POLLIN) != 0) {
+                    const auto amountReceived = recv(socket, buffer.data(), buffer.size(), 0);
+                    if (amountReceived == 0) {
+                        break;
+                    }
+                    if (amountReceived < 0) {
+                        if (
+                            (errno == EINTR)
+                            || (errno == EAGAIN)
+                            || (errno == EWOULDBLOCK)
+                        ) {
+                            continue;
+                        }
+                        break;
+                    }
+                    client.inbound.append(buffer.data(), (size_t)amountReceived);
+                    size_t lineStart = 0;
+                    for (;;) {
+                        const auto lineEnd = client.inbound.find(CRLF, lineStart);
+                        if (lineEnd == std::string::npos) {
+                            break;
+                        }
+                        HandleLine(client, client.inbound.substr(lineStart, lineEnd - lineStart));
+                        lineStart = lineEnd + CRLF.length();
+                    }
+                    client.inbound.erase(0, lineStart);
+                } else if ((pollSocket.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) {
+                    break;
+                }
+            }
+            (void)close(socket);
+        }
+
+        /**
+         * This method is the body of the thread which accepts clients.
+         */
+        void Acceptor() {
+            uint64_t clientNumber = 0;
+            while (!stopping) {
+                struct pollfd pollListener;
+                pollListener.fd = listener;
+                pollListener.events = POLLIN;
+                pollListener.revents = 0;
+                if (poll(&pollListener, 1, POLL_TIMEOUT_MILLISECONDS) <= 0) {
+                    continue;
+                }
+                const auto socket = accept(listener, NULL, NULL);
+                if (socket < 0) {
+                    continue;
+                }
+                (void)fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+                int noDelay = 1;
+                (void)setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+                ++clientsConnected;
+                const auto seed = configuration.seed + clientNumber++;
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                clientThreads.emplace_back(&Impl::ServeClient, this, socket, seed);
+            }
+        }
+    };
+
+    SyntheticServer::~SyntheticServer() noexcept {
+        Stop();
+    }
+
+    SyntheticServer::SyntheticServer()
+        : impl_(new Impl)
+    {
+    }
+
+    bool SyntheticServer::Start(const Configuration& configuration) {
+        Stop();
+        impl_->configuration = configuration;
+        if (impl_->configuration.chattersPerChannel == 0) {
+            impl_->configuration.chattersPerChannel = 1;
+        }
+        impl_->listener = socket(AF_INET, SOCK_STREAM, 0);
+        if (impl_->listener < 0) {
+            return false;
+        }
+        int reuseAddress = 1;
+        (void)setsockopt(impl_->listener, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+        struct sockaddr_in address;
+        (void)memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(configuration.port);
+        socklen_t addressLength = sizeof(address);
+        if (
+            (bind(impl_->listener, (struct sockaddr*)&address, sizeof(address)) != 0)
+            || (listen(impl_->listener, SOMAXCONN) != 0)
+            || (getsockname(impl_->listener, (struct sockaddr*)&address, &addressLength) != 0)
+        ) {
+            (void)close(impl_->listener);
+            impl_->listener = -1;
+            return false;
+        }
+        impl_->port = ntohs(address.sin_port);
+        impl_->stopping = false;
+        impl_->acceptor = std::thread(&Impl::Acceptor, impl_.get());
+        return true;
+    }
+
+    void SyntheticServer::Stop() {
+        if (impl_->listener < 0) {
+            return;
+        }
+        impl_->stopping = true;
+        impl_->acceptor.join();
+        std::vector< std::thread > clientThreads;
+        {
+            std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+            clientThreads.swap(impl_->clientThreads);
+        }
+        for (auto& clientThread: clientThreads) {
+            clientThread.join();
+        }
+        (void)close(impl_->listener);
+        impl_->listener = -1;
+        impl_->port = 0;
+    }
+
+    uint16_t SyntheticServer::GetPort() const {
+        return impl_->port;
+    }
+
+    auto SyntheticServer::GetStatistics() const -> Statistics {
+        Statistics statistics;
+        statistics.clientsConnected = impl_->clientsConnected;
+        statistics.linesReceived = impl_->linesReceived;
+        statistics.linesSent = impl_->linesSent;
+        statistics.bytesSent = impl_->bytesSent;
+        return statistics;
+    }
+
+}
@@ -0,0 +1,210 @@
+#ifndef TWITCH_SYNTHETIC_SERVER_HPP
+#define TWITCH_SYNTHETIC_SERVER_HPP
+
+/**
+ * @file SyntheticServer.hpp
+ *
+ * This module declares the Twitch::SyntheticServer class.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Twitch {
+
+    /**
+     * This is a stand-in for the Twitch chat server which listens on the
+     * loopback interface and, once a client has logged in and joined
+     * channels, floods those channels with synthetic traffic, in order
+     * to load-test clients and this library on one machine.
+     *
+     * The server implements just enough of the Twitch chat protocol
+     * (CAP, PASS, NICK, JOIN, PART, PING, and QUIT) for clients to log in
+     * and join any number of channels.  Each client is served by its own
+     * thread, which batches the traffic it generates into large writes.
+     */
+    class SyntheticServer {
+        // Types
+    public:
+        /**
+         * This holds the relative weights of the different kinds of
+         * traffic to generate.  A weight of zero turns off that kind
+         * of traffic.
+         */
+        struct TrafficMix {
+            /**
+             * This is the weight of ordinary chat messages (PRIVMSG).
+             */
+            double messages = 1.0;
+
+            /**
+             * This is the weight of sub bombs: a USERNOTICE announcing
+             * a number of gift subscriptions, followed by a USERNOTICE for
+             * each of them.
+             */
+            double subBombs = 0.0;
+
+            /**
+             * This is the weight of raids (USERNOTICE with msg-id=raid).
+             */
+            double raids = 0.0;
+
+            /**
+             * This is the weight of CLEARCHAT storms: a burst of CLEARCHAT
+             * commands, each timing out a different chatter.
+             */
+            double clearChatStorms = 0.0;
+
+            /**
+             * This is the number of gift subscriptions in each sub bomb.
+             */
+            size_t subBombSize = 20;
+
+            /**
+             * This is the number of CLEARCHAT commands in each storm.
+             * If zero, no storms are generated, whatever their weight.
+             */
+            size_t clearChatStormSize = 50;
+        };
+
+        /**
+         * This holds the settings of the server.
+         */
+        struct Configuration {
+            /**
+             * This is the port on which to listen for clients,
+             * or zero to pick any available port.
+             */
+            uint16_t port = 0;
+
+            /**
+             * This is the most number of lines of synthetic traffic to
+             * send to each client per second, or zero to send them as
+             * fast as the client takes them.
+             */
+            size_t linesPerSecond = 0;
+
+            /**
+             * This is the most number of lines of synthetic traffic to
+             * send to each client, or zero for no limit.
+             */
+            size_t maxLines = 0;
+
+            /**
+             * This is the number of different chatters to pretend are
+             * in each channel.
+             */
+            size_t chattersPerChannel = 1000;
+
+            /**
+             * This is the seed of the pseudo-random number generator used
+             * to generate traffic, so that the same traffic can be
+             * generated again.
+             */
+            uint64_t seed = 1;
+
+            /**
+             * These are the relative weights of the different kinds
+             * of traffic to generate.
+             */
+            TrafficMix mix;
+        };
+
+        /**
+         * This holds counts of what the server has done so far.
+         */
+        struct Statistics {
+            /**
+             * This is the number of clients which have connected.
+             */
+            size_t clientsConnected = 0;
+
+            /**
+             * This is the number of lines received from clients.
+             */
+            size_t linesReceived = 0;
+
+            /**
+             * This is the number of lines sent to clients, including
+             * synthetic traffic.
+             */
+            size_t linesSent = 0;
+
+            /**
+             * This is the number of bytes sent to clients.
+             */
+            size_t bytesSent = 0;
+        };
+
+        // Lifecycle management
+    public:
+        ~SyntheticServer() noexcept;
+        SyntheticServer(const SyntheticServer& other) = delete;
+        SyntheticServer(SyntheticServer&&) noexcept = delete;
+        SyntheticServer& operator=(const SyntheticServer& other) = delete;
+        SyntheticServer& operator=(SyntheticServer&&) noexcept = delete;
+
+        // Public methods
+    public:
+        /**
+         * This is the default constructor.
+         */
+        SyntheticServer();
+
+        /**
+         * This method starts listening for clients on the loopback
+         * interface.
+         *
+         * @param[in] configuration
+         *     These are the settings of the server.
+         *
+         * @return
+         *     An indication of whether or not the server started
+         *     is returned.
+         */
+        bool Start(const Configuration& configuration);
+
+        /**
+         * This method stops the server, disconnecting all clients.
+         */
+        void Stop();
+
+        /**
+         * This method returns the port on which the server is listening
+         * for clients.
+         *
+         * @return
+         *     The port on which the server is listening for clients,
+         *     or zero if the server isn't started, is returned.
+         */
+        uint16_t GetPort() const;
+
+        /**
+         * This method returns counts of what the server has done so far.
+         *
+         * @return
+         *     Counts of what the server has done so far are returned.
+         */
+        Statistics GetStatistics() const;
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
+
+#endif /* TWITCH_SYNTHETIC_SERVER_HPP */
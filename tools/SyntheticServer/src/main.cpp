@@ -0,0 +1,140 @@
+/**
+ * @file main.cpp
+ *
+ * This module holds the main() function, which is the entrypoint
+ * to the program which runs a synthetic Twitch chat server on the
+ * loopback interface, for load testing.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include "SyntheticServer.hpp"
+
+#include <chrono>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <thread>
+
+namespace {
+
+    /**
+     * This flag is set when the program is asked to stop.
+     */
+    volatile sig_atomic_t shutDown = 0;
+
+    /**
+     * This function is called when the program is asked to stop.
+     *
+     * @param[in] signalNumber
+     *     This is the signal received.
+     */
+    void OnSignal(int signalNumber) {
+        (void)signalNumber;
+        shutDown = 1;
+    }
+
+}
+
+/**
+ * This function prints to the standard error stream information
+ * about how to use this program.
+ */
+void PrintUsageInformation() {
+    fprintf(
+        stderr,
+        (
+            "Usage: TwitchSyntheticServer [OPTION]...\n"
+            "\n"
+            "Run a synthetic Twitch chat server on the loopback interface which floods\n"
+            "the channels joined by each client with generated traffic.\n"
+            "\n"
+            "  --port N               Port on which to listen (default: any available port)\n"
+            "  --rate N               Lines per second per client (default: 0, unlimited)\n"
+            "  --max-lines N          Lines of traffic per client (default: 0, unlimited)\n"
+            "  --chatters N           Chatters per channel (default: 1000)\n"
+            "  --seed N               Seed for generating traffic (default: 1)\n"
+            "  --messages W           Weight of PRIVMSG traffic (default: 1)\n"
+            "  --sub-bombs W          Weight of sub bombs (default: 0)\n"
+            "  --raids W              Weight of raids (default: 0)\n"
+            "  --clearchat-storms W   Weight of CLEARCHAT storms (default: 0)\n"
+            "  --sub-bomb-size N      Gift subscriptions per sub bomb (default: 20)\n"
+            "  --storm-size N         CLEARCHAT commands per storm; 0 means no storms (default: 50)\n"
+        )
+    );
+}
+
+/**
+ * This function is the entrypoint of the program.
+ *
+ * @param[in] argc
+ *     This is the number of command-line arguments given to the program.
+ *
+ * @param[in] argv
+ *     This is the array of command-line arguments given to the program.
+ */
+int main(int argc, char* argv[]) {
+    Twitch::SyntheticServer::Configuration configuration;
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (i + 1 >= argc) {
+            PrintUsageInformation();
+            return EXIT_FAILURE;
+        }
+        const char* value = argv[++i];
+        if (option == "--port") {
+            configuration.port = (uint16_t)strtoul(value, NULL, 10);
+        } else if (option == "--rate") {
+            configuration.linesPerSecond = (size_t)strtoull(value, NULL, 10);
+        } else if (option == "--max-lines") {
+            configuration.maxLines = (size_t)strtoull(value, NULL, 10);
+        } else if (option == "--chatters") {
+            configuration.chattersPerChannel = (size_t)strtoull(value, NULL, 10);
+        } else if (option == "--seed") {
+            configuration.seed = (uint64_t)strtoull(value, NULL, 10);
+        } else if (option == "--messages") {
+            configuration.mix.messages = strtod(value, NULL);
+        } else if (option == "--sub-bombs") {
+            configuration.mix.subBombs = strtod(value, NULL);
+        } else if (option == "--raids") {
+            configuration.mix.raids = strtod(value, NULL);
+        } else if (option == "--clearchat-storms") {
+            configuration.mix.clearChatStorms = strtod(value, NULL);
+        } else if (option == "--sub-bomb-size") {
+            configuration.mix.subBombSize = (size_t)strtoull(value, NULL, 10);
+        } else if (option == "--storm-size") {
+            configuration.mix.clearChatStormSize = (size_t)strtoull(value, NULL, 10);
+        } else {
+            PrintUsageInformation();
+            return EXIT_FAILURE;
+        }
+    }
+    Twitch::SyntheticServer server;
+    if (!server.Start(configuration)) {
+        fprintf(stderr, "error: unable to listen on port %u (%s)\n", (unsigned int)configuration.port, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    (void)signal(SIGINT, OnSignal);
+    (void)signal(SIGTERM, OnSignal);
+    printf("Listening on 127.0.0.1:%u\n", (unsigned int)server.GetPort());
+    (void)fflush(stdout);
+    auto lastStatistics = server.GetStatistics();
+    while (!shutDown) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        const auto statistics = server.GetStatistics();
+        printf(
+            "clients: %zu, lines/s: %zu, MB/s: %.1f, lines received: %zu\n",
+            statistics.clientsConnected,
+            statistics.linesSent - lastStatistics.linesSent,
+            (double)(statistics.bytesSent - lastStatistics.bytesSent) / 1e6,
+            statistics.linesReceived
+        );
+        (void)fflush(stdout);
+        lastStatistics = statistics;
+    }
+    server.Stop();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file main.cpp
+ *
+ * This module holds the main() function, which is the entrypoint
+ * to the program which decodes files of traffic recorded by
+ * Twitch::TrafficRecorder into text.
+ *
+ * © 2018 by Richard Walters
+ */
+
+#include <fstream>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <Twitch/TrafficRecorder.hpp>
+
+/**
+ * This function prints to the standard error stream information
+ * about how to use this program.
+ */
+void PrintUsageInformation() {
+    fprintf(
+        stderr,
+        (
+            "Usage: TwitchTrafficDecoder FILE\n"
+            "\n"
+            "Decode a file of traffic recorded with Twitch::TrafficRecorder,\n"
+            "printing each record as a line of text to the standard output stream.\n"
+            "\n"
+            "  FILE     Path to the file of recorded traffic to decode\n"
+        )
+    );
+}
+
+/**
+ * This function is the entrypoint of the program.
+ *
+ * @param[in] argc
+ *     This is the number of command-line arguments given to the program.
+ *
+ * @param[in] argv
+ *     This is the array of command-line arguments given to the program.
+ */
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        PrintUsageInformation();
+        return EXIT_FAILURE;
+    }
+    std::ifstream input(argv[1], std::ios::binary);
+    if (!input) {
+        fprintf(stderr, "error: unable to open file '%s'\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    if (!Twitch::TrafficRecorder::ReadHeader(input)) {
+        fprintf(stderr, "error: '%s' is not a file of recorded traffic\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    Twitch::TrafficRecorder::Record record;
+    while (Twitch::TrafficRecorder::ReadRecord(input, record)) {
+        std::cout << Twitch::TrafficRecorder::FormatRecord(record) << '\n';
+    }
+    return EXIT_SUCCESS;
+}